@@ -3,6 +3,8 @@
 
 #include <string>
 #include <string_view>
+#include <cstdint>
+#include <vector>
 
 #include "utils/mac.hpp"
 
@@ -21,6 +23,9 @@ namespace hub
         struct
         {
             std::string     uri;
+            uint32_t        batch_period{ 1000 };      // Miliseconds, maximum time a scan result waits before being published.
+            uint32_t        batch_size{ 32 };          // Maximum number of scan results in a single message.
+            uint32_t        diagnostics_period{ 60 };  // Seconds between scanner statistics messages, 0 disables them.
         } mqtt;
 
         struct
@@ -29,6 +34,50 @@ namespace hub
             std::string     object_id;
             std::string     discovery_prefix;
         } general;
+
+        struct
+        {
+            uint32_t        duplicate_ttl{ 60000 };    // Miliseconds, 0 forwards every advertisement.
+            uint32_t        interval{ 50 };            // Miliseconds.
+            uint32_t        window{ 30 };              // Miliseconds, at most interval.
+            uint32_t        duration{ 3 };             // Seconds, length of a scan burst or of a single continuous scan cycle.
+            bool            continuous{ false };       // Scan all the time instead of on the switch command.
+        } scan;
+
+        struct
+        {
+            std::string     path;                      // File the raw scan results are written to, empty disables file recording.
+            bool            mqtt{ false };             // Publish the raw scan results log on the recording topic.
+        } recording;
+
+        struct connection_profile
+        {
+            std::string     name;
+            double          min_interval;              // Miliseconds, multiple of 1.25.
+            double          max_interval;              // Miliseconds, multiple of 1.25.
+            uint32_t        latency;                   // Connection events the device may skip.
+            uint32_t        timeout;                   // Miliseconds, multiple of 10.
+        };
+
+        struct
+        {
+            uint32_t        park_time{ 10 };           // Seconds a device stays connected after its last command.
+            uint32_t        poll_period{ 300 };        // Seconds between visits of devices without commands, 0 connects only for commands.
+            uint32_t        backoff_base{ 1 };         // Seconds before retrying a failed connection, doubled with every further failure.
+            uint32_t        backoff_max{ 300 };        // Longest delay in seconds between connection attempts.
+            std::vector<connection_profile> profiles;  // Besides the built-in low_latency, balanced and low_power profiles.
+        } connections;
+
+        struct device
+        {
+            utils::mac      address;
+            bool            random_address{ false };
+            std::string     type;                      // Device mapper name, empty for devices that are only scanned.
+            std::string     active_profile{ "low_latency" };   // Connection profile while commands are delivered.
+            std::string     idle_profile{ "low_power" };       // Connection profile while listening for notifications.
+        };
+
+        std::vector<device> devices;                   // Device inventory, when not empty only these devices are scanned.
     };
 }
 
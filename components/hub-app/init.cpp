@@ -1,5 +1,7 @@
 // #include "esp_mac.h"
 
+#include <algorithm>
+
 #include "rxcpp/rx.hpp"
 
 #include "rapidjson/document.h"
@@ -66,13 +68,230 @@ namespace hub
             })
             .and_then([&config](rjs::Document&& js_config) -> tl::expected<rapidjson::Document, esp_err_t> {
                 if (!js_config["mqtt"].IsObject() ||
-                    !js_config["mqtt"]["uri"].IsString())
+                    !js_config["mqtt"]["uri"].IsString() ||
+                    (js_config["mqtt"].HasMember("batch_period") && !js_config["mqtt"]["batch_period"].IsUint()) ||
+                    (js_config["mqtt"].HasMember("batch_size") && !js_config["mqtt"]["batch_size"].IsUint()) ||
+                    (js_config["mqtt"].HasMember("diagnostics_period") && !js_config["mqtt"]["diagnostics_period"].IsUint()))
                 {
                     return tl::make_unexpected<esp_err_t>(ESP_ERR_INVALID_ARG);
                 }
 
                 config.mqtt.uri = js_config["mqtt"]["uri"].GetString();
 
+                if (js_config["mqtt"].HasMember("batch_period"))
+                {
+                    config.mqtt.batch_period = js_config["mqtt"]["batch_period"].GetUint();
+                }
+
+                if (js_config["mqtt"].HasMember("batch_size"))
+                {
+                    config.mqtt.batch_size = std::max(js_config["mqtt"]["batch_size"].GetUint(), 1u);
+                }
+
+                if (js_config["mqtt"].HasMember("diagnostics_period"))
+                {
+                    config.mqtt.diagnostics_period = js_config["mqtt"]["diagnostics_period"].GetUint();
+                }
+
+                return std::move(js_config);
+            })
+            .and_then([&config](rjs::Document&& js_config) -> tl::expected<rapidjson::Document, esp_err_t> {
+                // Optional section, defaults are kept for missing members.
+                if (!js_config.HasMember("scan"))
+                {
+                    return std::move(js_config);
+                }
+
+                const auto& js_scan = js_config["scan"];
+
+                if (!js_scan.IsObject() ||
+                    (js_scan.HasMember("duplicate_ttl") && !js_scan["duplicate_ttl"].IsUint()) ||
+                    (js_scan.HasMember("interval") && !js_scan["interval"].IsUint()) ||
+                    (js_scan.HasMember("window") && !js_scan["window"].IsUint()) ||
+                    (js_scan.HasMember("duration") && !js_scan["duration"].IsUint()) ||
+                    (js_scan.HasMember("continuous") && !js_scan["continuous"].IsBool()))
+                {
+                    return tl::make_unexpected<esp_err_t>(ESP_ERR_INVALID_ARG);
+                }
+
+                if (js_scan.HasMember("duplicate_ttl"))
+                {
+                    config.scan.duplicate_ttl = js_scan["duplicate_ttl"].GetUint();
+                }
+
+                if (js_scan.HasMember("interval"))
+                {
+                    config.scan.interval = js_scan["interval"].GetUint();
+                }
+
+                if (js_scan.HasMember("window"))
+                {
+                    config.scan.window = js_scan["window"].GetUint();
+                }
+
+                if (js_scan.HasMember("duration"))
+                {
+                    config.scan.duration = js_scan["duration"].GetUint();
+                }
+
+                if (js_scan.HasMember("continuous"))
+                {
+                    config.scan.continuous = js_scan["continuous"].GetBool();
+                }
+
+                return std::move(js_config);
+            })
+            .and_then([&config](rjs::Document&& js_config) -> tl::expected<rapidjson::Document, esp_err_t> {
+                // Optional section, recording is disabled without it.
+                if (!js_config.HasMember("recording"))
+                {
+                    return std::move(js_config);
+                }
+
+                const auto& js_recording = js_config["recording"];
+
+                if (!js_recording.IsObject() ||
+                    (js_recording.HasMember("path") && !js_recording["path"].IsString()) ||
+                    (js_recording.HasMember("mqtt") && !js_recording["mqtt"].IsBool()))
+                {
+                    return tl::make_unexpected<esp_err_t>(ESP_ERR_INVALID_ARG);
+                }
+
+                if (js_recording.HasMember("path"))
+                {
+                    config.recording.path = js_recording["path"].GetString();
+                }
+
+                if (js_recording.HasMember("mqtt"))
+                {
+                    config.recording.mqtt = js_recording["mqtt"].GetBool();
+                }
+
+                return std::move(js_config);
+            })
+            .and_then([&config](rjs::Document&& js_config) -> tl::expected<rapidjson::Document, esp_err_t> {
+                // Optional section, defaults are kept for missing members.
+                if (!js_config.HasMember("connections"))
+                {
+                    return std::move(js_config);
+                }
+
+                const auto& js_connections = js_config["connections"];
+
+                if (!js_connections.IsObject() ||
+                    (js_connections.HasMember("park_time") && !js_connections["park_time"].IsUint()) ||
+                    (js_connections.HasMember("poll_period") && !js_connections["poll_period"].IsUint()) ||
+                    (js_connections.HasMember("backoff_base") && !js_connections["backoff_base"].IsUint()) ||
+                    (js_connections.HasMember("backoff_max") && !js_connections["backoff_max"].IsUint()) ||
+                    (js_connections.HasMember("profiles") && !js_connections["profiles"].IsObject()))
+                {
+                    return tl::make_unexpected<esp_err_t>(ESP_ERR_INVALID_ARG);
+                }
+
+                if (js_connections.HasMember("park_time"))
+                {
+                    config.connections.park_time = js_connections["park_time"].GetUint();
+                }
+
+                if (js_connections.HasMember("poll_period"))
+                {
+                    config.connections.poll_period = js_connections["poll_period"].GetUint();
+                }
+
+                if (js_connections.HasMember("backoff_base"))
+                {
+                    config.connections.backoff_base = js_connections["backoff_base"].GetUint();
+                }
+
+                if (js_connections.HasMember("backoff_max"))
+                {
+                    config.connections.backoff_max = js_connections["backoff_max"].GetUint();
+                }
+
+                if (js_connections.HasMember("profiles"))
+                {
+                    for (const auto& js_profile : js_connections["profiles"].GetObject())
+                    {
+                        const auto& js_params = js_profile.value;
+
+                        if (!js_params.IsObject() ||
+                            !js_params.HasMember("min_interval") || !js_params["min_interval"].IsNumber() ||
+                            !js_params.HasMember("max_interval") || !js_params["max_interval"].IsNumber() ||
+                            !js_params.HasMember("latency") || !js_params["latency"].IsUint() ||
+                            !js_params.HasMember("timeout") || !js_params["timeout"].IsUint())
+                        {
+                            return tl::make_unexpected<esp_err_t>(ESP_ERR_INVALID_ARG);
+                        }
+
+                        config.connections.profiles.push_back(configuration::connection_profile{
+                            js_profile.name.GetString(),
+                            js_params["min_interval"].GetDouble(),
+                            js_params["max_interval"].GetDouble(),
+                            js_params["latency"].GetUint(),
+                            js_params["timeout"].GetUint()
+                        });
+                    }
+                }
+
+                return std::move(js_config);
+            })
+            .and_then([&config](rjs::Document&& js_config) -> tl::expected<rapidjson::Document, esp_err_t> {
+                // Optional section, without it all devices are scanned.
+                if (!js_config.HasMember("devices"))
+                {
+                    return std::move(js_config);
+                }
+
+                if (!js_config["devices"].IsArray())
+                {
+                    return tl::make_unexpected<esp_err_t>(ESP_ERR_INVALID_ARG);
+                }
+
+                for (const auto& js_device : js_config["devices"].GetArray())
+                {
+                    if (!js_device.IsObject() ||
+                        !js_device.HasMember("address") ||
+                        !js_device["address"].IsString() ||
+                        js_device["address"].GetStringLength() != utils::mac::MAC_STR_SIZE ||
+                        (js_device.HasMember("address_type") && !js_device["address_type"].IsString()) ||
+                        (js_device.HasMember("type") && !js_device["type"].IsString()) ||
+                        (js_device.HasMember("active_profile") && !js_device["active_profile"].IsString()) ||
+                        (js_device.HasMember("idle_profile") && !js_device["idle_profile"].IsString()))
+                    {
+                        return tl::make_unexpected<esp_err_t>(ESP_ERR_INVALID_ARG);
+                    }
+
+                    auto& device = config.devices.emplace_back();
+                    device.address = utils::mac(std::string_view(js_device["address"].GetString(), js_device["address"].GetStringLength()));
+
+                    if (js_device.HasMember("address_type"))
+                    {
+                        std::string_view address_type = js_device["address_type"].GetString();
+
+                        if (address_type != "public" && address_type != "random")
+                        {
+                            return tl::make_unexpected<esp_err_t>(ESP_ERR_INVALID_ARG);
+                        }
+
+                        device.random_address = (address_type == "random");
+                    }
+
+                    if (js_device.HasMember("type"))
+                    {
+                        device.type = js_device["type"].GetString();
+                    }
+
+                    if (js_device.HasMember("active_profile"))
+                    {
+                        device.active_profile = js_device["active_profile"].GetString();
+                    }
+
+                    if (js_device.HasMember("idle_profile"))
+                    {
+                        device.idle_profile = js_device["idle_profile"].GetString();
+                    }
+                }
+
                 return std::move(js_config);
             })
             .and_then([&config](rjs::Document&& js_config) -> tl::expected<configuration, esp_err_t> {
@@ -1,5 +1,13 @@
 #include <memory>
+#include <cstdio>
 #include <array>
+#include <algorithm>
+#include <limits>
+#include <chrono>
+#include <vector>
+#include <optional>
+#include <string_view>
+#include <cmath>
 
 #include "esp_err.h"
 #include "esp_log.h"
@@ -8,15 +16,217 @@
 
 #include "fmt/format.h"
 #include "rapidjson/document.h"
+#include "rapidjson/writer.h"
+#include "rapidjson/stringbuffer.h"
 
 #include "mqtt/client.hpp"
 #include "utils/json.hpp"
+#include "mappers/mappers.hpp"
+#include "connection_manager.hpp"
 
 #include "app/consts.hpp"
 #include "app/running.hpp"
 
 namespace hub
 {
+    namespace
+    {
+        void write_scan_result(rjs::Writer<rjs::StringBuffer>& writer, const ble::scanner::message_type& message)
+        {
+            std::array<char, utils::mac::MAC_STR_SIZE> address;
+            utils::mac(message.address.begin(), message.address.end()).to_charbuff(address.begin());
+
+            auto name = message.get_name();
+
+            writer.StartObject();
+            writer.Key("name");
+            writer.String(name.data(), static_cast<rjs::SizeType>(name.length()));
+            writer.Key("address");
+            writer.String(address.data(), static_cast<rjs::SizeType>(address.size()));
+            writer.Key("rssi");
+            writer.Int(message.rssi);
+
+            // Connectionless sensors broadcast their readings, publish them along with the scan result.
+            device::passive::reading reading{  };
+
+            if (device::mappers::decode_advertisement(message, reading))
+            {
+                for (const auto& measurement : reading)
+                {
+                    auto key = device::passive::to_string(measurement.type);
+                    writer.Key(key.data(), static_cast<rjs::SizeType>(key.length()));
+                    writer.Double(measurement.value);
+                }
+            }
+
+            writer.EndObject();
+        }
+
+        void write_histogram(rjs::Writer<rjs::StringBuffer>& writer, const char* name, const ble::scanner::latency_histogram::snapshot_type& histogram)
+        {
+            writer.Key(name);
+            writer.StartObject();
+            writer.Key("count");
+            writer.Uint(histogram.count);
+            writer.Key("mean_us");
+            writer.Uint(histogram.mean());
+            writer.Key("p50_us");
+            writer.Uint64(histogram.percentile(50));
+            writer.Key("p99_us");
+            writer.Uint64(histogram.percentile(99));
+            writer.Key("max_us");
+            writer.Uint(histogram.max);
+            writer.EndObject();
+        }
+
+        void write_connections(rjs::Writer<rjs::StringBuffer>& writer, const std::vector<device::connection_manager::link_t>& links)
+        {
+            writer.Key("connections");
+            writer.StartArray();
+
+            for (const auto& link : links)
+            {
+                std::array<char, utils::mac::MAC_STR_SIZE> address;
+                link.address.to_charbuff(address.begin());
+
+                writer.StartObject();
+                writer.Key("address");
+                writer.String(address.data(), static_cast<rjs::SizeType>(address.size()));
+                writer.Key("connected");
+                writer.Bool(link.connected);
+                writer.Key("health");
+                writer.Uint(link.health.score());
+                writer.Key("success_rate");
+                writer.Double(link.health.get_success_rate() / 1000.0);
+                writer.Key("failures");
+                writer.Uint(link.health.get_failures());
+                writer.Key("drops");
+                writer.Uint(link.health.get_drops());
+
+                if (link.health.get_connect_time() != 0)
+                {
+                    writer.Key("connect_ms");
+                    writer.Uint(link.health.get_connect_time());
+                }
+
+                if (link.health.get_rssi() != device::link_health::RSSI_UNKNOWN)
+                {
+                    writer.Key("rssi");
+                    writer.Int(link.health.get_rssi());
+                }
+
+                if (link.retry_in != 0)
+                {
+                    writer.Key("retry_in_ms");
+                    writer.Uint(link.retry_in);
+                }
+
+                writer.Key("gatt");
+                writer.StartObject();
+
+                for (std::size_t metric = 0; metric < link.timing.size(); metric++)
+                {
+                    if (link.timing[metric].count != 0)
+                    {
+                        write_histogram(writer, ble::operation_timing::get_name(metric), link.timing[metric]);
+                    }
+                }
+
+                writer.EndObject();
+
+                if (link.connected && link.params.timeout != 0)
+                {
+                    writer.Key("profile");
+                    writer.String(link.idle ? "idle" : "active");
+                    writer.Key("interval_ms");
+                    writer.Double(link.params.max_interval * 1.25);
+                    writer.Key("latency");
+                    writer.Uint(link.params.latency);
+                    writer.Key("timeout_ms");
+                    writer.Uint(link.params.timeout * 10u);
+                }
+
+                writer.EndObject();
+            }
+
+            writer.EndArray();
+        }
+
+        void write_statistics(
+            rjs::Writer<rjs::StringBuffer>&                         writer, 
+            const ble::scanner::statistics_t&                       statistics, 
+            const ble::scanner::statistics_t&                       previous, 
+            uint32_t                                                period,
+            const std::vector<device::connection_manager::link_t>&  links)
+        {
+            writer.StartObject();
+            writer.Key("received");
+            writer.Uint(statistics.received);
+            writer.Key("received_per_second");
+            writer.Double(static_cast<double>(statistics.received - previous.received) / period);
+            writer.Key("unnamed");
+            writer.Uint(statistics.unnamed);
+            writer.Key("filtered");
+            writer.Uint(statistics.filtered);
+            writer.Key("suppressed");
+            writer.Uint(statistics.suppressed);
+            writer.Key("dropped");
+            writer.Uint(statistics.dropped);
+            writer.Key("forwarded");
+            writer.Uint(statistics.forwarded);
+            write_histogram(writer, "callback_duration", statistics.callback_duration);
+            write_histogram(writer, "publish_latency", statistics.publish_latency);
+
+            if (!links.empty())
+            {
+                write_connections(writer, links);
+            }
+
+            writer.EndObject();
+        }
+
+        /**
+         * @brief Parameters of a connection profile defined in the configuration, or of a built-in one.
+         */
+        std::optional<ble::connection_params> find_connection_profile(const configuration& config, std::string_view name)
+        {
+            // Intervals are configured in miliseconds, the controller expects units of 1.25 ms and the timeout in units of 10 ms.
+            const auto to_units = [](double duration, double unit) {
+                return static_cast<uint16_t>(std::clamp<long>(std::lround(duration / unit), 0, std::numeric_limits<uint16_t>::max()));
+            };
+
+            for (const auto& profile : config.connections.profiles)
+            {
+                if (profile.name == name)
+                {
+                    return ble::connection_params{
+                        to_units(profile.min_interval, 1.25),
+                        to_units(profile.max_interval, 1.25),
+                        static_cast<uint16_t>(std::min<uint32_t>(profile.latency, std::numeric_limits<uint16_t>::max())),
+                        to_units(profile.timeout, 10.0)
+                    };
+                }
+            }
+
+            if (name == "low_latency")
+            {
+                return ble::connection_profile::low_latency;
+            }
+
+            if (name == "balanced")
+            {
+                return ble::connection_profile::balanced;
+            }
+
+            if (name == "low_power")
+            {
+                return ble::connection_profile::low_power;
+            }
+
+            return std::nullopt;
+        }
+    }
+
     running_t::running_t(const configuration& config) :
         m_config{ std::cref(config) }
     {
@@ -57,27 +267,280 @@ namespace hub
 
         std::string switch_command_topic = make_topic(switch_topic_prefix, "set");
         std::string sensor_state_topic   = make_topic(sensor_topic_prefix, "state");
+        std::string diagnostics_topic    = make_topic(sensor_topic_prefix, "diagnostics");
 
-        auto ble_scan_results = mqtt_client.subscribe(switch_command_topic) |
-            filter([](std::string_view message) {
-                return message == "ON";
-            }) |
-            map([make_ble_scanner{ ble::scanner::get_observable_factory() }](std::string_view) { 
-                return make_ble_scanner(3); 
+        // Scan interval and window are given in miliseconds, the controller expects units of 0.625 ms.
+        const auto to_scan_units = [](uint32_t duration) {
+            return static_cast<uint16_t>(std::min<uint32_t>((duration * 8) / 5, std::numeric_limits<uint16_t>::max()));
+        };
+
+        ble::scanner::config_t scanner_config{
+            timing::miliseconds(config.scan.duplicate_ttl),
+            to_scan_units(config.scan.interval),
+            to_scan_units(config.scan.window),
+            config.scan.continuous
+        };
+
+        // Devices in the inventory are filtered by the controller, so advertisements of other devices never reach the host.
+        for (const auto& device : config.devices)
+        {
+            auto& entry = scanner_config.accept_list.emplace_back();
+            const auto* address = static_cast<const uint8_t*>(device.address);
+
+            std::copy(address, address + utils::mac::MAC_SIZE, entry.address.begin());
+            entry.type = device.random_address ? BLE_ADDR_TYPE_RANDOM : BLE_ADDR_TYPE_PUBLIC;
+        }
+
+        // In continuous mode scanning starts right away and never completes, otherwise it runs on every "ON" command.
+        rx::observable<std::string_view> scan_trigger = config.scan.continuous ?
+            rx::observable<>::just<std::string_view>("ON"sv).as_dynamic() :
+            (mqtt_client.subscribe(switch_command_topic) |
+                filter([](std::string_view message) {
+                    return message == "ON";
+                })).as_dynamic();
+
+        // Raw scan results are recorded before any filtering, to be replayed on the host.
+        std::string recording_topic = make_topic(sensor_topic_prefix, "recording");
+        rx::subjects::subject<std::string_view> recording_subject;
+
+        // The scanner holds a raw pointer, it is cleared before the recorder is destroyed on any return path.
+        const auto release_recorder = [](ble::recording::recorder* recorder) {
+            ble::scanner::set_recorder(nullptr);
+            delete recorder;
+        };
+
+        std::unique_ptr<ble::recording::recorder, decltype(release_recorder)> recorder{ nullptr, release_recorder };
+
+        if (!config.recording.path.empty() || config.recording.mqtt)
+        {
+            std::shared_ptr<std::FILE> file;
+
+            if (!config.recording.path.empty())
+            {
+                if (file = std::shared_ptr<std::FILE>(std::fopen(config.recording.path.c_str(), "wb"), &std::fclose); !file)
+                {
+                    ESP_LOGE(TAG, "Could not open recording file %s.", config.recording.path.c_str());
+                    return tl::make_unexpected(ESP_ERR_NOT_FOUND);
+                }
+            }
+
+            if (config.recording.mqtt)
+            {
+                recording_subject.get_observable() |
+                    mqtt_client.publish(recording_topic) |
+                    subscribe<int>();
+            }
+
+            try
+            {
+                recorder.reset(new ble::recording::recorder(
+                    [file, mqtt{ config.recording.mqtt }, subscriber{ recording_subject.get_subscriber() }](const uint8_t* data, std::size_t length) {
+                        if (file)
+                        {
+                            std::fwrite(data, 1, length, file.get());
+                            std::fflush(file.get());
+                        }
+
+                        if (mqtt)
+                        {
+                            subscriber.on_next(std::string_view(reinterpret_cast<const char*>(data), length));
+                        }
+                    }));
+            }
+            catch (const utils::esp_exception& err)
+            {
+                return tl::make_unexpected(err.errc());
+            }
+
+            ble::scanner::set_recorder(recorder.get());
+        }
+
+        // GATT devices of the inventory share the connection slots, commands are delivered on their next connection.
+        std::string device_command_topic = make_topic(switch_topic_prefix, "device/set");
+        std::string device_state_topic   = make_topic(sensor_topic_prefix, "device");
+        rx::subjects::subject<std::string> device_state_subject;
+        rx::composite_subscription device_commands;
+        std::unique_ptr<device::connection_manager> connection_manager;
+
+        if (std::any_of(config.devices.cbegin(), config.devices.cend(), [](const auto& device) { return device::mappers::is_device_supported(device.type); }))
+        {
+            // States are delivered from the Bluedroid task, publishing runs on the event loop like the scan results.
+            device_state_subject.get_observable() |
+                observe_on(rx::observe_on_event_loop()) |
+                map([cache{ std::string() }](std::string payload) mutable {
+                    cache = std::move(payload);
+                    return std::string_view(cache);
+                }) |
+                mqtt_client.publish(device_state_topic) |
+                subscribe<int>();
+
+            try
+            {
+                connection_manager = std::make_unique<device::connection_manager>(
+                    device::connection_manager::config_t{
+                        static_cast<uint8_t>(ble::MAX_CLIENTS),
+                        timing::seconds(config.connections.park_time),
+                        timing::seconds(config.connections.poll_period),
+                        timing::seconds(config.connections.backoff_base),
+                        timing::seconds(config.connections.backoff_max)
+                    },
+                    [subscriber{ device_state_subject.get_subscriber() }](const utils::mac&, std::string_view payload) {
+                        subscriber.on_next(std::string(payload));
+                    });
+            }
+            catch (const utils::esp_exception& err)
+            {
+                return tl::make_unexpected(err.errc());
+            }
+
+            for (const auto& device : config.devices)
+            {
+                if (!device::mappers::is_device_supported(device.type))
+                {
+                    continue;
+                }
+
+                const auto active   = find_connection_profile(config, device.active_profile);
+                const auto idle     = find_connection_profile(config, device.idle_profile);
+
+                if (!active || !idle)
+                {
+                    ESP_LOGE(TAG, "Unknown connection profile of %s.", std::string(device.address).c_str());
+                    return tl::make_unexpected(ESP_ERR_INVALID_ARG);
+                }
+
+                const esp_ble_addr_type_t address_type = device.random_address ? BLE_ADDR_TYPE_RANDOM : BLE_ADDR_TYPE_PUBLIC;
+
+                if (esp_err_t result = connection_manager->add_device(device.address, address_type, device::mappers::make_device(device.type), { *active, *idle }); result != ESP_OK)
+                {
+                    ESP_LOGE(TAG, "Could not add %s, error code %i [%s].", std::string(device.address).c_str(), result, esp_err_to_name(result));
+                    return tl::make_unexpected(result);
+                }
+            }
+
+            device_commands = mqtt_client.subscribe(device_command_topic).subscribe([manager{ connection_manager.get() }, &config](std::string_view message) {
+                device::device_base::in_message_t command;
+
+                if (command.Parse(message.data(), message.length()).HasParseError() ||
+                    !command.IsObject() ||
+                    !command.HasMember("address") ||
+                    !command["address"].IsString() ||
+                    command["address"].GetStringLength() != utils::mac::MAC_STR_SIZE)
+                {
+                    ESP_LOGW(TAG, "Invalid device command.");
+                    return;
+                }
+
+                const utils::mac address(std::string_view(command["address"].GetString(), command["address"].GetStringLength()));
+
+                // Profile switches are handled by the manager, e.g. {"address": "...", "connection": {"idle": "balanced"}}.
+                if (command.HasMember("connection"))
+                {
+                    const auto& js_connection = command["connection"];
+
+                    auto configured = std::find_if(config.devices.cbegin(), config.devices.cend(), [&address](const auto& device) {
+                        return device.address == address;
+                    });
+
+                    if (!js_connection.IsObject() ||
+                        configured == config.devices.cend() ||
+                        (js_connection.HasMember("active") && !js_connection["active"].IsString()) ||
+                        (js_connection.HasMember("idle") && !js_connection["idle"].IsString()))
+                    {
+                        ESP_LOGW(TAG, "Invalid connection profile command.");
+                        return;
+                    }
+
+                    // Profiles not given fall back to the configured ones.
+                    const auto active = find_connection_profile(
+                        config, js_connection.HasMember("active") ? js_connection["active"].GetString() : configured->active_profile);
+                    const auto idle = find_connection_profile(
+                        config, js_connection.HasMember("idle") ? js_connection["idle"].GetString() : configured->idle_profile);
+
+                    if (!active || !idle)
+                    {
+                        ESP_LOGW(TAG, "Unknown connection profile.");
+                        return;
+                    }
+
+                    if (esp_err_t result = manager->set_profile(address, { *active, *idle }); result != ESP_OK)
+                    {
+                        ESP_LOGW(TAG, "Connection profile rejected with error code %i [%s].", result, esp_err_to_name(result));
+                    }
+
+                    return;
+                }
+
+                if (esp_err_t result = manager->submit(address, std::move(command)); result != ESP_OK)
+                {
+                    ESP_LOGW(TAG, "Device command rejected with error code %i [%s].", result, esp_err_to_name(result));
+                }
+            });
+        }
+
+        // Scanner statistics, and the connections of the inventory when GATT devices are served.
+        rx::composite_subscription diagnostics;
+
+        if (config.mqtt.diagnostics_period != 0)
+        {
+            diagnostics = rx::observable<>::interval(std::chrono::seconds(config.mqtt.diagnostics_period), rx::observe_on_event_loop()) |
+                map([cache{ std::string() }, previous{ ble::scanner::statistics_t{  } }, period{ config.mqtt.diagnostics_period }, manager{ connection_manager.get() }](auto) mutable {
+                    rjs::StringBuffer buffer;
+                    rjs::Writer<rjs::StringBuffer> writer(buffer);
+
+                    const auto statistics = ble::scanner::get_statistics();
+                    write_statistics(writer, statistics, previous, period, manager ? manager->get_links() : std::vector<device::connection_manager::link_t>());
+                    previous = statistics;
+
+                    cache.assign(buffer.GetString(), buffer.GetSize());
+                    return std::string_view(cache);
+                }) |
+                mqtt_client.publish(diagnostics_topic) |
+                subscribe<int>();
+        }
+
+        // Reception times of the batch being published, recorded once the publish returned.
+        auto published = std::make_shared<std::vector<int64_t>>();
+        published->reserve(config.mqtt.batch_size);
+
+        auto ble_scan_results = scan_trigger |
+            map([make_ble_scanner{ ble::scanner::get_observable_factory(scanner_config) }, duration{ static_cast<uint16_t>(config.scan.duration) }](std::string_view) { 
+                return make_ble_scanner(duration); 
             }) |
             switch_on_next() |
-            map([cache{ std::string() }] (ble::scanner::message_type message) mutable {
-                rjs::Document json;
-                auto& allocator = json.GetAllocator();
+            // Flushes the pending batch when the scan completes.
+            buffer_with_time_or_count(
+                std::chrono::milliseconds(config.mqtt.batch_period),
+                config.mqtt.batch_size,
+                rx::observe_on_event_loop()) |
+            filter([](const std::vector<ble::scanner::message_type>& batch) {
+                return !batch.empty();
+            }) |
+            map([cache{ std::string() }, published] (const std::vector<ble::scanner::message_type>& batch) mutable {
+                rjs::StringBuffer buffer;
+                rjs::Writer<rjs::StringBuffer> writer(buffer);
 
-                json.SetObject();
-                json.AddMember("name", rjs::StringRef(message.name.data(), message.name.length()), allocator);
-                json.AddMember("address", rjs::StringRef(message.mac.data(), message.mac.length()), allocator);
+                writer.StartArray();
+                published->clear();
 
-                cache = utils::json::dump(std::move(json));
+                for (const auto& message : batch)
+                {
+                    write_scan_result(writer, message);
+                    published->push_back(message.timestamp);
+                }
+
+                writer.EndArray();
+
+                cache.assign(buffer.GetString(), buffer.GetSize());
                 return std::string_view(cache);
             }) |
             mqtt_client.publish(sensor_state_topic) |
+            tap([published](int) {
+                for (int64_t timestamp : *published)
+                {
+                    ble::scanner::record_publish_latency(timestamp);
+                }
+            }) |
             as_blocking();
 
         ble_scan_results.subscribe(
@@ -94,6 +557,8 @@ namespace hub
             }
         );
 
+        diagnostics.unsubscribe();
+        device_commands.unsubscribe();
         return tl::expected<void, esp_err_t>();
     }
 }
@@ -0,0 +1,154 @@
+#include "ble/advertisement.hpp"
+
+#include <algorithm>
+
+namespace hub::ble
+{
+    namespace
+    {
+        inline uint16_t read_uint16(const uint8_t* data) noexcept
+        {
+            return static_cast<uint16_t>(data[0] | (data[1] << 8));
+        }
+    }
+
+    void parse_advertisement(const uint8_t* payload, uint8_t length, advertisement& result) noexcept
+    {
+        length = std::min<uint8_t>(length, advertisement::MAX_DATA_SIZE);
+
+        std::copy(payload, payload + length, result.data.begin());
+
+        result.data_length          = length;
+        result.fields               = 0;
+        result.flags                = 0;
+        result.tx_power             = 0;
+        result.name                 = advertisement::field{ 0, 0 };
+        result.company_id           = 0;
+        result.manufacturer_data    = advertisement::field{ 0, 0 };
+        result.uuid16_count         = 0;
+        result.uuid128_count        = 0;
+        result.service_data_count   = 0;
+
+        const uint8_t* data = result.data.data();
+        uint8_t offset      = 0;
+
+        while (offset < length)
+        {
+            const uint8_t field_length = data[offset];
+
+            if (field_length == 0)
+            {
+                break;
+            }
+
+            if (offset + 1 + field_length > length)
+            {
+                result.fields |= advertisement::MALFORMED;
+                break;
+            }
+
+            const uint8_t type          = data[offset + 1];
+            const uint8_t value_offset  = offset + 2;
+            const uint8_t value_length  = field_length - 1;
+            const uint8_t* value        = data + value_offset;
+
+            switch (type)
+            {
+            case ESP_BLE_AD_TYPE_FLAG:
+                if (value_length >= 1)
+                {
+                    result.flags    = value[0];
+                    result.fields  |= advertisement::HAS_FLAGS;
+                }
+                break;
+            case ESP_BLE_AD_TYPE_TX_PWR:
+                if (value_length >= 1)
+                {
+                    result.tx_power = static_cast<int8_t>(value[0]);
+                    result.fields  |= advertisement::HAS_TX_POWER;
+                }
+                break;
+            case ESP_BLE_AD_TYPE_NAME_CMPL:
+                result.name     = advertisement::field{ value_offset, value_length };
+                result.fields  |= advertisement::HAS_NAME_COMPLETE;
+                break;
+            case ESP_BLE_AD_TYPE_NAME_SHORT:
+                // Complete name takes precedence regardless of the order of the structures.
+                if (!result.has(advertisement::HAS_NAME_COMPLETE))
+                {
+                    result.name = advertisement::field{ value_offset, value_length };
+                }
+                result.fields |= advertisement::HAS_NAME_SHORT;
+                break;
+            case ESP_BLE_AD_TYPE_16SRV_PART:
+            case ESP_BLE_AD_TYPE_16SRV_CMPL:
+                for (uint8_t i = 0; i + 1 < value_length; i += 2)
+                {
+                    if (result.uuid16_count == advertisement::MAX_UUID16)
+                    {
+                        result.fields |= advertisement::TRUNCATED;
+                        break;
+                    }
+
+                    result.uuid16[result.uuid16_count++] = read_uint16(value + i);
+                }
+                break;
+            case ESP_BLE_AD_TYPE_128SRV_PART:
+            case ESP_BLE_AD_TYPE_128SRV_CMPL:
+                for (uint8_t i = 0; i + ESP_UUID_LEN_128 <= value_length; i += ESP_UUID_LEN_128)
+                {
+                    if (result.uuid128_count == advertisement::MAX_UUID128)
+                    {
+                        result.fields |= advertisement::TRUNCATED;
+                        break;
+                    }
+
+                    result.uuid128[result.uuid128_count++] = advertisement::field{ static_cast<uint8_t>(value_offset + i), ESP_UUID_LEN_128 };
+                }
+                break;
+            case ESP_BLE_AD_TYPE_SERVICE_DATA:
+                if (value_length < 2)
+                {
+                    break;
+                }
+
+                if (result.service_data_count == advertisement::MAX_SERVICE_DATA)
+                {
+                    result.fields |= advertisement::TRUNCATED;
+                    break;
+                }
+
+                result.service_data[result.service_data_count++] = advertisement::service_data_type{
+                    read_uint16(value),
+                    advertisement::field{ static_cast<uint8_t>(value_offset + 2), static_cast<uint8_t>(value_length - 2) }
+                };
+                break;
+            case ESP_BLE_AD_MANUFACTURER_SPECIFIC_TYPE:
+                if (value_length < 2)
+                {
+                    break;
+                }
+
+                result.company_id           = read_uint16(value);
+                result.manufacturer_data    = advertisement::field{ static_cast<uint8_t>(value_offset + 2), static_cast<uint8_t>(value_length - 2) };
+                result.fields              |= advertisement::HAS_MANUFACTURER_DATA;
+                break;
+            default:
+                break;
+            }
+
+            offset += field_length + 1;
+        }
+    }
+
+    void parse_advertisement(const esp_ble_gap_cb_param_t::ble_scan_result_evt_param& scan_result, advertisement& result) noexcept
+    {
+        std::copy(std::begin(scan_result.bda), std::end(scan_result.bda), result.address.begin());
+
+        result.address_type = scan_result.ble_addr_type;
+        result.event_type   = scan_result.ble_evt_type;
+        result.rssi         = static_cast<int8_t>(scan_result.rssi);
+
+        parse_advertisement(scan_result.ble_adv, scan_result.adv_data_len + scan_result.scan_rsp_len, result);
+    }
+}
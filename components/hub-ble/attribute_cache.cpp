@@ -0,0 +1,380 @@
+#include "ble/attribute_cache.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <new>
+#include <string_view>
+
+#include "nvs.h"
+#include "esp_log.h"
+
+namespace hub::ble
+{
+    namespace
+    {
+        constexpr std::array<uint8_t, 16> BASE_UUID{
+            0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+        };
+
+        std::array<uint8_t, 16> to_uuid128(const esp_bt_uuid_t& uuid) noexcept
+        {
+            std::array<uint8_t, 16> result = BASE_UUID;
+
+            switch (uuid.len)
+            {
+            case ESP_UUID_LEN_16:
+                result[12] = static_cast<uint8_t>(uuid.uuid.uuid16);
+                result[13] = static_cast<uint8_t>(uuid.uuid.uuid16 >> 8);
+                break;
+            case ESP_UUID_LEN_32:
+                for (std::size_t i = 0; i < sizeof(uint32_t); i++)
+                {
+                    result[12 + i] = static_cast<uint8_t>(uuid.uuid.uuid32 >> (8 * i));
+                }
+                break;
+            default:
+                // The uuid is packed, std::begin and std::end would each bind a temporary copy of the array.
+                std::copy(uuid.uuid.uuid128, uuid.uuid.uuid128 + ESP_UUID_LEN_128, result.begin());
+                break;
+            }
+
+            return result;
+        }
+    }
+
+    bool uuid_equal(const esp_bt_uuid_t& lhs, const esp_bt_uuid_t& rhs) noexcept
+    {
+        if (lhs.len == rhs.len && lhs.len == ESP_UUID_LEN_16)
+        {
+            return lhs.uuid.uuid16 == rhs.uuid.uuid16;
+        }
+
+        return to_uuid128(lhs) == to_uuid128(rhs);
+    }
+
+    std::pair<attribute_table::characteristic_iterator, attribute_table::characteristic_iterator> attribute_table::get_characteristics(
+        uint16_t start_handle,
+        uint16_t end_handle) const noexcept
+    {
+        const auto by_handle = [](const esp_gattc_char_elem_t& elem, uint32_t handle) { return elem.char_handle < handle; };
+
+        // The value follows its declaration, which is the first attribute of a characteristic.
+        auto first = std::lower_bound(characteristics.cbegin(), characteristics.cend(), static_cast<uint32_t>(start_handle) + 1, by_handle);
+        auto last  = std::lower_bound(first, characteristics.cend(), static_cast<uint32_t>(end_handle) + 1, by_handle);
+
+        return std::make_pair(first, last);
+    }
+
+    std::pair<attribute_table::descriptor_iterator, attribute_table::descriptor_iterator> attribute_table::get_descriptors(
+        uint16_t char_handle,
+        uint16_t service_end_handle) const noexcept
+    {
+        uint32_t end_handle = static_cast<uint32_t>(service_end_handle) + 1;
+
+        // Descriptors end where the declaration of the next characteristic starts.
+        if (auto next = std::upper_bound(characteristics.cbegin(), characteristics.cend(), char_handle, [](uint16_t handle, const esp_gattc_char_elem_t& elem) {
+                return handle < elem.char_handle;
+            });
+            next != characteristics.cend())
+        {
+            end_handle = std::min<uint32_t>(end_handle, next->char_handle - 1u);
+        }
+
+        const auto by_handle = [](const esp_gattc_descr_elem_t& elem, uint32_t handle) { return elem.handle < handle; };
+
+        auto first = std::lower_bound(descriptors.cbegin(), descriptors.cend(), static_cast<uint32_t>(char_handle) + 1, by_handle);
+        auto last  = std::lower_bound(first, descriptors.cend(), end_handle, by_handle);
+
+        return std::make_pair(first, last);
+    }
+}
+
+namespace hub::ble::attribute_cache
+{
+    namespace
+    {
+        constexpr const char* TAG{ "hub::ble::attribute_cache" };
+
+        constexpr const char*   NVS_NAMESPACE{ "gatt_cache" };
+        constexpr uint16_t      RECORD_MAGIC{ 0x4741 };
+        constexpr uint8_t       RECORD_VERSION{ 1 };
+
+        /**
+         * @brief Record layout: header, services, characteristics, descriptors, database hash.
+         * Elements are stored as the raw Bluedroid structures, their sizes are checked on load.
+         */
+        struct record_header
+        {
+            uint16_t    magic;
+            uint8_t     version;
+            uint8_t     service_size;
+            uint8_t     characteristic_size;
+            uint8_t     descriptor_size;
+            uint8_t     hash_length;
+            uint8_t     reserved;
+            uint16_t    service_count;
+            uint16_t    characteristic_count;
+            uint16_t    descriptor_count;
+            uint16_t    database_hash_handle;
+            uint32_t    checksum;               // FNV-1a over everything following the header.
+        };
+
+        using key_type = std::array<char, utils::mac::MAC_SIZE * 2 + 1>;
+
+        /**
+         * @brief NVS keys are limited to 15 characters, the address is stored as 12 hex digits.
+         */
+        key_type make_key(const utils::mac& address) noexcept
+        {
+            constexpr std::string_view digits{ "0123456789abcdef" };
+
+            const auto* bytes = static_cast<const uint8_t*>(address);
+            key_type key{  };
+
+            for (std::size_t i = 0; i < utils::mac::MAC_SIZE; i++)
+            {
+                key[2 * i]      = digits[bytes[i] >> 4];
+                key[2 * i + 1]  = digits[bytes[i] & 0x0f];
+            }
+
+            return key;
+        }
+
+        uint32_t checksum(const uint8_t* data, std::size_t length) noexcept
+        {
+            uint32_t hash = 2166136261u;
+
+            for (std::size_t i = 0; i < length; i++)
+            {
+                hash = (hash ^ data[i]) * 16777619u;
+            }
+
+            return hash;
+        }
+
+        template<typename ElemT>
+        uint8_t* write_elements(uint8_t* out, const std::vector<ElemT>& elements) noexcept
+        {
+            const std::size_t length = elements.size() * sizeof(ElemT);
+
+            // Empty vectors may have no storage, memcpy takes no null pointers even for zero bytes.
+            if (length != 0)
+            {
+                std::memcpy(out, elements.data(), length);
+            }
+
+            return out + length;
+        }
+
+        template<typename ElemT>
+        const uint8_t* read_elements(const uint8_t* in, std::size_t count, std::vector<ElemT>& elements)
+        {
+            elements.resize(count);
+
+            if (count != 0)
+            {
+                std::memcpy(elements.data(), in, count * sizeof(ElemT));
+            }
+
+            return in + count * sizeof(ElemT);
+        }
+
+        class nvs_guard
+        {
+        public:
+
+            explicit nvs_guard(nvs_open_mode_t mode) noexcept :
+                m_handle{ 0 },
+                m_result{ nvs_open(NVS_NAMESPACE, mode, &m_handle) }
+            {
+
+            }
+
+            nvs_guard(const nvs_guard&)             = delete;
+
+            nvs_guard& operator=(const nvs_guard&)  = delete;
+
+            ~nvs_guard()
+            {
+                if (m_result == ESP_OK)
+                {
+                    nvs_close(m_handle);
+                }
+            }
+
+            esp_err_t get_result() const noexcept
+            {
+                return m_result;
+            }
+
+            nvs_handle_t get() const noexcept
+            {
+                return m_handle;
+            }
+
+        private:
+
+            nvs_handle_t    m_handle;
+            esp_err_t       m_result;
+        };
+    }
+
+    tl::expected<attribute_table, esp_err_t> load(const utils::mac& address) noexcept
+    {
+        // The namespace does not exist until the first table is stored.
+        nvs_guard nvs{ NVS_READONLY };
+
+        if (nvs.get_result() != ESP_OK)
+        {
+            return tl::make_unexpected(nvs.get_result() == ESP_ERR_NVS_NOT_FOUND ? ESP_ERR_NOT_FOUND : nvs.get_result());
+        }
+
+        const auto key = make_key(address);
+        std::size_t length = 0;
+
+        if (esp_err_t result = nvs_get_blob(nvs.get(), key.data(), nullptr, &length); result != ESP_OK)
+        {
+            return tl::make_unexpected(result == ESP_ERR_NVS_NOT_FOUND ? ESP_ERR_NOT_FOUND : result);
+        }
+
+        try
+        {
+            std::vector<uint8_t> record(length);
+
+            if (esp_err_t result = nvs_get_blob(nvs.get(), key.data(), record.data(), &length); result != ESP_OK)
+            {
+                return tl::make_unexpected(result);
+            }
+
+            record_header header{  };
+
+            if (length < sizeof(header))
+            {
+                return tl::make_unexpected(ESP_ERR_INVALID_SIZE);
+            }
+
+            std::memcpy(&header, record.data(), sizeof(header));
+
+            if (header.magic != RECORD_MAGIC ||
+                header.version != RECORD_VERSION ||
+                header.service_size != sizeof(esp_gattc_service_elem_t) ||
+                header.characteristic_size != sizeof(esp_gattc_char_elem_t) ||
+                header.descriptor_size != sizeof(esp_gattc_descr_elem_t))
+            {
+                return tl::make_unexpected(ESP_ERR_INVALID_VERSION);
+            }
+
+            const std::size_t expected_length = sizeof(header) +
+                header.service_count * sizeof(esp_gattc_service_elem_t) +
+                header.characteristic_count * sizeof(esp_gattc_char_elem_t) +
+                header.descriptor_count * sizeof(esp_gattc_descr_elem_t) +
+                header.hash_length;
+
+            if (length != expected_length || checksum(record.data() + sizeof(header), length - sizeof(header)) != header.checksum)
+            {
+                return tl::make_unexpected(ESP_ERR_INVALID_CRC);
+            }
+
+            attribute_table table{  };
+            const uint8_t* in = record.data() + sizeof(header);
+
+            in = read_elements(in, header.service_count, table.services);
+            in = read_elements(in, header.characteristic_count, table.characteristics);
+            in = read_elements(in, header.descriptor_count, table.descriptors);
+
+            table.database_hash_handle = header.database_hash_handle;
+            table.database_hash.assign(in, in + header.hash_length);
+
+            return table;
+        }
+        catch (const std::bad_alloc&)
+        {
+            return tl::make_unexpected(ESP_ERR_NO_MEM);
+        }
+    }
+
+    esp_err_t store(const utils::mac& address, const attribute_table& table) noexcept
+    {
+        if (table.services.size() > UINT16_MAX ||
+            table.characteristics.size() > UINT16_MAX ||
+            table.descriptors.size() > UINT16_MAX ||
+            table.database_hash.size() > UINT8_MAX)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        record_header header{
+            RECORD_MAGIC,
+            RECORD_VERSION,
+            sizeof(esp_gattc_service_elem_t),
+            sizeof(esp_gattc_char_elem_t),
+            sizeof(esp_gattc_descr_elem_t),
+            static_cast<uint8_t>(table.database_hash.size()),
+            0,
+            static_cast<uint16_t>(table.services.size()),
+            static_cast<uint16_t>(table.characteristics.size()),
+            static_cast<uint16_t>(table.descriptors.size()),
+            table.database_hash_handle,
+            0
+        };
+
+        std::vector<uint8_t> record;
+
+        try
+        {
+            record.resize(sizeof(header) +
+                table.services.size() * sizeof(esp_gattc_service_elem_t) +
+                table.characteristics.size() * sizeof(esp_gattc_char_elem_t) +
+                table.descriptors.size() * sizeof(esp_gattc_descr_elem_t) +
+                table.database_hash.size());
+        }
+        catch (const std::bad_alloc&)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+
+        uint8_t* out = record.data() + sizeof(header);
+
+        out = write_elements(out, table.services);
+        out = write_elements(out, table.characteristics);
+        out = write_elements(out, table.descriptors);
+        std::copy(table.database_hash.cbegin(), table.database_hash.cend(), out);
+
+        header.checksum = checksum(record.data() + sizeof(header), record.size() - sizeof(header));
+        std::memcpy(record.data(), &header, sizeof(header));
+
+        nvs_guard nvs{ NVS_READWRITE };
+
+        if (nvs.get_result() != ESP_OK)
+        {
+            ESP_LOGW(TAG, "Could not open NVS namespace, error code %i [%s].", nvs.get_result(), esp_err_to_name(nvs.get_result()));
+            return nvs.get_result();
+        }
+
+        if (esp_err_t result = nvs_set_blob(nvs.get(), make_key(address).data(), record.data(), record.size()); result != ESP_OK)
+        {
+            ESP_LOGW(TAG, "Could not store attribute table, error code %i [%s].", result, esp_err_to_name(result));
+            return result;
+        }
+
+        return nvs_commit(nvs.get());
+    }
+
+    esp_err_t erase(const utils::mac& address) noexcept
+    {
+        nvs_guard nvs{ NVS_READWRITE };
+
+        if (nvs.get_result() != ESP_OK)
+        {
+            return nvs.get_result();
+        }
+
+        if (esp_err_t result = nvs_erase_key(nvs.get(), make_key(address).data()); result != ESP_OK)
+        {
+            return (result == ESP_ERR_NVS_NOT_FOUND) ? ESP_OK : result;
+        }
+
+        return nvs_commit(nvs.get());
+    }
+}
\ No newline at end of file
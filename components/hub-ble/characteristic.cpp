@@ -7,10 +7,9 @@
 #include "esp_bt_defs.h"
 #include "esp_gattc_api.h"
 
-#include "freertos/FreeRTOS.h"
-#include "freertos/event_groups.h"
-
 #include <stdexcept>
+#include <algorithm>
+#include <iterator>
 
 namespace hub::ble
 {
@@ -29,155 +28,130 @@ namespace hub::ble
         if (!shared_client)
         {
             ESP_LOGE(TAG, "Client is not connected.");
-            return tl::make_unexpected<esp_err_t>(ESP_ERR_INVALID_STATE);
+            return tl::expected<void, esp_err_t>(tl::unexpect, ESP_ERR_INVALID_STATE);
         }
 
-        if (esp_err_t result = esp_ble_gattc_write_char(
-                shared_client->m_gattc_interface, 
-                shared_client->m_connection_id,
-                m_characteristic.char_handle,
-                data.size(),
-                data.data(),
-                ESP_GATT_WRITE_TYPE_RSP,
-                ESP_GATT_AUTH_REQ_NONE);
-            result != ESP_OK)
+        if (auto result = shared_client->write_long(m_characteristic.char_handle, data); !result)
         {
-            ESP_LOGE(TAG, "Write characteristic failed.");
-            return tl::expected<void, esp_err_t>(tl::unexpect, result);
+            ESP_LOGE(TAG, "Write characteristic failed with error code %i [%s].", result.error(), esp_err_to_name(result.error()));
+            return tl::expected<void, esp_err_t>(tl::unexpect, result.error());
         }
 
-        EventBits_t bits = xEventGroupWaitBits(
-            shared_client->m_event_group, 
-            client::WRITE_CHAR_BIT | client::FAIL_BIT, 
-            pdTRUE, 
-            pdFALSE, 
-            static_cast<TickType_t>(BLE_TIMEOUT));
+        ESP_LOGD(TAG, "Write characteristic success.");
+        return tl::expected<void, esp_err_t>();
+    }
+
+    tl::expected<void, esp_err_t> characteristic::write_without_response(const std::vector<uint8_t>& data) noexcept
+    {
+        auto shared_client = m_client_ptr.lock();
 
-        if (bits & client::WRITE_CHAR_BIT)
+        if (!shared_client)
         {
-            ESP_LOGI(TAG, "Write characteristic success.");
-            return tl::expected<void, esp_err_t>();
+            ESP_LOGE(TAG, "Client is not connected.");
+            return tl::expected<void, esp_err_t>(tl::unexpect, ESP_ERR_INVALID_STATE);
         }
-        else if (bits & client::FAIL_BIT)
+
+        if (auto result = shared_client->write_stream(m_characteristic.char_handle, data); !result)
         {
-            ESP_LOGE(TAG, "Write characteristic failed.");
-            return tl::expected<void, esp_err_t>(tl::unexpect, ESP_FAIL);
+            ESP_LOGE(TAG, "Write characteristic without response failed with error code %i [%s].", result.error(), esp_err_to_name(result.error()));
+            return result;
         }
-        else
+
+        ESP_LOGD(TAG, "Write characteristic without response success.");
+        return tl::expected<void, esp_err_t>();
+    }
+
+    tl::expected<std::vector<uint8_t>, esp_err_t> characteristic::read() const noexcept
+    {
+        auto result = read_async().wait(BLE_TIMEOUT);
+
+        if (!result)
         {
-            ESP_LOGE(TAG, "Write characteristic timeout.");
-            return tl::expected<void, esp_err_t>(tl::unexpect, ESP_ERR_TIMEOUT);
+            ESP_LOGE(TAG, "Read characteristic failed with error code %i [%s].", result.error(), esp_err_to_name(result.error()));
+            return result;
         }
+
+        ESP_LOGD(TAG, "Read characteristic success.");
+        return result;
     }
 
-    tl::expected<std::vector<uint8_t>, esp_err_t> characteristic::read() const noexcept
+    completion_token characteristic::write_async(const std::vector<uint8_t>& data) noexcept
     {
         auto shared_client = m_client_ptr.lock();
 
         if (!shared_client)
         {
             ESP_LOGE(TAG, "Client is not connected.");
-            return tl::expected<std::vector<uint8_t>, esp_err_t>(tl::unexpect, ESP_ERR_INVALID_STATE);
+            return completion_token(ESP_ERR_INVALID_STATE);
         }
 
-        if (esp_err_t result = esp_ble_gattc_read_char(
-                shared_client->m_gattc_interface, 
-                shared_client->m_connection_id,
-                m_characteristic.char_handle,
-                ESP_GATT_AUTH_REQ_NONE); 
-            result != ESP_OK)
-        {
-            ESP_LOGE(TAG, "Read characteristic failed.");
-            return tl::expected<std::vector<uint8_t>, esp_err_t>(tl::unexpect, result);
-        }
+        return shared_client->submit(operation_type::write_characteristic, m_characteristic.char_handle, data);
+    }
 
-        EventBits_t bits = xEventGroupWaitBits(
-            shared_client->m_event_group, 
-            client::READ_CHAR_BIT | client::FAIL_BIT, 
-            pdTRUE, 
-            pdFALSE, 
-            static_cast<TickType_t>(BLE_TIMEOUT));
+    completion_token characteristic::write_without_response_async(const std::vector<uint8_t>& data) noexcept
+    {
+        auto shared_client = m_client_ptr.lock();
 
-        if (bits & client::READ_CHAR_BIT)
-        {
-            ESP_LOGI(TAG, "Read characteristic success.");
-            return std::vector<uint8_t>(std::move(shared_client->m_characteristic_data_cache));
-        }
-        else if (bits & client::FAIL_BIT)
-        {
-            ESP_LOGE(TAG, "Read characteristic failed.");
-            return tl::expected<std::vector<uint8_t>, esp_err_t>(tl::unexpect, ESP_FAIL);
-        }
-        else
+        if (!shared_client)
         {
-            ESP_LOGE(TAG, "Read characteristic timeout.");
-            return tl::expected<std::vector<uint8_t>, esp_err_t>(tl::unexpect, ESP_ERR_TIMEOUT);
+            ESP_LOGE(TAG, "Client is not connected.");
+            return completion_token(ESP_ERR_INVALID_STATE);
         }
+
+        return shared_client->submit_write(
+            operation_type::write_characteristic, 
+            m_characteristic.char_handle, 
+            data.data(), 
+            static_cast<uint16_t>(data.size()), 
+            0, 
+            ESP_GATT_WRITE_TYPE_NO_RSP);
     }
 
-    tl::expected<std::vector<descriptor>, esp_gatt_status_t> characteristic::get_descriptors() const noexcept
+    completion_token characteristic::read_async() const noexcept
     {
-        esp_gatt_status_t result = ESP_GATT_OK;
-        uint16_t descriptor_count = 0U;
-        std::vector<esp_gattc_descr_elem_t> descriptors;
-
         auto shared_client = m_client_ptr.lock();
 
         if (!shared_client)
         {
             ESP_LOGE(TAG, "Client is not connected.");
-            return tl::expected<std::vector<descriptor>, esp_gatt_status_t>(tl::unexpect, ESP_GATT_WRONG_STATE);
+            return completion_token(ESP_ERR_INVALID_STATE);
         }
 
-        result = esp_ble_gattc_get_attr_count(
-            shared_client->m_gattc_interface, 
-            shared_client->m_connection_id,
-            ESP_GATT_DB_DESCRIPTOR,
-            0,
-            0,
-            m_characteristic.char_handle,
-            &descriptor_count);
+        return shared_client->submit(operation_type::read_characteristic, m_characteristic.char_handle);
+    }
+
+    tl::expected<std::vector<descriptor>, esp_gatt_status_t> characteristic::get_descriptors() const noexcept
+    {
+        auto shared_client = m_client_ptr.lock();
 
-        if (result != ESP_GATT_OK)
+        if (!shared_client)
         {
-            ESP_LOGE(TAG, "Could not get desriptor count.");
-            return tl::expected<std::vector<descriptor>, esp_gatt_status_t>(tl::unexpect, result);
+            ESP_LOGE(TAG, "Client is not connected.");
+            return tl::expected<std::vector<descriptor>, esp_gatt_status_t>(tl::unexpect, ESP_GATT_WRONG_STATE);
         }
 
-        descriptors.resize(descriptor_count);
+        auto attributes = shared_client->get_attributes();
 
-        result = esp_ble_gattc_get_all_descr(
-            shared_client->m_gattc_interface, 
-            shared_client->m_connection_id,
-            m_characteristic.char_handle,
-            descriptors.data(),
-            &descriptor_count,
-            0);
-
-        if (result != ESP_GATT_OK)
+        if (!attributes)
         {
             ESP_LOGE(TAG, "Could not retrieve desriptors.");
-            return tl::expected<std::vector<descriptor>, esp_gatt_status_t>(tl::unexpect, result);
+            return tl::expected<std::vector<descriptor>, esp_gatt_status_t>(tl::unexpect, ESP_GATT_ERROR);
         }
 
-        {
-            std::vector<descriptor> result;
-            result.reserve(descriptors.size());
+        auto [first, last] = (*attributes)->get_descriptors(m_characteristic.char_handle, m_service_handle_range.second);
 
-            std::transform(descriptors.cbegin(), descriptors.cend(), std::back_inserter(result), [this](auto elem) { 
-                return descriptor(m_client_ptr, elem); 
-            });
+        std::vector<descriptor> result;
+        result.reserve(std::distance(first, last));
 
-            return std::vector<descriptor>(std::move(result));
-        }
+        std::transform(first, last, std::back_inserter(result), [this](auto elem) { 
+            return descriptor(m_client_ptr, elem); 
+        });
+
+        return result;
     }
 
     tl::expected<descriptor, esp_gatt_status_t> characteristic::get_descriptor_by_uuid(const esp_bt_uuid_t* uuid) const noexcept
     {
-        esp_gatt_status_t result = ESP_GATT_OK;
-        uint16_t descriptor_count = 0U;
-        std::vector<esp_gattc_descr_elem_t> descriptors;
-
         auto shared_client = m_client_ptr.lock();
 
         if (!shared_client)
@@ -186,129 +160,87 @@ namespace hub::ble
             return tl::expected<descriptor, esp_gatt_status_t>(tl::unexpect, ESP_GATT_WRONG_STATE);
         }
 
-        result = esp_ble_gattc_get_attr_count(
-            shared_client->m_gattc_interface, 
-            shared_client->m_connection_id,
-            ESP_GATT_DB_DESCRIPTOR,
-            0,
-            0,
-            m_characteristic.char_handle,
-            &descriptor_count);
+        auto attributes = shared_client->get_attributes();
 
-        if (result != ESP_GATT_OK)
+        if (!attributes)
         {
-            ESP_LOGE(TAG, "Could not get desriptor count.");
-            return tl::expected<descriptor, esp_gatt_status_t>(tl::unexpect, result);
+            ESP_LOGE(TAG, "Could not retrieve desriptors.");
+            return tl::expected<descriptor, esp_gatt_status_t>(tl::unexpect, ESP_GATT_ERROR);
         }
 
-        descriptors.resize(descriptor_count);
+        auto [first, last] = (*attributes)->get_descriptors(m_characteristic.char_handle, m_service_handle_range.second);
 
-        result = esp_ble_gattc_get_descr_by_uuid(
-            shared_client->m_gattc_interface, 
-            shared_client->m_connection_id,
-            m_service_handle_range.first,
-            m_service_handle_range.second,
-            m_characteristic.uuid,
-            *uuid,
-            descriptors.data(),
-            &descriptor_count);
+        if (auto iter = std::find_if(first, last, [uuid](const auto& elem) { return uuid_equal(elem.uuid, *uuid); }); iter != last)
+        {
+            return descriptor(m_client_ptr, *iter);
+        }
+
+        ESP_LOGE(TAG, "Descriptor not found.");
+        return tl::expected<descriptor, esp_gatt_status_t>(tl::unexpect, ESP_GATT_NOT_FOUND);
+    }
 
-        if (result != ESP_GATT_OK)
+    tl::expected<void, esp_err_t> characteristic::subscribe(notify_handler callback) noexcept
+    {
+        if (auto result = subscribe_async(std::move(callback)).wait(BLE_TIMEOUT); !result)
         {
-            ESP_LOGE(TAG, "Could not retrieve desriptors.");
-            return tl::expected<descriptor, esp_gatt_status_t>(tl::unexpect, result);
+            if (auto shared_client = m_client_ptr.lock(); shared_client)
+            {
+                shared_client->clear_notify_handler(m_characteristic.char_handle);
+            }
+
+            ESP_LOGE(TAG, "Subscribe to characteristic failed with error code %i [%s].", result.error(), esp_err_to_name(result.error()));
+            return tl::expected<void, esp_err_t>(tl::unexpect, result.error());
         }
 
-        return descriptor(m_client_ptr, std::move(descriptors.front()));
+        ESP_LOGD(TAG, "Subscribe to characteristic success.");
+        return tl::expected<void, esp_err_t>();
     }
 
-    tl::expected<void, esp_err_t> characteristic::subscribe(std::function<void(const std::vector<uint8_t>&)> callback) noexcept
+    completion_token characteristic::subscribe_async(notify_handler callback) noexcept
     {
         auto shared_client = m_client_ptr.lock();
 
         if (!shared_client)
         {
             ESP_LOGE(TAG, "Client is not connected.");
-            return tl::expected<void, esp_err_t>(tl::unexpect, ESP_ERR_INVALID_STATE);
-        }
-
-        if (esp_err_t result = esp_ble_gattc_register_for_notify(
-                shared_client->m_gattc_interface, 
-                static_cast<uint8_t*>(shared_client->m_address), 
-                m_characteristic.char_handle); 
-            result != ESP_OK)
-        {
-            ESP_LOGE(TAG, "Subscribe to characteristic failed.");
-            return tl::expected<void, esp_err_t>(tl::unexpect, result);
+            return completion_token(ESP_ERR_INVALID_STATE);
         }
 
-        EventBits_t bits = xEventGroupWaitBits(
-            shared_client->m_event_group, 
-            client::REG_FOR_NOTIFY_BIT | client::FAIL_BIT, 
-            pdTRUE, 
-            pdFALSE, 
-            static_cast<TickType_t>(BLE_TIMEOUT));
-
-        if (bits & client::REG_FOR_NOTIFY_BIT)
+        // Installed before registering, so notifications sent right after the registration are not lost.
+        try
         {
-            shared_client->m_characteristics_callbacks[m_characteristic.char_handle] = callback;
-            ESP_LOGI(TAG, "Subscribe to characteristic success.");
-            return tl::expected<void, esp_err_t>();
+            shared_client->set_notify_handler(m_characteristic.char_handle, std::move(callback));
         }
-        else if (bits & client::FAIL_BIT)
+        catch (const std::bad_alloc&)
         {
-            ESP_LOGE(TAG, "Subscribe to characteristic failed.");
-            return tl::expected<void, esp_err_t>(tl::unexpect, ESP_FAIL);
+            return completion_token(ESP_ERR_NO_MEM);
         }
-        else
+
+        return shared_client->submit(operation_type::register_for_notify, m_characteristic.char_handle);
+    }
+
+    tl::expected<void, esp_err_t> characteristic::unsubscribe() noexcept
+    {
+        if (auto result = unsubscribe_async().wait(BLE_TIMEOUT); !result)
         {
-            ESP_LOGE(TAG, "Subscribe to characteristic timeout.");
-            return tl::expected<void, esp_err_t>(tl::unexpect, ESP_ERR_TIMEOUT);
+            ESP_LOGE(TAG, "Unsubscribe from characteristic failed with error code %i [%s].", result.error(), esp_err_to_name(result.error()));
+            return tl::expected<void, esp_err_t>(tl::unexpect, result.error());
         }
+
+        ESP_LOGD(TAG, "Unsubscribe from characteristic success.");
+        return tl::expected<void, esp_err_t>();
     }
 
-    tl::expected<void, esp_err_t> characteristic::unsubscribe() noexcept
+    completion_token characteristic::unsubscribe_async() noexcept
     {
         auto shared_client = m_client_ptr.lock();
 
         if (!shared_client)
         {
             ESP_LOGE(TAG, "Client is not connected.");
-            return tl::make_unexpected<esp_err_t>(ESP_ERR_INVALID_STATE);
+            return completion_token(ESP_ERR_INVALID_STATE);
         }
 
-        if (esp_err_t result = esp_ble_gattc_unregister_for_notify(
-                shared_client->m_gattc_interface, 
-                static_cast<uint8_t*>(shared_client->m_address), 
-                m_characteristic.char_handle); 
-            result != ESP_OK)
-        {
-            ESP_LOGI(TAG, "Unsubscribe from characteristic failed.");
-            return tl::expected<void, esp_err_t>(tl::unexpect, result);
-        }
-
-        EventBits_t bits = xEventGroupWaitBits(
-            shared_client->m_event_group, 
-            client::UNREG_FOR_NOTIFY_BIT | client::FAIL_BIT, 
-            pdTRUE, 
-            pdFALSE, 
-            static_cast<TickType_t>(BLE_TIMEOUT));
-
-        if (bits & client::UNREG_FOR_NOTIFY_BIT)
-        {
-            shared_client->m_characteristics_callbacks.erase(m_characteristic.char_handle);
-            ESP_LOGI(TAG, "Unsubscribe from characteristic success.");
-            return tl::expected<void, esp_err_t>();
-        }
-        else if (bits & client::FAIL_BIT)
-        {
-            ESP_LOGE(TAG, "Unsubscribe from characteristic failed.");
-            return tl::expected<void, esp_err_t>(tl::unexpect, ESP_FAIL);
-        }
-        else
-        {
-            ESP_LOGE(TAG, "Unsubscribe from characteristic timeout.");
-            return tl::expected<void, esp_err_t>(tl::unexpect, ESP_ERR_TIMEOUT);
-        }
+        return shared_client->submit(operation_type::unregister_for_notify, m_characteristic.char_handle);
     }
 }
\ No newline at end of file
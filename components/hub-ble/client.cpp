@@ -1,4 +1,5 @@
 #include "ble/client.hpp"
+#include "ble/gap.hpp"
 
 #include "esp_bt.h"
 #include "esp_bt_main.h"
@@ -7,92 +8,128 @@
 #include "esp_gap_ble_api.h"
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include <stdexcept>
 #include <array>
 #include <algorithm>
+#include <mutex>
+#include <string>
+#include <atomic>
+
+#include "freertos/task.h"
 
 namespace hub::ble
 {
     static std::array<std::weak_ptr<client>, MAX_CLIENTS> g_client_refs;
+    static std::mutex g_client_refs_mutex;  // Clients claim and release application slots from different tasks.
+
+    // Registered clients indexed by GATTC interface, filled at ESP_GATTC_REG_EVT and cleared by release_application.
+    // Entries are plain pointers, a client clears its entry and waits for a running callback before it is destroyed.
+    static std::array<std::atomic<client*>, ESP_GATT_IF_NONE> g_dispatch_table{  };
+    static std::atomic<uint32_t> g_dispatch_sequence{ 0 };         // Odd while the GATTC callback runs.
+    static std::atomic<TaskHandle_t> g_dispatch_task{ nullptr };   // Task running the GATTC callback.
+
+    /**
+     * @brief Marks a callback looking up clients in the dispatch table, see release_application.
+     */
+    struct dispatch_guard
+    {
+        dispatch_guard() noexcept
+        {
+            g_dispatch_sequence.fetch_add(1);
+
+            if (!g_dispatch_task.load(std::memory_order_relaxed))
+            {
+                g_dispatch_task.store(xTaskGetCurrentTaskHandle(), std::memory_order_relaxed);
+            }
+        }
+
+        ~dispatch_guard()
+        {
+            g_dispatch_sequence.fetch_add(1);
+        }
+    };
+
+    static constexpr auto by_handle = [](const auto& entry, uint16_t handle) { return entry.handle < handle; };
 
     client::client() :
         m_connection_id             { 0 },
         m_app_id                    { 0 },
         m_gattc_interface           { ESP_GATT_IF_NONE },
         m_address                   {  },
-        m_event_group               { xEventGroupCreate() },
-        m_services_cache            {  },
-        m_characteristic_data_cache {  },
-        m_descriptor_data_cache     {  },
-        m_characteristics_callbacks {  }
+        m_mtu                       { ESP_GATT_DEF_BLE_MTU_SIZE },
+        m_connected                 { false },
+        m_connection_params         {  },
+        m_open_address              {  },
+        m_completions               { std::make_shared<impl::completion_pool>() },
+        m_issue_mutex               {  },
+        m_operations_mutex          {  },
+        m_characteristics_callbacks {  },
+        m_disconnect_handler        {  },
+        m_registered                { false },
+        m_attributes_mutex          {  },
+        m_attributes                {  },
+        m_attributes_invalid        { false }
     {
-        if (!m_event_group)
-        {
-            throw std::bad_alloc();
-        }
+
     }
 
     client::~client()
     {
-        g_client_refs[m_app_id].reset();
-
-        if (m_gattc_interface != ESP_GATT_IF_NONE)
-        {
-            esp_ble_gattc_app_unregister(m_gattc_interface);
-        }
-
-        vEventGroupDelete(m_event_group);
+        release_application();
     }
 
     void client::gattc_callback(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t *param) noexcept
     {
-        
-        ESP_LOGI(TAG, "Event: %x.", event);
-
-        auto get_shared_client = [](esp_gatt_if_t gattc_interface) {
-            if (auto iter = std::find_if(
-                    g_client_refs.cbegin(), 
-                    g_client_refs.cend(), 
-                    [gattc_interface](auto client_ref) { return !client_ref.expired() && client_ref.lock()->m_gattc_interface == gattc_interface; }); 
-                iter != g_client_refs.cend())
-            {
-                return iter->lock();
-            }
+        dispatch_guard guard;
 
-            return std::shared_ptr<client>();
-        };
+        ESP_LOGV(TAG, "Event: %x.", event);
 
-        std::shared_ptr<client> client_ptr = get_shared_client(gattc_if);
+        client* client_ptr = (gattc_if < g_dispatch_table.size()) ? g_dispatch_table[gattc_if].load() : nullptr;
         
         if (!client_ptr)
         {
             // If the client is not found, it may be not registered at this point. Check if callback is due to registration request.
             if (event == ESP_GATTC_REG_EVT)
             {
-                if (param->reg.status != ESP_GATT_OK)
+                std::shared_ptr<client> registered;
+
+                if (param->reg.app_id < MAX_CLIENTS)
                 {
-                    ESP_LOGE(TAG, "GATTC register failed with error code: %04x.", param->reg.status);
-                    return;
+                    std::lock_guard lock{ g_client_refs_mutex };
+                    registered = g_client_refs[param->reg.app_id].lock();
                 }
 
-                ESP_LOGI(TAG, "Registered GATTC app ID: %04x.", param->reg.app_id);
-
+                if (!registered)
                 {
-                    client_ptr = g_client_refs[param->reg.app_id].lock();
+                    ESP_LOGW(TAG, "Client not found.");
+                    return;
+                }
 
-                    if (!client_ptr)
-                    {
-                        ESP_LOGW(TAG, "Client not found.");
-                        return;
-                    }
+                esp_gatt_status_t status = param->reg.status;
 
-                    ESP_LOGI(TAG, "GATTC interface is: %x", gattc_if);
-                    client_ptr->m_gattc_interface = gattc_if;
+                if (status != ESP_GATT_OK)
+                {
+                    ESP_LOGE(TAG, "GATTC register failed with error code: %04x.", status);
                 }
+                else if (gattc_if >= g_dispatch_table.size())
+                {
+                    ESP_LOGE(TAG, "Invalid GATTC interface: %x.", gattc_if);
+                    status = ESP_GATT_ERROR;
+                }
+                else
+                {
+                    ESP_LOGD(TAG, "Registered GATTC app ID: %04x, interface: %x.", param->reg.app_id, gattc_if);
+                    registered->m_gattc_interface = gattc_if;
+                    g_dispatch_table[gattc_if].store(registered.get());
+                }
+
+                registered->complete(operation_type::register_application, param->reg.app_id, status);
             }
-            else
+            else if (event != ESP_GATTC_CLOSE_EVT && event != ESP_GATTC_UNREG_EVT)
             {
+                // Close and unregistration events of a released client arrive after it gave up its slot.
                 ESP_LOGW(TAG, "Client not found.");
             }
 
@@ -102,70 +139,124 @@ namespace hub::ble
         switch (event)
         {
         case ESP_GATTC_NOTIFY_EVT:
-            if (auto characteristic_iter = client_ptr->m_characteristics_callbacks.find(param->notify.handle); 
-                characteristic_iter != client_ptr->m_characteristics_callbacks.end())
+        {
+            notify_event_handler_t handler;
+
             {
-                std::invoke(
-                    characteristic_iter->second, 
-                    std::vector<uint8_t>(param->notify.value, param->notify.value + static_cast<size_t>(param->notify.value_len)));
+                // Handlers may issue requests, so they are invoked outside of the lock.
+                std::lock_guard lock{ client_ptr->m_operations_mutex };
+
+                const auto& callbacks = client_ptr->m_characteristics_callbacks;
+
+                if (auto characteristic_iter = std::lower_bound(callbacks.cbegin(), callbacks.cend(), param->notify.handle, by_handle);
+                    characteristic_iter != callbacks.cend() && characteristic_iter->handle == param->notify.handle)
+                {
+                    handler = characteristic_iter->handler;
+                }
+            }
+
+            if (handler)
+            {
+                const int64_t start = esp_timer_get_time();
+
+                handler(value_view(param->notify.value, param->notify.value_len));
+                client_ptr->m_completions->timing().record(operation_timing::NOTIFICATION, start);
             }
             break;
+        }
         case ESP_GATTC_CONNECT_EVT:
+        {
+            const utils::mac remote(param->connect.remote_bda, param->connect.remote_bda + utils::mac::MAC_SIZE);
+
+            {
+                // Connections are reported to every application, only the one this client opened is taken.
+                std::lock_guard lock{ client_ptr->m_operations_mutex };
+
+                if (remote != client_ptr->m_open_address)
+                {
+                    break;
+                }
+            }
+
             client_ptr->m_connection_id = param->connect.conn_id;
-            client_ptr->m_address       = utils::mac(param->connect.remote_bda, param->connect.remote_bda + utils::mac::MAC_SIZE);
+            client_ptr->m_address       = remote;
 
             if (esp_ble_gattc_send_mtu_req(gattc_if, client_ptr->m_connection_id) != ESP_OK)
             {
-                xEventGroupSetBits(client_ptr->m_event_group, FAIL_BIT);
+                client_ptr->complete(operation_type::open, 0, ESP_GATT_ERROR);
             }
 
+            break;
+        }
+        case ESP_GATTC_OPEN_EVT:
+            if (param->open.status != ESP_GATT_OK)
+            {
+                client_ptr->complete(operation_type::open, 0, param->open.status);
+            }
             break;
         case ESP_GATTC_CFG_MTU_EVT:
-            client_ptr->m_self_ref = client_ptr;
-            xEventGroupSetBits(client_ptr->m_event_group, CONNECT_BIT);
+            // The connection stays usable with the default MTU if the exchange failed.
+            if (param->cfg_mtu.status == ESP_GATT_OK)
+            {
+                client_ptr->m_mtu.store(param->cfg_mtu.mtu, std::memory_order_relaxed);
+            }
+
+            client_ptr->m_self_ref = client_ptr->weak_from_this().lock();
+            client_ptr->m_connected.store(true, std::memory_order_release);
+            client_ptr->complete(operation_type::open, 0, ESP_GATT_OK);
             break;
         case ESP_GATTC_SEARCH_RES_EVT:
-            client_ptr->m_services_cache.push_back(
-                service(
-                    client_ptr, 
-                    { 
-                        param->search_res.is_primary,
-                        param->search_res.start_handle,
-                        param->search_res.end_handle,
-                        param->search_res.srvc_id.uuid
-                    }
-                )
-            );
+            client_ptr->on_search_result(
+                { 
+                    param->search_res.is_primary,
+                    param->search_res.start_handle,
+                    param->search_res.end_handle,
+                    param->search_res.srvc_id.uuid
+                });
             break;
         case ESP_GATTC_SEARCH_CMPL_EVT:
-            xEventGroupSetBits(client_ptr->m_event_group, SEARCH_SERVICE_BIT);
+            client_ptr->complete(operation_type::search_service, 0, param->search_cmpl.status);
             break;
         case ESP_GATTC_REG_FOR_NOTIFY_EVT:
-            xEventGroupSetBits(client_ptr->m_event_group, REG_FOR_NOTIFY_BIT);
+            client_ptr->complete(operation_type::register_for_notify, param->reg_for_notify.handle, param->reg_for_notify.status);
             break;
         case ESP_GATTC_UNREG_FOR_NOTIFY_EVT:
-            xEventGroupSetBits(client_ptr->m_event_group, UNREG_FOR_NOTIFY_BIT);
+            client_ptr->complete(operation_type::unregister_for_notify, param->unreg_for_notify.handle, param->unreg_for_notify.status);
             break;
         case ESP_GATTC_WRITE_CHAR_EVT:
-            xEventGroupSetBits(client_ptr->m_event_group, WRITE_CHAR_BIT);
+            client_ptr->complete(operation_type::write_characteristic, param->write.handle, param->write.status);
+            break;
+        case ESP_GATTC_PREP_WRITE_EVT:
+            client_ptr->complete(operation_type::prepare_write, param->write.handle, param->write.status);
+            break;
+        case ESP_GATTC_EXEC_EVT:
+            client_ptr->complete(operation_type::execute_write, 0, param->exec_cmpl.status);
             break;
         case ESP_GATTC_READ_CHAR_EVT:
-            client_ptr->m_characteristic_data_cache.resize(param->read.value_len);
-            std::copy(param->read.value, param->read.value + param->read.value_len, client_ptr->m_characteristic_data_cache.begin());
-            xEventGroupSetBits(client_ptr->m_event_group, READ_CHAR_BIT);
+            client_ptr->complete(operation_type::read_characteristic, param->read.handle, param->read.status, param->read.value, param->read.value_len);
             break;
         case ESP_GATTC_WRITE_DESCR_EVT:
-            client_ptr->m_descriptor_data_cache.resize(param->read.value_len);
-            std::copy(param->read.value, param->read.value + param->read.value_len, client_ptr->m_descriptor_data_cache.begin());
-            xEventGroupSetBits(client_ptr->m_event_group, WRITE_DESCR_BIT);
+            client_ptr->complete(operation_type::write_descriptor, param->write.handle, param->write.status);
             break;
         case ESP_GATTC_READ_DESCR_EVT:
-            xEventGroupSetBits(client_ptr->m_event_group, READ_DESCR_BIT);
+            client_ptr->complete(operation_type::read_descriptor, param->read.handle, param->read.status, param->read.value, param->read.value_len);
+            break;
+        case ESP_GATTC_QUEUE_FULL_EVT:
+            if (param->queue_full.is_full)
+            {
+                ESP_LOGW(TAG, "GATTC command queue full.");
+            }
             break;
         case ESP_GATTC_DISCONNECT_EVT:
-            xEventGroupSetBits(client_ptr->m_event_group, DISCONNECT_BIT);
+            // Reported to every application as well.
+            if (param->disconnect.conn_id == client_ptr->m_connection_id &&
+                utils::mac(param->disconnect.remote_bda, param->disconnect.remote_bda + utils::mac::MAC_SIZE) == client_ptr->m_address)
+            {
+                client_ptr->on_disconnect(param->disconnect.reason);
+            }
             break;
         case ESP_GATTC_CLOSE_EVT:
+            // May destroy the client, it is not accessed afterwards.
             client_ptr->m_self_ref.reset();
             break;
         default:
@@ -173,171 +264,802 @@ namespace hub::ble
         }
     }
 
-    tl::expected<void, esp_err_t> client::connect(utils::mac address) noexcept
+    void client::gap_callback(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param) noexcept
     {
-        esp_err_t result = ESP_OK;
+        const uint8_t* bda = nullptr;
+
+        switch (event)
+        {
+        case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
+            bda = param->update_conn_params.bda;
+            break;
+        case ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT:
+            bda = param->read_rssi_cmpl.remote_addr;
+            break;
+        default:
+            return;
+        }
+
+        dispatch_guard guard;
+
+        const utils::mac address(bda, bda + utils::mac::MAC_SIZE);
+
+        // Connection events are rare, the few registered clients are compared by address.
+        for (const auto& entry : g_dispatch_table)
+        {
+            if (client* client_ptr = entry.load(); client_ptr && client_ptr->m_address == address)
+            {
+                if (event == ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT)
+                {
+                    client_ptr->on_connection_update(param->update_conn_params);
+                }
+                else
+                {
+                    client_ptr->on_rssi(param->read_rssi_cmpl);
+                }
+
+                return;
+            }
+        }
+    }
+
+    completion_token client::submit(operation_type type, uint16_t handle, const std::vector<uint8_t>& data) const noexcept
+    {
+        // Bluedroid copies the written value before returning.
+        auto* value = const_cast<uint8_t*>(data.data());
+
+        return issue(type, handle, [this, type, handle, value, length{ static_cast<uint16_t>(data.size()) }]() {
+            switch (type)
+            {
+            case operation_type::write_characteristic:
+                return esp_ble_gattc_write_char(
+                    m_gattc_interface, m_connection_id, handle, length, value, ESP_GATT_WRITE_TYPE_RSP, ESP_GATT_AUTH_REQ_NONE);
+            case operation_type::read_characteristic:
+                return esp_ble_gattc_read_char(m_gattc_interface, m_connection_id, handle, ESP_GATT_AUTH_REQ_NONE);
+            case operation_type::write_descriptor:
+                return esp_ble_gattc_write_char_descr(
+                    m_gattc_interface, m_connection_id, handle, length, value, ESP_GATT_WRITE_TYPE_RSP, ESP_GATT_AUTH_REQ_NONE);
+            case operation_type::read_descriptor:
+                return esp_ble_gattc_read_char_descr(m_gattc_interface, m_connection_id, handle, ESP_GATT_AUTH_REQ_NONE);
+            case operation_type::register_for_notify:
+                return esp_ble_gattc_register_for_notify(m_gattc_interface, const_cast<uint8_t*>(static_cast<const uint8_t*>(m_address)), handle);
+            case operation_type::unregister_for_notify:
+                return esp_ble_gattc_unregister_for_notify(m_gattc_interface, const_cast<uint8_t*>(static_cast<const uint8_t*>(m_address)), handle);
+            default:
+                return ESP_ERR_INVALID_ARG;
+            }
+        });
+    }
+
+    completion_token client::submit_write(
+        operation_type          type,
+        uint16_t                handle,
+        const uint8_t*          value,
+        uint16_t                length,
+        uint16_t                offset,
+        esp_gatt_write_type_t   write_type) const noexcept
+    {
+        // Bluedroid copies the written value before returning.
+        auto* data = const_cast<uint8_t*>(value);
+
+        return issue(type, handle, [this, type, handle, data, length, offset, write_type]() {
+            if (type == operation_type::prepare_write)
+            {
+                return esp_ble_gattc_prepare_write(m_gattc_interface, m_connection_id, handle, offset, length, data, ESP_GATT_AUTH_REQ_NONE);
+            }
 
-        auto iter = std::find_if(g_client_refs.cbegin(), g_client_refs.cend(), [](const auto& client_ref) {
-            return client_ref.expired();
+            return esp_ble_gattc_write_char(m_gattc_interface, m_connection_id, handle, length, data, write_type, ESP_GATT_AUTH_REQ_NONE);
         });
+    }
+
+    tl::expected<void, esp_err_t> client::write_long(uint16_t handle, const std::vector<uint8_t>& data) const noexcept
+    {
+        const std::size_t mtu = get_mtu();
 
-        if (iter == g_client_refs.cend())
+        if (data.size() <= mtu - 3)
         {
-            ESP_LOGE(TAG, "Maximum number of clients already connected.");
-            tl::expected<void, esp_err_t>(tl::unexpect, ESP_FAIL);
+            if (auto result = submit(operation_type::write_characteristic, handle, data).wait(BLE_TIMEOUT); !result)
+            {
+                return tl::make_unexpected(result.error());
+            }
+
+            return tl::expected<void, esp_err_t>();
         }
 
-        if (result = esp_ble_gattc_register_callback(&client::gattc_callback); result != ESP_OK)
+        if (data.size() > MAX_ATTRIBUTE_LENGTH)
         {
-            ESP_LOGE(TAG, "Could not register GATTC callback.");
-            tl::expected<void, esp_err_t>(tl::unexpect, result);
+            return tl::make_unexpected(ESP_ERR_INVALID_SIZE);
         }
 
-        if (result = esp_ble_gatt_set_local_mtu(500); result != ESP_OK)
+        // Prepare Write Request carries the handle and the offset, two bytes more than a Write Request.
+        const std::size_t chunk = mtu - 5;
+
+        auto prepared = pipeline((data.size() + chunk - 1) / chunk, [this, handle, &data, chunk](std::size_t index) {
+            const std::size_t offset = index * chunk;
+
+            return submit_write(
+                operation_type::prepare_write, 
+                handle, 
+                data.data() + offset, 
+                static_cast<uint16_t>(std::min(chunk, data.size() - offset)), 
+                static_cast<uint16_t>(offset));
+        });
+
+        // The server discards the prepared chunks if the write is cancelled.
+        auto executed = issue(operation_type::execute_write, 0, [this, execute{ prepared.has_value() }]() {
+            return esp_ble_gattc_execute_write(m_gattc_interface, m_connection_id, execute);
+        }).wait(BLE_TIMEOUT);
+
+        if (!prepared)
         {
-            ESP_LOGE(TAG, "Could set local MTU size.");
-            tl::expected<void, esp_err_t>(tl::unexpect, result);
+            return prepared;
         }
 
+        if (!executed)
         {
-            m_app_id = std::distance(g_client_refs.cbegin(), iter);
-            g_client_refs[m_app_id] = shared_client::weak_from_this();
+            return tl::make_unexpected(executed.error());
+        }
+
+        return tl::expected<void, esp_err_t>();
+    }
+
+    tl::expected<void, esp_err_t> client::write_stream(uint16_t handle, const std::vector<uint8_t>& data) const noexcept
+    {
+        const std::size_t chunk = get_mtu() - 3;
+
+        return pipeline(std::max<std::size_t>((data.size() + chunk - 1) / chunk, 1), [this, handle, &data, chunk](std::size_t index) {
+            const std::size_t offset = index * chunk;
+
+            return submit_write(
+                operation_type::write_characteristic, 
+                handle, 
+                data.data() + offset, 
+                static_cast<uint16_t>(std::min(chunk, data.size() - offset)), 
+                0, 
+                ESP_GATT_WRITE_TYPE_NO_RSP);
+        });
+    }
+
+    void client::complete(operation_type type, uint16_t handle, esp_gatt_status_t status, const uint8_t* value, uint16_t length) noexcept
+    {
+        std::lock_guard lock{ m_operations_mutex };
+
+        const std::size_t index = m_completions->find_oldest(type, handle);
+
+        if (index == impl::completion_pool::INVALID_INDEX)
+        {
+            ESP_LOGW(TAG, "No pending GATT operation %u on handle 0x%04x.", static_cast<unsigned>(type), handle);
+            return;
+        }
+
+        if (status == ESP_GATT_INVALID_HANDLE)
+        {
+            // The server changed since its attributes were cached, the table is dropped when the connection is released.
+            m_attributes_invalid.store(true, std::memory_order_relaxed);
+        }
+
+        if (type == operation_type::unregister_for_notify && status == ESP_GATT_OK)
+        {
+            erase_notify_handler(handle);
+        }
+
+        m_completions->complete(index, status, value, length);
+    }
+
+    void client::on_disconnect(esp_gatt_conn_reason_t reason) noexcept
+    {
+        m_connected.store(false, std::memory_order_release);
+
+        disconnect_handler_t handler;
+
+        {
+            std::lock_guard lock{ m_operations_mutex };
+
+            // The connection may also be lost without a close request.
+            const std::size_t index = m_completions->find_oldest(operation_type::close, 0);
+
+            if (index != impl::completion_pool::INVALID_INDEX)
+            {
+                m_completions->complete(index, ESP_GATT_OK);
+            }
+            else if (m_disconnect_handler)
+            {
+                try
+                {
+                    handler = m_disconnect_handler;
+                }
+                catch (const std::bad_alloc&)
+                {
+                    ESP_LOGE(TAG, "Not enough memory to invoke the disconnect handler.");
+                }
+            }
+
+            m_completions->fail_all(ESP_ERR_INVALID_STATE, index);
+        }
+
+        // Invoked without the lock, the handler may issue requests of its own.
+        if (handler)
+        {
+            ESP_LOGW(TAG, "Connection to %s lost, reason 0x%x.", std::string(m_address).c_str(), static_cast<unsigned>(reason));
+            handler(reason);
+        }
+    }
+
+    void client::on_search_result(const esp_gattc_service_elem_t& service) noexcept
+    {
+        std::lock_guard lock{ m_operations_mutex };
+
+        if (const std::size_t index = m_completions->find_oldest(operation_type::search_service, 0); index != impl::completion_pool::INVALID_INDEX)
+        {
+            auto& slot = (*m_completions)[index];
 
-            if (result = esp_ble_gattc_app_register(m_app_id); result != ESP_OK)
+            try
             {
-                ESP_LOGE(TAG, "Could not register GATTC app.");
-                tl::expected<void, esp_err_t>(tl::unexpect, result);
+                slot.services.push_back(service);
+            }
+            catch (const std::bad_alloc&)
+            {
+                slot.error = ESP_ERR_NO_MEM;
             }
         }
+    }
 
-        if (result = esp_ble_gattc_open(
-                m_gattc_interface, 
-                static_cast<uint8_t*>(address), 
-                BLE_ADDR_TYPE_PUBLIC, 
-                true); 
-            result != ESP_OK)
+    void client::on_connection_update(const esp_ble_gap_cb_param_t::ble_update_conn_params_evt_param& update) noexcept
+    {
+        std::lock_guard lock{ m_operations_mutex };
+
+        if (update.status == ESP_BT_STATUS_SUCCESS)
         {
-            ESP_LOGE(TAG, "GATTC open failed.");
-            tl::expected<void, esp_err_t>(tl::unexpect, result);
+            m_connection_params = connection_params{ update.conn_int, update.conn_int, update.latency, update.timeout };
+
+            ESP_LOGD(TAG, "Connection interval %u, latency %u, timeout %u.", update.conn_int, update.latency, update.timeout);
+        }
+        else
+        {
+            ESP_LOGW(TAG, "Connection parameters update failed with status %i.", update.status);
         }
 
-        EventBits_t bits = xEventGroupWaitBits(m_event_group, CONNECT_BIT | FAIL_BIT, pdTRUE, pdFALSE, static_cast<TickType_t>(BLE_TIMEOUT));
+        // Updates initiated by the peripheral complete no request.
+        if (const std::size_t index = m_completions->find_oldest(operation_type::update_connection_params, 0); index != impl::completion_pool::INVALID_INDEX)
+        {
+            m_completions->complete(index, update.status == ESP_BT_STATUS_SUCCESS ? ESP_GATT_OK : ESP_GATT_ERROR);
+        }
+    }
 
-        if (bits & CONNECT_BIT)
+    void client::on_rssi(const esp_ble_gap_cb_param_t::ble_read_rssi_cmpl_evt_param& rssi) noexcept
+    {
+        std::lock_guard lock{ m_operations_mutex };
+
+        if (const std::size_t index = m_completions->find_oldest(operation_type::read_rssi, 0); index != impl::completion_pool::INVALID_INDEX)
         {
-            ESP_LOGI(TAG, "GATT client connected.");
-            return tl::expected<void, esp_err_t>();
+            const auto value = static_cast<uint8_t>(rssi.rssi);
+
+            m_completions->complete(index, rssi.status == ESP_BT_STATUS_SUCCESS ? ESP_GATT_OK : ESP_GATT_ERROR, &value, sizeof(value));
         }
-        else if (bits & FAIL_BIT)
+    }
+
+    void client::set_notify_handler(uint16_t handle, notify_event_handler_t handler)
+    {
+        std::lock_guard lock{ m_operations_mutex };
+
+        if (auto iter = std::lower_bound(m_characteristics_callbacks.begin(), m_characteristics_callbacks.end(), handle, by_handle);
+            iter != m_characteristics_callbacks.end() && iter->handle == handle)
         {
-            ESP_LOGE(TAG, "GATT client connecton failed.");
-            return tl::expected<void, esp_err_t>(tl::unexpect, ESP_FAIL);
+            iter->handler = std::move(handler);
         }
         else
         {
-            ESP_LOGE(TAG, "GATT client connecton timed out.");
-            return tl::expected<void, esp_err_t>(tl::unexpect, ESP_ERR_TIMEOUT);
+            m_characteristics_callbacks.insert(iter, notify_entry{ handle, std::move(handler) });
         }
     }
 
-    tl::expected<void, esp_err_t> client::disconnect() noexcept
+    void client::clear_notify_handler(uint16_t handle) noexcept
+    {
+        std::lock_guard lock{ m_operations_mutex };
+        erase_notify_handler(handle);
+    }
+
+    void client::erase_notify_handler(uint16_t handle) noexcept
+    {
+        if (auto iter = std::lower_bound(m_characteristics_callbacks.begin(), m_characteristics_callbacks.end(), handle, by_handle);
+            iter != m_characteristics_callbacks.end() && iter->handle == handle)
+        {
+            m_characteristics_callbacks.erase(iter);
+        }
+    }
+
+    tl::expected<void, esp_err_t> client::connect(utils::mac address, esp_ble_addr_type_t address_type) noexcept
+    {
+        if (auto acquired = acquire_application(); !acquired)
+        {
+            return acquired;
+        }
+
+        // The interface used to open the connection is only known once the registration completes.
+        if (auto registered = register_application().wait(BLE_TIMEOUT); !registered)
+        {
+            ESP_LOGE(TAG, "Could not register GATTC app.");
+            release_application();
+            return tl::expected<void, esp_err_t>(tl::unexpect, registered.error());
+        }
+
+        if (auto opened = open(address, address_type).wait(BLE_TIMEOUT); !opened)
+        {
+            ESP_LOGE(TAG, "GATT client connection failed with error code %i [%s].", opened.error(), esp_err_to_name(opened.error()));
+            release_application();
+            return tl::expected<void, esp_err_t>(tl::unexpect, opened.error());
+        }
+
+        ESP_LOGI(TAG, "GATT client connected.");
+        return tl::expected<void, esp_err_t>();
+    }
+
+    tl::expected<void, esp_err_t> client::acquire_application() noexcept
     {
         esp_err_t result = ESP_OK;
 
-        if (result = esp_ble_gattc_close(m_gattc_interface, m_connection_id); result != ESP_OK)
+        if (result = esp_ble_gattc_register_callback(&client::gattc_callback); result != ESP_OK)
         {
-            ESP_LOGE(TAG, "GATTC disconnect failed.");
+            ESP_LOGE(TAG, "Could not register GATTC callback.");
             return tl::expected<void, esp_err_t>(tl::unexpect, result);
         }
 
-        EventBits_t bits = xEventGroupWaitBits(m_event_group, DISCONNECT_BIT | FAIL_BIT, pdTRUE, pdFALSE, static_cast<TickType_t>(BLE_TIMEOUT));
+        if (result = gap::add_handler(&client::gap_callback); result != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Could not add GAP handler.");
+            return tl::expected<void, esp_err_t>(tl::unexpect, result);
+        }
 
-        if (bits & DISCONNECT_BIT)
+        if (result = esp_ble_gatt_set_local_mtu(LOCAL_MTU); result != ESP_OK)
         {
-            ESP_LOGI(TAG, "Disconnect success.");
-            return tl::expected<void, esp_err_t>();
+            ESP_LOGE(TAG, "Could set local MTU size.");
+            return tl::expected<void, esp_err_t>(tl::unexpect, result);
         }
-        else if (bits & FAIL_BIT)
+
+        if (!m_registered)
         {
-            ESP_LOGE(TAG, "GATTC disconnect failed.");
-            return tl::expected<void, esp_err_t>(tl::unexpect, ESP_FAIL);
+            std::lock_guard lock{ g_client_refs_mutex };
+
+            auto iter = std::find_if(g_client_refs.cbegin(), g_client_refs.cend(), [](const auto& client_ref) {
+                return client_ref.expired();
+            });
+
+            if (iter == g_client_refs.cend())
+            {
+                ESP_LOGE(TAG, "Maximum number of clients already connected.");
+                return tl::expected<void, esp_err_t>(tl::unexpect, ESP_ERR_NOT_FOUND);
+            }
+
+            m_app_id = std::distance(g_client_refs.cbegin(), iter);
+            g_client_refs[m_app_id] = shared_client::weak_from_this();
+            m_registered = true;
         }
-        else
+
+        return tl::expected<void, esp_err_t>();
+    }
+
+    completion_token client::register_application() noexcept
+    {
+        return issue(operation_type::register_application, m_app_id, [this]() {
+            return esp_ble_gattc_app_register(m_app_id);
+        });
+    }
+
+    completion_token client::open(const utils::mac& address, esp_ble_addr_type_t address_type) noexcept
+    {
+        m_mtu.store(ESP_GATT_DEF_BLE_MTU_SIZE, std::memory_order_relaxed);
+
         {
-            ESP_LOGE(TAG, "GATTC disconnect timeout.");
-            return tl::expected<void, esp_err_t>(tl::unexpect, ESP_ERR_TIMEOUT);
+            std::lock_guard lock{ m_operations_mutex };
+            m_connection_params = connection_params{  };
+            m_open_address      = address;
         }
+
+        return issue(operation_type::open, 0, [this, &address, address_type]() {
+            return esp_ble_gattc_open(m_gattc_interface, const_cast<uint8_t*>(static_cast<const uint8_t*>(address)), address_type, true);
+        });
     }
 
-    tl::expected<std::vector<service>, esp_err_t> client::get_services() const noexcept
+    tl::expected<void, esp_err_t> client::set_connection_params(const connection_params& params) noexcept
     {
-        esp_err_t result = ESP_OK;
+        if (!params.is_valid())
+        {
+            return tl::expected<void, esp_err_t>(tl::unexpect, ESP_ERR_INVALID_ARG);
+        }
 
-        m_services_cache = std::vector<service>();
-        
-        if (result = esp_ble_gattc_search_service(m_gattc_interface, m_connection_id, nullptr); result != ESP_OK)
+        auto updated = issue(operation_type::update_connection_params, 0, [this, &params]() {
+            esp_ble_conn_update_params_t update{  };
+
+            std::copy(static_cast<const uint8_t*>(m_address), static_cast<const uint8_t*>(m_address) + utils::mac::MAC_SIZE, update.bda);
+            update.min_int  = params.min_interval;
+            update.max_int  = params.max_interval;
+            update.latency  = params.latency;
+            update.timeout  = params.timeout;
+
+            return esp_ble_gap_update_conn_params(&update);
+        }).wait(BLE_TIMEOUT);
+
+        if (!updated)
         {
-            return tl::expected<std::vector<service>, esp_err_t>(tl::unexpect, result);
+            ESP_LOGW(TAG, "Connection parameters update failed with error code %i [%s].", updated.error(), esp_err_to_name(updated.error()));
+            return tl::expected<void, esp_err_t>(tl::unexpect, updated.error());
         }
 
-        EventBits_t bits = xEventGroupWaitBits(m_event_group, SEARCH_SERVICE_BIT | FAIL_BIT, pdTRUE, pdFALSE, static_cast<TickType_t>(BLE_TIMEOUT));
+        return tl::expected<void, esp_err_t>();
+    }
+
+    void client::set_disconnect_handler(disconnect_handler_t handler)
+    {
+        std::lock_guard lock{ m_operations_mutex };
+        m_disconnect_handler = std::move(handler);
+    }
+
+    tl::expected<int8_t, esp_err_t> client::read_rssi() const noexcept
+    {
+        auto read = issue(operation_type::read_rssi, 0, [this]() {
+            return esp_ble_gap_read_rssi(const_cast<uint8_t*>(static_cast<const uint8_t*>(m_address)));
+        }).wait(BLE_TIMEOUT);
 
-        if (bits & SEARCH_SERVICE_BIT)
+        if (!read)
         {
-            ESP_LOGI(TAG, "Get service success.");
+            return tl::expected<int8_t, esp_err_t>(tl::unexpect, read.error());
         }
-        else if (bits & FAIL_BIT)
+
+        if (read->size() != 1)
         {
-            ESP_LOGE(TAG, "Retrieve service failed.");
-            return tl::expected<std::vector<service>, esp_err_t>(tl::unexpect, ESP_FAIL);
+            return tl::expected<int8_t, esp_err_t>(tl::unexpect, ESP_FAIL);
         }
-        else
+
+        return static_cast<int8_t>(read->front());
+    }
+
+    connection_params client::get_connection_params() const noexcept
+    {
+        std::lock_guard lock{ m_operations_mutex };
+        return m_connection_params;
+    }
+
+    tl::expected<void, esp_err_t> client::disconnect() noexcept
+    {
+        // A lost connection was already closed by the controller, only the application slot is left to free.
+        if (!is_connected())
+        {
+            release_application();
+            return tl::expected<void, esp_err_t>();
+        }
+
+        auto closed = issue(operation_type::close, 0, [this]() {
+            return esp_ble_gattc_close(m_gattc_interface, m_connection_id);
+        }).wait(BLE_TIMEOUT);
+
+        // The slot is given up even if the close timed out, unregistering the application drops its connection.
+        release_application();
+
+        if (!closed)
         {
-            ESP_LOGE(TAG, "Retrieve service timeout.");
-            return tl::expected<std::vector<service>, esp_err_t>(tl::unexpect, ESP_ERR_TIMEOUT);
+            ESP_LOGE(TAG, "GATTC disconnect failed with error code %i [%s].", closed.error(), esp_err_to_name(closed.error()));
+            return tl::expected<void, esp_err_t>(tl::unexpect, closed.error());
         }
 
-        if (m_services_cache.empty())
+        ESP_LOGI(TAG, "Disconnect success.");
+        return tl::expected<void, esp_err_t>();
+    }
+
+    void client::release_application() noexcept
+    {
+        if (m_gattc_interface != ESP_GATT_IF_NONE)
+        {
+            g_dispatch_table[m_gattc_interface].store(nullptr);
+            esp_ble_gattc_app_unregister(m_gattc_interface);
+            m_gattc_interface = ESP_GATT_IF_NONE;
+            m_connected.store(false, std::memory_order_release);
+
+            // A callback that loaded the entry before it was cleared may still be running, unless this is that callback.
+            if (xTaskGetCurrentTaskHandle() != g_dispatch_task.load(std::memory_order_relaxed))
+            {
+                if (const uint32_t sequence = g_dispatch_sequence.load(); sequence & 1)
+                {
+                    while (g_dispatch_sequence.load() == sequence)
+                    {
+                        vTaskDelay(1);
+                    }
+                }
+            }
+        }
+
+        if (m_registered)
+        {
+            std::lock_guard lock{ g_client_refs_mutex };
+            g_client_refs[m_app_id].reset();
+            m_registered = false;
+        }
+
+        m_self_ref.reset();
+
+        {
+            std::lock_guard lock{ m_attributes_mutex };
+            m_attributes.reset();
+        }
+
+        if (m_attributes_invalid.exchange(false, std::memory_order_relaxed))
+        {
+            ESP_LOGW(TAG, "Cached attributes of %s are stale, discarding them.", std::string(m_address).c_str());
+            attribute_cache::erase(m_address);
+        }
+    }
+
+    tl::expected<std::vector<esp_gattc_service_elem_t>, esp_err_t> client::search_services(esp_bt_uuid_t* uuid) const noexcept
+    {
+        auto token = search_services_async(uuid);
+        return collect_services(token, BLE_TIMEOUT);
+    }
+
+    completion_token client::search_services_async(esp_bt_uuid_t* uuid) const noexcept
+    {
+        return issue(operation_type::search_service, 0, [this, uuid]() {
+            return esp_ble_gattc_search_service(m_gattc_interface, m_connection_id, uuid);
+        });
+    }
+
+    tl::expected<std::vector<esp_gattc_service_elem_t>, esp_err_t> client::collect_services(completion_token& token, timing::duration_t timeout) const noexcept
+    {
+        auto slot = token.wait_for_slot(timeout);
+
+        if (!slot)
+        {
+            ESP_LOGE(TAG, "Retrieve service failed with error code %i [%s].", slot.error(), esp_err_to_name(slot.error()));
+            return tl::make_unexpected(slot.error());
+        }
+
+        if ((*slot)->services.empty())
         {
             ESP_LOGE(TAG, "No service found.");
-            return tl::expected<std::vector<service>, esp_err_t>(tl::unexpect, ESP_FAIL);
+            return tl::make_unexpected(ESP_FAIL);
         }
 
-        return tl::expected<std::vector<service>, esp_err_t>(std::move(m_services_cache));
+        try
+        {
+            return std::vector<esp_gattc_service_elem_t>((*slot)->services);
+        }
+        catch (const std::bad_alloc&)
+        {
+            return tl::make_unexpected(ESP_ERR_NO_MEM);
+        }
     }
 
-    tl::expected<service, esp_err_t> client::get_service_by_uuid(const esp_bt_uuid_t* uuid) const noexcept
+    tl::expected<std::shared_ptr<const attribute_table>, esp_err_t> client::get_attributes() const noexcept
     {
-        m_services_cache = std::move(std::vector<service>());
-        
-        if (esp_err_t result = esp_ble_gattc_search_service(m_gattc_interface, m_connection_id, const_cast<esp_bt_uuid_t*>(uuid)); result != ESP_OK)
+        std::lock_guard lock{ m_attributes_mutex };
+
+        if (m_attributes)
+        {
+            return m_attributes;
+        }
+
+        const int64_t start = esp_timer_get_time();
+
+        tl::expected<attribute_table, esp_err_t> table = attribute_cache::load(m_address);
+
+        if (table && !validate_attributes(*table))
         {
-            return  tl::expected<service, esp_err_t>(tl::unexpect, result);
+            ESP_LOGI(TAG, "Cached attributes of %s changed, discovering.", std::string(m_address).c_str());
+            table = tl::make_unexpected(ESP_ERR_INVALID_STATE);
         }
 
-        EventBits_t bits = xEventGroupWaitBits(m_event_group, SEARCH_SERVICE_BIT | FAIL_BIT, pdTRUE, pdFALSE, static_cast<TickType_t>(BLE_TIMEOUT));
+        bool discovered = false;
 
-        if (bits & SEARCH_SERVICE_BIT)
+        if (!table)
         {
-            ESP_LOGI(TAG, "Get service success.");
+            if (table = discover_attributes(); !table)
+            {
+                return tl::make_unexpected(table.error());
+            }
+
+            discovered = true;
         }
-        else if (bits & FAIL_BIT)
+
+        return install_attributes(std::move(*table), discovered, start);
+    }
+
+    tl::expected<std::shared_ptr<const attribute_table>, esp_err_t> client::install_attributes(attribute_table&& table, bool discovered, int64_t start) const noexcept
+    {
+        if (discovered)
         {
-            ESP_LOGE(TAG, "Retrieve service failed.");
-            return  tl::expected<service, esp_err_t>(tl::unexpect, ESP_FAIL);
+            if (esp_err_t result = attribute_cache::store(m_address, table); result != ESP_OK)
+            {
+                ESP_LOGW(TAG, "Could not cache attributes, error code %i [%s].", result, esp_err_to_name(result));
+            }
         }
-        else
+
+        try
+        {
+            m_attributes = std::make_shared<const attribute_table>(std::move(table));
+        }
+        catch (const std::bad_alloc&)
+        {
+            return tl::make_unexpected(ESP_ERR_NO_MEM);
+        }
+
+        m_completions->timing().record(operation_timing::ATTRIBUTES, start);
+
+        return m_attributes;
+    }
+
+    tl::expected<attribute_table, esp_err_t> client::discover_attributes() const noexcept
+    {
+        auto services = search_services(nullptr);
+
+        if (!services)
+        {
+            return tl::make_unexpected(services.error());
+        }
+
+        auto table = build_attributes(std::move(*services));
+
+        if (table && table->database_hash_handle != ESP_GATT_ILLEGAL_HANDLE)
+        {
+            // The table is only validated by hash if the hash could be read.
+            if (auto hash = submit(operation_type::read_characteristic, table->database_hash_handle).wait(BLE_TIMEOUT); hash)
+            {
+                table->database_hash = std::move(*hash);
+            }
+            else
+            {
+                table->database_hash_handle = ESP_GATT_ILLEGAL_HANDLE;
+            }
+        }
+
+        return table;
+    }
+
+    tl::expected<attribute_table, esp_err_t> client::build_attributes(std::vector<esp_gattc_service_elem_t>&& services) const noexcept
+    {
+        try
+        {
+            attribute_table table{  };
+            table.services = std::move(services);
+
+            // Bluedroid answers these from its local copy of the server database, filled by the search.
+            for (const auto& service : table.services)
+            {
+                uint16_t count = 0;
+
+                if (esp_ble_gattc_get_attr_count(m_gattc_interface, m_connection_id, ESP_GATT_DB_CHARACTERISTIC, 
+                        service.start_handle, service.end_handle, ESP_GATT_ILLEGAL_HANDLE, &count) != ESP_GATT_OK || count == 0)
+                {
+                    continue;
+                }
+
+                const std::size_t first = table.characteristics.size();
+                table.characteristics.resize(first + count);
+
+                if (esp_ble_gattc_get_all_char(m_gattc_interface, m_connection_id, service.start_handle, service.end_handle, 
+                        &table.characteristics[first], &count, 0) != ESP_GATT_OK)
+                {
+                    count = 0;
+                }
+
+                table.characteristics.resize(first + count);
+            }
+
+            for (const auto& characteristic : table.characteristics)
+            {
+                uint16_t count = 0;
+
+                if (esp_ble_gattc_get_attr_count(m_gattc_interface, m_connection_id, ESP_GATT_DB_DESCRIPTOR, 
+                        0, 0, characteristic.char_handle, &count) != ESP_GATT_OK || count == 0)
+                {
+                    continue;
+                }
+
+                const std::size_t first = table.descriptors.size();
+                table.descriptors.resize(first + count);
+
+                if (esp_ble_gattc_get_all_descr(m_gattc_interface, m_connection_id, characteristic.char_handle, 
+                        &table.descriptors[first], &count, 0) != ESP_GATT_OK)
+                {
+                    count = 0;
+                }
+
+                table.descriptors.resize(first + count);
+            }
+
+            std::sort(table.characteristics.begin(), table.characteristics.end(), [](const auto& lhs, const auto& rhs) { 
+                return lhs.char_handle < rhs.char_handle; 
+            });
+
+            std::sort(table.descriptors.begin(), table.descriptors.end(), [](const auto& lhs, const auto& rhs) { 
+                return lhs.handle < rhs.handle; 
+            });
+
+            if (auto iter = std::find_if(table.characteristics.cbegin(), table.characteristics.cend(), [](const auto& elem) {
+                    return uuid_equal(elem.uuid, DATABASE_HASH_UUID);
+                });
+                iter != table.characteristics.cend())
+            {
+                table.database_hash_handle = iter->char_handle;
+            }
+
+            ESP_LOGI(TAG, "Discovered %u services, %u characteristics, %u descriptors.", 
+                static_cast<unsigned>(table.services.size()), 
+                static_cast<unsigned>(table.characteristics.size()), 
+                static_cast<unsigned>(table.descriptors.size()));
+
+            return table;
+        }
+        catch (const std::bad_alloc&)
         {
-            ESP_LOGE(TAG, "Retrieve service timeout.");
-            return  tl::expected<service, esp_err_t>(tl::unexpect, ESP_ERR_TIMEOUT);
+            return tl::make_unexpected(ESP_ERR_NO_MEM);
         }
+    }
+
+    bool client::validate_attributes(const attribute_table& table) const noexcept
+    {
+        if (table.database_hash_handle == ESP_GATT_ILLEGAL_HANDLE)
+        {
+            return true;
+        }
+
+        auto hash = submit(operation_type::read_characteristic, table.database_hash_handle).wait(BLE_TIMEOUT);
+        return hash && *hash == table.database_hash;
+    }
+
+    tl::expected<std::vector<service>, esp_err_t> client::get_services() const noexcept
+    {
+        auto attributes = get_attributes();
+
+        if (!attributes)
+        {
+            return tl::make_unexpected(attributes.error());
+        }
+
+        try
+        {
+            std::weak_ptr<client> client_ptr = std::const_pointer_cast<client>(shared_client::shared_from_this());
+            std::vector<service> result;
+            result.reserve((*attributes)->services.size());
+
+            for (const auto& elem : (*attributes)->services)
+            {
+                result.emplace_back(client_ptr, elem);
+            }
+
+            ESP_LOGD(TAG, "Get service success.");
+            return tl::expected<std::vector<service>, esp_err_t>(std::move(result));
+        }
+        catch (const std::bad_alloc&)
+        {
+            return tl::make_unexpected(ESP_ERR_NO_MEM);
+        }
+    }
+
+    tl::expected<service, esp_err_t> client::get_service_by_uuid(const esp_bt_uuid_t* uuid) const noexcept
+    {
+        auto attributes = get_attributes();
+
+        if (!attributes)
+        {
+            return tl::make_unexpected(attributes.error());
+        }
+
+        return find_service(**attributes, uuid);
+    }
+
+    tl::expected<service, esp_err_t> client::find_service(const attribute_table& attributes, const esp_bt_uuid_t* uuid) const noexcept
+    {
+        const auto& services = attributes.services;
+
+        auto iter = std::find_if(services.cbegin(), services.cend(), [uuid](const auto& elem) { 
+            return uuid_equal(elem.uuid, *uuid); 
+        });
 
-        if (m_services_cache.empty())
+        if (iter == services.cend())
         {
             ESP_LOGE(TAG, "No service found.");
-            return  tl::expected<service, esp_err_t>(tl::unexpect, ESP_FAIL);
+            return tl::make_unexpected(ESP_ERR_NOT_FOUND);
         }
 
-        return tl::expected<service, esp_err_t>(std::move(m_services_cache.front()));
+        ESP_LOGD(TAG, "Get service success.");
+        return service(std::const_pointer_cast<client>(shared_client::shared_from_this()), *iter);
     }
 }
\ No newline at end of file
@@ -0,0 +1,421 @@
+#include "ble/coroutine.hpp"
+
+#ifdef HUB_BLE_COROUTINES
+
+#include <algorithm>
+#include <new>
+#include <string>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "ble/attribute_cache.hpp"
+
+namespace hub::ble::coro
+{
+    namespace
+    {
+        constexpr const char* TAG{ "hub::ble::coro" };
+
+        constexpr EventBits_t WAKER_BIT{ ble::impl::completion_pool::WAKER_BIT };
+    }
+
+    /**
+     * @brief The steps of the blocking client calls the coroutines await one by one.
+     */
+    struct client_access
+    {
+        static tl::expected<void, esp_err_t> acquire_application(client& device) noexcept
+        {
+            return device.acquire_application();
+        }
+
+        static completion_token register_application(client& device) noexcept
+        {
+            return device.register_application();
+        }
+
+        static completion_token open(client& device, const utils::mac& address, esp_ble_addr_type_t address_type) noexcept
+        {
+            return device.open(address, address_type);
+        }
+
+        static void release_application(client& device) noexcept
+        {
+            device.release_application();
+        }
+
+        static completion_token read(const client& device, uint16_t handle) noexcept
+        {
+            return device.submit(operation_type::read_characteristic, handle);
+        }
+
+        static completion_token search_services(const client& device) noexcept
+        {
+            return device.search_services_async(nullptr);
+        }
+
+        static tl::expected<std::vector<esp_gattc_service_elem_t>, esp_err_t> collect_services(const client& device, completion_token& token) noexcept
+        {
+            return device.collect_services(token, timing::duration_t{  });
+        }
+
+        static std::shared_ptr<const attribute_table> get_attributes(const client& device) noexcept
+        {
+            std::lock_guard lock{ device.m_attributes_mutex };
+            return device.m_attributes;
+        }
+
+        static tl::expected<attribute_table, esp_err_t> build_attributes(const client& device, std::vector<esp_gattc_service_elem_t>&& services) noexcept
+        {
+            return device.build_attributes(std::move(services));
+        }
+
+        static tl::expected<std::shared_ptr<const attribute_table>, esp_err_t> install_attributes(
+            const client& device, attribute_table&& table, bool discovered, int64_t start) noexcept
+        {
+            std::lock_guard lock{ device.m_attributes_mutex };
+            return device.install_attributes(std::move(table), discovered, start);
+        }
+
+        static void clear_notify_handler(const characteristic& target) noexcept
+        {
+            if (auto shared_client = target.m_client_ptr.lock(); shared_client)
+            {
+                shared_client->clear_notify_handler(target.get_handle());
+            }
+        }
+
+        static tl::expected<service, esp_err_t> find_service(const client& device, const attribute_table& attributes, const esp_bt_uuid_t& uuid) noexcept
+        {
+            return device.find_service(attributes, &uuid);
+        }
+    };
+
+    namespace
+    {
+        /**
+         * @brief Awaitable service search, resumes with the found services.
+         */
+        class service_search : public operation
+        {
+        public:
+
+            service_search(const client& device, timing::duration_t timeout) noexcept :
+                operation(client_access::search_services(device), timeout),
+                m_device{ device }
+            {
+
+            }
+
+            tl::expected<std::vector<esp_gattc_service_elem_t>, esp_err_t> await_resume() noexcept
+            {
+                return client_access::collect_services(m_device, m_token);
+            }
+
+        private:
+
+            const client& m_device;
+        };
+    }
+
+    executor::executor() :
+        m_sessions{  },
+        m_ready{  },
+        m_waiters{  },
+        m_event_group{ xEventGroupCreate() }
+    {
+        if (!m_event_group)
+        {
+            throw std::bad_alloc();
+        }
+    }
+
+    executor::~executor()
+    {
+        m_waiters.clear();
+        m_ready.clear();
+        m_sessions.clear();
+
+        vEventGroupDelete(m_event_group);
+    }
+
+    void executor::spawn(task<void> session)
+    {
+        // A session waits for one thing at a time, reserving here keeps suspending free of allocations.
+        const std::size_t count = m_sessions.size() + 1;
+
+        m_sessions.reserve(count);
+        m_ready.reserve(count);
+        m_waiters.reserve(count);
+
+        session.m_handle.promise().m_executor = this;
+
+        m_ready.push_back(session.m_handle);
+        m_sessions.push_back(std::move(session));
+    }
+
+    void executor::run()
+    {
+        while (!m_sessions.empty())
+        {
+            // Sessions spawned by a resumed coroutine are appended and resumed in the same pass.
+            for (std::size_t index = 0; index < m_ready.size(); index++)
+            {
+                m_ready[index].resume();
+            }
+
+            m_ready.clear();
+            reap();
+
+            if (m_sessions.empty())
+            {
+                break;
+            }
+
+            // Cleared before polling, a completion arriving after the poll sets it again and ends the wait.
+            xEventGroupClearBits(m_event_group, WAKER_BIT);
+
+            if (const TickType_t timeout = poll_waiters(); m_ready.empty())
+            {
+                xEventGroupWaitBits(m_event_group, WAKER_BIT, pdTRUE, pdFALSE, timeout);
+                poll_waiters();
+            }
+        }
+    }
+
+    void executor::wake() noexcept
+    {
+        xEventGroupSetBits(m_event_group, WAKER_BIT);
+    }
+
+    void executor::suspend(std::coroutine_handle<> handle, ready_check_t is_ready, const void* context, timing::duration_t timeout) noexcept
+    {
+        const bool timed = (timeout != timing::MAX_DELAY);
+        const TickType_t deadline = timed ? xTaskGetTickCount() + timing::to_ticks(timeout) : 0;
+
+        m_waiters.push_back(waiter{ handle, is_ready, context, deadline, timed });
+    }
+
+    TickType_t executor::poll_waiters() noexcept
+    {
+        const TickType_t now = xTaskGetTickCount();
+        TickType_t nearest = portMAX_DELAY;
+
+        for (std::size_t index = 0; index < m_waiters.size(); )
+        {
+            auto& entry = m_waiters[index];
+
+            // Tick counts wrap, compare by distance.
+            if (entry.is_ready(entry.context) || (entry.timed && static_cast<int32_t>(now - entry.deadline) >= 0))
+            {
+                m_ready.push_back(entry.handle);
+                entry = m_waiters.back();
+                m_waiters.pop_back();
+                continue;
+            }
+
+            if (entry.timed)
+            {
+                nearest = std::min<TickType_t>(nearest, entry.deadline - now);
+            }
+
+            index++;
+        }
+
+        return nearest;
+    }
+
+    void executor::reap() noexcept
+    {
+        auto finished = std::remove_if(m_sessions.begin(), m_sessions.end(), [](const task<void>& session) {
+            if (!session.m_handle.done())
+            {
+                return false;
+            }
+
+            if (const auto& error = session.m_handle.promise().m_exception; error)
+            {
+                try
+                {
+                    std::rethrow_exception(error);
+                }
+                catch (const std::exception& e)
+                {
+                    ESP_LOGE(TAG, "Session failed: %s", e.what());
+                }
+                catch (...)
+                {
+                    ESP_LOGE(TAG, "Session failed.");
+                }
+            }
+
+            return true;
+        });
+
+        m_sessions.erase(finished, m_sessions.end());
+    }
+
+    notification_stream::notification_stream() :
+        m_state{ std::make_shared<state>() }
+    {
+
+    }
+
+    notify_handler notification_stream::get_handler() const noexcept
+    {
+        return [state{ m_state }](value_view value) {
+            {
+                std::lock_guard lock{ state->mutex };
+
+                if (state->count == CAPACITY)
+                {
+                    state->dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+
+                auto copy = value.copy();
+
+                if (!copy)
+                {
+                    state->dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+
+                state->values[(state->head + state->count) % CAPACITY] = std::move(*copy);
+                state->count++;
+            }
+
+            if (EventGroupHandle_t waker = state->waker.load(std::memory_order_acquire); waker)
+            {
+                xEventGroupSetBits(waker, WAKER_BIT);
+            }
+        };
+    }
+
+    bool notification_stream::next_awaiter::is_ready(const void* context) noexcept
+    {
+        const auto& stream = *static_cast<const notification_stream*>(context);
+
+        std::lock_guard lock{ stream.m_state->mutex };
+        return stream.m_state->count != 0;
+    }
+
+    tl::expected<pooled_value, esp_err_t> notification_stream::pop() noexcept
+    {
+        std::lock_guard lock{ m_state->mutex };
+
+        if (m_state->count == 0)
+        {
+            return tl::make_unexpected(ESP_ERR_TIMEOUT);
+        }
+
+        pooled_value value = std::move(m_state->values[m_state->head]);
+        m_state->head = (m_state->head + 1) % CAPACITY;
+        m_state->count--;
+
+        return value;
+    }
+
+    task<tl::expected<void, esp_err_t>> connect(std::shared_ptr<client> device, utils::mac address, esp_ble_addr_type_t address_type)
+    {
+        if (auto acquired = client_access::acquire_application(*device); !acquired)
+        {
+            co_return acquired;
+        }
+
+        // The interface used to open the connection is only known once the registration completes.
+        if (auto registered = co_await operation(client_access::register_application(*device), BLE_TIMEOUT); !registered)
+        {
+            ESP_LOGE(TAG, "Could not register GATTC app.");
+            client_access::release_application(*device);
+            co_return tl::expected<void, esp_err_t>(tl::unexpect, registered.error());
+        }
+
+        if (auto opened = co_await operation(client_access::open(*device, address, address_type), BLE_TIMEOUT); !opened)
+        {
+            ESP_LOGE(TAG, "GATT client connection failed with error code %i [%s].", opened.error(), esp_err_to_name(opened.error()));
+            client_access::release_application(*device);
+            co_return tl::expected<void, esp_err_t>(tl::unexpect, opened.error());
+        }
+
+        co_return tl::expected<void, esp_err_t>();
+    }
+
+    task<tl::expected<service, esp_err_t>> get_service_by_uuid(std::shared_ptr<client> device, esp_bt_uuid_t uuid)
+    {
+        if (auto attributes = client_access::get_attributes(*device); attributes)
+        {
+            co_return client_access::find_service(*device, *attributes, uuid);
+        }
+
+        const int64_t start = esp_timer_get_time();
+
+        tl::expected<attribute_table, esp_err_t> table = attribute_cache::load(device->get_address());
+
+        if (table && table->database_hash_handle != ESP_GATT_ILLEGAL_HANDLE)
+        {
+            if (auto hash = co_await operation(client_access::read(*device, table->database_hash_handle), BLE_TIMEOUT); !hash || *hash != table->database_hash)
+            {
+                ESP_LOGI(TAG, "Cached attributes of %s changed, discovering.", std::string(device->get_address()).c_str());
+                table = tl::make_unexpected(ESP_ERR_INVALID_STATE);
+            }
+        }
+
+        bool discovered = false;
+
+        if (!table)
+        {
+            auto services = co_await service_search(*device, BLE_TIMEOUT);
+
+            if (!services)
+            {
+                co_return tl::make_unexpected(services.error());
+            }
+
+            if (table = client_access::build_attributes(*device, std::move(*services)); !table)
+            {
+                co_return tl::make_unexpected(table.error());
+            }
+
+            // The table is only validated by hash if the hash could be read.
+            if (table->database_hash_handle != ESP_GATT_ILLEGAL_HANDLE)
+            {
+                if (auto hash = co_await operation(client_access::read(*device, table->database_hash_handle), BLE_TIMEOUT); hash)
+                {
+                    table->database_hash = std::move(*hash);
+                }
+                else
+                {
+                    table->database_hash_handle = ESP_GATT_ILLEGAL_HANDLE;
+                }
+            }
+
+            discovered = true;
+        }
+
+        auto attributes = client_access::install_attributes(*device, std::move(*table), discovered, start);
+
+        if (!attributes)
+        {
+            co_return tl::make_unexpected(attributes.error());
+        }
+
+        co_return client_access::find_service(*device, **attributes, uuid);
+    }
+
+    task<operation_result> subscribe(characteristic target, notify_handler handler, timing::duration_t timeout)
+    {
+        auto result = co_await operation(target.subscribe_async(std::move(handler)), timeout);
+
+        // Left installed, the handler would keep receiving values and keep its captures alive.
+        if (!result)
+        {
+            client_access::clear_notify_handler(target);
+        }
+
+        co_return result;
+    }
+}
+
+#endif
\ No newline at end of file
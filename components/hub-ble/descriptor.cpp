@@ -19,94 +19,53 @@ namespace hub::ble
 
     tl::expected<void, esp_err_t> descriptor::write(std::vector<uint8_t> data) noexcept
     {
-        auto shared_client = m_client_ptr.lock();
-
-        if (!shared_client)
+        if (auto result = write_async(data).wait(BLE_TIMEOUT); !result)
         {
-            ESP_LOGE(TAG, "Client is not connected.");
-            return tl::expected<void, esp_err_t>(tl::unexpect, ESP_ERR_INVALID_STATE);
+            ESP_LOGE(TAG, "Write descriptor failed with error code %i [%s].", result.error(), esp_err_to_name(result.error()));
+            return tl::expected<void, esp_err_t>(tl::unexpect, result.error());
         }
 
-        if (esp_err_t result = esp_ble_gattc_write_char_descr(
-                shared_client->m_gattc_interface, 
-                shared_client->m_connection_id,
-                m_descriptor.handle,
-                data.size(),
-                data.data(),
-                ESP_GATT_WRITE_TYPE_RSP,
-                ESP_GATT_AUTH_REQ_NONE); 
-            result != ESP_OK)
-        {
-            ESP_LOGE(TAG, "Write descriptor failed.");
-            return tl::expected<void, esp_err_t>(tl::unexpect, result);
-        }
+        ESP_LOGD(TAG, "Write descriptor success.");
+        return tl::expected<void, esp_err_t>();
+    }
 
-        EventBits_t bits = xEventGroupWaitBits(
-            shared_client->m_event_group, 
-            client::WRITE_DESCR_BIT | client::FAIL_BIT, 
-            pdTRUE, 
-            pdFALSE, 
-            static_cast<TickType_t>(BLE_TIMEOUT));
+    tl::expected<std::vector<uint8_t>, esp_err_t> descriptor::read() const noexcept
+    {
+        auto result = read_async().wait(BLE_TIMEOUT);
 
-        if (bits & client::WRITE_DESCR_BIT)
-        {
-            ESP_LOGI(TAG, "Write descriptor success.");
-            return tl::expected<void, esp_err_t>();
-        }
-        else if (bits & client::FAIL_BIT)
+        if (!result)
         {
-            ESP_LOGE(TAG, "Write descriptor failed.");
-            return tl::expected<void, esp_err_t>(tl::unexpect, ESP_FAIL);
-        }
-        else
-        {
-            ESP_LOGE(TAG, "Write descriptor timeout.");
-            return tl::expected<void, esp_err_t>(tl::unexpect, ESP_ERR_TIMEOUT);
+            ESP_LOGE(TAG, "Read descriptor failed with error code %i [%s].", result.error(), esp_err_to_name(result.error()));
+            return result;
         }
+
+        ESP_LOGD(TAG, "Read descriptor success.");
+        return result;
     }
 
-    tl::expected<std::vector<uint8_t>, esp_err_t> descriptor::read() const noexcept
+    completion_token descriptor::write_async(const std::vector<uint8_t>& data) noexcept
     {
         auto shared_client = m_client_ptr.lock();
 
         if (!shared_client)
         {
             ESP_LOGE(TAG, "Client is not connected.");
-            return tl::make_unexpected<esp_err_t>(ESP_ERR_INVALID_STATE);
+            return completion_token(ESP_ERR_INVALID_STATE);
         }
 
-        if (esp_err_t result = esp_ble_gattc_read_char_descr(
-            shared_client->m_gattc_interface, 
-            shared_client->m_connection_id,
-            m_descriptor.handle,
-            ESP_GATT_AUTH_REQ_NONE); 
-            result != ESP_OK)
-        {
-            ESP_LOGE(TAG, "Read descriptor failed.");
-            return tl::expected<std::vector<uint8_t>, esp_err_t>(tl::unexpect, result);
-        }
+        return shared_client->submit(operation_type::write_descriptor, m_descriptor.handle, data);
+    }
 
-        EventBits_t bits = xEventGroupWaitBits(
-            shared_client->m_event_group, 
-            client::READ_DESCR_BIT | client::FAIL_BIT, 
-            pdTRUE, 
-            pdFALSE, 
-            static_cast<TickType_t>(BLE_TIMEOUT));
+    completion_token descriptor::read_async() const noexcept
+    {
+        auto shared_client = m_client_ptr.lock();
 
-        if (bits & client::READ_DESCR_BIT)
-        {
-            ESP_LOGI(TAG, "Read descriptor success.");
-            return std::vector<uint8_t>(std::move(shared_client->m_descriptor_data_cache));
-        }
-        else if (bits & client::FAIL_BIT)
-        {
-            ESP_LOGE(TAG, "Read descriptor failed.");
-            return tl::expected<std::vector<uint8_t>, esp_err_t>(tl::unexpect, ESP_FAIL);
-        }
-        else
+        if (!shared_client)
         {
-            ESP_LOGE(TAG, "Read descriptor timeout.");
-            return tl::expected<std::vector<uint8_t>, esp_err_t>(tl::unexpect, ESP_ERR_TIMEOUT);
+            ESP_LOGE(TAG, "Client is not connected.");
+            return completion_token(ESP_ERR_INVALID_STATE);
         }
+
+        return shared_client->submit(operation_type::read_descriptor, m_descriptor.handle);
     }
 }
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include "ble/gap.hpp"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+
+#include "esp_log.h"
+
+namespace hub::ble::gap
+{
+    namespace
+    {
+        constexpr const char* TAG{ "hub::ble::gap" };
+
+        std::array<std::atomic<handler_t>, MAX_HANDLERS> g_handlers{  };
+        std::mutex g_handlers_mutex;  // Serializes adding, the callback only loads the entries.
+
+        void gap_callback(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param)
+        {
+            for (const auto& entry : g_handlers)
+            {
+                handler_t handler = entry.load(std::memory_order_acquire);
+
+                if (!handler)
+                {
+                    break;
+                }
+
+                handler(event, param);
+            }
+        }
+    }
+
+    esp_err_t add_handler(handler_t handler) noexcept
+    {
+        std::lock_guard lock{ g_handlers_mutex };
+
+        for (auto& entry : g_handlers)
+        {
+            const handler_t current = entry.load(std::memory_order_relaxed);
+
+            if (current == handler)
+            {
+                return ESP_OK;
+            }
+
+            if (current)
+            {
+                continue;
+            }
+
+            // The callback is registered with the first handler, Bluedroid may deliver events right away.
+            if (&entry == &g_handlers.front())
+            {
+                if (esp_err_t result = esp_ble_gap_register_callback(&gap_callback); result != ESP_OK)
+                {
+                    ESP_LOGE(TAG, "Register GAP callback failed with error code %i [%s].", result, esp_err_to_name(result));
+                    return result;
+                }
+            }
+
+            entry.store(handler, std::memory_order_release);
+            return ESP_OK;
+        }
+
+        ESP_LOGE(TAG, "Too many GAP handlers.");
+        return ESP_ERR_NO_MEM;
+    }
+}
\ No newline at end of file
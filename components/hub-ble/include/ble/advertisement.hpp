@@ -0,0 +1,131 @@
+#ifndef HUB_BLE_ADVERTISEMENT_HPP
+#define HUB_BLE_ADVERTISEMENT_HPP
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+#include "esp_gap_ble_api.h"
+
+#include "utils/mac.hpp"
+
+namespace hub::ble
+{
+    /**
+     * @brief Decoded BLE advertisement (advertising data followed by scan response).
+     * Fixed-size POD: variable length fields are stored as slices of the raw payload copy,
+     * so the structure can be copied by value without heap allocation.
+     */
+    struct advertisement
+    {
+        static constexpr std::size_t MAX_DATA_SIZE          { ESP_BLE_ADV_DATA_LEN_MAX + ESP_BLE_SCAN_RSP_DATA_LEN_MAX };
+        static constexpr std::size_t MAX_UUID16             { 8 };
+        static constexpr std::size_t MAX_UUID128            { 2 };
+        static constexpr std::size_t MAX_SERVICE_DATA       { 4 };
+
+        static constexpr uint16_t HAS_FLAGS                 { 1 << 0 };
+        static constexpr uint16_t HAS_TX_POWER              { 1 << 1 };
+        static constexpr uint16_t HAS_NAME_COMPLETE         { 1 << 2 };
+        static constexpr uint16_t HAS_NAME_SHORT            { 1 << 3 };
+        static constexpr uint16_t HAS_MANUFACTURER_DATA     { 1 << 4 };
+        static constexpr uint16_t TRUNCATED                 { 1 << 5 };  // More UUIDs or service data than fit in the arrays.
+        static constexpr uint16_t MALFORMED                 { 1 << 6 };  // AD structure length exceeds the payload.
+
+        /**
+         * @brief Slice of the raw payload.
+         */
+        struct field
+        {
+            uint8_t offset;
+            uint8_t length;
+        };
+
+        struct service_data_type
+        {
+            uint16_t    uuid;
+            field       value;
+        };
+
+        int64_t                                             timestamp;          // Reception time, microseconds since boot.
+        std::array<uint8_t, utils::mac::MAC_SIZE>           address;
+        esp_ble_addr_type_t                                 address_type;
+        esp_ble_evt_type_t                                  event_type;
+        int8_t                                              rssi;
+        int8_t                                              tx_power;
+        uint8_t                                             flags;
+        uint16_t                                            fields;
+        field                                               name;
+        uint16_t                                            company_id;
+        field                                               manufacturer_data;
+        uint8_t                                             uuid16_count;
+        uint8_t                                             uuid128_count;
+        uint8_t                                             service_data_count;
+        std::array<uint16_t, MAX_UUID16>                    uuid16;
+        std::array<field, MAX_UUID128>                      uuid128;
+        std::array<service_data_type, MAX_SERVICE_DATA>     service_data;
+        uint8_t                                             data_length;
+        std::array<uint8_t, MAX_DATA_SIZE>                  data;
+
+        bool has(uint16_t field_mask) const noexcept
+        {
+            return (fields & field_mask) == field_mask;
+        }
+
+        const uint8_t* begin(field value) const noexcept
+        {
+            return data.data() + value.offset;
+        }
+
+        const uint8_t* end(field value) const noexcept
+        {
+            return data.data() + value.offset + value.length;
+        }
+
+        /**
+         * @brief Complete name if advertised, short name otherwise. Empty if the device did not advertise a name.
+         */
+        std::string_view get_name() const noexcept
+        {
+            return std::string_view(reinterpret_cast<const char*>(begin(name)), name.length);
+        }
+
+        /**
+         * @brief Find service data by 16-bit service UUID.
+         *
+         * @return const service_data_type* Pointer to the entry or nullptr if not present.
+         */
+        const service_data_type* find_service_data(uint16_t uuid) const noexcept
+        {
+            for (uint8_t i = 0; i < service_data_count; i++)
+            {
+                if (service_data[i].uuid == uuid)
+                {
+                    return &service_data[i];
+                }
+            }
+
+            return nullptr;
+        }
+    };
+
+    static_assert(std::is_trivially_copyable_v<advertisement>, "advertisement must be trivially copyable.");
+
+    /**
+     * @brief Decode advertising data and scan response in a single pass over the AD structures.
+     * Parsing stops at the first zero-length structure (padding) or at a structure exceeding the payload,
+     * in which case MALFORMED is set and everything decoded so far is kept.
+     *
+     * @param payload Advertising data followed by scan response data.
+     * @param length Total length of the payload, at most advertisement::MAX_DATA_SIZE.
+     * @param result Structure to decode into. Address, RSSI and event type are left untouched.
+     */
+    void parse_advertisement(const uint8_t* payload, uint8_t length, advertisement& result) noexcept;
+
+    /**
+     * @brief Decode a GAP scan result event into result.
+     */
+    void parse_advertisement(const esp_ble_gap_cb_param_t::ble_scan_result_evt_param& scan_result, advertisement& result) noexcept;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,73 @@
+#ifndef HUB_BLE_ATTRIBUTE_CACHE_HPP
+#define HUB_BLE_ATTRIBUTE_CACHE_HPP
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+#include "esp_err.h"
+#include "esp_gatt_defs.h"
+
+#include "tl/expected.hpp"
+
+#include "utils/mac.hpp"
+
+namespace hub::ble
+{
+    /**
+     * @brief Compare UUIDs of any length, 16 and 32 bit UUIDs are expanded with the Bluetooth base UUID.
+     */
+    bool uuid_equal(const esp_bt_uuid_t& lhs, const esp_bt_uuid_t& rhs) noexcept;
+
+    /**
+     * @brief Services, characteristics and descriptors of a GATT server, as found by service discovery.
+     */
+    struct attribute_table
+    {
+        using characteristic_iterator   = std::vector<esp_gattc_char_elem_t>::const_iterator;
+        using descriptor_iterator       = std::vector<esp_gattc_descr_elem_t>::const_iterator;
+
+        std::vector<esp_gattc_service_elem_t>   services;
+        std::vector<esp_gattc_char_elem_t>      characteristics;                            // Ordered by value handle.
+        std::vector<esp_gattc_descr_elem_t>     descriptors;                                // Ordered by handle.
+        uint16_t                                database_hash_handle{ ESP_GATT_ILLEGAL_HANDLE };  // Database Hash characteristic, if the server has one.
+        std::vector<uint8_t>                    database_hash;                              // Its value when the table was discovered.
+
+        /**
+         * @brief Characteristics declared within the service handle range.
+         */
+        std::pair<characteristic_iterator, characteristic_iterator> get_characteristics(uint16_t start_handle, uint16_t end_handle) const noexcept;
+
+        /**
+         * @brief Descriptors of the characteristic, those following its value up to the next characteristic or the end of the service.
+         */
+        std::pair<descriptor_iterator, descriptor_iterator> get_descriptors(uint16_t char_handle, uint16_t service_end_handle) const noexcept;
+    };
+
+    /**
+     * @brief Attribute tables of known servers persisted in NVS, keyed by the device address.
+     * Lets a reconnecting client skip service discovery. Requires NVS flash to be initialized.
+     */
+    namespace attribute_cache
+    {
+        /**
+         * @brief Load the attribute table stored for the device.
+         *
+         * @return tl::expected<attribute_table, esp_err_t> Stored table, ESP_ERR_NOT_FOUND if there is none,
+         * ESP_ERR_INVALID_VERSION or ESP_ERR_INVALID_CRC if the record was written by a different firmware or is corrupted.
+         */
+        tl::expected<attribute_table, esp_err_t> load(const utils::mac& address) noexcept;
+
+        /**
+         * @brief Store the attribute table of the device, replacing the previous one.
+         */
+        esp_err_t store(const utils::mac& address, const attribute_table& table) noexcept;
+
+        /**
+         * @brief Remove the table of the device, e.g. when its handles turned out to be stale.
+         */
+        esp_err_t erase(const utils::mac& address) noexcept;
+    }
+}
+
+#endif
\ No newline at end of file
@@ -11,10 +11,18 @@
 
 #include "tl/expected.hpp"
 
+#include "operation.hpp"
+#include "notification.hpp"
+
 namespace hub::ble
 {
     class client;
     class descriptor;
+
+    namespace coro
+    {
+        struct client_access;
+    }
     
     /**
      * @brief Class representing BLE characteristics.
@@ -37,13 +45,24 @@ namespace hub::ble
         characteristic(std::weak_ptr<client> client_ptr, std::pair<uint16_t, uint16_t> service_handle_range, esp_gattc_char_elem_t characteristic);
 
         /**
-         * @brief Write data to the characteristic.
+         * @brief Write data to the characteristic. Values longer than the negotiated MTU allows for a single write
+         * are sent as prepared writes and applied by the server at once, up to MAX_ATTRIBUTE_LENGTH bytes.
          * 
          * @param data 
-         * @return tl::expected<void, esp_err_t> 
+         * @return tl::expected<void, esp_err_t> ESP_ERR_INVALID_SIZE if the value is too long.
          */
         tl::expected<void, esp_err_t> write(std::vector<uint8_t> data) noexcept;
 
+        /**
+         * @brief Stream data to the characteristic as writes without response, each carrying up to MTU - 3 bytes.
+         * For transfers the peripheral reassembles itself, e.g. firmware images. Packets are pipelined,
+         * the call returns once all of them were handed to the controller.
+         * 
+         * @param data 
+         * @return tl::expected<void, esp_err_t> 
+         */
+        tl::expected<void, esp_err_t> write_without_response(const std::vector<uint8_t>& data) noexcept;
+
         /**
          * @brief Read data from the characteristic.
          * 
@@ -51,6 +70,31 @@ namespace hub::ble
          */
         tl::expected<std::vector<uint8_t>, esp_err_t> read() const noexcept;
 
+        /**
+         * @brief Queue a write without waiting for the response. Requests issued back to back are pipelined by Bluedroid.
+         * The value must fit into a single write of MTU - 3 bytes.
+         * 
+         * @param data 
+         * @return completion_token 
+         */
+        completion_token write_async(const std::vector<uint8_t>& data) noexcept;
+
+        /**
+         * @brief Queue a write without response, completed once it was handed to the controller. Requests queued
+         * after it do not wait for a round trip of its own. The value must fit into a single write of MTU - 3 bytes.
+         * 
+         * @param data 
+         * @return completion_token 
+         */
+        completion_token write_without_response_async(const std::vector<uint8_t>& data) noexcept;
+
+        /**
+         * @brief Queue a read without waiting for the response, the token returns the read value.
+         * 
+         * @return completion_token 
+         */
+        completion_token read_async() const noexcept;
+
         /**
          * @brief Get the characteristic handle.
          * 
@@ -71,6 +115,16 @@ namespace hub::ble
             return m_characteristic.uuid;
         }
 
+        /**
+         * @brief Get the characteristic properties, ESP_GATT_CHAR_PROP_BIT_* flags.
+         * 
+         * @return esp_gatt_char_prop_t 
+         */
+        esp_gatt_char_prop_t get_properties() const noexcept
+        {
+            return m_characteristic.properties;
+        }
+
         /**
          * @brief Get all the descriptors for the given characteristic.
          * 
@@ -89,10 +143,18 @@ namespace hub::ble
         /**
          * @brief Subscribe to characteristic notifications.
          * 
-         * @param callback 
+         * @param callback Invoked in the Bluedroid task with a view of the value, which is only valid during the call.
          * @return tl::expected<void, esp_err_t> 
          */
-        tl::expected<void, esp_err_t> subscribe(std::function<void(const std::vector<uint8_t>&)> callback) noexcept;
+        tl::expected<void, esp_err_t> subscribe(notify_handler callback) noexcept;
+
+        /**
+         * @brief Install the notification callback and queue the registration without waiting for it.
+         * 
+         * @param callback 
+         * @return completion_token 
+         */
+        completion_token subscribe_async(notify_handler callback) noexcept;
 
         /**
          * @brief Unsubscribe from characteristic notifications.
@@ -101,8 +163,17 @@ namespace hub::ble
          */
         tl::expected<void, esp_err_t> unsubscribe() noexcept;
 
+        /**
+         * @brief Queue the unregistration without waiting for it, the callback is removed once it completes.
+         * 
+         * @return completion_token 
+         */
+        completion_token unsubscribe_async() noexcept;
+
     private:
 
+        friend struct coro::client_access;
+
         static constexpr const char* TAG{ "hub::ble::characteristic" };
 
         esp_gattc_char_elem_t           m_characteristic;
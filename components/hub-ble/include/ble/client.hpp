@@ -2,7 +2,6 @@
 #define HUB_BLE_CLIENT_HPP
 
 #include "freertos/FreeRTOS.h"
-#include "freertos/event_groups.h"
 
 #include <cstdint>
 #include <vector>
@@ -11,17 +10,25 @@
 #include <functional>
 #include <utility>
 #include <string_view>
-#include <map>
+#include <mutex>
+#include <atomic>
+#include <array>
+#include <optional>
 
 #include "tl/expected.hpp"
 
 #include "esp_gatt_defs.h"
 #include "esp_gattc_api.h"
+#include "esp_gap_ble_api.h"
 #include "esp_err.h"
+#include "esp_log.h"
 
 #include "utils/mac.hpp"
 #include "timing/timing.hpp"
 
+#include "operation.hpp"
+#include "notification.hpp"
+#include "attribute_cache.hpp"
 #include "service.hpp"
 #include "characteristic.hpp"
 #include "descriptor.hpp"
@@ -32,6 +39,53 @@ namespace hub::ble
 
     inline constexpr uint16_t   MAX_CLIENTS{ CONFIG_BTDM_CTRL_BLE_MAX_CONN };
     inline constexpr auto       BLE_TIMEOUT{ 5_s };
+    inline constexpr uint16_t   LOCAL_MTU{ 500 };
+    inline constexpr uint16_t   MAX_ATTRIBUTE_LENGTH{ 512 };   // Longest value a long write may carry.
+
+    /**
+     * @brief Connection parameters, intervals in units of 1.25 ms and the supervision timeout in units of 10 ms.
+     */
+    struct connection_params
+    {
+        uint16_t    min_interval;
+        uint16_t    max_interval;
+        uint16_t    latency;        // Connection events the peripheral may skip.
+        uint16_t    timeout;
+
+        bool operator==(const connection_params& other) const noexcept
+        {
+            return min_interval == other.min_interval && max_interval == other.max_interval && latency == other.latency && timeout == other.timeout;
+        }
+
+        bool operator!=(const connection_params& other) const noexcept
+        {
+            return !(*this == other);
+        }
+
+        /**
+         * @brief Check the ranges of the Core Specification, the supervision timeout has to outlast
+         * the longest sequence of skipped connection events twice.
+         */
+        constexpr bool is_valid() const noexcept
+        {
+            return min_interval >= 6 && min_interval <= max_interval && max_interval <= 3200 &&
+                latency <= 499 &&
+                timeout >= 10 && timeout <= 3200 &&
+                static_cast<uint32_t>(timeout) * 4 > (1u + latency) * max_interval;
+        }
+    };
+
+    namespace connection_profile
+    {
+        inline constexpr connection_params low_latency{ 6, 12, 0, 200 };      // 7.5 - 15 ms, for command bursts.
+        inline constexpr connection_params balanced{ 24, 40, 0, 400 };        // 30 - 50 ms.
+        inline constexpr connection_params low_power{ 80, 160, 4, 600 };      // 100 - 200 ms, the peripheral may sleep through 4 events.
+    }
+
+    namespace coro
+    {
+        struct client_access;
+    }
 
     class client : public std::enable_shared_from_this<client>
     {
@@ -40,8 +94,10 @@ namespace hub::ble
         friend class service;
         friend class characteristic;
         friend class descriptor;
+        friend struct coro::client_access;
 
-        using notify_event_handler_t = std::function<void(const std::vector<uint8_t>&)>;
+        using notify_event_handler_t = notify_handler;
+        using disconnect_handler_t = std::function<void(esp_gatt_conn_reason_t)>;
         using shared_client = std::enable_shared_from_this<client>;
 
         /**
@@ -66,9 +122,10 @@ namespace hub::ble
          * @brief 
          * 
          * @param address 
+         * @param address_type Type of the address, random for devices using a static random or private address.
          * @return tl::expected<void, esp_err_t> 
          */
-        tl::expected<void, esp_err_t> connect(utils::mac address) noexcept;
+        tl::expected<void, esp_err_t> connect(utils::mac address, esp_ble_addr_type_t address_type = BLE_ADDR_TYPE_PUBLIC) noexcept;
 
         /**
          * @brief 
@@ -102,36 +159,337 @@ namespace hub::ble
             return m_address;
         }
 
+        /**
+         * @brief ATT MTU negotiated for the connection, a single write carries up to MTU - 3 bytes.
+         * 
+         * @return uint16_t 
+         */
+        uint16_t get_mtu() const noexcept
+        {
+            return m_mtu.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Latency of the GATT operations issued by this client since it was created, over all its connections.
+         * 
+         * @return operation_timing::snapshot_type 
+         */
+        operation_timing::snapshot_type get_timing() const noexcept
+        {
+            return m_completions->timing().snapshot();
+        }
+
+        /**
+         * @brief Check if the connection is open. Cleared as soon as the controller reports a disconnection.
+         * 
+         * @return true Connected and the MTU exchanged.
+         * @return false 
+         */
+        bool is_connected() const noexcept
+        {
+            return m_connected.load(std::memory_order_acquire);
+        }
+
+        /**
+         * @brief Set the handler invoked when the connection is lost without being closed by disconnect(),
+         * e.g. on a supervision timeout. Called from the Bluedroid task, the handler must not wait for GATT requests.
+         * 
+         * @param handler Handler receiving the reason reported by the controller.
+         */
+        void set_disconnect_handler(disconnect_handler_t handler);
+
+        /**
+         * @brief Read the signal strength of the connection.
+         * 
+         * @return tl::expected<int8_t, esp_err_t> RSSI in dBm, ESP_FAIL if the controller could not read it.
+         */
+        tl::expected<int8_t, esp_err_t> read_rssi() const noexcept;
+
+        /**
+         * @brief Ask the peripheral to switch to the given connection parameters and wait until the controller reports the result.
+         * 
+         * @param params Requested parameters.
+         * @return tl::expected<void, esp_err_t> ESP_ERR_INVALID_ARG for parameters out of range, ESP_FAIL if the update was rejected.
+         */
+        tl::expected<void, esp_err_t> set_connection_params(const connection_params& params) noexcept;
+
+        /**
+         * @brief Parameters of the connection as last reported by the controller. The interval range collapses
+         * to the interval in use. All zero until the first update is reported.
+         * 
+         * @return connection_params 
+         */
+        connection_params get_connection_params() const noexcept;
+
     private:
 
         static constexpr const char* TAG{ "hub::ble::client" };
 
-        static constexpr EventBits_t CONNECT_BIT            { BIT0 };
-        static constexpr EventBits_t SEARCH_SERVICE_BIT     { BIT1 };
-        static constexpr EventBits_t WRITE_CHAR_BIT         { BIT2 };
-        static constexpr EventBits_t READ_CHAR_BIT          { BIT3 };
-        static constexpr EventBits_t WRITE_DESCR_BIT        { BIT4 };
-        static constexpr EventBits_t READ_DESCR_BIT         { BIT5 };
-        static constexpr EventBits_t REG_FOR_NOTIFY_BIT     { BIT6 };
-        static constexpr EventBits_t UNREG_FOR_NOTIFY_BIT   { BIT7 };
-        static constexpr EventBits_t DISCONNECT_BIT         { BIT8 };
-        static constexpr EventBits_t FAIL_BIT               { BIT15 };
+        static constexpr esp_bt_uuid_t DATABASE_HASH_UUID{ ESP_UUID_LEN_16, { 0x2b2a } };
+
+        // Chunks of long and streamed writes in flight, half of the completion slots are left to other requests.
+        static constexpr std::size_t WRITE_WINDOW{ impl::completion_pool::SIZE / 2 };
 
         static void gattc_callback(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t* param) noexcept;
 
+        static void gap_callback(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param) noexcept;
+
+        /**
+         * @brief Install the Bluedroid callbacks and claim an application slot, first step of connecting.
+         * The slot is kept until release_application.
+         */
+        tl::expected<void, esp_err_t> acquire_application() noexcept;
+
+        /**
+         * @brief Register the GATTC application of the claimed slot, completed with the interface used to open the connection.
+         */
+        completion_token register_application() noexcept;
+
+        /**
+         * @brief Open the connection on the registered interface, completed once the MTU is exchanged.
+         */
+        completion_token open(const utils::mac& address, esp_ble_addr_type_t address_type) noexcept;
+
+        /**
+         * @brief Claim a completion slot and issue the request without waiting for the response.
+         * Slots are claimed and requests issued under one lock, so responses of the same type and handle
+         * arrive in slot sequence order. The GATTC callback does not take this lock, Bluedroid may deliver
+         * the response before the call returns.
+         *
+         * @param type Request type, matched against the GATTC event completing it.
+         * @param handle Attribute handle, or the value identifying the request for non-attribute requests.
+         * @param issue_request Makes the Bluedroid call, returns its result.
+         * @return completion_token Token completed by the GATTC callback, or failed if the request could not be issued.
+         */
+        template<typename IssueT>
+        completion_token issue(operation_type type, uint16_t handle, IssueT&& issue_request) const noexcept
+        {
+            std::lock_guard lock{ m_issue_mutex };
+
+            const std::size_t index = m_completions->acquire(type, handle);
+
+            if (index == impl::completion_pool::INVALID_INDEX)
+            {
+                ESP_LOGE(TAG, "No free completion slot, too many pending GATT operations.");
+                return completion_token(ESP_ERR_NO_MEM);
+            }
+
+            if (esp_err_t result = issue_request(); result != ESP_OK)
+            {
+                ESP_LOGE(TAG, "GATT operation %u on handle 0x%04x failed with error code %i [%s].", 
+                    static_cast<unsigned>(type), handle, result, esp_err_to_name(result));
+                m_completions->cancel(index);
+                return completion_token(result);
+            }
+
+            return completion_token(m_completions, index);
+        }
+
+        /**
+         * @brief Issue a characteristic or descriptor request.
+         *
+         * @param type Request type.
+         * @param handle Attribute handle.
+         * @param data Value to write, ignored by other requests.
+         * @return completion_token 
+         */
+        completion_token submit(operation_type type, uint16_t handle, const std::vector<uint8_t>& data = {}) const noexcept;
+
+        /**
+         * @brief Issue a single characteristic write or prepared write of a chunk.
+         *
+         * @param type write_characteristic or prepare_write.
+         * @param handle Characteristic handle.
+         * @param value Chunk, copied by Bluedroid.
+         * @param length Chunk length, at most MTU - 3 for writes and MTU - 5 for prepared writes.
+         * @param offset Offset of the chunk in the value, prepared writes only.
+         * @param write_type Response type, writes only.
+         * @return completion_token 
+         */
+        completion_token submit_write(
+            operation_type          type,
+            uint16_t                handle,
+            const uint8_t*          value,
+            uint16_t                length,
+            uint16_t                offset      = 0,
+            esp_gatt_write_type_t   write_type  = ESP_GATT_WRITE_TYPE_RSP) const noexcept;
+
+        /**
+         * @brief Issue count requests keeping up to WRITE_WINDOW of them in flight. No further requests are issued
+         * after one fails, those already issued are awaited.
+         *
+         * @param count Number of requests.
+         * @param issue_request Called with the request index, returns its token.
+         * @return tl::expected<void, esp_err_t> Error of the first failed request.
+         */
+        template<typename IssueT>
+        tl::expected<void, esp_err_t> pipeline(std::size_t count, IssueT&& issue_request) const noexcept
+        {
+            std::array<std::optional<completion_token>, WRITE_WINDOW> window;
+            esp_err_t error = ESP_OK;
+
+            std::size_t issued      = 0;
+            std::size_t completed   = 0;
+
+            while (completed < count)
+            {
+                if (error == ESP_OK && issued < count && issued - completed < WRITE_WINDOW)
+                {
+                    window[issued % WRITE_WINDOW].emplace(issue_request(issued));
+                    issued++;
+                    continue;
+                }
+
+                if (completed == issued)
+                {
+                    break;
+                }
+
+                if (auto result = window[completed % WRITE_WINDOW]->wait(BLE_TIMEOUT); !result && error == ESP_OK)
+                {
+                    error = result.error();
+                }
+
+                window[completed % WRITE_WINDOW].reset();
+                completed++;
+            }
+
+            if (error != ESP_OK)
+            {
+                return tl::make_unexpected(error);
+            }
+
+            return tl::expected<void, esp_err_t>();
+        }
+
+        /**
+         * @brief Write a value of any length up to MAX_ATTRIBUTE_LENGTH. Values longer than MTU - 3 are split into
+         * prepared writes, which the server applies together on execution.
+         */
+        tl::expected<void, esp_err_t> write_long(uint16_t handle, const std::vector<uint8_t>& data) const noexcept;
+
+        /**
+         * @brief Split the data into MTU - 3 byte packets written without response, back to back.
+         */
+        tl::expected<void, esp_err_t> write_stream(uint16_t handle, const std::vector<uint8_t>& data) const noexcept;
+
+        /**
+         * @brief Complete the oldest pending request of the given type on the handle. Runs in the Bluedroid task.
+         */
+        void complete(operation_type type, uint16_t handle, esp_gatt_status_t status, const uint8_t* value = nullptr, uint16_t length = 0) noexcept;
+
+        /**
+         * @brief Complete a pending close and fail every other request. Without a pending close the connection was lost,
+         * the disconnect handler is invoked. Runs in the Bluedroid task.
+         */
+        void on_disconnect(esp_gatt_conn_reason_t reason) noexcept;
+
+        /**
+         * @brief Store a service search result in the oldest pending search. Runs in the Bluedroid task.
+         */
+        void on_search_result(const esp_gattc_service_elem_t& service) noexcept;
+
+        /**
+         * @brief Record the connection parameters reported by the controller and complete a pending update. Runs in the Bluedroid task.
+         * Updates requested by the peripheral are reported the same way.
+         */
+        void on_connection_update(const esp_ble_gap_cb_param_t::ble_update_conn_params_evt_param& update) noexcept;
+
+        /**
+         * @brief Complete a pending RSSI read. Runs in the Bluedroid task.
+         */
+        void on_rssi(const esp_ble_gap_cb_param_t::ble_read_rssi_cmpl_evt_param& rssi) noexcept;
+
+        tl::expected<std::vector<esp_gattc_service_elem_t>, esp_err_t> search_services(esp_bt_uuid_t* uuid) const noexcept;
+
+        completion_token search_services_async(esp_bt_uuid_t* uuid) const noexcept;
+
+        /**
+         * @brief Wait for a service search and copy its results.
+         */
+        tl::expected<std::vector<esp_gattc_service_elem_t>, esp_err_t> collect_services(completion_token& token, timing::duration_t timeout) const noexcept;
+
+        /**
+         * @brief Attribute table of the connected server. On first use after connecting, the table stored
+         * in the attribute cache is reused if it is still valid, otherwise the server is discovered and the cache updated.
+         */
+        tl::expected<std::shared_ptr<const attribute_table>, esp_err_t> get_attributes() const noexcept;
+
+        /**
+         * @brief Discover all services, characteristics and descriptors of the server.
+         */
+        tl::expected<attribute_table, esp_err_t> discover_attributes() const noexcept;
+
+        /**
+         * @brief Fill the table with the characteristics and descriptors of the found services from the Bluedroid database.
+         * The Database Hash handle is set if the server has one, its value is left to the caller to read.
+         */
+        tl::expected<attribute_table, esp_err_t> build_attributes(std::vector<esp_gattc_service_elem_t>&& services) const noexcept;
+
+        /**
+         * @brief Make the table the attribute table of the connection, storing discovered tables in the attribute cache.
+         * Requires the attributes lock.
+         *
+         * @param table Loaded or discovered table.
+         * @param discovered The table was discovered rather than loaded from the cache.
+         * @param start esp_timer_get_time() when loading started.
+         */
+        tl::expected<std::shared_ptr<const attribute_table>, esp_err_t> install_attributes(attribute_table&& table, bool discovered, int64_t start) const noexcept;
+
+        tl::expected<service, esp_err_t> find_service(const attribute_table& attributes, const esp_bt_uuid_t* uuid) const noexcept;
+
+        /**
+         * @brief Check the cached table against the server. Servers exposing a Database Hash are checked by reading it,
+         * tables of the other servers are trusted until a request fails with an invalid handle.
+         */
+        bool validate_attributes(const attribute_table& table) const noexcept;
+
+        /**
+         * @brief Notification handler entry, kept in a vector ordered by handle.
+         */
+        struct notify_entry
+        {
+            uint16_t                handle;
+            notify_event_handler_t  handler;
+        };
+
+        void set_notify_handler(uint16_t handle, notify_event_handler_t handler);
+
+        void clear_notify_handler(uint16_t handle) noexcept;
+
+        /**
+         * @brief Remove the handler of the characteristic. Requires the operations lock.
+         */
+        void erase_notify_handler(uint16_t handle) noexcept;
+
+        /**
+         * @brief Unregister the GATTC application and free its slot, so another client can connect.
+         * The client can connect again afterwards.
+         */
+        void release_application() noexcept;
+
         uint16_t                                                    m_connection_id;
         uint16_t                                                    m_app_id;
         uint16_t                                                    m_gattc_interface;
         utils::mac                                                  m_address;
-        EventGroupHandle_t                                          m_event_group;
+        std::atomic<uint16_t>                                       m_mtu;
+        std::atomic<bool>                                           m_connected;
+        connection_params                                           m_connection_params;    // Guarded by the operations lock.
+        utils::mac                                                  m_open_address;         // Device being opened, guarded by the operations lock.
 
-        mutable std::vector<service>                                m_services_cache;
-        mutable std::vector<uint8_t>                                m_characteristic_data_cache;
-        mutable std::vector<uint8_t>                                m_descriptor_data_cache;
+        std::shared_ptr<impl::completion_pool>                      m_completions;
+        mutable std::mutex                                          m_issue_mutex;          // Orders slot claims with Bluedroid calls.
+        mutable std::mutex                                          m_operations_mutex;     // Guards response matching and notification handlers.
 
-        mutable std::map<uint16_t, notify_event_handler_t>          m_characteristics_callbacks;
+        std::vector<notify_entry>                                   m_characteristics_callbacks;    // Ordered by handle.
+        disconnect_handler_t                                        m_disconnect_handler;           // Guarded by the operations lock.
 
         mutable std::shared_ptr<client>                             m_self_ref;
+        bool                                                        m_registered;           // Holds an application slot.
+
+        mutable std::mutex                                          m_attributes_mutex;     // Serializes attribute table loading.
+        mutable std::shared_ptr<const attribute_table>              m_attributes;
+        std::atomic<bool>                                           m_attributes_invalid;   // A request failed with an invalid handle.
     };
 }
 
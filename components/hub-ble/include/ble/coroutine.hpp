@@ -0,0 +1,585 @@
+#ifndef HUB_BLE_COROUTINE_HPP
+#define HUB_BLE_COROUTINE_HPP
+
+// The firmware is built as C++17, the coroutine front-end is only available when coroutines are enabled, e.g. with -std=gnu++20.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#define HUB_BLE_COROUTINES 1
+
+#include <cstdint>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <vector>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+#include "esp_err.h"
+#include "esp_gatt_defs.h"
+
+#include "tl/expected.hpp"
+
+#include "utils/mac.hpp"
+#include "timing/timing.hpp"
+
+#include "client.hpp"
+#include "operation.hpp"
+#include "notification.hpp"
+#include "service.hpp"
+#include "characteristic.hpp"
+#include "descriptor.hpp"
+
+/**
+ * @brief Awaitable front-end of the GATT client. Device sessions written as coroutines are interleaved by an executor
+ * on a single task, each suspended session costs its coroutine frames instead of a blocked task and its stack.
+ *
+ * Requests are issued the same way as by the blocking API, the executor only waits for their completion slots.
+ */
+namespace hub::ble::coro
+{
+    class executor;
+
+    template<typename T = void>
+    class task;
+
+    namespace impl
+    {
+        class promise_base
+        {
+        public:
+
+            /**
+             * @brief Resumes the awaiting coroutine, or returns to the executor for sessions.
+             */
+            struct final_awaiter
+            {
+                bool await_ready() const noexcept
+                {
+                    return false;
+                }
+
+                template<typename PromiseT>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<PromiseT> handle) noexcept
+                {
+                    if (auto continuation = handle.promise().m_continuation; continuation)
+                    {
+                        return continuation;
+                    }
+
+                    return std::noop_coroutine();
+                }
+
+                void await_resume() const noexcept
+                {
+
+                }
+            };
+
+            std::suspend_always initial_suspend() const noexcept
+            {
+                return {  };
+            }
+
+            final_awaiter final_suspend() const noexcept
+            {
+                return {  };
+            }
+
+            void unhandled_exception() noexcept
+            {
+                m_exception = std::current_exception();
+            }
+
+            executor* get_executor() const noexcept
+            {
+                return m_executor;
+            }
+
+        protected:
+
+            template<typename T>
+            friend class coro::task;
+
+            friend class coro::executor;
+
+            void rethrow() const
+            {
+                if (m_exception)
+                {
+                    std::rethrow_exception(m_exception);
+                }
+            }
+
+            executor*               m_executor{ nullptr };
+            std::coroutine_handle<> m_continuation{  };
+            std::exception_ptr      m_exception{  };
+        };
+
+        template<typename T>
+        class promise : public promise_base
+        {
+        public:
+
+            task<T> get_return_object() noexcept;
+
+            template<typename U>
+            void return_value(U&& value)
+            {
+                m_value.emplace(std::forward<U>(value));
+            }
+
+            T take()
+            {
+                rethrow();
+                return std::move(*m_value);
+            }
+
+        private:
+
+            std::optional<T> m_value;
+        };
+
+        template<>
+        class promise<void> : public promise_base
+        {
+        public:
+
+            task<void> get_return_object() noexcept;
+
+            void return_void() const noexcept
+            {
+
+            }
+
+            void take() const
+            {
+                rethrow();
+            }
+        };
+    }
+
+    /**
+     * @brief Lazily started coroutine, runs when awaited or spawned on an executor.
+     * Exceptions escaping the coroutine are rethrown to the awaiting one.
+     */
+    template<typename T>
+    class task
+    {
+    public:
+
+        using promise_type = impl::promise<T>;
+
+        explicit task(std::coroutine_handle<promise_type> handle) noexcept :
+            m_handle{ handle }
+        {
+
+        }
+
+        task(const task&)               = delete;
+
+        task& operator=(const task&)    = delete;
+
+        task(task&& other) noexcept :
+            m_handle{ std::exchange(other.m_handle, nullptr) }
+        {
+
+        }
+
+        task& operator=(task&& other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                m_handle = std::exchange(other.m_handle, nullptr);
+            }
+
+            return *this;
+        }
+
+        ~task()
+        {
+            reset();
+        }
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        /**
+         * @brief Start the coroutine on the executor of the awaiting one, transferring control to it directly.
+         */
+        template<typename PromiseT>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<PromiseT> caller) noexcept
+        {
+            auto& promise = m_handle.promise();
+            promise.m_continuation  = caller;
+            promise.m_executor      = caller.promise().get_executor();
+            return m_handle;
+        }
+
+        T await_resume()
+        {
+            return m_handle.promise().take();
+        }
+
+    private:
+
+        friend class executor;
+
+        void reset() noexcept
+        {
+            if (m_handle)
+            {
+                m_handle.destroy();
+                m_handle = nullptr;
+            }
+        }
+
+        std::coroutine_handle<promise_type> m_handle;
+    };
+
+    namespace impl
+    {
+        template<typename T>
+        task<T> promise<T>::get_return_object() noexcept
+        {
+            return task<T>(std::coroutine_handle<promise<T>>::from_promise(*this));
+        }
+
+        inline task<void> promise<void>::get_return_object() noexcept
+        {
+            return task<void>(std::coroutine_handle<promise<void>>::from_promise(*this));
+        }
+    }
+
+    /**
+     * @brief Runs sessions on the calling task. Suspended coroutines are resumed once the request they wait for completes
+     * or their timeout expires, the task blocks on a single event group in between.
+     *
+     * Not thread-safe, sessions are spawned before run() or from the sessions themselves.
+     */
+    class executor
+    {
+    public:
+
+        using ready_check_t = bool (*)(const void* context) noexcept;
+
+        executor();
+
+        executor(const executor&)               = delete;
+
+        executor& operator=(const executor&)    = delete;
+
+        /**
+         * @brief Destroy the sessions left, abandoning their pending requests.
+         */
+        ~executor();
+
+        /**
+         * @brief Add a session, started by run().
+         *
+         * @param session Coroutine, exceptions escaping it are logged and dropped.
+         */
+        void spawn(task<void> session);
+
+        /**
+         * @brief Run the sessions until all of them have finished.
+         */
+        void run();
+
+        /**
+         * @brief Event group the executor blocks on, completions set impl::completion_pool::WAKER_BIT in it.
+         */
+        EventGroupHandle_t get_event_group() const noexcept
+        {
+            return m_event_group;
+        }
+
+        /**
+         * @brief Wake the executor from any task, e.g. after a condition checked by a waiting coroutine changed.
+         */
+        void wake() noexcept;
+
+        /**
+         * @brief Park a coroutine until is_ready returns true for the context or the timeout expires. Used by the awaitables.
+         *
+         * @param handle Coroutine to resume.
+         * @param is_ready Checked on every wake, from the executor task.
+         * @param context Passed to is_ready, usually the awaitable.
+         * @param timeout timing::MAX_DELAY waits without timeout.
+         */
+        void suspend(std::coroutine_handle<> handle, ready_check_t is_ready, const void* context, timing::duration_t timeout) noexcept;
+
+    private:
+
+        struct waiter
+        {
+            std::coroutine_handle<>     handle;
+            ready_check_t               is_ready;
+            const void*                 context;
+            TickType_t                  deadline;
+            bool                        timed;
+        };
+
+        /**
+         * @brief Move the waiters whose condition holds or whose timeout expired to the ready queue.
+         *
+         * @return TickType_t Ticks until the nearest deadline, portMAX_DELAY without one.
+         */
+        TickType_t poll_waiters() noexcept;
+
+        /**
+         * @brief Destroy finished sessions.
+         */
+        void reap() noexcept;
+
+        std::vector<task<void>>                 m_sessions;
+        std::vector<std::coroutine_handle<>>    m_ready;
+        std::vector<waiter>                     m_waiters;      // Capacity for one waiter per session, so suspending never allocates.
+        EventGroupHandle_t                      m_event_group;
+    };
+
+    /**
+     * @brief Awaitable GATT request, resumes with the result of the completion token.
+     */
+    class operation
+    {
+    public:
+
+        operation(completion_token&& token, timing::duration_t timeout) noexcept :
+            m_token{ std::move(token) },
+            m_timeout{ timeout }
+        {
+
+        }
+
+        bool await_ready() const noexcept
+        {
+            return m_token.is_done();
+        }
+
+        template<typename PromiseT>
+        void await_suspend(std::coroutine_handle<PromiseT> caller) noexcept
+        {
+            executor& owner = *caller.promise().get_executor();
+            m_token.set_waker(owner.get_event_group());
+            owner.suspend(caller, &operation::is_ready, this, m_timeout);
+        }
+
+        /**
+         * @brief Result of the request, ESP_ERR_TIMEOUT if no response arrived in time.
+         */
+        operation_result await_resume() noexcept
+        {
+            return m_token.wait(timing::duration_t{  });
+        }
+
+    protected:
+
+        static bool is_ready(const void* context) noexcept
+        {
+            return static_cast<const operation*>(context)->m_token.is_done();
+        }
+
+        completion_token    m_token;
+        timing::duration_t  m_timeout;
+    };
+
+    /**
+     * @brief Awaitable delay, other sessions run in the meantime.
+     */
+    class delay
+    {
+    public:
+
+        explicit delay(timing::duration_t duration) noexcept :
+            m_duration{ duration }
+        {
+
+        }
+
+        bool await_ready() const noexcept
+        {
+            return timing::to_ticks(m_duration) == 0;
+        }
+
+        template<typename PromiseT>
+        void await_suspend(std::coroutine_handle<PromiseT> caller) noexcept
+        {
+            caller.promise().get_executor()->suspend(caller, &delay::is_ready, this, m_duration);
+        }
+
+        void await_resume() const noexcept
+        {
+
+        }
+
+    private:
+
+        static bool is_ready(const void*) noexcept
+        {
+            return false;
+        }
+
+        timing::duration_t m_duration;
+    };
+
+    /**
+     * @brief Notifications of a characteristic queued for a session. Values are copied into the notification pool
+     * in the Bluedroid task, values arriving while the queue is full or longer than pooled_value::BLOCK_SIZE are dropped.
+     *
+     * @code
+     * coro::notification_stream stream;
+     * co_await coro::subscribe(characteristic, stream.get_handler());
+     * auto value = co_await stream.next(5_s);
+     * @endcode
+     */
+    class notification_stream
+    {
+    public:
+
+        static constexpr std::size_t CAPACITY{ 8 };
+
+        class next_awaiter
+        {
+        public:
+
+            next_awaiter(notification_stream& stream, timing::duration_t timeout) noexcept :
+                m_stream{ stream },
+                m_timeout{ timeout }
+            {
+
+            }
+
+            bool await_ready() const noexcept
+            {
+                return is_ready(&m_stream);
+            }
+
+            template<typename PromiseT>
+            void await_suspend(std::coroutine_handle<PromiseT> caller) noexcept
+            {
+                executor& owner = *caller.promise().get_executor();
+                m_stream.m_state->waker.store(owner.get_event_group(), std::memory_order_release);
+                owner.suspend(caller, &next_awaiter::is_ready, &m_stream, m_timeout);
+            }
+
+            /**
+             * @brief Oldest queued value, ESP_ERR_TIMEOUT if none arrived in time.
+             */
+            tl::expected<pooled_value, esp_err_t> await_resume() noexcept
+            {
+                m_stream.m_state->waker.store(nullptr, std::memory_order_release);
+                return m_stream.pop();
+            }
+
+        private:
+
+            static bool is_ready(const void* context) noexcept;
+
+            notification_stream&    m_stream;
+            timing::duration_t      m_timeout;
+        };
+
+        notification_stream();
+
+        /**
+         * @brief Handler queueing the values, to subscribe with. Keeps the queue alive while installed.
+         */
+        notify_handler get_handler() const noexcept;
+
+        next_awaiter next(timing::duration_t timeout) noexcept
+        {
+            return next_awaiter(*this, timeout);
+        }
+
+        /**
+         * @brief Number of values dropped since the stream was created.
+         */
+        uint32_t get_dropped() const noexcept
+        {
+            return m_state->dropped.load(std::memory_order_relaxed);
+        }
+
+    private:
+
+        struct state
+        {
+            std::mutex                              mutex;
+            std::array<pooled_value, CAPACITY>      values;
+            std::size_t                             head{ 0 };
+            std::size_t                             count{ 0 };
+            std::atomic<uint32_t>                   dropped{ 0 };
+            std::atomic<EventGroupHandle_t>         waker{ nullptr };
+        };
+
+        tl::expected<pooled_value, esp_err_t> pop() noexcept;
+
+        std::shared_ptr<state> m_state;
+    };
+
+    /**
+     * @brief Connect the client to the device, as client::connect.
+     */
+    task<tl::expected<void, esp_err_t>> connect(std::shared_ptr<client> device, utils::mac address, esp_ble_addr_type_t address_type = BLE_ADDR_TYPE_PUBLIC);
+
+    /**
+     * @brief Find a service of the connected device, as client::get_service_by_uuid. On first use after connecting
+     * the cached attribute table is validated or the device discovered without blocking the executor.
+     */
+    task<tl::expected<service, esp_err_t>> get_service_by_uuid(std::shared_ptr<client> device, esp_bt_uuid_t uuid);
+
+    inline operation read(const characteristic& target, timing::duration_t timeout = BLE_TIMEOUT) noexcept
+    {
+        return operation(target.read_async(), timeout);
+    }
+
+    /**
+     * @brief Write a value fitting into a single write of MTU - 3 bytes, as characteristic::write_async.
+     * Longer values are written with the blocking characteristic::write.
+     */
+    inline operation write(characteristic& target, const std::vector<uint8_t>& data, timing::duration_t timeout = BLE_TIMEOUT) noexcept
+    {
+        return operation(target.write_async(data), timeout);
+    }
+
+    inline operation read(const descriptor& target, timing::duration_t timeout = BLE_TIMEOUT) noexcept
+    {
+        return operation(target.read_async(), timeout);
+    }
+
+    inline operation write(descriptor& target, const std::vector<uint8_t>& data, timing::duration_t timeout = BLE_TIMEOUT) noexcept
+    {
+        return operation(target.write_async(data), timeout);
+    }
+
+    /**
+     * @brief Install the handler and register for notifications, as characteristic::subscribe.
+     * The handler is removed again if the registration fails.
+     *
+     * GCC 12 destroys lambdas converted to notify_handler inside a co_await expression twice,
+     * pass a notify_handler instead, e.g. notification_stream::get_handler().
+     */
+    task<operation_result> subscribe(characteristic target, notify_handler handler, timing::duration_t timeout = BLE_TIMEOUT);
+
+    inline operation unsubscribe(characteristic& target, timing::duration_t timeout = BLE_TIMEOUT) noexcept
+    {
+        return operation(target.unsubscribe_async(), timeout);
+    }
+
+    inline delay sleep_for(timing::duration_t duration) noexcept
+    {
+        return delay(duration);
+    }
+}
+
+#endif
+
+#endif
\ No newline at end of file
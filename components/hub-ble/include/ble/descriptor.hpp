@@ -10,6 +10,8 @@
 
 #include "tl/expected.hpp"
 
+#include "operation.hpp"
+
 namespace hub::ble
 {
     class client;
@@ -49,6 +51,21 @@ namespace hub::ble
          */
         tl::expected<std::vector<uint8_t>, esp_err_t> read() const noexcept;
 
+        /**
+         * @brief Queue a write without waiting for the response.
+         * 
+         * @param data 
+         * @return completion_token 
+         */
+        completion_token write_async(const std::vector<uint8_t>& data) noexcept;
+
+        /**
+         * @brief Queue a read without waiting for the response, the token returns the read value.
+         * 
+         * @return completion_token 
+         */
+        completion_token read_async() const noexcept;
+
         /**
          * @brief Get the descriptor handle.
          * 
@@ -0,0 +1,186 @@
+#ifndef HUB_BLE_DUPLICATE_FILTER_HPP
+#define HUB_BLE_DUPLICATE_FILTER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "freertos/FreeRTOS.h"
+
+#include "advertisement.hpp"
+
+namespace hub::ble
+{
+    /**
+     * @brief Suppresses advertisements repeating the previous payload of the same device within the TTL.
+     * Devices are kept in a fixed-size open-addressing table keyed by address, each entry holding
+     * the payload hash and the time the payload was last forwarded.
+     *
+     * Not thread-safe, meant to be used from a single task. TTL may be changed from any task.
+     *
+     * @tparam Capacity Number of table entries, must be a power of two.
+     */
+    template<std::size_t Capacity>
+    class duplicate_filter
+    {
+    public:
+
+        static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two.");
+
+        /**
+         * @brief Construct a new duplicate filter object.
+         *
+         * @param ttl Time after which an unchanged advertisement is forwarded again. Zero disables filtering.
+         */
+        explicit duplicate_filter(TickType_t ttl = 0) noexcept :
+            m_ttl{ ttl },
+            m_entries{  }
+        {
+
+        }
+
+        duplicate_filter(const duplicate_filter&)               = delete;
+
+        duplicate_filter& operator=(const duplicate_filter&)    = delete;
+
+        ~duplicate_filter()                                     = default;
+
+        void set_ttl(TickType_t ttl) noexcept
+        {
+            m_ttl.store(ttl, std::memory_order_relaxed);
+        }
+
+        TickType_t get_ttl() const noexcept
+        {
+            return m_ttl.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Check the advertisement against the table and record it.
+         *
+         * @param adv Received advertisement.
+         * @param now Current tick count.
+         * @return true Same payload was forwarded less than TTL ago, advertisement should be dropped.
+         * @return false Advertisement is new or changed, or TTL expired.
+         */
+        bool is_duplicate(const advertisement& adv, TickType_t now) noexcept
+        {
+            const TickType_t ttl = get_ttl();
+
+            if (ttl == 0)
+            {
+                return false;
+            }
+
+            const uint64_t key      = make_key(adv);
+            const uint32_t hash     = payload_hash(adv);
+            const std::size_t home  = (key * HASH_MULTIPLIER) >> (64 - INDEX_BITS);
+
+            entry* victim = nullptr;
+
+            // Keys are always stored within MAX_PROBE slots of their home slot, so the lookup is bounded.
+            for (std::size_t i = 0; i < MAX_PROBE; i++)
+            {
+                entry& current = m_entries[(home + i) & MASK];
+
+                if (current.key == key)
+                {
+                    if (current.payload_hash == hash && (now - current.last_seen) < ttl)
+                    {
+                        return true;
+                    }
+
+                    current.payload_hash    = hash;
+                    current.last_seen       = now;
+                    return false;
+                }
+
+                if (current.key == EMPTY_KEY)
+                {
+                    victim = &current;
+                    break;
+                }
+
+                if (!victim || (now - current.last_seen) > (now - victim->last_seen))
+                {
+                    victim = &current;
+                }
+            }
+
+            // Overwriting in place keeps the probe sequences of the other keys intact.
+            *victim = entry{ key, hash, now };
+            return false;
+        }
+
+        void clear() noexcept
+        {
+            m_entries.fill(entry{  });
+        }
+
+    private:
+
+        struct entry
+        {
+            uint64_t    key;
+            uint32_t    payload_hash;
+            TickType_t  last_seen;
+        };
+
+        static constexpr uint64_t       EMPTY_KEY{ 0 };
+        static constexpr uint64_t       OCCUPIED_BIT{ 1ull << 63 };
+        static constexpr uint64_t       SCAN_RSP_BIT{ 1ull << 62 };
+        static constexpr uint64_t       HASH_MULTIPLIER{ 0x9e3779b97f4a7c15ull };
+        static constexpr std::size_t    MASK{ Capacity - 1 };
+        static constexpr std::size_t    MAX_PROBE{ (Capacity < 8) ? Capacity : 8 };
+
+        static constexpr std::size_t log2(std::size_t value) noexcept
+        {
+            return (value <= 1) ? 0 : 1 + log2(value >> 1);
+        }
+
+        static constexpr std::size_t    INDEX_BITS{ (Capacity == 1) ? 1 : log2(Capacity) };
+
+        /**
+         * @brief Scan responses are keyed separately, otherwise an active scan would alternate
+         * between advertising and scan response payloads and nothing would be suppressed.
+         */
+        static uint64_t make_key(const advertisement& adv) noexcept
+        {
+            uint64_t key = 0;
+
+            for (uint8_t byte : adv.address)
+            {
+                key = (key << 8) | byte;
+            }
+
+            key |= OCCUPIED_BIT;
+
+            if (adv.event_type == ESP_BLE_EVT_SCAN_RSP)
+            {
+                key |= SCAN_RSP_BIT;
+            }
+
+            return key;
+        }
+
+        /**
+         * @brief FNV-1a over the raw payload.
+         */
+        static uint32_t payload_hash(const advertisement& adv) noexcept
+        {
+            uint32_t hash = 2166136261u;
+
+            for (uint8_t i = 0; i < adv.data_length; i++)
+            {
+                hash = (hash ^ adv.data[i]) * 16777619u;
+            }
+
+            return hash;
+        }
+
+        std::atomic<TickType_t>         m_ttl;
+        std::array<entry, Capacity>     m_entries;
+    };
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef HUB_BLE_GAP_HPP
+#define HUB_BLE_GAP_HPP
+
+#include <cstddef>
+
+#include "esp_err.h"
+#include "esp_gap_ble_api.h"
+
+namespace hub::ble::gap
+{
+    using handler_t = void (*)(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param);
+
+    inline constexpr std::size_t MAX_HANDLERS{ 4 };
+
+    /**
+     * @brief Bluedroid accepts a single GAP callback, modules using GAP events add their handler here instead.
+     * Handlers are invoked in the Bluedroid task in the order they were added and cannot be removed.
+     *
+     * @param handler Handler to add, adding it again has no effect.
+     * @return esp_err_t ESP_ERR_NO_MEM if MAX_HANDLERS were already added, or the error of the callback registration.
+     */
+    esp_err_t add_handler(handler_t handler) noexcept;
+}
+
+#endif
\ No newline at end of file
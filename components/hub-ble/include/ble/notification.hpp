@@ -0,0 +1,268 @@
+#ifndef HUB_BLE_NOTIFICATION_HPP
+#define HUB_BLE_NOTIFICATION_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <functional>
+#include <type_traits>
+
+#include "esp_err.h"
+
+#include "tl/expected.hpp"
+
+namespace hub::ble
+{
+    class pooled_value;
+
+    /**
+     * @brief Non-owning view of a notification value. The bytes belong to Bluedroid and are only valid
+     * while the notification handler runs, use copy() or construct a container to keep them.
+     */
+    class value_view
+    {
+    public:
+
+        using value_type        = uint8_t;
+        using const_iterator    = const uint8_t*;
+
+        constexpr value_view() noexcept :
+            m_data{ nullptr },
+            m_size{ 0 }
+        {
+
+        }
+
+        constexpr value_view(const uint8_t* data, std::size_t size) noexcept :
+            m_data{ data },
+            m_size{ size }
+        {
+
+        }
+
+        constexpr const uint8_t* data() const noexcept
+        {
+            return m_data;
+        }
+
+        constexpr std::size_t size() const noexcept
+        {
+            return m_size;
+        }
+
+        constexpr bool empty() const noexcept
+        {
+            return m_size == 0;
+        }
+
+        constexpr const_iterator begin() const noexcept
+        {
+            return m_data;
+        }
+
+        constexpr const_iterator end() const noexcept
+        {
+            return m_data + m_size;
+        }
+
+        constexpr uint8_t operator[](std::size_t index) const noexcept
+        {
+            return m_data[index];
+        }
+
+        /**
+         * @brief Copy the value into a block of the notification pool, for handlers passing it to another task.
+         *
+         * @return tl::expected<pooled_value, esp_err_t> Owned copy, ESP_ERR_INVALID_SIZE if the value does not fit
+         * into a block, ESP_ERR_NO_MEM if every block is in use.
+         */
+        tl::expected<pooled_value, esp_err_t> copy() const noexcept;
+
+    private:
+
+        const uint8_t*  m_data;
+        std::size_t     m_size;
+    };
+
+    /**
+     * @brief Notification value copied into a fixed size block of a static pool. The block is returned
+     * to the pool when the value is destroyed, which may happen in any task.
+     */
+    class pooled_value
+    {
+    public:
+
+        static constexpr std::size_t BLOCK_SIZE{ 64 };      // Largest value kept in the pool.
+        static constexpr std::size_t BLOCK_COUNT{ 32 };     // Values held at the same time.
+
+        pooled_value() noexcept :
+            m_block{ INVALID_BLOCK },
+            m_size{ 0 }
+        {
+
+        }
+
+        pooled_value(const pooled_value&)               = delete;
+
+        pooled_value& operator=(const pooled_value&)    = delete;
+
+        pooled_value(pooled_value&& other) noexcept :
+            m_block{ std::exchange(other.m_block, INVALID_BLOCK) },
+            m_size{ std::exchange(other.m_size, 0) }
+        {
+
+        }
+
+        pooled_value& operator=(pooled_value&& other) noexcept
+        {
+            if (this != &other)
+            {
+                release();
+                m_block = std::exchange(other.m_block, INVALID_BLOCK);
+                m_size  = std::exchange(other.m_size, 0);
+            }
+
+            return *this;
+        }
+
+        ~pooled_value()
+        {
+            release();
+        }
+
+        const uint8_t* data() const noexcept;
+
+        std::size_t size() const noexcept
+        {
+            return m_size;
+        }
+
+        value_view view() const noexcept
+        {
+            return value_view(data(), m_size);
+        }
+
+    private:
+
+        friend class value_view;
+
+        static constexpr uint8_t INVALID_BLOCK{ 0xff };
+
+        static_assert(BLOCK_COUNT <= 32, "Blocks are tracked in a 32 bit mask.");
+
+        pooled_value(uint8_t block, std::size_t size) noexcept :
+            m_block{ block },
+            m_size{ size }
+        {
+
+        }
+
+        void release() noexcept;
+
+        uint8_t     m_block;
+        std::size_t m_size;
+    };
+
+    /**
+     * @brief Notification handler stored inline, so installing and invoking it never allocates.
+     * Callables must fit into CAPACITY bytes and be nothrow copyable, which holds for lambdas capturing
+     * a few pointers or a shared_ptr.
+     */
+    class notify_handler
+    {
+    public:
+
+        static constexpr std::size_t CAPACITY{ 4 * sizeof(void*) };
+
+        notify_handler() noexcept :
+            m_ops{ nullptr }
+        {
+
+        }
+
+        template<typename FunT, typename = std::enable_if_t<!std::is_same_v<std::decay_t<FunT>, notify_handler>>>
+        notify_handler(FunT&& fun) noexcept :
+            m_ops{ &OPS<std::decay_t<FunT>> }
+        {
+            using callable_t = std::decay_t<FunT>;
+
+            static_assert(std::is_invocable_v<callable_t&, value_view>, "Handler must accept a value_view.");
+            static_assert(sizeof(callable_t) <= CAPACITY, "Handler captures too much state, capture a pointer to it instead.");
+            static_assert(alignof(callable_t) <= alignof(std::max_align_t), "Handler is overaligned.");
+            static_assert(std::is_nothrow_copy_constructible_v<callable_t>, "Handler must be nothrow copyable.");
+
+            new (m_storage) callable_t(std::forward<FunT>(fun));
+        }
+
+        notify_handler(const notify_handler& other) noexcept :
+            m_ops{ other.m_ops }
+        {
+            if (m_ops)
+            {
+                m_ops->copy(m_storage, other.m_storage);
+            }
+        }
+
+        notify_handler& operator=(const notify_handler& other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                m_ops = other.m_ops;
+
+                if (m_ops)
+                {
+                    m_ops->copy(m_storage, other.m_storage);
+                }
+            }
+
+            return *this;
+        }
+
+        ~notify_handler()
+        {
+            reset();
+        }
+
+        explicit operator bool() const noexcept
+        {
+            return m_ops != nullptr;
+        }
+
+        void operator()(value_view value)
+        {
+            m_ops->invoke(m_storage, value);
+        }
+
+        void reset() noexcept
+        {
+            if (m_ops)
+            {
+                m_ops->destroy(m_storage);
+                m_ops = nullptr;
+            }
+        }
+
+    private:
+
+        struct ops
+        {
+            void (*invoke)(void* storage, value_view value);
+            void (*copy)(void* storage, const void* other) noexcept;
+            void (*destroy)(void* storage) noexcept;
+        };
+
+        template<typename CallableT>
+        static constexpr ops OPS{
+            [](void* storage, value_view value) { std::invoke(*static_cast<CallableT*>(storage), value); },
+            [](void* storage, const void* other) noexcept { new (storage) CallableT(*static_cast<const CallableT*>(other)); },
+            [](void* storage) noexcept { static_cast<CallableT*>(storage)->~CallableT(); }
+        };
+
+        alignas(std::max_align_t) unsigned char m_storage[CAPACITY];
+        const ops*                              m_ops;
+    };
+}
+
+#endif
\ No newline at end of file
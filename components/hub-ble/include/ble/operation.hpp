@@ -0,0 +1,556 @@
+#ifndef HUB_BLE_OPERATION_HPP
+#define HUB_BLE_OPERATION_HPP
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <limits>
+#include <algorithm>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_gatt_defs.h"
+
+#include "tl/expected.hpp"
+
+#include "timing/timing.hpp"
+#include "utils/histogram.hpp"
+
+namespace hub::ble
+{
+    class client;
+
+    /**
+     * @brief GATT requests queued by the client and completed by the GATTC callback.
+     */
+    enum class operation_type : uint8_t
+    {
+        register_application,
+        open,
+        close,
+        search_service,
+        write_characteristic,
+        read_characteristic,
+        write_descriptor,
+        read_descriptor,
+        register_for_notify,
+        unregister_for_notify,
+        prepare_write,
+        execute_write,
+        update_connection_params,
+        read_rssi
+    };
+
+    /**
+     * @brief Value read by the operation, empty for writes and (un)registrations.
+     */
+    using operation_result = tl::expected<std::vector<uint8_t>, esp_err_t>;
+
+    /**
+     * @brief Latency histograms of the GATT operations of one client, one per operation type from submission
+     * to response, plus the attribute table loading and the notification handlers.
+     *
+     * Recording is lock-free, done by the issuing tasks and the Bluedroid task. Requests that time out or fail
+     * because the connection was lost are not recorded.
+     */
+    class operation_timing
+    {
+    public:
+
+        using histogram_type = utils::histogram<24>;    // Microseconds, up to ~4 s.
+
+        static constexpr std::size_t OPERATION_COUNT{ static_cast<std::size_t>(operation_type::read_rssi) + 1 };
+        static constexpr std::size_t ATTRIBUTES{ OPERATION_COUNT };         // Attribute table loading on first use after connecting.
+        static constexpr std::size_t NOTIFICATION{ OPERATION_COUNT + 1 };   // Time spent in a notification handler.
+        static constexpr std::size_t METRIC_COUNT{ OPERATION_COUNT + 2 };
+
+        using snapshot_type = std::array<histogram_type::snapshot_type, METRIC_COUNT>;
+
+        /**
+         * @brief Record the time elapsed since start.
+         *
+         * @param metric Operation type index, ATTRIBUTES or NOTIFICATION.
+         * @param start esp_timer_get_time() at the start of the operation.
+         */
+        void record(std::size_t metric, int64_t start) noexcept
+        {
+            const int64_t duration = esp_timer_get_time() - start;
+            m_histograms[metric].record(static_cast<uint32_t>(std::clamp<int64_t>(duration, 0, std::numeric_limits<uint32_t>::max())));
+        }
+
+        void record(operation_type type, int64_t start) noexcept
+        {
+            record(static_cast<std::size_t>(type), start);
+        }
+
+        snapshot_type snapshot() const noexcept
+        {
+            snapshot_type result{  };
+
+            for (std::size_t metric = 0; metric < METRIC_COUNT; metric++)
+            {
+                result[metric] = m_histograms[metric].snapshot();
+            }
+
+            return result;
+        }
+
+        /**
+         * @brief Name of the metric, as exported.
+         */
+        static constexpr const char* get_name(std::size_t metric) noexcept
+        {
+            constexpr const char* NAMES[]{
+                "register_application",
+                "open",
+                "close",
+                "search_service",
+                "write_characteristic",
+                "read_characteristic",
+                "write_descriptor",
+                "read_descriptor",
+                "register_for_notify",
+                "unregister_for_notify",
+                "prepare_write",
+                "execute_write",
+                "update_connection_params",
+                "read_rssi",
+                "attributes",
+                "notification"
+            };
+
+            static_assert(sizeof(NAMES) / sizeof(NAMES[0]) == METRIC_COUNT, "Every metric needs a name.");
+
+            return (metric < METRIC_COUNT) ? NAMES[metric] : "";
+        }
+
+    private:
+
+        std::array<histogram_type, METRIC_COUNT> m_histograms;
+    };
+
+    namespace impl
+    {
+        enum class slot_state : uint8_t
+        {
+            free,
+            pending,    // Issued, waiting for the response.
+            ready,      // Response stored, waiting for the token to collect it.
+            abandoned   // Token dropped while pending, the response only frees the slot.
+        };
+
+        /**
+         * @brief Status and payload of a single outstanding request.
+         */
+        struct completion_slot
+        {
+            std::atomic<slot_state>                 state{ slot_state::free };
+            operation_type                          type{  };
+            uint16_t                                handle{ 0 };
+            uint32_t                                sequence{ 0 };
+            int64_t                                 submitted{ 0 };     // esp_timer_get_time() when the slot was claimed.
+            std::atomic<EventGroupHandle_t>         waker{ nullptr };   // Also signalled on completion, see completion_token::set_waker.
+            esp_err_t                               error{ ESP_OK };
+            std::vector<uint8_t>                    value{  };      // Capacity is kept across requests, so responses stop allocating once warmed up.
+            std::vector<esp_gattc_service_elem_t>   services{  };   // Service search results.
+        };
+
+        /**
+         * @brief Preallocated completion slots of one connection, each signalled by its own event group bit.
+         *
+         * Slots are acquired by one issuing task at a time and matched and completed by the GATTC callback,
+         * each side under its own lock of the owning client. Tokens collect and release their slot from any task
+         * without a lock, slot states change atomically.
+         */
+        class completion_pool
+        {
+        public:
+
+            static constexpr std::size_t SIZE{ 16 };
+            static constexpr std::size_t INVALID_INDEX{ SIZE };
+            static constexpr EventBits_t WAKER_BIT{ 1 };    // Set in the waker event group of a slot.
+
+            static_assert(SIZE <= 24, "Every slot needs an event group bit.");
+
+            completion_pool() :
+                m_slots{  },
+                m_event_group{ xEventGroupCreate() },
+                m_next_sequence{ 0 },
+                m_timing{  }
+            {
+                if (!m_event_group)
+                {
+                    throw std::bad_alloc();
+                }
+            }
+
+            completion_pool(const completion_pool&)             = delete;
+
+            completion_pool& operator=(const completion_pool&)  = delete;
+
+            ~completion_pool()
+            {
+                vEventGroupDelete(m_event_group);
+            }
+
+            completion_slot& operator[](std::size_t index) noexcept
+            {
+                return m_slots[index];
+            }
+
+            operation_timing& timing() noexcept
+            {
+                return m_timing;
+            }
+
+            /**
+             * @brief Claim a free slot for a request about to be issued.
+             *
+             * @return std::size_t Slot index, INVALID_INDEX if all slots are in use.
+             */
+            std::size_t acquire(operation_type type, uint16_t handle) noexcept
+            {
+                for (std::size_t index = 0; index < SIZE; index++)
+                {
+                    auto& slot = m_slots[index];
+
+                    if (slot.state.load(std::memory_order_acquire) != slot_state::free)
+                    {
+                        continue;
+                    }
+
+                    xEventGroupClearBits(m_event_group, to_bit(index));
+
+                    slot.type       = type;
+                    slot.handle     = handle;
+                    slot.sequence   = m_next_sequence++;
+                    slot.submitted  = esp_timer_get_time();
+                    slot.error      = ESP_OK;
+                    slot.waker.store(nullptr, std::memory_order_relaxed);
+                    slot.value.clear();
+                    slot.services.clear();
+                    slot.state.store(slot_state::pending, std::memory_order_release);
+
+                    return index;
+                }
+
+                return INVALID_INDEX;
+            }
+
+            /**
+             * @brief Oldest pending or abandoned slot of the given type on the handle.
+             * Requests are issued in sequence order, so this is the request the response belongs to.
+             */
+            std::size_t find_oldest(operation_type type, uint16_t handle) noexcept
+            {
+                std::size_t oldest = INVALID_INDEX;
+
+                for (std::size_t index = 0; index < SIZE; index++)
+                {
+                    const auto& slot = m_slots[index];
+                    const auto state = slot.state.load(std::memory_order_acquire);
+
+                    if ((state != slot_state::pending && state != slot_state::abandoned) || slot.type != type || slot.handle != handle)
+                    {
+                        continue;
+                    }
+
+                    // Sequence numbers wrap, compare by distance.
+                    if (oldest == INVALID_INDEX || static_cast<int32_t>(slot.sequence - m_slots[oldest].sequence) < 0)
+                    {
+                        oldest = index;
+                    }
+                }
+
+                return oldest;
+            }
+
+            /**
+             * @brief Store the response, record the latency of the request and wake the waiting task.
+             */
+            void complete(std::size_t index, esp_gatt_status_t status, const uint8_t* value = nullptr, uint16_t length = 0) noexcept
+            {
+                auto& slot = m_slots[index];
+
+                m_timing.record(slot.type, slot.submitted);
+
+                if (status != ESP_GATT_OK)
+                {
+                    slot.error = ESP_FAIL;
+                }
+                else if (value && length != 0)
+                {
+                    try
+                    {
+                        slot.value.assign(value, value + length);
+                    }
+                    catch (const std::bad_alloc&)
+                    {
+                        slot.error = ESP_ERR_NO_MEM;
+                    }
+                }
+
+                signal(index);
+            }
+
+            void fail(std::size_t index, esp_err_t error) noexcept
+            {
+                m_slots[index].error = error;
+                signal(index);
+            }
+
+            /**
+             * @brief Fail every outstanding request, e.g. when the connection is lost.
+             *
+             * @param except Slot left untouched, INVALID_INDEX fails all.
+             */
+            void fail_all(esp_err_t error, std::size_t except = INVALID_INDEX) noexcept
+            {
+                for (std::size_t index = 0; index < SIZE; index++)
+                {
+                    const auto state = m_slots[index].state.load(std::memory_order_acquire);
+
+                    if (index != except && (state == slot_state::pending || state == slot_state::abandoned))
+                    {
+                        fail(index, error);
+                    }
+                }
+            }
+
+            /**
+             * @brief Return a slot whose request could not be issued.
+             */
+            void cancel(std::size_t index) noexcept
+            {
+                m_slots[index].state.store(slot_state::free, std::memory_order_release);
+            }
+
+            /**
+             * @brief Block until the slot is completed.
+             */
+            bool wait(std::size_t index, timing::duration_t timeout) noexcept
+            {
+                const EventBits_t bit = to_bit(index);
+                return xEventGroupWaitBits(m_event_group, bit, pdFALSE, pdFALSE, static_cast<TickType_t>(timeout)) & bit;
+            }
+
+            bool is_done(std::size_t index) const noexcept
+            {
+                return xEventGroupGetBits(m_event_group) & to_bit(index);
+            }
+
+            /**
+             * @brief Give up the slot from the token side. A slot still pending is kept until its response arrives.
+             */
+            void release(std::size_t index) noexcept
+            {
+                auto& slot = m_slots[index];
+                auto expected = slot_state::pending;
+
+                if (!slot.state.compare_exchange_strong(expected, slot_state::abandoned, std::memory_order_acq_rel))
+                {
+                    slot.state.store(slot_state::free, std::memory_order_release);
+                }
+            }
+
+        private:
+
+            static constexpr EventBits_t to_bit(std::size_t index) noexcept
+            {
+                return static_cast<EventBits_t>(1) << index;
+            }
+
+            void signal(std::size_t index) noexcept
+            {
+                auto& slot = m_slots[index];
+                auto expected = slot_state::pending;
+
+                if (slot.state.compare_exchange_strong(expected, slot_state::ready, std::memory_order_acq_rel))
+                {
+                    xEventGroupSetBits(m_event_group, to_bit(index));
+
+                    if (EventGroupHandle_t waker = slot.waker.load(std::memory_order_acquire); waker)
+                    {
+                        xEventGroupSetBits(waker, WAKER_BIT);
+                    }
+                }
+                else if (expected == slot_state::abandoned)
+                {
+                    slot.state.store(slot_state::free, std::memory_order_release);
+                }
+            }
+
+            std::array<completion_slot, SIZE>   m_slots;
+            EventGroupHandle_t                  m_event_group;
+            uint32_t                            m_next_sequence;
+            operation_timing                    m_timing;
+        };
+    }
+
+    /**
+     * @brief Handle to an asynchronous GATT request, owning its completion slot until the result is collected.
+     * The request stays queued on the connection after the token is dropped or its wait times out,
+     * so later responses are still matched correctly.
+     */
+    class completion_token
+    {
+    public:
+
+        friend class client;
+
+        /**
+         * @brief Token of a request that could not be issued, wait returns the error right away.
+         */
+        explicit completion_token(esp_err_t error) noexcept :
+            m_pool{  },
+            m_index{ impl::completion_pool::INVALID_INDEX },
+            m_error{ error }
+        {
+
+        }
+
+        completion_token(std::shared_ptr<impl::completion_pool> pool, std::size_t index) noexcept :
+            m_pool{ std::move(pool) },
+            m_index{ index },
+            m_error{ ESP_OK }
+        {
+
+        }
+
+        completion_token(const completion_token&)               = delete;
+
+        completion_token& operator=(const completion_token&)    = delete;
+
+        completion_token(completion_token&& other) noexcept :
+            m_pool{ std::move(other.m_pool) },
+            m_index{ other.m_index },
+            m_error{ other.m_error }
+        {
+            other.m_pool.reset();
+        }
+
+        completion_token& operator=(completion_token&& other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                m_pool  = std::move(other.m_pool);
+                m_index = other.m_index;
+                m_error = other.m_error;
+                other.m_pool.reset();
+            }
+
+            return *this;
+        }
+
+        ~completion_token()
+        {
+            reset();
+        }
+
+        /**
+         * @brief Check if the response arrived, without blocking.
+         */
+        bool is_done() const noexcept
+        {
+            return !m_pool || m_pool->is_done(m_index);
+        }
+
+        /**
+         * @brief Have the completion also set impl::completion_pool::WAKER_BIT in the given event group,
+         * so an executor serving several requests from one task can block on a single event group.
+         * A response arriving before the call sets no bit, check is_done afterwards.
+         *
+         * @param waker Event group outliving the request.
+         */
+        void set_waker(EventGroupHandle_t waker) noexcept
+        {
+            if (m_pool)
+            {
+                (*m_pool)[m_index].waker.store(waker, std::memory_order_release);
+            }
+        }
+
+        /**
+         * @brief Block until the response arrives. The slot is released with the result, so wait returns it only once.
+         *
+         * @param timeout Maximum time to block.
+         * @return operation_result Read value, ESP_ERR_TIMEOUT if no response arrived in time, ESP_FAIL if the peer rejected the request.
+         */
+        operation_result wait(timing::duration_t timeout) noexcept
+        {
+            auto slot = wait_for_slot(timeout);
+
+            if (!slot)
+            {
+                return tl::make_unexpected(slot.error());
+            }
+
+            operation_result result{  };
+
+            try
+            {
+                result = std::vector<uint8_t>((*slot)->value);
+            }
+            catch (const std::bad_alloc&)
+            {
+                result = tl::make_unexpected(ESP_ERR_NO_MEM);
+            }
+
+            reset();
+            return result;
+        }
+
+    private:
+
+        /**
+         * @brief Block until the response arrives and give access to the slot. The slot stays owned by the token.
+         */
+        tl::expected<impl::completion_slot*, esp_err_t> wait_for_slot(timing::duration_t timeout) noexcept
+        {
+            if (!m_pool)
+            {
+                return tl::make_unexpected(m_error);
+            }
+
+            if (!m_pool->wait(m_index, timeout))
+            {
+                return tl::make_unexpected(ESP_ERR_TIMEOUT);
+            }
+
+            auto& slot = (*m_pool)[m_index];
+
+            if (slot.error != ESP_OK)
+            {
+                const esp_err_t error = slot.error;
+                reset();
+                m_error = error;
+                return tl::make_unexpected(error);
+            }
+
+            return &slot;
+        }
+
+        void reset() noexcept
+        {
+            if (m_pool)
+            {
+                m_pool->release(m_index);
+                m_pool.reset();
+                m_error = ESP_ERR_INVALID_STATE;    // Result already collected.
+            }
+        }
+
+        std::shared_ptr<impl::completion_pool>  m_pool;
+        std::size_t                             m_index;
+        esp_err_t                               m_error;
+    };
+}
+
+#endif
\ No newline at end of file
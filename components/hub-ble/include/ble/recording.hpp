@@ -0,0 +1,209 @@
+#ifndef HUB_BLE_RECORDING_HPP
+#define HUB_BLE_RECORDING_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+
+#include "esp_gap_ble_api.h"
+#include "esp_timer.h"
+#include "esp_err.h"
+
+#include "tl/expected.hpp"
+
+#include "utils/spsc_ring.hpp"
+
+/**
+ * @brief Compact binary log of raw GAP scan results.
+ *
+ * The log starts with HEADER_SIZE bytes: the MAGIC and VERSION. Each record follows as:
+ *
+ *      uint8_t     record length, including this byte
+ *      uint32_t    time since the previous record in microseconds, little endian
+ *      uint8_t[6]  advertiser address
+ *      uint8_t     address type
+ *      uint8_t     event type
+ *      int8_t      RSSI
+ *      uint8_t     advertising data length
+ *      uint8_t     scan response length
+ *      uint8_t[]   advertising data followed by scan response
+ */
+namespace hub::ble::recording
+{
+    using scan_result_type = esp_ble_gap_cb_param_t::ble_scan_result_evt_param;
+
+    inline constexpr std::array<uint8_t, 4> MAGIC       { 'H', 'B', 'S', 'L' };
+    inline constexpr uint8_t                VERSION     { 1 };
+    inline constexpr std::size_t            HEADER_SIZE { MAGIC.size() + 1 };
+
+    inline constexpr std::size_t RECORD_HEADER_SIZE { 16 };
+    inline constexpr std::size_t MAX_RECORD_SIZE    { RECORD_HEADER_SIZE + ESP_BLE_ADV_DATA_LEN_MAX + ESP_BLE_SCAN_RSP_DATA_LEN_MAX };
+
+    /**
+     * @brief Write the log header.
+     * 
+     * @param out Buffer of at least HEADER_SIZE bytes.
+     * @return std::size_t Number of bytes written.
+     */
+    std::size_t encode_header(uint8_t* out) noexcept;
+
+    bool is_valid_header(const uint8_t* data, std::size_t length) noexcept;
+
+    /**
+     * @brief Encode a single scan result.
+     * 
+     * @param scan_result Scan result as received in the GAP callback.
+     * @param delta Microseconds since the previous record.
+     * @param out Buffer of at least MAX_RECORD_SIZE bytes.
+     * @return std::size_t Number of bytes written.
+     */
+    std::size_t encode(const scan_result_type& scan_result, uint32_t delta, uint8_t* out) noexcept;
+
+    /**
+     * @brief Decode a single record into an ESP_GAP_SEARCH_INQ_RES_EVT scan result.
+     * 
+     * @return std::size_t Number of bytes consumed, 0 if the record is truncated or malformed.
+     */
+    std::size_t decode(const uint8_t* data, std::size_t length, scan_result_type& scan_result, uint32_t& delta) noexcept;
+
+    /**
+     * @brief Records scan results from the GAP callback and hands the encoded log to the sink in chunks.
+     * Recording only copies the encoded record into a queue, the sink is called from a separate writer task.
+     * The writer task runs periodically, or earlier once the queue starts filling up.
+     */
+    class recorder
+    {
+    public:
+
+        /**
+         * @brief Called from the writer task with a chunk of the log, the first chunk starts with the log header.
+         */
+        using sink_type = std::function<void(const uint8_t* data, std::size_t length)>;
+
+        explicit recorder(sink_type sink);
+
+        recorder(const recorder&)               = delete;
+
+        recorder& operator=(const recorder&)    = delete;
+
+        /**
+         * @brief Stops the writer task after flushing queued records.
+         */
+        ~recorder();
+
+        /**
+         * @brief Queue the scan result. Producer side, called from the GAP callback only.
+         */
+        void record(const scan_result_type& scan_result, int64_t timestamp) noexcept;
+
+        /**
+         * @brief Number of records lost because the writer task could not keep up.
+         */
+        uint32_t get_dropped_count() const noexcept
+        {
+            return m_dropped_count.load(std::memory_order_relaxed);
+        }
+
+    private:
+
+        static constexpr const char* TAG{ "hub::ble::recording::recorder" };
+
+        static constexpr std::size_t    QUEUE_SIZE{ 128 };
+        static constexpr std::size_t    WAKE_THRESHOLD{ QUEUE_SIZE / 4 };
+        static constexpr std::size_t    CHUNK_SIZE{ 1024 };
+        static constexpr TickType_t     FLUSH_PERIOD{ 100 / portTICK_PERIOD_MS };
+        static constexpr uint32_t       WRITER_TASK_STACK_SIZE{ 4096 };
+        static constexpr UBaseType_t    WRITER_TASK_PRIORITY{ 2 };
+
+        static constexpr EventBits_t    STOP_BIT{ BIT0 };
+        static constexpr EventBits_t    STOPPED_BIT{ BIT1 };
+        static constexpr EventBits_t    DATA_BIT{ BIT2 };
+
+        struct entry
+        {
+            uint8_t                                 length;
+            std::array<uint8_t, MAX_RECORD_SIZE>    data;
+        };
+
+        static void writer_task(void* arg);
+
+        /**
+         * @brief Move queued records into chunks and pass them to the sink. Writer task only.
+         */
+        void drain() noexcept;
+
+        void flush_chunk() noexcept;
+
+        sink_type                               m_sink;
+        utils::spsc_ring<entry, QUEUE_SIZE>     m_queue;
+        int64_t                                 m_last_timestamp;
+        std::atomic<uint32_t>                   m_dropped_count;
+        std::array<uint8_t, CHUNK_SIZE>         m_chunk;
+        std::size_t                             m_chunk_size;
+        EventGroupHandle_t                      m_event_group;
+        TaskHandle_t                            m_writer_task;
+    };
+
+    /**
+     * @brief Feed a recorded log through the GAP callback path, preserving the recorded timing.
+     * 
+     * @param log Log contents, starting with the header.
+     * @param length Log length in bytes.
+     * @param speed Playback speed, 1 for the original timing, 10 for ten times faster, 0 as fast as possible.
+     * @param dispatch Invoked with an ESP_GAP_BLE_SCAN_RESULT_EVT parameter for every record.
+     * @return tl::expected<std::size_t, esp_err_t> Number of replayed records, ESP_ERR_INVALID_VERSION for an unknown log format.
+     */
+    template<typename DispatchT>
+    tl::expected<std::size_t, esp_err_t> replay(const uint8_t* log, std::size_t length, double speed, DispatchT&& dispatch)
+    {
+        if (!is_valid_header(log, length))
+        {
+            return tl::make_unexpected<esp_err_t>(ESP_ERR_INVALID_VERSION);
+        }
+
+        std::size_t offset      = HEADER_SIZE;
+        std::size_t count       = 0;
+        uint64_t log_time       = 0;
+        const int64_t start     = esp_timer_get_time();
+
+        esp_ble_gap_cb_param_t param{  };
+
+        while (offset < length)
+        {
+            uint32_t delta          = 0;
+            const std::size_t size  = decode(log + offset, length - offset, param.scan_rst, delta);
+
+            if (size == 0)
+            {
+                break;
+            }
+
+            offset      += size;
+            log_time    += delta;
+
+            if (speed > 0)
+            {
+                // Sleep with tick resolution, lateness is not accumulated since the target is absolute.
+                const int64_t target    = start + static_cast<int64_t>(static_cast<double>(log_time) / speed);
+                const int64_t remaining = target - esp_timer_get_time();
+
+                if (remaining >= static_cast<int64_t>(portTICK_PERIOD_MS) * 1000)
+                {
+                    vTaskDelay(static_cast<TickType_t>(remaining / (static_cast<int64_t>(portTICK_PERIOD_MS) * 1000)));
+                }
+            }
+
+            std::invoke(dispatch, param);
+            count++;
+        }
+
+        return count;
+    }
+}
+
+#endif
\ No newline at end of file
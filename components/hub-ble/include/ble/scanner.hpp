@@ -5,6 +5,13 @@
 #include <type_traits>
 #include <cstdint>
 #include <memory>
+#include <atomic>
+#include <array>
+#include <vector>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
 
 #include "esp_bt.h"
 #include "esp_bt_main.h"
@@ -13,19 +20,58 @@
 
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "rxcpp/rx.hpp"
 #include "tl/expected.hpp"
 
 #include "utils/mac.hpp"
 #include "utils/esp_exception.hpp"
+#include "utils/spsc_ring.hpp"
+#include "utils/bloom_filter.hpp"
+#include "utils/histogram.hpp"
+#include "timing/timing.hpp"
+
+#include "advertisement.hpp"
+#include "duplicate_filter.hpp"
+#include "recording.hpp"
 
 namespace hub::ble::scanner
 {
-    struct message_type
+    using message_type = advertisement;
+
+    struct device_address
+    {
+        std::array<uint8_t, utils::mac::MAC_SIZE>   address;
+        esp_ble_addr_type_t                         type{ BLE_ADDR_TYPE_PUBLIC };
+
+        bool operator==(const device_address& other) const noexcept
+        {
+            return address == other.address && type == other.type;
+        }
+    };
+
+    using latency_histogram = utils::histogram<24>;    // Microseconds, up to ~4 s.
+
+    struct statistics_t
     {
-        std::string_view name;
-        std::string_view mac;
+        uint32_t                            received;           // Advertisements delivered by the controller.
+        uint32_t                            unnamed;            // Received advertisements without a local name.
+        uint32_t                            filtered;           // Rejected by the host-side accept list.
+        uint32_t                            suppressed;         // Unchanged repeats within the duplicate TTL.
+        uint32_t                            dropped;            // Lost because the scan queue was full.
+        uint32_t                            forwarded;          // Queued to the subscribers.
+        latency_histogram::snapshot_type    callback_duration;  // Time spent in the GAP callback per advertisement.
+        latency_histogram::snapshot_type    publish_latency;    // Time from reception until the MQTT publish returned.
+    };
+
+    struct config_t
+    {
+        timing::duration_t  duplicate_ttl{ timing::seconds(60) };   // Unchanged advertisements are forwarded at most once per TTL, zero disables suppression.
+        uint16_t            scan_interval{ 0x50 };                  // Units of 0.625 ms, 0x0004 - 0x4000.
+        uint16_t            scan_window{ 0x30 };                    // Units of 0.625 ms, at most scan_interval.
+        bool                continuous{ false };                    // Restart the scan on completion instead of completing the observable.
+        std::vector<device_address> accept_list{  };                // Forward only advertisements from these devices, empty forwards all.
     };
 
     namespace impl
@@ -56,65 +102,213 @@ namespace hub::ble::scanner
                 return m_subject;
             }
 
+            /**
+             * @brief Number of scan results dropped because the queue between the GAP callback and the consumer task was full.
+             */
+            static uint32_t get_dropped_count() noexcept
+            {
+                return s_dropped_count.load(std::memory_order_relaxed);
+            }
+
+            /**
+             * @brief Number of scan results suppressed as unchanged repeats within the duplicate TTL.
+             */
+            static uint32_t get_suppressed_count() noexcept
+            {
+                return s_suppressed_count.load(std::memory_order_relaxed);
+            }
+
+            /**
+             * @brief Number of advertisements rejected by the host-side accept list filter.
+             * Advertisements rejected by the controller never reach the host and are not counted.
+             */
+            static uint32_t get_filtered_count() noexcept
+            {
+                return s_filtered_count.load(std::memory_order_relaxed);
+            }
+
+            static statistics_t get_statistics() noexcept;
+
+            /**
+             * @brief Record every scan result received from the controller, before any filtering.
+             * 
+             * @param recorder Recorder, nullptr stops recording. Must outlive the scan or a later call with nullptr.
+             */
+            static void set_recorder(recording::recorder* recorder) noexcept
+            {
+                s_recorder.store(recorder, std::memory_order_release);
+            }
+
+            /**
+             * @brief Record the time from reception of an advertisement until now, called once its result was published.
+             *
+             * @param timestamp Reception time of the result, as in message_type::timestamp.
+             */
+            static void record_publish_latency(int64_t timestamp) noexcept
+            {
+                s_publish_latency.record(static_cast<uint32_t>(esp_timer_get_time() - timestamp));
+            }
+
+            /**
+             * @brief Apply scan configuration and start scanning.
+             *
+             * @param config Scanner configuration.
+             * @param scan_duration Scan duration in seconds, 0 scans until stopped. In continuous mode, duration of a single scan cycle.
+             * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG for an invalid duty cycle.
+             */
+            static esp_err_t start_scanning(const config_t& config, uint16_t scan_duration) noexcept;
+
         private:
 
-            static constexpr const char* TAG{ "hub::ble::scanner::impl::state" };
+            static constexpr std::size_t    SCAN_QUEUE_SIZE{ 32 };
+            static constexpr std::size_t    HOST_FILTER_BITS{ 1024 };
+            static constexpr std::size_t    DUPLICATE_FILTER_SIZE{ 256 };
+            static constexpr uint32_t       CONSUMER_TASK_STACK_SIZE{ 8192 };
+            static constexpr UBaseType_t    CONSUMER_TASK_PRIORITY{ 5 };
 
-            static constexpr esp_ble_scan_params_t BLE_SCAN_PARAMS{
-                BLE_SCAN_TYPE_ACTIVE,           // Scan type
-                BLE_ADDR_TYPE_PUBLIC,           // Address type
-                BLE_SCAN_FILTER_ALLOW_ALL,      // Filter policy
-                0x50,                           // Scan interval
-                0x30,                           // Scan window
-                BLE_SCAN_DUPLICATE_DISABLE      // Advertise duplicates filter policy
+            static constexpr EventBits_t    DATA_BIT{ BIT0 };
+            static constexpr EventBits_t    COMPLETED_BIT{ BIT1 };
+
+            /**
+             * @brief Host-side accept list, used when the list exceeds the controller capacity. Empty keys forward all.
+             */
+            struct host_filter
+            {
+                utils::bloom_filter<HOST_FILTER_BITS>   bloom{  };
+                std::vector<uint64_t>                   keys{  };   // Sorted.
             };
 
-            static std::weak_ptr<state>             s_scanner_state;
+            /**
+             * @brief Drains the scan queue and runs subscribers outside of the Bluedroid task.
+             */
+            static void consumer_task(void* arg);
+
+            /**
+             * @brief Filter, decode and queue a single scan result. Runs in the Bluedroid task.
+             */
+            static void on_scan_result(const esp_ble_gap_cb_param_t::ble_scan_result_evt_param& scan_result, int64_t timestamp) noexcept;
+
+            /**
+             * @brief Load the accept list into the controller filter accept list and select the matching scan filter policy.
+             * Lists exceeding the controller capacity are filtered on the host instead, in the GAP callback.
+             * The new host filter is only handed over to the Bluedroid task, see apply_host_filter.
+             * Does nothing if the list did not change since the last call.
+             */
+            static esp_err_t update_accept_list(const std::vector<device_address>& accept_list) noexcept;
+
+            /**
+             * @brief Replace the host filter with the pending one, if any. Runs in the Bluedroid task on scan stop and
+             * start completion, so the filter is never replaced while is_accepted reads it.
+             */
+            static void apply_host_filter() noexcept;
+
+            /**
+             * @brief Host-side accept list check, the bloom filter rejects most foreign devices without a search.
+             * Runs in the Bluedroid task.
+             */
+            static bool is_accepted(const uint8_t* address) noexcept;
 
-            rxcpp::subjects::subject<message_type>  m_subject;
+            static uint64_t to_key(const uint8_t* address) noexcept;
+
+            static constexpr const char* TAG{ "hub::ble::scanner::impl::state" };
+
+            static constexpr uint16_t       MIN_SCAN_INTERVAL{ 0x0004 };
+            static constexpr uint16_t       MAX_SCAN_INTERVAL{ 0x4000 };
+
+            static std::weak_ptr<state>                             s_scanner_state;
+            static utils::spsc_ring<message_type, SCAN_QUEUE_SIZE>  s_queue;
+            static std::atomic<uint32_t>                            s_received_count;
+            static std::atomic<uint32_t>                            s_unnamed_count;
+            static std::atomic<uint32_t>                            s_forwarded_count;
+            static std::atomic<uint32_t>                            s_dropped_count;
+            static duplicate_filter<DUPLICATE_FILTER_SIZE>          s_duplicate_filter;
+            static std::atomic<uint32_t>                            s_suppressed_count;
+            static std::atomic<bool>                                s_continuous;
+            static std::atomic<uint16_t>                            s_scan_duration;
+            static std::vector<device_address>                      s_accept_list;
+            static esp_ble_scan_filter_t                            s_filter_policy;
+            static std::unique_ptr<host_filter>                     s_host_filter;
+            static std::atomic<host_filter*>                        s_pending_host_filter;
+            static std::atomic<uint32_t>                            s_filtered_count;
+            static latency_histogram                                s_callback_duration;
+            static latency_histogram                                s_publish_latency;
+            static std::atomic<recording::recorder*>                s_recorder;
+            static EventGroupHandle_t                               s_event_group;
+            static TaskHandle_t                                     s_consumer_task;
+
+            rxcpp::subjects::subject<message_type>                  m_subject;
         };
     }
 
-    [[nodiscard]] inline auto get_observable_factory() noexcept
+    [[nodiscard]] inline uint32_t get_dropped_count() noexcept
+    {
+        return impl::state::get_dropped_count();
+    }
+
+    [[nodiscard]] inline uint32_t get_suppressed_count() noexcept
+    {
+        return impl::state::get_suppressed_count();
+    }
+
+    [[nodiscard]] inline uint32_t get_filtered_count() noexcept
+    {
+        return impl::state::get_filtered_count();
+    }
+
+    [[nodiscard]] inline statistics_t get_statistics() noexcept
+    {
+        return impl::state::get_statistics();
+    }
+
+    inline void set_recorder(recording::recorder* recorder) noexcept
+    {
+        impl::state::set_recorder(recorder);
+    }
+
+    inline void record_publish_latency(int64_t timestamp) noexcept
+    {
+        impl::state::record_publish_latency(timestamp);
+    }
+
+    [[nodiscard]] inline auto get_observable_factory(const config_t& config = config_t()) noexcept
     {
         static constexpr const char* TAG{ "hub::ble::scanner::get_observable_factory" };
 
-        return [](uint16_t scan_duration) -> rxcpp::observable<message_type> {
-            if (esp_err_t result = esp_ble_gap_start_scanning(scan_duration); result != ESP_OK)
-            {
-                return rxcpp::observable<>::error<message_type>(utils::esp_exception("Could not start BLE scan.", result));
-            }
-            else
+        return [config](uint16_t scan_duration) -> rxcpp::observable<message_type> {
+            std::shared_ptr<impl::state> local_state{  };
+
             {
-                std::shared_ptr<impl::state> local_state{  };
+                auto& weak_state = impl::state::get_state();
 
+                if (!weak_state.expired())
                 {
-                    auto& weak_state = impl::state::get_state();
-
-                    if (!weak_state.expired())
+                    ESP_LOGD(TAG, "Setting scanner local state.");
+                    local_state = weak_state.lock();
+                }
+                else
+                {
+                    try
                     {
-                        ESP_LOGD(TAG, "Setting scanner local state.");
-                        local_state = weak_state.lock();
+                        ESP_LOGD(TAG, "Creating scanner global state.");
+                        local_state = std::make_shared<impl::state>();
                     }
-                    else
+                    catch (const utils::esp_exception& err)
                     {
-                        try
-                        {
-                            ESP_LOGD(TAG, "Creating scanner global state.");
-                            local_state = std::make_shared<impl::state>();
-                        }
-                        catch (const utils::esp_exception& err)
-                        {
-                            ESP_LOGE(TAG, "Global state creation failed with error code %i [%s].", err.errc(), esp_err_to_name(err.errc()));
-                            return rxcpp::observable<>::error<message_type>(err);
-                        }
-
-                        weak_state = local_state;
+                        ESP_LOGE(TAG, "Global state creation failed with error code %i [%s].", err.errc(), esp_err_to_name(err.errc()));
+                        return rxcpp::observable<>::error<message_type>(err);
                     }
+
+                    weak_state = local_state;
                 }
+            }
 
-                return local_state->get_subject().get_observable() | rxcpp::operators::tap([local_state](message_type) {});
+            // GAP callback is registered by the state, so scanning starts only after it can receive results.
+            if (esp_err_t result = impl::state::start_scanning(config, scan_duration); result != ESP_OK)
+            {
+                return rxcpp::observable<>::error<message_type>(utils::esp_exception("Could not start BLE scan.", result));
             }
+
+            return local_state->get_subject().get_observable() | rxcpp::operators::tap([local_state](message_type) {});
         };
     }
 }
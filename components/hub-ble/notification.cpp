@@ -0,0 +1,54 @@
+#include "ble/notification.hpp"
+
+#include <atomic>
+#include <algorithm>
+
+namespace hub::ble
+{
+    namespace
+    {
+        alignas(4) uint8_t g_blocks[pooled_value::BLOCK_COUNT][pooled_value::BLOCK_SIZE];
+        std::atomic<uint32_t> g_used_blocks{ 0 };   // Bit per block, set while a value holds it.
+    }
+
+    tl::expected<pooled_value, esp_err_t> value_view::copy() const noexcept
+    {
+        if (m_size > pooled_value::BLOCK_SIZE)
+        {
+            return tl::make_unexpected(ESP_ERR_INVALID_SIZE);
+        }
+
+        constexpr uint32_t ALL_BLOCKS = (pooled_value::BLOCK_COUNT == 32) ? ~0u : ((1u << pooled_value::BLOCK_COUNT) - 1);
+
+        uint32_t used = g_used_blocks.load(std::memory_order_relaxed);
+        uint8_t block = 0;
+
+        do
+        {
+            if ((used & ALL_BLOCKS) == ALL_BLOCKS)
+            {
+                return tl::make_unexpected(ESP_ERR_NO_MEM);
+            }
+
+            block = static_cast<uint8_t>(__builtin_ctz(~used));
+        } while (!g_used_blocks.compare_exchange_weak(used, used | (1u << block), std::memory_order_acquire, std::memory_order_relaxed));
+
+        std::copy(begin(), end(), g_blocks[block]);
+        return pooled_value(block, m_size);
+    }
+
+    const uint8_t* pooled_value::data() const noexcept
+    {
+        return (m_block != INVALID_BLOCK) ? g_blocks[m_block] : nullptr;
+    }
+
+    void pooled_value::release() noexcept
+    {
+        if (m_block != INVALID_BLOCK)
+        {
+            g_used_blocks.fetch_and(~(1u << m_block), std::memory_order_release);
+            m_block = INVALID_BLOCK;
+            m_size  = 0;
+        }
+    }
+}
\ No newline at end of file
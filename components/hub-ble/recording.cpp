@@ -0,0 +1,191 @@
+#include "ble/recording.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#include "esp_log.h"
+
+#include "utils/esp_exception.hpp"
+
+namespace hub::ble::recording
+{
+    std::size_t encode_header(uint8_t* out) noexcept
+    {
+        std::copy(MAGIC.begin(), MAGIC.end(), out);
+        out[MAGIC.size()] = VERSION;
+        return HEADER_SIZE;
+    }
+
+    bool is_valid_header(const uint8_t* data, std::size_t length) noexcept
+    {
+        return length >= HEADER_SIZE && std::equal(MAGIC.begin(), MAGIC.end(), data) && data[MAGIC.size()] == VERSION;
+    }
+
+    std::size_t encode(const scan_result_type& scan_result, uint32_t delta, uint8_t* out) noexcept
+    {
+        const std::size_t payload_length = std::min<std::size_t>(
+            scan_result.adv_data_len + scan_result.scan_rsp_len,
+            ESP_BLE_ADV_DATA_LEN_MAX + ESP_BLE_SCAN_RSP_DATA_LEN_MAX);
+
+        const std::size_t length = RECORD_HEADER_SIZE + payload_length;
+
+        out[0] = static_cast<uint8_t>(length);
+        out[1] = static_cast<uint8_t>(delta);
+        out[2] = static_cast<uint8_t>(delta >> 8);
+        out[3] = static_cast<uint8_t>(delta >> 16);
+        out[4] = static_cast<uint8_t>(delta >> 24);
+        std::copy(std::begin(scan_result.bda), std::end(scan_result.bda), out + 5);
+        out[11] = static_cast<uint8_t>(scan_result.ble_addr_type);
+        out[12] = static_cast<uint8_t>(scan_result.ble_evt_type);
+        out[13] = static_cast<uint8_t>(static_cast<int8_t>(scan_result.rssi));
+        out[14] = scan_result.adv_data_len;
+        out[15] = static_cast<uint8_t>(payload_length - std::min<std::size_t>(scan_result.adv_data_len, payload_length));
+        std::copy(scan_result.ble_adv, scan_result.ble_adv + payload_length, out + RECORD_HEADER_SIZE);
+
+        return length;
+    }
+
+    std::size_t decode(const uint8_t* data, std::size_t length, scan_result_type& scan_result, uint32_t& delta) noexcept
+    {
+        if (length < RECORD_HEADER_SIZE)
+        {
+            return 0;
+        }
+
+        const std::size_t record_length     = data[0];
+        const std::size_t payload_length    = data[14] + data[15];
+
+        if (record_length > length ||
+            record_length != RECORD_HEADER_SIZE + payload_length ||
+            payload_length > ESP_BLE_ADV_DATA_LEN_MAX + ESP_BLE_SCAN_RSP_DATA_LEN_MAX)
+        {
+            return 0;
+        }
+
+        delta = static_cast<uint32_t>(data[1]) |
+            (static_cast<uint32_t>(data[2]) << 8) |
+            (static_cast<uint32_t>(data[3]) << 16) |
+            (static_cast<uint32_t>(data[4]) << 24);
+
+        scan_result.search_evt      = ESP_GAP_SEARCH_INQ_RES_EVT;
+        scan_result.dev_type        = ESP_BT_DEVICE_TYPE_BLE;
+        std::copy(data + 5, data + 11, scan_result.bda);
+        scan_result.ble_addr_type   = static_cast<esp_ble_addr_type_t>(data[11]);
+        scan_result.ble_evt_type    = static_cast<esp_ble_evt_type_t>(data[12]);
+        scan_result.rssi            = static_cast<int8_t>(data[13]);
+        scan_result.adv_data_len    = data[14];
+        scan_result.scan_rsp_len    = data[15];
+        scan_result.flag            = 0;
+        scan_result.num_resps       = 1;
+        scan_result.num_dis         = 0;
+
+        std::copy(data + RECORD_HEADER_SIZE, data + record_length, scan_result.ble_adv);
+        std::fill(scan_result.ble_adv + payload_length, std::end(scan_result.ble_adv), 0);
+
+        return record_length;
+    }
+
+    recorder::recorder(sink_type sink) :
+        m_sink{ std::move(sink) },
+        m_queue{  },
+        m_last_timestamp{ 0 },
+        m_dropped_count{ 0 },
+        m_chunk{  },
+        m_chunk_size{ 0 },
+        m_event_group{ nullptr },
+        m_writer_task{ nullptr }
+    {
+        m_chunk_size = encode_header(m_chunk.data());
+
+        if (m_event_group = xEventGroupCreate(); !m_event_group)
+        {
+            LOG_AND_THROW(TAG, utils::esp_exception("Recorder event group creation failed.", ESP_ERR_NO_MEM));
+        }
+
+        if (xTaskCreate(&writer_task, "ble_record", WRITER_TASK_STACK_SIZE, this, WRITER_TASK_PRIORITY, &m_writer_task) != pdPASS)
+        {
+            vEventGroupDelete(m_event_group);
+            LOG_AND_THROW(TAG, utils::esp_exception("Recorder writer task creation failed.", ESP_ERR_NO_MEM));
+        }
+    }
+
+    recorder::~recorder()
+    {
+        xEventGroupSetBits(m_event_group, STOP_BIT);
+        xEventGroupWaitBits(m_event_group, STOPPED_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
+        vEventGroupDelete(m_event_group);
+    }
+
+    void recorder::record(const scan_result_type& scan_result, int64_t timestamp) noexcept
+    {
+        entry record;
+
+        const int64_t delta = (m_last_timestamp == 0) ? 0 : timestamp - m_last_timestamp;
+        m_last_timestamp    = timestamp;
+
+        record.length = static_cast<uint8_t>(encode(
+            scan_result,
+            static_cast<uint32_t>(std::clamp<int64_t>(delta, 0, std::numeric_limits<uint32_t>::max())),
+            record.data.data()));
+
+        if (!m_queue.try_push(record))
+        {
+            m_dropped_count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        // The queue grows one record at a time, so the threshold is hit exactly once per burst.
+        if (m_queue.size() == WAKE_THRESHOLD)
+        {
+            xEventGroupSetBits(m_event_group, DATA_BIT);
+        }
+    }
+
+    void recorder::writer_task(void* arg)
+    {
+        auto* self = static_cast<recorder*>(arg);
+
+        while (!(xEventGroupWaitBits(self->m_event_group, STOP_BIT | DATA_BIT, pdFALSE, pdFALSE, FLUSH_PERIOD) & STOP_BIT))
+        {
+            xEventGroupClearBits(self->m_event_group, DATA_BIT);
+            self->drain();
+        }
+
+        self->drain();
+        xEventGroupSetBits(self->m_event_group, STOPPED_BIT);
+        vTaskDelete(nullptr);
+    }
+
+    void recorder::drain() noexcept
+    {
+        entry record;
+
+        while (m_queue.try_pop(record))
+        {
+            if (m_chunk_size + record.length > CHUNK_SIZE)
+            {
+                flush_chunk();
+            }
+
+            std::copy(record.data.begin(), record.data.begin() + record.length, m_chunk.begin() + m_chunk_size);
+            m_chunk_size += record.length;
+        }
+
+        flush_chunk();
+    }
+
+    void recorder::flush_chunk() noexcept
+    {
+        if (m_chunk_size == 0)
+        {
+            return;
+        }
+
+        if (m_sink)
+        {
+            m_sink(m_chunk.data(), m_chunk_size);
+        }
+
+        m_chunk_size = 0;
+    }
+}
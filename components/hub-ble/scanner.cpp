@@ -1,61 +1,135 @@
-#include <string>
-#include <array>
-
 #include "ble/scanner.hpp"
+#include "ble/gap.hpp"
+
+#include <algorithm>
 
 namespace hub::ble::scanner::impl
 {
-    std::weak_ptr<state> state::s_scanner_state{};
+    std::weak_ptr<state>                                    state::s_scanner_state{};
+    utils::spsc_ring<message_type, state::SCAN_QUEUE_SIZE>  state::s_queue{};
+    std::atomic<uint32_t>                                   state::s_received_count{ 0 };
+    std::atomic<uint32_t>                                   state::s_unnamed_count{ 0 };
+    std::atomic<uint32_t>                                   state::s_forwarded_count{ 0 };
+    std::atomic<uint32_t>                                   state::s_dropped_count{ 0 };
+    duplicate_filter<state::DUPLICATE_FILTER_SIZE>          state::s_duplicate_filter{  };
+    std::atomic<uint32_t>                                   state::s_suppressed_count{ 0 };
+    std::atomic<bool>                                       state::s_continuous{ false };
+    std::atomic<uint16_t>                                   state::s_scan_duration{ 0 };
+    std::vector<device_address>                             state::s_accept_list{  };
+    esp_ble_scan_filter_t                                   state::s_filter_policy{ BLE_SCAN_FILTER_ALLOW_ALL };
+    std::unique_ptr<state::host_filter>                     state::s_host_filter{  };
+    std::atomic<state::host_filter*>                        state::s_pending_host_filter{ nullptr };
+    std::atomic<uint32_t>                                   state::s_filtered_count{ 0 };
+    latency_histogram                                       state::s_callback_duration{  };
+    latency_histogram                                       state::s_publish_latency{  };
+    std::atomic<recording::recorder*>                       state::s_recorder{ nullptr };
+    EventGroupHandle_t                                      state::s_event_group{ nullptr };
+    TaskHandle_t                                            state::s_consumer_task{ nullptr };
+
+    void state::consumer_task(void* arg)
+    {
+        uint32_t        reported_drops = 0;
+        message_type    message;
+
+        while (true)
+        {
+            EventBits_t bits = xEventGroupWaitBits(s_event_group, DATA_BIT | COMPLETED_BIT, pdTRUE, pdFALSE, portMAX_DELAY);
+
+            auto state = s_scanner_state.lock();
+
+            while (s_queue.try_pop(message))
+            {
+                if (state)
+                {
+                    state->get_subject().get_subscriber().on_next(message);
+                }
+            }
+
+            if (uint32_t dropped = get_dropped_count(); dropped != reported_drops)
+            {
+                ESP_LOGW(TAG, "Scan queue full, %u scan results dropped.", dropped - reported_drops);
+                reported_drops = dropped;
+            }
+
+            if ((bits & COMPLETED_BIT) && state)
+            {
+                state->get_subject().get_subscriber().on_completed();
+            }
+        }
+    }
 
     state::state() :
         m_subject{  }
     {
         esp_err_t result = ESP_OK;
 
-        result = esp_ble_gap_register_callback([](esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
+        if (!s_consumer_task)
+        {
+            if (s_event_group = xEventGroupCreate(); !s_event_group)
+            {
+                LOG_AND_THROW(TAG, utils::esp_exception("Scan queue event group creation failed.", ESP_ERR_NO_MEM));
+            }
+
+            if (xTaskCreate(&consumer_task, "ble_scan", CONSUMER_TASK_STACK_SIZE, nullptr, CONSUMER_TASK_PRIORITY, &s_consumer_task) != pdPASS)
+            {
+                vEventGroupDelete(s_event_group);
+                s_event_group = nullptr;
+                LOG_AND_THROW(TAG, utils::esp_exception("Scan consumer task creation failed.", ESP_ERR_NO_MEM));
+            }
+        }
+
+        // Runs in the Bluedroid task: only copy the result into the queue, subscribers run in consumer_task.
+        result = gap::add_handler([](esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
 
             ESP_LOGV(TAG, "GAP event: %i.", event);
 
-            if (s_scanner_state.expired())
+            if (event == ESP_GAP_BLE_UPDATE_WHITELIST_COMPLETE_EVT && param->update_whitelist_cmpl.status != ESP_BT_STATUS_SUCCESS)
             {
-                ESP_LOGD(TAG, "Global state expired.");
+                ESP_LOGE(TAG, "Filter accept list update failed with status %i.", param->update_whitelist_cmpl.status);
                 return;
             }
 
+            if (event == ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT || event == ESP_GAP_BLE_SCAN_START_COMPLETE_EVT)
             {
-                auto state = s_scanner_state.lock();
-
-                if (event == ESP_GAP_BLE_SCAN_RESULT_EVT)
-                {
-                    ESP_LOGV(TAG, "GAP search event: %i.", param->scan_rst.search_evt);
-
-                    if (param->scan_rst.search_evt == ESP_GAP_SEARCH_INQ_RES_EVT)
-                    {
-                        uint8_t adv_name_len    = 0;
-                        uint8_t* adv_name       = esp_ble_resolve_adv_data(param->scan_rst.ble_adv, ESP_BLE_AD_TYPE_NAME_CMPL, &adv_name_len);
+                apply_host_filter();
+                return;
+            }
 
-                        if (adv_name == nullptr || adv_name_len == 0)
-                        {
-                            return;
-                        }
+            if (event != ESP_GAP_BLE_SCAN_RESULT_EVT)
+            {
+                return;
+            }
 
-                        ESP_LOGD(TAG, "Scan result received.");
+            if (s_scanner_state.expired())
+            {
+                ESP_LOGD(TAG, "Global state expired.");
+                return;
+            }
 
-                        {
-                            static std::array<char, utils::mac::MAC_STR_SIZE> cache;
-                            utils::mac(param->scan_rst.bda, param->scan_rst.bda + utils::mac::MAC_SIZE).to_charbuff(cache.begin());
+            ESP_LOGV(TAG, "GAP search event: %i.", param->scan_rst.search_evt);
 
-                            state->get_subject().get_subscriber().on_next(message_type{
-                                std::string_view(reinterpret_cast<const char*>(adv_name), static_cast<size_t>(adv_name_len)),
-                                std::string_view(cache.begin(), cache.size())
-                            });
-                        }
+            if (param->scan_rst.search_evt == ESP_GAP_SEARCH_INQ_RES_EVT)
+            {
+                const int64_t timestamp = esp_timer_get_time();
+                on_scan_result(param->scan_rst, timestamp);
+                s_callback_duration.record(static_cast<uint32_t>(esp_timer_get_time() - timestamp));
+            }
+            else if (param->scan_rst.search_evt == ESP_GAP_SEARCH_INQ_CMPL_EVT)
+            {
+                if (s_continuous.load(std::memory_order_relaxed))
+                {
+                    if (esp_err_t result = esp_ble_gap_start_scanning(s_scan_duration.load(std::memory_order_relaxed)); result == ESP_OK)
+                    {
+                        ESP_LOGD(TAG, "Scan cycle restarted.");
+                        return;
                     }
-                    else if (param->scan_rst.search_evt == ESP_GAP_SEARCH_INQ_CMPL_EVT)
+                    else
                     {
-                        state->get_subject().get_subscriber().on_completed();
+                        ESP_LOGE(TAG, "Scan cycle restart failed with error code %i [%s].", result, esp_err_to_name(result));
                     }
                 }
+
+                xEventGroupSetBits(s_event_group, COMPLETED_BIT);
             }
         });
 
@@ -63,10 +137,207 @@ namespace hub::ble::scanner::impl
         {
             LOG_AND_THROW(TAG, utils::esp_exception("Register GAP callback failed.", result));
         }
+    }
+
+    void state::on_scan_result(const esp_ble_gap_cb_param_t::ble_scan_result_evt_param& scan_result, int64_t timestamp) noexcept
+    {
+        s_received_count.fetch_add(1, std::memory_order_relaxed);
+
+        if (auto* recorder = s_recorder.load(std::memory_order_acquire); recorder)
+        {
+            recorder->record(scan_result, timestamp);
+        }
+
+        if (!is_accepted(scan_result.bda))
+        {
+            s_filtered_count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        message_type message;
+        parse_advertisement(scan_result, message);
+        message.timestamp = timestamp;
+
+        if (!message.has(advertisement::HAS_NAME_COMPLETE) && !message.has(advertisement::HAS_NAME_SHORT))
+        {
+            s_unnamed_count.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (s_duplicate_filter.is_duplicate(message, xTaskGetTickCount()))
+        {
+            s_suppressed_count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        if (!s_queue.try_push(message))
+        {
+            s_dropped_count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        s_forwarded_count.fetch_add(1, std::memory_order_relaxed);
+        xEventGroupSetBits(s_event_group, DATA_BIT);
+    }
+
+    statistics_t state::get_statistics() noexcept
+    {
+        return statistics_t{
+            s_received_count.load(std::memory_order_relaxed),
+            s_unnamed_count.load(std::memory_order_relaxed),
+            s_filtered_count.load(std::memory_order_relaxed),
+            s_suppressed_count.load(std::memory_order_relaxed),
+            s_dropped_count.load(std::memory_order_relaxed),
+            s_forwarded_count.load(std::memory_order_relaxed),
+            s_callback_duration.snapshot(),
+            s_publish_latency.snapshot()
+        };
+    }
+
+    esp_err_t state::start_scanning(const config_t& config, uint16_t scan_duration) noexcept
+    {
+        esp_err_t result = ESP_OK;
+
+        if (config.scan_interval < MIN_SCAN_INTERVAL ||
+            config.scan_interval > MAX_SCAN_INTERVAL ||
+            config.scan_window < MIN_SCAN_INTERVAL ||
+            config.scan_window > config.scan_interval)
+        {
+            ESP_LOGE(TAG, "Invalid scan duty cycle, interval: 0x%04x, window: 0x%04x.", config.scan_interval, config.scan_window);
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        if (result = update_accept_list(config.accept_list); result != ESP_OK)
+        {
+            return result;
+        }
+
+        esp_ble_scan_params_t scan_params{
+            BLE_SCAN_TYPE_ACTIVE,           // Scan type
+            BLE_ADDR_TYPE_PUBLIC,           // Address type
+            s_filter_policy,                // Filter policy
+            config.scan_interval,           // Scan interval
+            config.scan_window,             // Scan window
+            BLE_SCAN_DUPLICATE_DISABLE      // Advertise duplicates filter policy
+        };
+
+        s_duplicate_filter.set_ttl(timing::to_ticks(config.duplicate_ttl));
+        s_scan_duration.store(scan_duration, std::memory_order_relaxed);
+        s_continuous.store(config.continuous, std::memory_order_relaxed);
+
+        if (result = esp_ble_gap_set_scan_params(&scan_params); result != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Set GAP scan params failed.");
+            return result;
+        }
+
+        return esp_ble_gap_start_scanning(scan_duration);
+    }
+
+    esp_err_t state::update_accept_list(const std::vector<device_address>& accept_list) noexcept
+    {
+        esp_err_t result = ESP_OK;
+        uint16_t capacity = 0;
+
+        if (accept_list == s_accept_list)
+        {
+            return ESP_OK;
+        }
+
+        // The controller rejects accept list changes while a scan uses it.
+        esp_ble_gap_stop_scanning();
+
+        auto filter = std::make_unique<host_filter>();
+
+        if (result = esp_ble_gap_clear_whitelist(); result != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Clear filter accept list failed.");
+            return result;
+        }
+
+        if (result = esp_ble_gap_get_whitelist_size(&capacity); result != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Get filter accept list size failed.");
+            return result;
+        }
+
+        s_accept_list.clear();
+        s_filter_policy = BLE_SCAN_FILTER_ALLOW_ALL;
+
+        if (accept_list.empty())
+        {
+            ESP_LOGI(TAG, "Accept list empty, forwarding all advertisements.");
+        }
+        else if (accept_list.size() <= capacity)
+        {
+            for (const auto& device : accept_list)
+            {
+                esp_bd_addr_t address;
+                std::copy(device.address.begin(), device.address.end(), address);
+
+                const esp_ble_wl_addr_type_t type = (device.type == BLE_ADDR_TYPE_PUBLIC) ? BLE_WL_ADDR_TYPE_PUBLIC : BLE_WL_ADDR_TYPE_RANDOM;
+
+                if (result = esp_ble_gap_update_whitelist(true, address, type); result != ESP_OK)
+                {
+                    ESP_LOGE(TAG, "Add device to filter accept list failed.");
+                    return result;
+                }
+            }
 
-        if (result = esp_ble_gap_set_scan_params(const_cast<esp_ble_scan_params_t*>(&BLE_SCAN_PARAMS)); result != ESP_OK)
+            s_filter_policy = BLE_SCAN_FILTER_ALLOW_ONLY_WLST;
+            ESP_LOGI(TAG, "%u devices loaded into the controller filter accept list.", static_cast<unsigned>(accept_list.size()));
+        }
+        else
         {
-            LOG_AND_THROW(TAG, utils::esp_exception("Set GAP scan params failed.", result));
+            for (const auto& device : accept_list)
+            {
+                const uint64_t key = to_key(device.address.data());
+                filter->bloom.add(key);
+                filter->keys.push_back(key);
+            }
+
+            std::sort(filter->keys.begin(), filter->keys.end());
+            ESP_LOGW(TAG, "%u devices exceed the controller filter accept list capacity of %u, filtering on the host.",
+                static_cast<unsigned>(accept_list.size()), capacity);
         }
+
+        // Stopping the scan is asynchronous and results may still be in the GAP callback, which only picks the filter up
+        // on stop or start completion. A filter still pending from an earlier call was never used and is replaced.
+        delete s_pending_host_filter.exchange(filter.release(), std::memory_order_acq_rel);
+
+        s_accept_list = accept_list;
+        return ESP_OK;
+    }
+
+    void state::apply_host_filter() noexcept
+    {
+        if (host_filter* filter = s_pending_host_filter.exchange(nullptr, std::memory_order_acq_rel); filter)
+        {
+            s_host_filter.reset(filter);
+        }
+    }
+
+    bool state::is_accepted(const uint8_t* address) noexcept
+    {
+        if (!s_host_filter || s_host_filter->keys.empty())
+        {
+            return true;
+        }
+
+        const uint64_t key = to_key(address);
+
+        // Bloom filter false positives are resolved by the exact search.
+        return s_host_filter->bloom.might_contain(key) && std::binary_search(s_host_filter->keys.begin(), s_host_filter->keys.end(), key);
+    }
+
+    uint64_t state::to_key(const uint8_t* address) noexcept
+    {
+        uint64_t key = 0;
+
+        for (std::size_t i = 0; i < utils::mac::MAC_SIZE; i++)
+        {
+            key = (key << 8) | address[i];
+        }
+
+        return key;
     }
 }
\ No newline at end of file
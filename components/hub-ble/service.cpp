@@ -1,6 +1,8 @@
 #include "ble/service.hpp"
 
 #include <stdexcept>
+#include <algorithm>
+#include <iterator>
 
 #include "esp_bt_defs.h"
 #include "esp_gattc_api.h"
@@ -19,10 +21,6 @@ namespace hub::ble
 
     tl::expected<std::vector<characteristic>, esp_gatt_status_t> service::get_characteristics() const noexcept
     {
-        esp_gatt_status_t result = ESP_GATT_OK;
-        uint16_t characteristic_count = 0U;
-        std::vector<esp_gattc_char_elem_t> characteristics;
-
         auto shared_client = m_client_ptr.lock();
 
         if (!shared_client)
@@ -31,56 +29,28 @@ namespace hub::ble
             return tl::expected<std::vector<characteristic>, esp_gatt_status_t>(tl::unexpect, ESP_GATT_ERROR);
         }
 
-        result = esp_ble_gattc_get_attr_count(
-            shared_client->m_gattc_interface, 
-            shared_client->m_connection_id,
-            ESP_GATT_DB_CHARACTERISTIC,
-            m_service.start_handle,
-            m_service.end_handle,
-            ESP_GATT_ILLEGAL_HANDLE,
-            &characteristic_count);
-
-        if (result != ESP_GATT_OK)
-        {
-            ESP_LOGE(TAG, "Could not get characteristics count.");
-            return tl::expected<std::vector<characteristic>, esp_gatt_status_t>(tl::unexpect, result);
-        }
-
-        characteristics.resize(characteristic_count);
-
-        result = esp_ble_gattc_get_all_char(
-            shared_client->m_gattc_interface, 
-            shared_client->m_connection_id,
-            m_service.start_handle,
-            m_service.end_handle,
-            characteristics.data(),
-            &characteristic_count,
-            0);
+        auto attributes = shared_client->get_attributes();
 
-        if (result != ESP_GATT_OK)
+        if (!attributes)
         {
             ESP_LOGE(TAG, "Could not retrieve characteristics.");
-            return tl::expected<std::vector<characteristic>, esp_gatt_status_t>(tl::unexpect, result);
+            return tl::expected<std::vector<characteristic>, esp_gatt_status_t>(tl::unexpect, ESP_GATT_ERROR);
         }
 
-        {
-            std::vector<characteristic> result;
-            result.reserve(characteristics.size());
+        auto [first, last] = (*attributes)->get_characteristics(m_service.start_handle, m_service.end_handle);
 
-            std::transform(characteristics.cbegin(), characteristics.cend(), std::back_inserter(result), [this](auto elem) { 
-                return characteristic(m_client_ptr, get_handle_range(), elem); 
-            });
+        std::vector<characteristic> result;
+        result.reserve(std::distance(first, last));
 
-            return result;
-        }
+        std::transform(first, last, std::back_inserter(result), [this](auto elem) { 
+            return characteristic(m_client_ptr, get_handle_range(), elem); 
+        });
+
+        return result;
     }
     
     tl::expected<characteristic, esp_gatt_status_t> service::get_characteristic_by_uuid(const esp_bt_uuid_t* uuid) const noexcept
     {
-        esp_gatt_status_t result = ESP_GATT_OK;
-        uint16_t characteristic_count = 0U;
-        std::vector<esp_gattc_char_elem_t> characteristics;
-
         auto shared_client = m_client_ptr.lock();
 
         if (!shared_client)
@@ -89,38 +59,22 @@ namespace hub::ble
             return tl::expected<characteristic, esp_gatt_status_t>(tl::unexpect, ESP_GATT_ERROR);
         }
 
-        result = esp_ble_gattc_get_attr_count(
-            shared_client->m_gattc_interface, 
-            shared_client->m_connection_id,
-            ESP_GATT_DB_CHARACTERISTIC,
-            m_service.start_handle,
-            m_service.end_handle,
-            ESP_GATT_ILLEGAL_HANDLE,
-            &characteristic_count);
+        auto attributes = shared_client->get_attributes();
 
-        if (result != ESP_GATT_OK)
+        if (!attributes)
         {
-            ESP_LOGE(TAG, "Could not get characteristics count.");
-            return tl::expected<characteristic, esp_gatt_status_t>(tl::unexpect, result);
+            ESP_LOGE(TAG, "Could not retrieve characteristics.");
+            return tl::expected<characteristic, esp_gatt_status_t>(tl::unexpect, ESP_GATT_ERROR);
         }
 
-        characteristics.resize(characteristic_count);
-
-        result = esp_ble_gattc_get_char_by_uuid(
-            shared_client->m_gattc_interface, 
-            shared_client->m_connection_id,
-            m_service.start_handle,
-            m_service.end_handle,
-            *uuid,
-            characteristics.data(),
-            &characteristic_count);
+        auto [first, last] = (*attributes)->get_characteristics(m_service.start_handle, m_service.end_handle);
 
-        if (result != ESP_GATT_OK)
+        if (auto iter = std::find_if(first, last, [uuid](const auto& elem) { return uuid_equal(elem.uuid, *uuid); }); iter != last)
         {
-            ESP_LOGE(TAG, "Could not retrieve characteristics.");
-            return tl::expected<characteristic, esp_gatt_status_t>(tl::unexpect, result);
+            return characteristic(m_client_ptr, get_handle_range(), *iter);
         }
 
-        return characteristic(m_client_ptr, get_handle_range(), characteristics.front());
+        ESP_LOGE(TAG, "Characteristic not found.");
+        return tl::expected<characteristic, esp_gatt_status_t>(tl::unexpect, ESP_GATT_NOT_FOUND);
     }
 }
\ No newline at end of file
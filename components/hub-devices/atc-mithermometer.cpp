@@ -0,0 +1,33 @@
+#include "atc-mithermometer.hpp"
+
+namespace hub::device::atc
+{
+    bool mithermometer::decode(const uint8_t* data, std::size_t length, passive::reading& result) noexcept
+    {
+        using namespace passive;
+        using namespace passive::impl;
+
+        // Both formats start with the 6-byte MAC address.
+        if (length == ATC1441_LENGTH)
+        {
+            // Big endian: temperature 0.1 °C, humidity %, battery %, battery mV, frame counter.
+            result.add(quantity::temperature,   read_int16_be(data + 6) / 10.0);
+            result.add(quantity::humidity,      data[8]);
+            result.add(quantity::battery,       data[9]);
+            result.add(quantity::voltage,       read_uint16_be(data + 10) / 1000.0);
+            return true;
+        }
+
+        if (length == PVVX_LENGTH)
+        {
+            // Little endian: temperature 0.01 °C, humidity 0.01 %, battery mV, battery %, counter, flags.
+            result.add(quantity::temperature,   read_int16_le(data + 6) / 100.0);
+            result.add(quantity::humidity,      read_uint16_le(data + 8) / 100.0);
+            result.add(quantity::voltage,       read_uint16_le(data + 10) / 1000.0);
+            result.add(quantity::battery,       data[12]);
+            return true;
+        }
+
+        return false;
+    }
+}
@@ -0,0 +1,131 @@
+#include "bthome.hpp"
+
+#include <optional>
+
+namespace hub::device
+{
+    namespace
+    {
+        struct object_format
+        {
+            uint8_t                             id;
+            uint8_t                             length;
+            bool                                is_signed;
+            double                              factor;
+            std::optional<passive::quantity>    type;   // Objects without a type are skipped.
+        };
+
+        using passive::quantity;
+
+        // Objects have no length prefix, so the size of every object that can precede a supported one must be known.
+        constexpr object_format OBJECT_FORMATS[] = {
+            { 0x00, 1, false, 1.0,      quantity::packet_id },
+            { 0x01, 1, false, 1.0,      quantity::battery },
+            { 0x02, 2, true,  0.01,     quantity::temperature },
+            { 0x03, 2, false, 0.01,     quantity::humidity },
+            { 0x04, 3, false, 0.01,     quantity::pressure },
+            { 0x05, 3, false, 0.01,     quantity::illuminance },
+            { 0x06, 2, false, 0.01,     std::nullopt },             // Mass (kg)
+            { 0x07, 2, false, 0.01,     std::nullopt },             // Mass (lb)
+            { 0x08, 2, true,  0.01,     std::nullopt },             // Dew point
+            { 0x09, 1, false, 1.0,      std::nullopt },             // Count
+            { 0x0a, 3, false, 0.001,    std::nullopt },             // Energy
+            { 0x0b, 3, false, 0.01,     std::nullopt },             // Power
+            { 0x0c, 2, false, 0.001,    quantity::voltage },
+            { 0x0d, 2, false, 1.0,      std::nullopt },             // PM2.5
+            { 0x0e, 2, false, 1.0,      std::nullopt },             // PM10
+            { 0x0f, 1, false, 1.0,      std::nullopt },             // Generic boolean
+            { 0x10, 1, false, 1.0,      quantity::power },
+            { 0x11, 1, false, 1.0,      std::nullopt },             // Opening
+            { 0x12, 2, false, 1.0,      std::nullopt },             // CO2
+            { 0x13, 2, false, 1.0,      std::nullopt },             // TVOC
+            { 0x14, 2, false, 0.01,     quantity::moisture },
+            { 0x2e, 1, false, 1.0,      quantity::humidity },
+            { 0x2f, 1, false, 1.0,      quantity::moisture },
+            { 0x3a, 1, false, 1.0,      std::nullopt },             // Button
+            { 0x3d, 2, false, 1.0,      std::nullopt },             // Count
+            { 0x3e, 4, false, 1.0,      std::nullopt },             // Count
+            { 0x3f, 2, true,  0.1,      std::nullopt },             // Rotation
+            { 0x40, 2, false, 1.0,      std::nullopt },             // Distance (mm)
+            { 0x41, 2, false, 0.1,      std::nullopt },             // Distance (m)
+            { 0x42, 3, false, 0.001,    std::nullopt },             // Duration
+            { 0x43, 2, false, 0.001,    std::nullopt },             // Current
+            { 0x44, 2, false, 0.01,     std::nullopt },             // Speed
+            { 0x45, 2, true,  0.1,      quantity::temperature },
+            { 0x46, 1, false, 0.1,      std::nullopt },             // UV index
+            { 0x4a, 2, false, 0.1,      quantity::voltage },
+        };
+
+        // Binary sensors 0x15 - 0x2d are single byte objects.
+        constexpr object_format BINARY_SENSOR_FORMAT{ 0x15, 1, false, 1.0, std::nullopt };
+
+        constexpr const object_format* find_object_format(uint8_t id) noexcept
+        {
+            if (id >= 0x15 && id <= 0x2d)
+            {
+                return &BINARY_SENSOR_FORMAT;
+            }
+
+            for (const auto& format : OBJECT_FORMATS)
+            {
+                if (format.id == id)
+                {
+                    return &format;
+                }
+            }
+
+            return nullptr;
+        }
+
+        int32_t read_value(const uint8_t* data, uint8_t length, bool is_signed) noexcept
+        {
+            uint32_t value = 0;
+
+            for (uint8_t i = 0; i < length; i++)
+            {
+                value |= static_cast<uint32_t>(data[i]) << (8 * i);
+            }
+
+            if (is_signed && length < 4 && (value & (1u << (8 * length - 1))))
+            {
+                value |= ~((1u << (8 * length)) - 1);
+            }
+
+            return static_cast<int32_t>(value);
+        }
+    }
+
+    bool bthome::decode(const uint8_t* data, std::size_t length, passive::reading& result) noexcept
+    {
+        if (length < 1 || (data[0] & DEVICE_INFO_ENCRYPTED) || (data[0] >> 5) != VERSION)
+        {
+            return false;
+        }
+
+        const uint8_t initial_count = result.count;
+        std::size_t offset          = 1;
+
+        while (offset < length)
+        {
+            const object_format* format = find_object_format(data[offset]);
+
+            // Unknown object, the remaining objects cannot be located.
+            if (!format || offset + 1 + format->length > length)
+            {
+                break;
+            }
+
+            if (format->type)
+            {
+                const int32_t raw = read_value(data + offset + 1, format->length, format->is_signed);
+                const double value = format->is_signed ? raw * format->factor : static_cast<uint32_t>(raw) * format->factor;
+
+                result.add(*format->type, value);
+            }
+
+            offset += 1 + format->length;
+        }
+
+        return result.count != initial_count;
+    }
+}
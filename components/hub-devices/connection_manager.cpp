@@ -0,0 +1,619 @@
+#include "connection_manager.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <string>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+
+#include "utils/esp_exception.hpp"
+
+namespace hub::device
+{
+    connection_manager::connection_manager(const config_t& config, message_handler_t message_handler) :
+        m_config            { config },
+        m_message_handler   { std::move(message_handler) },
+        m_mutex             {  },
+        m_devices           {  },
+        m_idle_slots        { 0 },
+        m_slots             {  },
+        m_event_group       { xEventGroupCreate() }
+    {
+        if (!m_event_group)
+        {
+            LOG_AND_THROW(TAG, utils::esp_exception("Connection manager event group creation failed.", ESP_ERR_NO_MEM));
+        }
+
+        const uint8_t slot_count = std::clamp<uint8_t>(config.slot_count, 1, static_cast<uint8_t>(ble::MAX_CLIENTS));
+
+        // Tasks keep pointers to their context, so the vector must not reallocate.
+        m_slots.reserve(slot_count);
+
+        for (uint8_t slot = 0; slot < slot_count; slot++)
+        {
+            {
+                std::lock_guard lock{ m_mutex };
+                m_idle_slots++;
+            }
+
+            m_slots.push_back(slot_context{ this, slot });
+
+            if (xTaskCreate(&slot_task, "ble_conn", SLOT_TASK_STACK_SIZE, &m_slots.back(), SLOT_TASK_PRIORITY, nullptr) != pdPASS)
+            {
+                m_slots.pop_back();
+                stop();
+                LOG_AND_THROW(TAG, utils::esp_exception("Connection slot task creation failed.", ESP_ERR_NO_MEM));
+            }
+        }
+
+        ESP_LOGI(TAG, "Serving devices over %u connection slots.", slot_count);
+    }
+
+    connection_manager::~connection_manager()
+    {
+        stop();
+    }
+
+    esp_err_t connection_manager::add_device(const utils::mac& address, esp_ble_addr_type_t address_type, std::shared_ptr<device_base> device, const profile_t& profile)
+    {
+        if (!profile.active.is_valid() || !profile.idle.is_valid())
+        {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        {
+            std::lock_guard lock{ m_mutex };
+
+            if (std::any_of(m_devices.cbegin(), m_devices.cend(), [&address](const entry& device) { return device.address == address; }))
+            {
+                return ESP_ERR_INVALID_STATE;
+            }
+
+            device->set_message_handler([this, address](std::string_view payload) {
+                if (m_message_handler)
+                {
+                    m_message_handler(address, payload);
+                }
+            });
+
+            // The slot holding the device notices the lost connection when it wakes up.
+            device->set_disconnect_handler([this](esp_gatt_conn_reason_t) {
+                notify_slots();
+            });
+
+            m_devices.push_back(entry{ address, address_type, std::move(device), {  }, 0, 0, false, false, false, profile, false, false, {  }, {  }, 0 });
+        }
+
+        notify_slots();
+        return ESP_OK;
+    }
+
+    esp_err_t connection_manager::set_profile(const utils::mac& address, const profile_t& profile)
+    {
+        if (!profile.active.is_valid() || !profile.idle.is_valid())
+        {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        {
+            std::lock_guard lock{ m_mutex };
+
+            auto iter = std::find_if(m_devices.begin(), m_devices.end(), [&address](const entry& device) { return device.address == address; });
+
+            if (iter == m_devices.end())
+            {
+                return ESP_ERR_NOT_FOUND;
+            }
+
+            iter->profile = profile;
+        }
+
+        // The slot holding the device applies the profile when it wakes up.
+        notify_slots();
+        return ESP_OK;
+    }
+
+    std::vector<connection_manager::link_t> connection_manager::get_links() const
+    {
+        std::lock_guard lock{ m_mutex };
+
+        const TickType_t now = xTaskGetTickCount();
+
+        std::vector<link_t> links;
+        links.reserve(m_devices.size());
+
+        for (const auto& device : m_devices)
+        {
+            TickType_t remaining = 0;
+            is_backing_off(device, now, remaining);
+
+            links.push_back(link_t{
+                device.address, device.connected, device.idle, device.params, device.health, remaining * portTICK_PERIOD_MS, device.device->get_timing() });
+        }
+
+        return links;
+    }
+
+    esp_err_t connection_manager::submit(const utils::mac& address, device_base::in_message_t&& command)
+    {
+        {
+            std::lock_guard lock{ m_mutex };
+
+            auto iter = std::find_if(m_devices.begin(), m_devices.end(), [&address](const entry& device) { return device.address == address; });
+
+            if (iter == m_devices.end())
+            {
+                return ESP_ERR_NOT_FOUND;
+            }
+
+            // A burst of settings collapses into the queued command, the slot was notified when it was queued.
+            if (!iter->commands.empty() && iter->device->coalesce(iter->commands.back(), command))
+            {
+                return ESP_OK;
+            }
+
+            if (iter->commands.size() >= MAX_PENDING_COMMANDS)
+            {
+                ESP_LOGW(TAG, "Command queue of %s full.", std::string(address).c_str());
+                return ESP_ERR_NO_MEM;
+            }
+
+            if (iter->commands.empty())
+            {
+                iter->command_time = xTaskGetTickCount();
+            }
+
+            iter->commands.push_back(std::move(command));
+        }
+
+        notify_slots();
+        return ESP_OK;
+    }
+
+    void connection_manager::slot_task(void* arg)
+    {
+        auto* context = static_cast<slot_context*>(arg);
+        context->manager->run(context->index);
+    }
+
+    void connection_manager::run(uint8_t slot)
+    {
+        const EventBits_t slot_bit = to_bit(slot);
+
+        while (true)
+        {
+            // Cleared before the schedule is checked, so a wake-up arriving in between is not lost.
+            xEventGroupClearBits(m_event_group, slot_bit);
+
+            TickType_t wait = portMAX_DELAY;
+            std::size_t index = INVALID_INDEX;
+
+            {
+                std::lock_guard lock{ m_mutex };
+
+                if (xEventGroupGetBits(m_event_group) & STOP_BIT)
+                {
+                    break;
+                }
+
+                if (index = select(xTaskGetTickCount(), wait); index != INVALID_INDEX)
+                {
+                    m_devices[index].active = true;
+                    m_idle_slots--;
+                }
+            }
+
+            if (index == INVALID_INDEX)
+            {
+                xEventGroupWaitBits(m_event_group, slot_bit | STOP_BIT, pdFALSE, pdFALSE, wait);
+                continue;
+            }
+
+            const outcome result = serve(slot, index);
+
+            {
+                std::lock_guard lock{ m_mutex };
+
+                m_devices[index].active = false;
+                m_idle_slots++;
+
+                reschedule(m_devices[index], result, xTaskGetTickCount());
+            }
+
+            // Commands may have arrived for this device while it was disconnecting.
+            notify_slots();
+        }
+
+        xEventGroupSetBits(m_event_group, slot_bit << STOPPED_SHIFT);
+        vTaskDelete(nullptr);
+    }
+
+    void connection_manager::reschedule(entry& device, outcome result, TickType_t now) noexcept
+    {
+        device.served       = true;
+        device.served_time  = now;
+        device.reconnect    = (result == outcome::lost);
+
+        if (result == outcome::closed)
+        {
+            return;
+        }
+
+        const uint32_t delay = device.health.backoff(
+            timing::to_ticks(m_config.backoff_base), timing::to_ticks(m_config.backoff_max), esp_random());
+
+        device.retry_time = now + delay;
+
+        ESP_LOGD(TAG, "%s retried in %u ms, %u consecutive failures.", std::string(device.address).c_str(),
+            static_cast<unsigned>(delay * portTICK_PERIOD_MS), device.health.get_failures());
+
+        if (result == outcome::failed && !device.commands.empty())
+        {
+            if (device.health.get_failures() % MAX_CONNECT_ATTEMPTS == 0)
+            {
+                ESP_LOGW(TAG, "%s unreachable, %u pending commands dropped.",
+                    std::string(device.address).c_str(), static_cast<unsigned>(device.commands.size()));
+                device.commands.clear();
+            }
+            else
+            {
+                // Retried after the commands of the other devices, instead of holding on to a slot.
+                device.command_time = now;
+            }
+        }
+    }
+
+    bool connection_manager::is_backing_off(const entry& device, TickType_t now, TickType_t& remaining) noexcept
+    {
+        remaining = 0;
+
+        if (device.health.get_failures() == 0)
+        {
+            return false;
+        }
+
+        // Tick counts wrap, compare by distance.
+        if (const auto left = static_cast<int32_t>(device.retry_time - now); left > 0)
+        {
+            remaining = static_cast<TickType_t>(left);
+            return true;
+        }
+
+        return false;
+    }
+
+    std::size_t connection_manager::select(TickType_t now, TickType_t& wait) const noexcept
+    {
+        const TickType_t poll_ticks = timing::to_ticks(m_config.poll_period);
+
+        std::size_t commanded = INVALID_INDEX;
+        std::size_t reconnected = INVALID_INDEX;
+        std::size_t polled = INVALID_INDEX;
+
+        wait = portMAX_DELAY;
+
+        // Healthy devices go before flaky ones, within each group the order below applies.
+        const auto by_health = [](const entry& device, const entry& candidate, auto&& precedes) {
+            const bool flaky = device.health.is_flaky();
+            return (flaky != candidate.health.is_flaky()) ? !flaky : precedes();
+        };
+
+        for (std::size_t index = 0; index < m_devices.size(); index++)
+        {
+            const auto& device = m_devices[index];
+
+            if (device.active)
+            {
+                continue;
+            }
+
+            if (TickType_t remaining = 0; is_backing_off(device, now, remaining))
+            {
+                wait = std::min(wait, remaining);
+                continue;
+            }
+
+            if (!device.commands.empty())
+            {
+                // Tick counts wrap, compare by distance.
+                if (commanded == INVALID_INDEX || by_health(device, m_devices[commanded], [&]() {
+                        return static_cast<int32_t>(device.command_time - m_devices[commanded].command_time) < 0;
+                    }))
+                {
+                    commanded = index;
+                }
+
+                continue;
+            }
+
+            if (device.reconnect)
+            {
+                if (reconnected == INVALID_INDEX || by_health(device, m_devices[reconnected], [&]() {
+                        return static_cast<int32_t>(device.served_time - m_devices[reconnected].served_time) < 0;
+                    }))
+                {
+                    reconnected = index;
+                }
+
+                continue;
+            }
+
+            if (poll_ticks == 0)
+            {
+                continue;
+            }
+
+            const TickType_t elapsed = now - device.served_time;
+
+            if (device.served && elapsed < poll_ticks)
+            {
+                wait = std::min(wait, poll_ticks - elapsed);
+                continue;
+            }
+
+            // Devices never served go first, then the least recently served.
+            if (const auto* candidate = (polled != INVALID_INDEX) ? &m_devices[polled] : nullptr;
+                !candidate ||
+                by_health(device, *candidate, [&]() {
+                    return (!device.served && candidate->served) ||
+                        (device.served && candidate->served && elapsed > now - candidate->served_time);
+                }))
+            {
+                polled = index;
+            }
+        }
+
+        if (commanded != INVALID_INDEX)
+        {
+            return commanded;
+        }
+
+        return (reconnected != INVALID_INDEX) ? reconnected : polled;
+    }
+
+    bool connection_manager::is_slot_wanted(TickType_t now) const noexcept
+    {
+        if (m_idle_slots != 0)
+        {
+            return false;
+        }
+
+        return std::any_of(m_devices.cbegin(), m_devices.cend(), [now](const entry& device) {
+            TickType_t remaining = 0;
+            return !device.active && !device.commands.empty() && !is_backing_off(device, now, remaining);
+        });
+    }
+
+    connection_manager::outcome connection_manager::serve(uint8_t slot, std::size_t index)
+    {
+        std::shared_ptr<device_base> device;
+        utils::mac address;
+        esp_ble_addr_type_t address_type;
+
+        {
+            std::lock_guard lock{ m_mutex };
+            device          = m_devices[index].device;
+            address         = m_devices[index].address;
+            address_type    = m_devices[index].address_type;
+        }
+
+        const std::string name(address);
+        const int64_t connect_start = esp_timer_get_time();
+        bool connected = false;
+
+        try
+        {
+            device->connect(address, address_type);
+            connected = device->is_connected();
+        }
+        catch (const std::exception& err)
+        {
+            ESP_LOGE(TAG, "Slot %u could not connect to %s: %s", slot, name.c_str(), err.what());
+        }
+
+        const auto connect_time = static_cast<uint32_t>((esp_timer_get_time() - connect_start) / 1000);
+
+        if (!connected)
+        {
+            // The driver may have failed after the connection was opened, its application slot is freed either way.
+            try
+            {
+                device->disconnect();
+            }
+            catch (const std::exception& err)
+            {
+                ESP_LOGD(TAG, "Slot %u could not clean up the connection to %s: %s", slot, name.c_str(), err.what());
+            }
+
+            std::lock_guard lock{ m_mutex };
+            m_devices[index].health.record_connect(false, connect_time);
+
+            return outcome::failed;
+        }
+
+        ESP_LOGD(TAG, "Slot %u connected to %s in %u ms.", slot, name.c_str(), static_cast<unsigned>(connect_time));
+
+        const auto rssi = device->read_rssi();
+
+        {
+            std::lock_guard lock{ m_mutex };
+
+            auto& entry     = m_devices[index];
+            entry.connected = true;
+            entry.health.record_connect(true, connect_time);
+
+            if (rssi)
+            {
+                entry.health.record_rssi(*rssi);
+            }
+        }
+
+        const EventBits_t slot_bit = to_bit(slot);
+        const TickType_t park_ticks = timing::to_ticks(m_config.park_time);
+        TickType_t park_until = xTaskGetTickCount() + park_ticks;
+        ble::connection_params applied{  };
+
+        while (device->is_connected())
+        {
+            xEventGroupClearBits(m_event_group, slot_bit);
+
+            while (auto command = pop_command(index))
+            {
+                apply_profile(index, *device, false, applied);
+
+                try
+                {
+                    device->process_message(std::move(*command));
+                }
+                catch (const std::exception& err)
+                {
+                    ESP_LOGE(TAG, "Command for %s failed: %s", name.c_str(), err.what());
+                }
+
+                park_until = xTaskGetTickCount() + park_ticks;
+
+                if (!device->is_connected())
+                {
+                    break;
+                }
+            }
+
+            if (!device->is_connected())
+            {
+                break;
+            }
+
+            apply_profile(index, *device, true, applied);
+
+            const auto remaining = static_cast<int32_t>(park_until - xTaskGetTickCount());
+
+            if (remaining <= 0)
+            {
+                break;
+            }
+
+            {
+                std::lock_guard lock{ m_mutex };
+
+                if (is_slot_wanted(xTaskGetTickCount()))
+                {
+                    ESP_LOGD(TAG, "Slot %u released early, devices are waiting.", slot);
+                    break;
+                }
+            }
+
+            if (xEventGroupWaitBits(m_event_group, slot_bit | STOP_BIT, pdFALSE, pdFALSE, static_cast<TickType_t>(remaining)) & STOP_BIT)
+            {
+                break;
+            }
+        }
+
+        // Checked before disconnecting, which clears the connection either way.
+        const bool lost = !device->is_connected();
+
+        try
+        {
+            device->disconnect();
+        }
+        catch (const std::exception& err)
+        {
+            ESP_LOGE(TAG, "Slot %u could not disconnect from %s: %s", slot, name.c_str(), err.what());
+        }
+
+        std::lock_guard lock{ m_mutex };
+
+        auto& entry     = m_devices[index];
+        entry.connected = false;
+        entry.idle      = false;
+        entry.params    = ble::connection_params{  };
+
+        if (lost)
+        {
+            entry.health.record_drop();
+            return outcome::lost;
+        }
+
+        entry.health.record_close();
+        return outcome::closed;
+    }
+
+    void connection_manager::apply_profile(std::size_t index, device_base& device, bool idle, ble::connection_params& applied)
+    {
+        ble::connection_params wanted{  };
+
+        {
+            std::lock_guard lock{ m_mutex };
+
+            auto& entry = m_devices[index];
+            entry.idle  = idle;
+            wanted      = idle ? entry.profile.idle : entry.profile.active;
+        }
+
+        if (wanted == applied)
+        {
+            return;
+        }
+
+        // A rejected request is not repeated on this connection, the device keeps its current parameters.
+        applied = wanted;
+
+        if (auto result = device.set_connection_params(wanted); !result)
+        {
+            ESP_LOGW(TAG, "%s rejected the %s connection parameters.", std::string(device.get_address()).c_str(), idle ? "idle" : "active");
+        }
+
+        std::lock_guard lock{ m_mutex };
+        m_devices[index].params = device.get_connection_params();
+    }
+
+    std::optional<device_base::in_message_t> connection_manager::pop_command(std::size_t index)
+    {
+        std::lock_guard lock{ m_mutex };
+
+        auto& commands = m_devices[index].commands;
+
+        if (commands.empty())
+        {
+            return std::nullopt;
+        }
+
+        std::optional<device_base::in_message_t> command{ std::move(commands.front()) };
+        commands.pop_front();
+
+        return command;
+    }
+
+    void connection_manager::notify_slots() noexcept
+    {
+        EventBits_t bits = 0;
+
+        for (const auto& slot : m_slots)
+        {
+            bits |= to_bit(slot.index);
+        }
+
+        xEventGroupSetBits(m_event_group, bits);
+    }
+
+    void connection_manager::stop() noexcept
+    {
+        EventBits_t stopped_bits = 0;
+
+        for (const auto& slot : m_slots)
+        {
+            stopped_bits |= to_bit(slot.index) << STOPPED_SHIFT;
+        }
+
+        xEventGroupSetBits(m_event_group, STOP_BIT);
+
+        if (stopped_bits != 0)
+        {
+            xEventGroupWaitBits(m_event_group, stopped_bits, pdFALSE, pdTRUE, portMAX_DELAY);
+        }
+
+        vEventGroupDelete(m_event_group);
+        m_event_group = nullptr;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#ifndef HUB_DEVICE_ATC_MITHERMOMETER_HPP
+#define HUB_DEVICE_ATC_MITHERMOMETER_HPP
+
+#include <cstdint>
+#include <string_view>
+
+#include "passive.hpp"
+
+namespace hub::device::atc
+{
+    /**
+     * @brief Decoder of the custom firmware (ATC1441 and pvvx formats) for Xiaomi LYWSD03MMC thermometers,
+     * broadcast as Environmental Sensing (0x181A) service data.
+     * 
+     */
+    struct mithermometer
+    {
+        static constexpr std::string_view       DECODER_NAME{ "ATC_MiThermometer" };
+        static constexpr passive::decoder_key   DECODER_KEY{ passive::data_source::service_data, 0x181a };
+
+        static bool decode(const uint8_t* data, std::size_t length, passive::reading& result) noexcept;
+
+    private:
+
+        static constexpr std::size_t ATC1441_LENGTH { 13 };
+        static constexpr std::size_t PVVX_LENGTH    { 15 };
+    };
+}
+
+#endif
\ No newline at end of file
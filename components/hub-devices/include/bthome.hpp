@@ -0,0 +1,29 @@
+#ifndef HUB_DEVICE_BTHOME_HPP
+#define HUB_DEVICE_BTHOME_HPP
+
+#include <cstdint>
+#include <string_view>
+
+#include "passive.hpp"
+
+namespace hub::device
+{
+    /**
+     * @brief Decoder of unencrypted BTHome v2 (0xFCD2) service data.
+     * 
+     */
+    struct bthome
+    {
+        static constexpr std::string_view       DECODER_NAME{ "BTHome" };
+        static constexpr passive::decoder_key   DECODER_KEY{ passive::data_source::service_data, 0xfcd2 };
+
+        static bool decode(const uint8_t* data, std::size_t length, passive::reading& result) noexcept;
+
+    private:
+
+        static constexpr uint8_t DEVICE_INFO_ENCRYPTED  { 1 << 0 };
+        static constexpr uint8_t VERSION                { 2 };
+    };
+}
+
+#endif
\ No newline at end of file
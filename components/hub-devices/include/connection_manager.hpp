@@ -0,0 +1,253 @@
+#ifndef HUB_DEVICE_CONNECTION_MANAGER_HPP
+#define HUB_DEVICE_CONNECTION_MANAGER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <functional>
+#include <string_view>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+
+#include "esp_err.h"
+
+#include "ble/client.hpp"
+#include "utils/mac.hpp"
+#include "timing/timing.hpp"
+
+#include "device_base.hpp"
+#include "link_health.hpp"
+
+namespace hub::device
+{
+    /**
+     * @brief Serves an inventory of GATT devices larger than the number of connection slots.
+     *
+     * Every slot is run by its own task, which takes the next device from the scheduler, connects to it,
+     * delivers its pending commands and keeps the connection parked to receive notifications, then disconnects.
+     * A parked connection is given up early when a device with pending commands is waiting and no slot is idle.
+     *
+     * Devices with pending commands are served first, oldest command first. The others are visited once per
+     * poll period, least recently served first, so every device gets a slot eventually.
+     *
+     * Every device has a connection profile: the active parameters are requested while its commands are delivered,
+     * the idle parameters while the connection is parked listening for notifications.
+     *
+     * The health of every link is tracked. Failed attempts and lost connections are retried after a jittered
+     * exponential backoff, a device whose parked connection was lost is reconnected even without pending commands.
+     * Devices with a poor health score are served after the healthy ones, so a misbehaving device cannot hold on to the slots.
+     */
+    class connection_manager
+    {
+    public:
+
+        using message_handler_t = std::function<void(const utils::mac&, std::string_view payload)>;
+
+        static constexpr std::size_t MAX_PENDING_COMMANDS{ 8 };    // Per device, further commands are rejected until it is served.
+
+        struct profile_t
+        {
+            ble::connection_params  active;     // While commands are delivered.
+            ble::connection_params  idle;       // While parked.
+        };
+
+        /**
+         * @brief Connection state of a device, for diagnostics.
+         */
+        struct link_t
+        {
+            utils::mac                              address;
+            bool                                    connected;
+            bool                                    idle;       // Parked, as opposed to delivering commands.
+            ble::connection_params                  params;     // As reported by the controller, all zero if not known.
+            link_health                             health;
+            uint32_t                                retry_in;   // Milliseconds until the next attempt is allowed, zero if not backing off.
+            ble::operation_timing::snapshot_type    timing;     // GATT operation latency since the device was added.
+        };
+
+        struct config_t
+        {
+            uint8_t             slot_count{ static_cast<uint8_t>(ble::MAX_CLIENTS) };   // Concurrent connections, at most ble::MAX_CLIENTS.
+            timing::duration_t  park_time{ timing::seconds(10) };                       // Time a connection stays open after the last command.
+            timing::duration_t  poll_period{ timing::seconds(300) };                    // Devices without commands are visited this often, zero visits them only for commands.
+            timing::duration_t  backoff_base{ timing::seconds(1) };                     // Delay after the first failed attempt, doubled with every further failure.
+            timing::duration_t  backoff_max{ timing::seconds(300) };                    // Longest delay between attempts.
+        };
+
+        /**
+         * @brief Start the slot tasks. Slots stay idle until devices are added.
+         *
+         * @param config Scheduling configuration.
+         * @param message_handler Receives the serialized messages published by the devices, called from the Bluedroid task.
+         * The payload is only valid during the call.
+         */
+        connection_manager(const config_t& config, message_handler_t message_handler);
+
+        connection_manager(const connection_manager&)               = delete;
+
+        connection_manager& operator=(const connection_manager&)    = delete;
+
+        /**
+         * @brief Stop the slot tasks, waiting for the connections in use to be closed.
+         */
+        ~connection_manager();
+
+        /**
+         * @brief Add a device to the inventory.
+         *
+         * @param address Device address.
+         * @param address_type Type of the device address, used to open its connections.
+         * @param device Device driver, owned by the manager from now on.
+         * @param profile Connection parameters requested from the device.
+         * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_STATE if the address is already in the inventory.
+         */
+        esp_err_t add_device(const utils::mac& address, esp_ble_addr_type_t address_type, std::shared_ptr<device_base> device, const profile_t& profile);
+
+        /**
+         * @brief Replace the connection profile of the device. A connected device is switched right away.
+         *
+         * @return esp_err_t ESP_OK on success, ESP_ERR_NOT_FOUND for an unknown device, ESP_ERR_INVALID_ARG for parameters out of range.
+         */
+        esp_err_t set_profile(const utils::mac& address, const profile_t& profile);
+
+        /**
+         * @brief Connection state of every device in the inventory.
+         */
+        std::vector<link_t> get_links() const;
+
+        /**
+         * @brief Queue a command for the device, delivered on its next connection or right away to a parked one.
+         * Commands the device coalesces with the last queued one replace it and do not count against the queue.
+         *
+         * @param address Device address.
+         * @param command Command passed to device_base::process_message.
+         * @return esp_err_t ESP_OK on success, ESP_ERR_NOT_FOUND for an unknown device, ESP_ERR_NO_MEM if its queue is full.
+         */
+        esp_err_t submit(const utils::mac& address, device_base::in_message_t&& command);
+
+    private:
+
+        static constexpr const char* TAG{ "hub::device::connection_manager" };
+
+        static constexpr std::size_t    INVALID_INDEX{ static_cast<std::size_t>(-1) };
+        static constexpr uint32_t       SLOT_TASK_STACK_SIZE{ 8192 };
+        static constexpr UBaseType_t    SLOT_TASK_PRIORITY{ 4 };
+        static constexpr uint8_t        MAX_CONNECT_ATTEMPTS{ 3 };  // Pending commands of an unreachable device are dropped after this many failures.
+
+        enum class outcome : uint8_t
+        {
+            failed,     // No connection.
+            lost,       // Connected, then lost the connection.
+            closed      // Connected and disconnected as planned.
+        };
+
+        // One wake bit and one stopped bit per slot.
+        static constexpr EventBits_t    STOP_BIT{ BIT8 };
+        static constexpr uint8_t        STOPPED_SHIFT{ 9 };
+
+        static_assert(ble::MAX_CLIENTS <= 8, "Every slot needs an event group bit.");
+
+        struct entry
+        {
+            utils::mac                                  address;
+            esp_ble_addr_type_t                         address_type;
+            std::shared_ptr<device_base>                device;
+            std::deque<device_base::in_message_t>       commands;
+            TickType_t                                  command_time;   // Arrival of the oldest pending command.
+            TickType_t                                  served_time;    // Last disconnect.
+            bool                                        served;         // Connected at least once.
+            bool                                        active;         // Currently holding a slot.
+            bool                                        reconnect;      // Parked connection was lost, to be connected again.
+            profile_t                                   profile;
+            bool                                        connected;
+            bool                                        idle;
+            ble::connection_params                      params;         // Last reported by the controller.
+            link_health                                 health;
+            TickType_t                                  retry_time;     // No attempt before, if the health reports failures.
+        };
+
+        struct slot_context
+        {
+            connection_manager*                         manager;
+            uint8_t                                     index;
+        };
+
+        static void slot_task(void* arg);
+
+        static constexpr EventBits_t to_bit(uint8_t slot) noexcept
+        {
+            return static_cast<EventBits_t>(1) << slot;
+        }
+
+        /**
+         * @brief Pick the next device to serve. Requires the lock.
+         *
+         * @param now Current tick count.
+         * @param wait Set to the time until the next poll is due, if no device is ready.
+         * @return std::size_t Inventory index, INVALID_INDEX if no device is ready.
+         */
+        std::size_t select(TickType_t now, TickType_t& wait) const noexcept;
+
+        /**
+         * @brief Check if a device with pending commands waits for a slot while none is idle. Requires the lock.
+         */
+        bool is_slot_wanted(TickType_t now) const noexcept;
+
+        /**
+         * @brief Check if the device is backing off after a failure. Requires the lock.
+         *
+         * @param remaining Set to the time left until the next attempt.
+         */
+        static bool is_backing_off(const entry& device, TickType_t now, TickType_t& remaining) noexcept;
+
+        /**
+         * @brief Connect to the device, deliver its commands and keep the connection parked until it should be given up
+         * or the connection is lost. Records the attempt in the device health.
+         */
+        outcome serve(uint8_t slot, std::size_t index);
+
+        /**
+         * @brief Update the schedule of the device after it was served. Requires the lock.
+         */
+        void reschedule(entry& device, outcome result, TickType_t now) noexcept;
+
+        std::optional<device_base::in_message_t> pop_command(std::size_t index);
+
+        /**
+         * @brief Request the active or idle parameters of the device profile, unless they are already applied.
+         *
+         * @param applied Parameters requested last on this connection, updated.
+         */
+        void apply_profile(std::size_t index, device_base& device, bool idle, ble::connection_params& applied);
+
+        /**
+         * @brief Wake every idle or parked slot to reconsider the schedule.
+         */
+        void notify_slots() noexcept;
+
+        /**
+         * @brief Slot task loop, serves devices until the manager is stopped.
+         */
+        void run(uint8_t slot);
+
+        /**
+         * @brief Stop the slot tasks and wait for them to exit.
+         */
+        void stop() noexcept;
+
+        const config_t                      m_config;
+        const message_handler_t             m_message_handler;
+        mutable std::mutex                  m_mutex;
+        std::vector<entry>                  m_devices;
+        uint8_t                             m_idle_slots;
+        std::vector<slot_context>           m_slots;
+        EventGroupHandle_t                  m_event_group;
+    };
+}
+
+#endif
\ No newline at end of file
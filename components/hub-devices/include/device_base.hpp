@@ -3,6 +3,8 @@
 
 #include <functional>
 #include <memory>
+#include <string>
+#include <string_view>
 
 #include "esp_log.h"
 
@@ -18,7 +20,7 @@ namespace hub::device
 
         using in_message_t      = rapidjson::Document;
         using out_message_t     = rapidjson::Document;
-        using message_handler_t = std::function<void(out_message_t&&)>;
+        using message_handler_t = std::function<void(std::string_view payload)>;
 
         device_base() :
             m_message_handler{  }
@@ -32,11 +34,22 @@ namespace hub::device
             m_message_handler = message_handler;
         }
 
-        virtual void connect(utils::mac address)        = 0;
+        virtual void connect(utils::mac address, esp_ble_addr_type_t address_type)  = 0;
 
-        virtual void disconnect()                       = 0;
+        virtual void disconnect()                                                   = 0;
 
-        virtual void process_message(in_message_t&&)    = 0;
+        virtual void process_message(in_message_t&&)                                = 0;
+
+        /**
+         * @brief Fold a command into the last one still waiting for delivery, for settings where only the latest value
+         * matters. Called by the connection manager with its lock held, must not block.
+         *
+         * @return true The command was merged into the queued one and is not delivered on its own.
+         */
+        virtual bool coalesce(in_message_t&, const in_message_t&) const
+        {
+            return false;
+        }
 
         virtual ~device_base()
         {
@@ -50,7 +63,31 @@ namespace hub::device
             return get_shared_client();
         }
 
+        /**
+         * @brief Serialize and publish a message. Messages of all devices share the topic, the address of the device
+         * is added to objects to tell them apart.
+         */
         void invoke_message_handler(out_message_t&& message) const
+        {
+            if (message.IsObject())
+            {
+                const std::string address(get_address());
+                auto& allocator = message.GetAllocator();
+                message.AddMember("address", rjs::Value(address.c_str(), static_cast<rjs::SizeType>(address.length()), allocator), allocator);
+            }
+
+            rjs::StringBuffer buffer;
+            rjs::Writer<rjs::StringBuffer> writer(buffer);
+            message.Accept(writer);
+
+            invoke_message_handler(std::string_view(buffer.GetString(), buffer.GetSize()));
+        }
+
+        /**
+         * @brief Publish a serialized message as it is, it has to carry the address of the device itself.
+         * The payload is only valid during the call.
+         */
+        void invoke_message_handler(std::string_view payload) const
         {
             if (!m_message_handler)
             {
@@ -58,7 +95,7 @@ namespace hub::device
                 return;
             }
 
-            std::invoke(m_message_handler, std::move(message));
+            std::invoke(m_message_handler, payload);
         }
 
     private:
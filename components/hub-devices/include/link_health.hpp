@@ -0,0 +1,193 @@
+#ifndef HUB_DEVICE_LINK_HEALTH_HPP
+#define HUB_DEVICE_LINK_HEALTH_HPP
+
+#include <cstdint>
+#include <algorithm>
+
+namespace hub::device
+{
+    /**
+     * @brief Connection health of a device, used by the connection manager to pace reconnections and to rank
+     * devices competing for a slot.
+     *
+     * Connection attempts and lost connections are averaged with a weight of 1/4 for the latest sample,
+     * so a device recovers from a bad spell within a few good connections. Not thread-safe.
+     */
+    class link_health
+    {
+    public:
+
+        static constexpr uint8_t    MAX_SCORE{ 100 };
+        static constexpr uint8_t    FLAKY_SCORE{ 50 };          // Devices scoring below are served after the others.
+        static constexpr int8_t     RSSI_UNKNOWN{ 127 };        // As reported by the controller when no value is available.
+        static constexpr int8_t     WEAK_RSSI{ -75 };           // Every dBm below costs a point.
+        static constexpr uint32_t   SLOW_CONNECT_MS{ 1000 };    // Every 100 ms above costs a point, up to MAX_LATENCY_PENALTY.
+        static constexpr uint8_t    MAX_LATENCY_PENALTY{ 20 };
+
+        constexpr link_health() noexcept :
+            m_success_rate{ 1000 },
+            m_connect_time{ 0 },
+            m_rssi{ RSSI_UNKNOWN },
+            m_failures{ 0 },
+            m_attempts{ 0 },
+            m_drops{ 0 }
+        {
+
+        }
+
+        /**
+         * @brief Record a connection attempt.
+         *
+         * @param success The connection was established and the device driver set it up.
+         * @param duration_ms Time taken by the attempt, only averaged for successful ones.
+         */
+        constexpr void record_connect(bool success, uint32_t duration_ms) noexcept
+        {
+            m_attempts++;
+            average(success);
+
+            if (success)
+            {
+                m_connect_time = (m_connect_time == 0) ? duration_ms : m_connect_time - m_connect_time / 4 + duration_ms / 4;
+            }
+            else
+            {
+                m_failures++;
+            }
+        }
+
+        /**
+         * @brief Record a connection lost before it was closed, counted as a failure.
+         */
+        constexpr void record_drop() noexcept
+        {
+            m_drops++;
+            m_failures++;
+            average(false);
+        }
+
+        /**
+         * @brief Record a connection closed as planned, ending the sequence of consecutive failures.
+         */
+        constexpr void record_close() noexcept
+        {
+            m_failures = 0;
+        }
+
+        constexpr void record_rssi(int8_t rssi) noexcept
+        {
+            m_rssi = rssi;
+        }
+
+        /**
+         * @brief Health from 0 to MAX_SCORE: the success rate in percent, less penalties for a weak signal and slow connections.
+         */
+        constexpr uint8_t score() const noexcept
+        {
+            int32_t score = m_success_rate / 10;
+
+            if (m_rssi != RSSI_UNKNOWN && m_rssi < WEAK_RSSI)
+            {
+                score -= WEAK_RSSI - m_rssi;
+            }
+
+            if (m_connect_time > SLOW_CONNECT_MS)
+            {
+                score -= static_cast<int32_t>(std::min<uint32_t>((m_connect_time - SLOW_CONNECT_MS) / 100, MAX_LATENCY_PENALTY));
+            }
+
+            return static_cast<uint8_t>(std::clamp<int32_t>(score, 0, MAX_SCORE));
+        }
+
+        constexpr bool is_flaky() const noexcept
+        {
+            return score() < FLAKY_SCORE;
+        }
+
+        /**
+         * @brief Moving average of successful connections and connections kept until closed, in permille.
+         */
+        constexpr uint16_t get_success_rate() const noexcept
+        {
+            return m_success_rate;
+        }
+
+        /**
+         * @brief Moving average of the time taken to connect, zero until the first connection.
+         */
+        constexpr uint32_t get_connect_time() const noexcept
+        {
+            return m_connect_time;
+        }
+
+        /**
+         * @brief Signal strength read on the last connection, RSSI_UNKNOWN if never read.
+         */
+        constexpr int8_t get_rssi() const noexcept
+        {
+            return m_rssi;
+        }
+
+        /**
+         * @brief Failed attempts and lost connections since the last connection closed as planned.
+         */
+        constexpr uint16_t get_failures() const noexcept
+        {
+            return m_failures;
+        }
+
+        constexpr uint32_t get_attempts() const noexcept
+        {
+            return m_attempts;
+        }
+
+        constexpr uint32_t get_drops() const noexcept
+        {
+            return m_drops;
+        }
+
+        /**
+         * @brief Delay before the next attempt: base doubled with every consecutive failure up to max, then drawn
+         * from its upper half, so devices failing together do not retry in lockstep.
+         *
+         * @param base Delay after the first failure.
+         * @param max Longest delay.
+         * @param random Uniformly distributed random number.
+         * @return uint32_t Zero without failures.
+         */
+        constexpr uint32_t backoff(uint32_t base, uint32_t max, uint32_t random) const noexcept
+        {
+            if (m_failures == 0 || base == 0)
+            {
+                return 0;
+            }
+
+            uint32_t delay = std::min(base, max);
+
+            for (uint16_t i = 1; i < m_failures && delay < max; i++)
+            {
+                delay = (delay > max / 2) ? max : delay * 2;
+            }
+
+            const uint32_t half = delay / 2;
+            return delay - half + random % (half + 1);
+        }
+
+    private:
+
+        constexpr void average(bool success) noexcept
+        {
+            const uint16_t sample = success ? 1000 : 0;
+            m_success_rate = static_cast<uint16_t>(m_success_rate - m_success_rate / 4 + sample / 4);
+        }
+
+        uint16_t    m_success_rate;     // Permille.
+        uint32_t    m_connect_time;     // Milliseconds.
+        int8_t      m_rssi;
+        uint16_t    m_failures;
+        uint32_t    m_attempts;
+        uint32_t    m_drops;
+    };
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,143 @@
+#ifndef HUB_DEVICE_PASSIVE_HPP
+#define HUB_DEVICE_PASSIVE_HPP
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace hub::device::passive
+{
+    /**
+     * @brief Physical quantities reported by connectionless sensors.
+     * 
+     */
+    enum class quantity : uint8_t
+    {
+        temperature,    // °C
+        humidity,       // %
+        battery,        // %
+        voltage,        // V
+        pressure,       // hPa
+        illuminance,    // lx
+        moisture,       // %
+        conductivity,   // µS/cm
+        power,          // 0 - off, 1 - on
+        packet_id
+    };
+
+    inline constexpr std::string_view to_string(quantity type) noexcept
+    {
+        switch (type)
+        {
+        case quantity::temperature:     return "temperature";
+        case quantity::humidity:        return "humidity";
+        case quantity::battery:         return "battery";
+        case quantity::voltage:         return "voltage";
+        case quantity::pressure:        return "pressure";
+        case quantity::illuminance:     return "illuminance";
+        case quantity::moisture:        return "moisture";
+        case quantity::conductivity:    return "conductivity";
+        case quantity::power:           return "power";
+        case quantity::packet_id:       return "packet_id";
+        default:                        return "unknown";
+        }
+    }
+
+    struct measurement
+    {
+        quantity    type;
+        double      value;
+    };
+
+    /**
+     * @brief Measurements decoded from a single advertisement. Fixed size, no heap allocation.
+     * 
+     */
+    struct reading
+    {
+        static constexpr std::size_t MAX_MEASUREMENTS{ 8 };
+
+        std::array<measurement, MAX_MEASUREMENTS>   measurements;
+        uint8_t                                     count;
+
+        bool add(quantity type, double value) noexcept
+        {
+            if (count == MAX_MEASUREMENTS)
+            {
+                return false;
+            }
+
+            measurements[count++] = measurement{ type, value };
+            return true;
+        }
+
+        const measurement* begin() const noexcept
+        {
+            return measurements.data();
+        }
+
+        const measurement* end() const noexcept
+        {
+            return measurements.data() + count;
+        }
+    };
+
+    /**
+     * @brief Part of the advertisement a decoder is matched against.
+     * 
+     */
+    enum class data_source : uint8_t
+    {
+        service_data,       // Matched by 16-bit service UUID.
+        manufacturer_data   // Matched by company identifier.
+    };
+
+    struct decoder_key
+    {
+        data_source source;
+        uint16_t    id;
+
+        constexpr bool operator==(const decoder_key& other) const noexcept
+        {
+            return source == other.source && id == other.id;
+        }
+    };
+
+    /**
+     * @brief Decode the payload following the service UUID or company identifier.
+     * 
+     * @return true Payload recognized and at least one measurement added.
+     * @return false Unsupported format, encrypted or malformed payload.
+     */
+    using decoder_function_type = bool(*)(const uint8_t* data, std::size_t length, reading& result);
+
+    namespace impl
+    {
+        inline constexpr uint16_t read_uint16_le(const uint8_t* data) noexcept
+        {
+            return static_cast<uint16_t>(data[0] | (data[1] << 8));
+        }
+
+        inline constexpr int16_t read_int16_le(const uint8_t* data) noexcept
+        {
+            return static_cast<int16_t>(read_uint16_le(data));
+        }
+
+        inline constexpr uint16_t read_uint16_be(const uint8_t* data) noexcept
+        {
+            return static_cast<uint16_t>((data[0] << 8) | data[1]);
+        }
+
+        inline constexpr int16_t read_int16_be(const uint8_t* data) noexcept
+        {
+            return static_cast<int16_t>(read_uint16_be(data));
+        }
+
+        inline constexpr uint32_t read_uint24_le(const uint8_t* data) noexcept
+        {
+            return static_cast<uint32_t>(data[0] | (data[1] << 8) | (data[2] << 16));
+        }
+    }
+}
+
+#endif
\ No newline at end of file
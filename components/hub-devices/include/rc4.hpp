@@ -0,0 +1,93 @@
+#ifndef HUB_DEVICE_RC4_HPP
+#define HUB_DEVICE_RC4_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace hub::device::rc4
+{
+    /**
+     * @brief RC4 key stream, as used by the Xiaomi authentication. Usable in constant expressions, so streams for
+     * constant keys and messages encrypted with them are computed at compile time.
+     */
+    class stream
+    {
+    public:
+
+        static constexpr std::size_t PERM_LENGTH{ 256 };
+
+        /**
+         * @brief Run the key schedule.
+         *
+         * @param key Key of at least one byte, indexable and with a size().
+         */
+        template<typename KeyT>
+        constexpr explicit stream(const KeyT& key) noexcept :
+            m_perm{  },
+            m_index1{ 0 },
+            m_index2{ 0 }
+        {
+            for (std::size_t i = 0; i < PERM_LENGTH; i++)
+            {
+                m_perm[i] = static_cast<uint8_t>(i);
+            }
+
+            uint8_t j = 0;
+
+            for (std::size_t i = 0; i < PERM_LENGTH; i++)
+            {
+                j += m_perm[i] + static_cast<uint8_t>(key[i % key.size()]);
+                swap(i, j);
+            }
+        }
+
+        /**
+         * @brief Encrypt or decrypt the next length bytes of the stream. Input and output may be the same buffer.
+         */
+        constexpr void apply(const uint8_t* input, uint8_t* output, std::size_t length) noexcept
+        {
+            for (std::size_t i = 0; i < length; i++)
+            {
+                m_index1++;
+                m_index2 += m_perm[m_index1];
+                swap(m_index1, m_index2);
+
+                output[i] = input[i] ^ m_perm[static_cast<uint8_t>(m_perm[m_index1] + m_perm[m_index2])];
+            }
+        }
+
+        template<std::size_t Size>
+        constexpr void apply(const std::array<uint8_t, Size>& input, std::array<uint8_t, Size>& output) noexcept
+        {
+            apply(input.data(), output.data(), Size);
+        }
+
+        /**
+         * @brief Encrypt input with a copy of the stream, for streams kept as precomputed key schedules.
+         */
+        template<std::size_t Size>
+        static constexpr std::array<uint8_t, Size> encrypt(stream key_stream, const std::array<uint8_t, Size>& input) noexcept
+        {
+            std::array<uint8_t, Size> output{  };
+            key_stream.apply(input, output);
+            return output;
+        }
+
+    private:
+
+        constexpr void swap(std::size_t first, std::size_t second) noexcept
+        {
+            const uint8_t value = m_perm[first];
+
+            m_perm[first]   = m_perm[second];
+            m_perm[second]  = value;
+        }
+
+        std::array<uint8_t, PERM_LENGTH>    m_perm;
+        uint8_t                             m_index1;   // Wraps like the 8 bit indices of the cipher.
+        uint8_t                             m_index2;
+    };
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef HUB_DEVICE_XIAOMI_MIBEACON_HPP
+#define HUB_DEVICE_XIAOMI_MIBEACON_HPP
+
+#include <cstdint>
+#include <string_view>
+
+#include "passive.hpp"
+
+namespace hub::device::xiaomi
+{
+    /**
+     * @brief Decoder of unencrypted MiBeacon (0xFE95) service data broadcast by Xiaomi sensors and kettles.
+     * 
+     */
+    struct mibeacon
+    {
+        static constexpr std::string_view       DECODER_NAME{ "MiBeacon" };
+        static constexpr passive::decoder_key   DECODER_KEY{ passive::data_source::service_data, 0xfe95 };
+
+        static bool decode(const uint8_t* data, std::size_t length, passive::reading& result) noexcept;
+
+    private:
+
+        static constexpr uint16_t FRAME_ENCRYPTED           { 1 << 3 };
+        static constexpr uint16_t FRAME_MAC_INCLUDED        { 1 << 4 };
+        static constexpr uint16_t FRAME_CAPABILITY_INCLUDED { 1 << 5 };
+        static constexpr uint16_t FRAME_OBJECT_INCLUDED     { 1 << 6 };
+
+        static constexpr uint8_t  CAPABILITY_IO             { 1 << 5 };
+
+        static constexpr uint16_t OBJECT_TEMPERATURE        { 0x1004 };
+        static constexpr uint16_t OBJECT_KETTLE             { 0x1005 };
+        static constexpr uint16_t OBJECT_HUMIDITY           { 0x1006 };
+        static constexpr uint16_t OBJECT_ILLUMINANCE        { 0x1007 };
+        static constexpr uint16_t OBJECT_MOISTURE           { 0x1008 };
+        static constexpr uint16_t OBJECT_CONDUCTIVITY       { 0x1009 };
+        static constexpr uint16_t OBJECT_BATTERY            { 0x100a };
+        static constexpr uint16_t OBJECT_TEMPERATURE_HUMIDITY { 0x100d };
+    };
+}
+
+#endif
\ No newline at end of file
@@ -2,17 +2,23 @@
 #define HUB_DEVICE_XIAOMI_MIKETTLE_HPP
 
 #include "device_base.hpp"
+#include "rc4.hpp"
+
+#include "tl/expected.hpp"
 
 #include "utils/json.hpp"
+#include "utils/json_writer.hpp"
 #include "ble/client.hpp"
+#include "ble/coroutine.hpp"
+#include "timing/timing.hpp"
 #include "utils/mac.hpp"
 
 #include <memory>
+#include <mutex>
 #include <string_view>
 #include <array>
-#include <algorithm>
+#include <optional>
 #include <vector>
-#include <numeric>
 
 namespace hub::device::xiaomi
 {
@@ -22,11 +28,128 @@ namespace hub::device::xiaomi
 
         static constexpr std::string_view DEVICE_NAME{ "MiKettle" };
 
-        void connect(utils::mac address)                override;
+        /**
+         * @brief State reported by the status characteristic, decoded in place from the notification.
+         */
+        struct status
+        {
+            static constexpr std::size_t PAYLOAD_SIZE{ 9 };     // Bytes decoded, the kettle may send more.
+            static constexpr std::size_t MESSAGE_SIZE{ 192 };   // Longest serialized message.
+
+            uint8_t     action;
+            uint8_t     mode;
+            uint8_t     set_temperature;        // °C
+            uint8_t     current_temperature;    // °C
+            uint8_t     keep_warm_type;
+            uint16_t    keep_warm_time;
+
+            /**
+             * @brief Decode a status notification.
+             *
+             * @return tl::expected<status, esp_err_t> ESP_ERR_INVALID_SIZE if the payload is shorter than PAYLOAD_SIZE.
+             */
+            static tl::expected<status, esp_err_t> decode(const uint8_t* data, std::size_t length) noexcept
+            {
+                if (length < PAYLOAD_SIZE)
+                {
+                    return tl::make_unexpected(ESP_ERR_INVALID_SIZE);
+                }
+
+                return status{ data[0], data[1], data[4], data[5], data[6], static_cast<uint16_t>((data[7] << 8) | data[8]) };
+            }
+
+            /**
+             * @brief Write the status message published for the kettle.
+             *
+             * @param writer Writer with room for MESSAGE_SIZE bytes.
+             * @param address Address of the kettle, as formatted by utils::mac.
+             */
+            template<std::size_t Capacity>
+            void write(utils::json::fixed_writer<Capacity>& writer, std::string_view address) const noexcept
+            {
+                static_assert(Capacity >= MESSAGE_SIZE, "Writer too small for the status message.");
+
+                writer.start_object();
+                writer.key("action");
+                writer.number(uint32_t{ action });
+                writer.key("mode");
+                writer.number(uint32_t{ mode });
+
+                writer.key("temperature");
+                writer.start_object();
+                writer.key("set");
+                writer.number(uint32_t{ set_temperature });
+                writer.key("current");
+                writer.number(uint32_t{ current_temperature });
+                writer.end_object();
+
+                writer.key("keep_warm");
+                writer.start_object();
+                writer.key("type");
+                writer.number(uint32_t{ keep_warm_type });
+                writer.key("time");
+                writer.number(uint32_t{ keep_warm_time });
+                writer.end_object();
+
+                writer.key("address");
+                writer.string(address);
+                writer.end_object();
+            }
+        };
+
+        /**
+         * @brief Settings changed by a command, the ones not given are left as they are.
+         *
+         * e.g. {"keep_warm": {"type": 1, "temperature": 70, "limit": 6.5}, "turn_off_after_boil": true}
+         */
+        struct command
+        {
+            static constexpr uint8_t MIN_TEMPERATURE{ 40 };     // °C
+            static constexpr uint8_t MAX_TEMPERATURE{ 90 };     // °C
+            static constexpr uint8_t MAX_KEEP_WARM_TYPE{ 1 };   // 0 boils and cools down to the temperature, 1 heats up to it.
+            static constexpr uint8_t MAX_LIMIT{ 24 };           // Half hours.
+
+            std::optional<uint8_t>  keep_warm_type;
+            std::optional<uint8_t>  keep_warm_temperature;
+            std::optional<uint8_t>  keep_warm_limit;            // Half hours.
+            std::optional<bool>     turn_off_after_boil;
+
+            /**
+             * @brief Parse a command message.
+             *
+             * @return tl::expected<command, esp_err_t> ESP_ERR_INVALID_ARG for values of the wrong type or out of range,
+             * ESP_ERR_NOT_FOUND if the message sets nothing.
+             */
+            static tl::expected<command, esp_err_t> parse(const rjs::Value& message) noexcept;
+
+            /**
+             * @brief Take over the settings given by a later command.
+             */
+            void merge(const command& later) noexcept;
+
+            /**
+             * @brief Command message carrying the settings, as understood by parse.
+             */
+            in_message_t to_message() const;
+        };
+
+        void connect(utils::mac address, esp_ble_addr_type_t address_type)  override;
+
+#if defined(HUB_BLE_COROUTINES)
+        /**
+         * @brief Connect and authenticate as connect(), awaiting the requests and the authentication reply
+         * on a ble::coro::executor instead of blocking the calling task.
+         *
+         * @throws std::runtime_error to the awaiting coroutine if the kettle could not be connected or authenticated.
+         */
+        ble::coro::task<void> connect_async(utils::mac address, esp_ble_addr_type_t address_type);
+#endif
 
-        void disconnect()                               override;
+        void disconnect()                                                   override;
 
-        void process_message(in_message_t&& message)    override;
+        void process_message(in_message_t&& message)                        override;
+
+        bool coalesce(in_message_t& queued, const in_message_t& message) const override;
 
     private:
 
@@ -34,15 +157,65 @@ namespace hub::device::xiaomi
 
         static constexpr uint8_t    KEY_LENGTH                      { 4 };
         static constexpr uint8_t    TOKEN_LENGTH                    { 12 };
-        static constexpr uint16_t   PERM_LENGTH                     { 256 };
 
         static constexpr uint16_t   PRODUCT_ID                      { 275 };
 
+        static constexpr timing::duration_t AUTH_TIMEOUT            { timing::seconds(5) };
+
         static constexpr std::array<uint8_t, KEY_LENGTH> key1       { 0x90, 0xCA, 0x85, 0xDE };
         static constexpr std::array<uint8_t, KEY_LENGTH> key2       { 0x92, 0xAB, 0x54, 0xFA };
         static constexpr std::array<uint8_t, TOKEN_LENGTH> token    { 0x91, 0xf5, 0x80, 0x93, 0x24, 0x49, 0xb4, 0x0d, 0x6b, 0x06, 0xd2, 0x8a };
         static constexpr std::array<uint8_t, 2> subscribe           { 0x01, 0x00 };
 
+        // Key schedule of the token and the confirmation encrypted with it, neither depends on the kettle.
+        static constexpr rc4::stream TOKEN_STREAM                   { token };
+        static constexpr std::array<uint8_t, KEY_LENGTH> AUTH_CONFIRMATION{ rc4::stream::encrypt(TOKEN_STREAM, key2) };
+
+        std::array<char, utils::mac::MAC_STR_SIZE> m_address_str{  };  // Formatted once per connection for the status messages.
+
+        /**
+         * @brief Authentication messages derived from the kettle address, kept across connections.
+         */
+        struct auth_session
+        {
+            utils::mac                          address;
+            std::array<uint8_t, TOKEN_LENGTH>   request;    // Token encrypted with the first key derived from the address.
+            std::array<uint8_t, TOKEN_LENGTH>   response;   // Reply of the kettle, the request encrypted with the second one.
+        };
+
+        /**
+         * @brief Authentication reply notified by the kettle.
+         */
+        struct auth_reply
+        {
+            std::mutex              mutex;
+            std::vector<uint8_t>    value;
+        };
+
+        /**
+         * @brief Attributes used by the handshake, resolved before authenticating.
+         */
+        struct handshake_attributes
+        {
+            ble::characteristic auth_init;
+            ble::characteristic auth;
+            ble::characteristic version;
+            ble::descriptor     auth_descriptor;
+            ble::characteristic status;
+            ble::descriptor     status_descriptor;
+        };
+
+        std::optional<auth_session>             m_auth{  };
+
+        // Setting characteristics, found on connection.
+        std::optional<ble::characteristic>      m_setup_characteristic{  };
+        std::optional<ble::characteristic>      m_time_characteristic{  };
+        std::optional<ble::characteristic>      m_boil_mode_characteristic{  };
+
+        // Last reported status, completing keep warm settings given in part.
+        std::mutex                              m_status_mutex{  };
+        std::optional<status>                   m_status{  };
+
         /* MiKettle services */
         static constexpr esp_bt_uuid_t GATT_UUID_KETTLE_SRV         { ESP_UUID_LEN_16, { 0xfe95 } };
         static constexpr esp_bt_uuid_t GATT_UUID_KETTLE_DATA_SRV{ 
@@ -61,73 +234,79 @@ namespace hub::device::xiaomi
         static constexpr esp_bt_uuid_t GATT_UUID_MCU_VERSION    { ESP_UUID_LEN_16, { 0x2a28 } };
         static constexpr esp_bt_uuid_t GATT_UUID_CCCD           { ESP_UUID_LEN_16, { 0x2902 } };
 
-        template<typename InputT, typename KeyT>
-        static std::vector<uint8_t> cipher(const KeyT& key, const InputT& input)
-        {
-            std::vector<uint8_t> result;
-            std::array<uint8_t, PERM_LENGTH> perm;
+        /**
+         * @brief Wait for requests queued back to back, Bluedroid issues them in order and only the results are awaited.
+         *
+         * @throws std::runtime_error with the error message on the first request that failed.
+         */
+        template<typename TokensT>
+        static void wait_all(TokensT& tokens, const char* step, const char* error);
 
-            uint16_t index1 = 0;
-            uint16_t index2 = 0;
-            uint16_t index3 = 0;
+#if defined(HUB_BLE_COROUTINES)
+        /**
+         * @brief Await requests queued back to back, as wait_all.
+         */
+        template<std::size_t Count>
+        static ble::coro::task<void> await_all(std::array<ble::completion_token, Count>& tokens, const char* step, const char* error);
+#endif
 
-            std::iota(perm.begin(), perm.end(), 0);
+        /**
+         * @brief Find the handshake attributes and the setting characteristics.
+         */
+        handshake_attributes resolve_attributes(const ble::service& kettle_service, const ble::service& kettle_data_service);
 
-            uint16_t j = 0;
-            for (uint16_t i = 0; i < perm.size(); i++)
-            {
-                j += perm[i] + key[i % key.size()];
-                j &= 0xff;
-                std::swap(perm[i], perm[j]);
-            }
+        /**
+         * @brief Queue the authentication request, the reply is notified to on_auth.
+         */
+        static std::array<ble::completion_token, 4> request_authentication(
+            handshake_attributes& attributes, const auth_session& auth, ble::notify_handler on_auth);
 
-            for (uint16_t i = 0; i < input.size(); i++)
-            {
-                ++index1;
-                index1 &= 0xff;
-                index2 += perm[index1];
-                index2 &= 0xff;
-                std::swap(perm[index1], perm[index2]);
-                index3 = perm[index1] + perm[index2];
-                index3 &= 0xff;
-                result.push_back((input[i] ^ perm[index3]) & 0xff);
-            }
+        /**
+         * @brief Queue the confirmation and the status subscription. The kettle takes the confirmation only once its reply went out.
+         */
+        std::array<ble::completion_token, 5> confirm_authentication(handshake_attributes& attributes);
 
-            return result;
-        }
+        /**
+         * @brief Log replies other than the expected one, kettles replying otherwise are still served.
+         */
+        void check_auth_reply(const uint8_t* data, std::size_t size, const auth_session& auth) const noexcept;
+
+        /**
+         * @brief Publish a status notification.
+         */
+        void on_status(ble::value_view data);
+
+        /**
+         * @brief Authentication messages of the kettle, derived on the first connection and reused on reconnections.
+         */
+        auth_session& get_auth_session(const utils::mac& address) noexcept;
 
-        template<typename ContainerT>
-        static std::vector<uint8_t> mix_a(const ContainerT& data, const uint16_t product_id)
+        static constexpr std::array<uint8_t, 8> mix_a(const std::array<uint8_t, utils::mac::MAC_SIZE>& data, const uint16_t product_id) noexcept
         {
-            std::vector<uint8_t> result(8);
-
-            result[0] = data[0];
-            result[1] = data[2];
-            result[2] = data[5];
-            result[3] = product_id & 0xff;
-            result[4] = product_id & 0xff;
-            result[5] = data[4];
-            result[6] = data[5];
-            result[7] = data[1];
-
-            return result;
+            return {
+                data[0],
+                data[2],
+                data[5],
+                static_cast<uint8_t>(product_id & 0xff),
+                static_cast<uint8_t>(product_id & 0xff),
+                data[4],
+                data[5],
+                data[1]
+            };
         }
 
-        template<typename ContainerT>
-        static std::vector<uint8_t> mix_b(const ContainerT& data, const uint16_t product_id)
+        static constexpr std::array<uint8_t, 8> mix_b(const std::array<uint8_t, utils::mac::MAC_SIZE>& data, const uint16_t product_id) noexcept
         {
-            std::vector<uint8_t> result(8);
-
-            result[0] = data[0];
-            result[1] = data[2];
-            result[2] = data[5];
-            result[3] = (product_id >> 8) & 0xff;
-            result[4] = data[4];
-            result[5] = data[0];
-            result[6] = data[5];
-            result[7] = product_id & 0xff;
-
-            return result;
+            return {
+                data[0],
+                data[2],
+                data[5],
+                static_cast<uint8_t>((product_id >> 8) & 0xff),
+                data[4],
+                data[0],
+                data[5],
+                static_cast<uint8_t>(product_id & 0xff)
+            };
         }
     };
 }
@@ -0,0 +1,114 @@
+#include "xiaomi-mibeacon.hpp"
+
+namespace hub::device::xiaomi
+{
+    bool mibeacon::decode(const uint8_t* data, std::size_t length, passive::reading& result) noexcept
+    {
+        using namespace passive;
+        using namespace passive::impl;
+
+        // Frame control, product ID and frame counter.
+        std::size_t offset = 5;
+
+        if (length < offset)
+        {
+            return false;
+        }
+
+        const uint16_t frame_control = read_uint16_le(data);
+
+        if ((frame_control & FRAME_ENCRYPTED) || !(frame_control & FRAME_OBJECT_INCLUDED))
+        {
+            return false;
+        }
+
+        if (frame_control & FRAME_MAC_INCLUDED)
+        {
+            offset += 6;
+        }
+
+        if (frame_control & FRAME_CAPABILITY_INCLUDED)
+        {
+            if (offset >= length)
+            {
+                return false;
+            }
+
+            offset += (data[offset] & CAPABILITY_IO) ? 3 : 1;
+        }
+
+        const uint8_t initial_count = result.count;
+
+        while (offset + 3 <= length)
+        {
+            const uint16_t type         = read_uint16_le(data + offset);
+            const uint8_t object_length = data[offset + 2];
+            const uint8_t* object       = data + offset + 3;
+
+            if (offset + 3 + object_length > length)
+            {
+                break;
+            }
+
+            switch (type)
+            {
+            case OBJECT_TEMPERATURE:
+                if (object_length >= 2)
+                {
+                    result.add(quantity::temperature, read_int16_le(object) / 10.0);
+                }
+                break;
+            case OBJECT_KETTLE:
+                if (object_length >= 2)
+                {
+                    result.add(quantity::power, object[0] ? 1 : 0);
+                    result.add(quantity::temperature, object[1]);
+                }
+                break;
+            case OBJECT_HUMIDITY:
+                if (object_length >= 2)
+                {
+                    result.add(quantity::humidity, read_uint16_le(object) / 10.0);
+                }
+                break;
+            case OBJECT_ILLUMINANCE:
+                if (object_length >= 3)
+                {
+                    result.add(quantity::illuminance, read_uint24_le(object));
+                }
+                break;
+            case OBJECT_MOISTURE:
+                if (object_length >= 1)
+                {
+                    result.add(quantity::moisture, object[0]);
+                }
+                break;
+            case OBJECT_CONDUCTIVITY:
+                if (object_length >= 2)
+                {
+                    result.add(quantity::conductivity, read_uint16_le(object));
+                }
+                break;
+            case OBJECT_BATTERY:
+                if (object_length >= 1)
+                {
+                    result.add(quantity::battery, object[0]);
+                }
+                break;
+            case OBJECT_TEMPERATURE_HUMIDITY:
+                if (object_length >= 4)
+                {
+                    result.add(quantity::temperature, read_int16_le(object) / 10.0);
+                    result.add(quantity::humidity, read_uint16_le(object + 2) / 10.0);
+                }
+                break;
+            default:
+                break;
+            }
+
+            offset += 3 + object_length;
+        }
+
+        return result.count != initial_count;
+    }
+}
@@ -5,113 +5,249 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
 #include <type_traits>
+#include <vector>
 
 #include "esp_log.h"
 
 namespace hub::device::xiaomi
 {
-    void mikettle::connect(utils::mac address)
+    template<typename TokensT>
+    void mikettle::wait_all(TokensT& tokens, const char* step, const char* error)
     {
-        using namespace timing::literals;
+        for (auto& token : tokens)
+        {
+            if (auto result = token.wait(ble::BLE_TIMEOUT); !result)
+            {
+                ESP_LOGE(TAG, "%s failed with error code %i [%s].", step, result.error(), esp_err_to_name(result.error()));
+                throw std::runtime_error(error);
+            }
+        }
+    }
+
+#if defined(HUB_BLE_COROUTINES)
+    template<std::size_t Count>
+    ble::coro::task<void> mikettle::await_all(std::array<ble::completion_token, Count>& tokens, const char* step, const char* error)
+    {
+        for (auto& token : tokens)
+        {
+            if (auto result = co_await ble::coro::operation(std::move(token), ble::BLE_TIMEOUT); !result)
+            {
+                ESP_LOGE(TAG, "%s failed with error code %i [%s].", step, result.error(), esp_err_to_name(result.error()));
+                throw std::runtime_error(error);
+            }
+        }
+    }
+#endif
 
+    void mikettle::connect(utils::mac address, esp_ble_addr_type_t address_type)
+    {
         static constexpr EventBits_t AUTH_BIT{ BIT0 };
 
         auto client = get_client();
 
-        client->connect(address);
+        client->connect(address, address_type);
+
+        auto kettle_service         = client->get_service_by_uuid(&GATT_UUID_KETTLE_SRV).value();
+        auto kettle_data_service    = client->get_service_by_uuid(&GATT_UUID_KETTLE_DATA_SRV).value();
+        auto attributes             = resolve_attributes(kettle_service, kettle_data_service);
+
+        address.to_charbuff(m_address_str.begin());
 
-        auto kettle_service = client->get_service_by_uuid(&GATT_UUID_KETTLE_SRV).value();
+        static_assert(std::is_pointer_v<EventGroupHandle_t>, "EventGroupHandle_t is not a pointer.");
+        static_assert(std::is_same_v<EventGroupHandle_t, void*>, "EventGroupHandle_t is not a void pointer.");
+        std::shared_ptr<void> auth_event_group{ xEventGroupCreate(), &vEventGroupDelete };
+        auto reply = std::make_shared<auth_reply>();
+
+        const auto on_auth = [auth_event_group, reply](ble::value_view data) {
+            {
+                std::lock_guard lock{ reply->mutex };
+                reply->value.assign(data.begin(), data.end());
+            }
 
-        auto auth_characteristic = kettle_service.get_characteristic_by_uuid(&GATT_UUID_AUTH).value();
+            xEventGroupSetBits(auth_event_group.get(), AUTH_BIT);
+        };
 
-        kettle_service
-            .get_characteristic_by_uuid(&GATT_UUID_AUTH_INIT)
-            .value()
-            .write({ key1.cbegin(), key1.cend() });
-        
-        auth_characteristic
-            .get_descriptor_by_uuid(&GATT_UUID_CCCD)
-            .value()
-            .write({ subscribe.cbegin(), subscribe.cend() });
+        const auto& auth = get_auth_session(address);
 
         {
-            static_assert(std::is_pointer_v<EventGroupHandle_t>, "EventGroupHandle_t is not a pointer.");
-            static_assert(std::is_same_v<EventGroupHandle_t, void*>, "EventGroupHandle_t is not a void pointer.");
-            std::shared_ptr<void> auth_event_group{ xEventGroupCreate(), &vEventGroupDelete };
+            auto handshake = request_authentication(attributes, auth, on_auth);
 
-            auth_characteristic.subscribe([auth_event_group](const std::vector<uint8_t>& data) {
-                xEventGroupSetBits(auth_event_group.get(), AUTH_BIT);
-            });
+            wait_all(handshake, "Authentication request", "Could not authenticate.");
 
-            {
-                std::array<uint8_t, 6> reversed_mac;
-                std::reverse_copy(
-                    static_cast<const uint8_t*>(address), 
-                    static_cast<const uint8_t*>(address) + utils::mac::MAC_SIZE, 
-                    reversed_mac.begin());
+            EventBits_t bits = xEventGroupWaitBits(auth_event_group.get(), AUTH_BIT, pdTRUE, pdFALSE, static_cast<TickType_t>(AUTH_TIMEOUT));
 
-                auth_characteristic.write(cipher(mix_a(reversed_mac, PRODUCT_ID), token));
+            if (!(bits & AUTH_BIT))
+            {
+                throw std::runtime_error("Could not authenticate.");
             }
 
-            EventBits_t bits = xEventGroupWaitBits(auth_event_group.get(), AUTH_BIT, pdTRUE, pdFALSE, static_cast<TickType_t>(5_s));
+            // The reply is valid once the event group bit is set.
+            std::lock_guard lock{ reply->mutex };
+            check_auth_reply(reply->value.data(), reply->value.size(), auth);
+        }
 
-            if (!(bits & AUTH_BIT))
+        {
+            auto confirmation = confirm_authentication(attributes);
+
+            wait_all(confirmation, "Authentication confirmation", "Could not authenticate.");
+        }
+    }
+
+#if defined(HUB_BLE_COROUTINES)
+    ble::coro::task<void> mikettle::connect_async(utils::mac address, esp_ble_addr_type_t address_type)
+    {
+        auto client = get_client();
+
+        if (auto connected = co_await ble::coro::connect(client, address, address_type); !connected)
+        {
+            throw std::runtime_error("Could not connect.");
+        }
+
+        auto kettle_service         = (co_await ble::coro::get_service_by_uuid(client, GATT_UUID_KETTLE_SRV)).value();
+        auto kettle_data_service    = (co_await ble::coro::get_service_by_uuid(client, GATT_UUID_KETTLE_DATA_SRV)).value();
+        auto attributes             = resolve_attributes(kettle_service, kettle_data_service);
+
+        address.to_charbuff(m_address_str.begin());
+
+        const auto& auth = get_auth_session(address);
+
+        // The reply resumes the session, the executor runs the other sessions meanwhile.
+        ble::coro::notification_stream replies;
+
+        {
+            auto handshake = request_authentication(attributes, auth, replies.get_handler());
+
+            co_await await_all(handshake, "Authentication request", "Could not authenticate.");
+
+            auto reply = co_await replies.next(AUTH_TIMEOUT);
+
+            if (!reply)
             {
                 throw std::runtime_error("Could not authenticate.");
             }
+
+            check_auth_reply(reply->data(), reply->size(), auth);
         }
 
-        auth_characteristic.write(cipher(token, key2));
+        {
+            auto confirmation = confirm_authentication(attributes);
 
-        kettle_service
-            .get_characteristic_by_uuid(&GATT_UUID_VERSION)
-            .value()
-            .read();
+            co_await await_all(confirmation, "Authentication confirmation", "Could not authenticate.");
+        }
+    }
+#endif
 
-        auth_characteristic.unsubscribe();
+    mikettle::handshake_attributes mikettle::resolve_attributes(const ble::service& kettle_service, const ble::service& kettle_data_service)
+    {
+        auto auth_characteristic    = kettle_service.get_characteristic_by_uuid(&GATT_UUID_AUTH).value();
+        auto auth_descriptor        = auth_characteristic.get_descriptor_by_uuid(&GATT_UUID_CCCD).value();
+
+        // Resolved before authenticating, the status subscription is queued together with the confirmation.
+        auto status_characteristic  = kettle_data_service.get_characteristic_by_uuid(&GATT_UUID_STATUS).value();
+        auto status_descriptor      = status_characteristic.get_descriptor_by_uuid(&GATT_UUID_CCCD).value();
+
+        m_setup_characteristic      = kettle_data_service.get_characteristic_by_uuid(&GATT_UUID_SETUP).value();
+        m_time_characteristic       = kettle_data_service.get_characteristic_by_uuid(&GATT_UUID_TIME).value();
+        m_boil_mode_characteristic  = kettle_data_service.get_characteristic_by_uuid(&GATT_UUID_BOIL_MODE).value();
+
+        return handshake_attributes{
+            kettle_service.get_characteristic_by_uuid(&GATT_UUID_AUTH_INIT).value(),
+            std::move(auth_characteristic),
+            kettle_service.get_characteristic_by_uuid(&GATT_UUID_VERSION).value(),
+            std::move(auth_descriptor),
+            std::move(status_characteristic),
+            std::move(status_descriptor)
+        };
+    }
+
+    std::array<ble::completion_token, 4> mikettle::request_authentication(
+        handshake_attributes& attributes, const auth_session& auth, ble::notify_handler on_auth)
+    {
+        // A kettle accepting write commands on the auth init characteristic takes the key without a round trip.
+        // Descriptors are always written with write requests.
+        const bool init_command = attributes.auth_init.get_properties() & ESP_GATT_CHAR_PROP_BIT_WRITE_NR;
+
+        return {
+            init_command ?
+                attributes.auth_init.write_without_response_async({ key1.cbegin(), key1.cend() }) :
+                attributes.auth_init.write_async({ key1.cbegin(), key1.cend() }),
+            attributes.auth_descriptor.write_async({ subscribe.cbegin(), subscribe.cend() }),
+            attributes.auth.subscribe_async(std::move(on_auth)),
+            attributes.auth.write_async({ auth.request.cbegin(), auth.request.cend() })
+        };
+    }
+
+    std::array<ble::completion_token, 5> mikettle::confirm_authentication(handshake_attributes& attributes)
+    {
+        return {
+            attributes.auth.write_async({ AUTH_CONFIRMATION.cbegin(), AUTH_CONFIRMATION.cend() }),
+            attributes.version.read_async(),
+            attributes.auth.unsubscribe_async(),
+            attributes.status_descriptor.write_async({ subscribe.cbegin(), subscribe.cend() }),
+            attributes.status.subscribe_async([this](ble::value_view data) { on_status(data); })
+        };
+    }
 
+    void mikettle::check_auth_reply(const uint8_t* data, std::size_t size, const auth_session& auth) const noexcept
+    {
+        if (!std::equal(data, data + size, auth.response.cbegin(), auth.response.cend()))
         {
-            auto kettle_data_service    = client->get_service_by_uuid(&GATT_UUID_KETTLE_DATA_SRV).value();
-            auto status_characteristic  = kettle_data_service.get_characteristic_by_uuid(&GATT_UUID_STATUS).value();
+            ESP_LOGW(TAG, "Unexpected authentication reply from %.*s.", static_cast<int>(m_address_str.size()), m_address_str.data());
+        }
+    }
 
-            status_characteristic
-                .get_descriptor_by_uuid(&GATT_UUID_CCCD)
-                .value()
-                .write({ subscribe.cbegin(), subscribe.cend() });
+    void mikettle::on_status(ble::value_view data)
+    {
+        auto decoded = status::decode(data.data(), data.size());
 
-            status_characteristic.subscribe([this](const std::vector<uint8_t>& data) {
-                rapidjson::Document result;
-                
-                result.SetObject();
-                result.AddMember("action",  rapidjson::Value(data[0]), result.GetAllocator());
-                result.AddMember("mode",    rapidjson::Value(data[1]), result.GetAllocator());
+        if (!decoded)
+        {
+            ESP_LOGW(TAG, "Status of %u bytes is too short.", static_cast<unsigned>(data.size()));
+            return;
+        }
 
-                {
-                    auto temperature = rapidjson::Value(rapidjson::kObjectType);
+        {
+            std::lock_guard lock{ m_status_mutex };
+            m_status = *decoded;
+        }
 
-                    temperature.AddMember("set",        rapidjson::Value(data[4]), result.GetAllocator());
-                    temperature.AddMember("current",    rapidjson::Value(data[5]), result.GetAllocator());
+        utils::json::fixed_writer<status::MESSAGE_SIZE> writer;
+        decoded->write(writer, std::string_view(m_address_str.data(), m_address_str.size()));
 
-                    result.AddMember("temperature", temperature, result.GetAllocator());
-                }
+        invoke_message_handler(writer.view());
+    }
 
-                {
-                    auto keep_warm = rapidjson::Value(rapidjson::kObjectType);
+    mikettle::auth_session& mikettle::get_auth_session(const utils::mac& address) noexcept
+    {
+        if (!m_auth || m_auth->address != address)
+        {
+            std::array<uint8_t, utils::mac::MAC_SIZE> reversed_mac;
+            std::reverse_copy(
+                static_cast<const uint8_t*>(address), 
+                static_cast<const uint8_t*>(address) + utils::mac::MAC_SIZE, 
+                reversed_mac.begin());
 
-                    keep_warm.AddMember("type", rapidjson::Value(data[6]),                  result.GetAllocator());
-                    keep_warm.AddMember("time", rapidjson::Value((data[7] << 8) & data[8]), result.GetAllocator());
+            auth_session session{ address, {  }, {  } };
 
-                    result.AddMember("keep_warm", keep_warm, result.GetAllocator());
-                }
+            rc4::stream(mix_a(reversed_mac, PRODUCT_ID)).apply(token, session.request);
+            rc4::stream(mix_b(reversed_mac, PRODUCT_ID)).apply(session.request, session.response);
 
-                invoke_message_handler(std::move(result));
-            });
+            m_auth = session;
         }
+
+        return *m_auth;
     }
 
     void mikettle::disconnect()
     {
+        m_setup_characteristic.reset();
+        m_time_characteristic.reset();
+        m_boil_mode_characteristic.reset();
+
         auto client = get_client();
         client->disconnect();
 
@@ -120,6 +256,208 @@ namespace hub::device::xiaomi
 
     void mikettle::process_message(in_message_t&& message)
     {
-        return;
+        auto parsed = command::parse(message);
+
+        if (!parsed)
+        {
+            ESP_LOGW(TAG, "Invalid command, error code %i [%s].", parsed.error(), esp_err_to_name(parsed.error()));
+            return;
+        }
+
+        if (!m_setup_characteristic || !m_time_characteristic || !m_boil_mode_characteristic)
+        {
+            throw std::runtime_error("Kettle not connected.");
+        }
+
+        std::vector<ble::completion_token> writes;
+        writes.reserve(3);
+
+        if (parsed->keep_warm_type || parsed->keep_warm_temperature)
+        {
+            std::optional<status> current;
+
+            {
+                std::lock_guard lock{ m_status_mutex };
+                current = m_status;
+            }
+
+            // Type and temperature are written together, the one not given is kept as last reported.
+            if (current || (parsed->keep_warm_type && parsed->keep_warm_temperature))
+            {
+                const uint8_t type          = parsed->keep_warm_type ? *parsed->keep_warm_type : current->keep_warm_type;
+                const uint8_t temperature   = parsed->keep_warm_temperature ? *parsed->keep_warm_temperature : current->set_temperature;
+
+                writes.push_back(m_setup_characteristic->write_async({ type, temperature }));
+            }
+            else
+            {
+                ESP_LOGW(TAG, "Keep warm type and temperature have to be given together until the kettle reported its status.");
+            }
+        }
+
+        if (parsed->keep_warm_limit)
+        {
+            writes.push_back(m_time_characteristic->write_async({ *parsed->keep_warm_limit }));
+        }
+
+        if (parsed->turn_off_after_boil)
+        {
+            writes.push_back(m_boil_mode_characteristic->write_async({ static_cast<uint8_t>(*parsed->turn_off_after_boil) }));
+        }
+
+        wait_all(writes, "Setting", "Could not apply the command.");
+    }
+
+    bool mikettle::coalesce(in_message_t& queued, const in_message_t& message) const
+    {
+        auto pending    = command::parse(queued);
+        auto later      = command::parse(message);
+
+        // Invalid commands are delivered on their own and reported then.
+        if (!pending || !later)
+        {
+            return false;
+        }
+
+        pending->merge(*later);
+        queued = pending->to_message();
+
+        return true;
+    }
+
+    tl::expected<mikettle::command, esp_err_t> mikettle::command::parse(const rjs::Value& message) noexcept
+    {
+        if (!message.IsObject())
+        {
+            return tl::make_unexpected(ESP_ERR_INVALID_ARG);
+        }
+
+        command result{  };
+
+        if (message.HasMember("keep_warm"))
+        {
+            const auto& js_keep_warm = message["keep_warm"];
+
+            if (!js_keep_warm.IsObject())
+            {
+                return tl::make_unexpected(ESP_ERR_INVALID_ARG);
+            }
+
+            if (js_keep_warm.HasMember("type"))
+            {
+                const auto& js_type = js_keep_warm["type"];
+
+                if (!js_type.IsUint() || js_type.GetUint() > MAX_KEEP_WARM_TYPE)
+                {
+                    return tl::make_unexpected(ESP_ERR_INVALID_ARG);
+                }
+
+                result.keep_warm_type = static_cast<uint8_t>(js_type.GetUint());
+            }
+
+            if (js_keep_warm.HasMember("temperature"))
+            {
+                const auto& js_temperature = js_keep_warm["temperature"];
+
+                if (!js_temperature.IsUint() || js_temperature.GetUint() < MIN_TEMPERATURE || js_temperature.GetUint() > MAX_TEMPERATURE)
+                {
+                    return tl::make_unexpected(ESP_ERR_INVALID_ARG);
+                }
+
+                result.keep_warm_temperature = static_cast<uint8_t>(js_temperature.GetUint());
+            }
+
+            // Given in hours, set in half hours.
+            if (js_keep_warm.HasMember("limit"))
+            {
+                const auto& js_limit = js_keep_warm["limit"];
+
+                if (!js_limit.IsNumber() || js_limit.GetDouble() < 0 || js_limit.GetDouble() > MAX_LIMIT / 2.0)
+                {
+                    return tl::make_unexpected(ESP_ERR_INVALID_ARG);
+                }
+
+                result.keep_warm_limit = static_cast<uint8_t>(std::lround(js_limit.GetDouble() * 2));
+            }
+        }
+
+        if (message.HasMember("turn_off_after_boil"))
+        {
+            const auto& js_turn_off = message["turn_off_after_boil"];
+
+            if (!js_turn_off.IsBool())
+            {
+                return tl::make_unexpected(ESP_ERR_INVALID_ARG);
+            }
+
+            result.turn_off_after_boil = js_turn_off.GetBool();
+        }
+
+        if (!result.keep_warm_type && !result.keep_warm_temperature && !result.keep_warm_limit && !result.turn_off_after_boil)
+        {
+            return tl::make_unexpected(ESP_ERR_NOT_FOUND);
+        }
+
+        return result;
+    }
+
+    void mikettle::command::merge(const command& later) noexcept
+    {
+        if (later.keep_warm_type)
+        {
+            keep_warm_type = later.keep_warm_type;
+        }
+
+        if (later.keep_warm_temperature)
+        {
+            keep_warm_temperature = later.keep_warm_temperature;
+        }
+
+        if (later.keep_warm_limit)
+        {
+            keep_warm_limit = later.keep_warm_limit;
+        }
+
+        if (later.turn_off_after_boil)
+        {
+            turn_off_after_boil = later.turn_off_after_boil;
+        }
+    }
+
+    device_base::in_message_t mikettle::command::to_message() const
+    {
+        in_message_t result;
+        auto& allocator = result.GetAllocator();
+
+        result.SetObject();
+
+        if (keep_warm_type || keep_warm_temperature || keep_warm_limit)
+        {
+            auto keep_warm = rjs::Value(rjs::kObjectType);
+
+            if (keep_warm_type)
+            {
+                keep_warm.AddMember("type", rjs::Value(static_cast<unsigned>(*keep_warm_type)), allocator);
+            }
+
+            if (keep_warm_temperature)
+            {
+                keep_warm.AddMember("temperature", rjs::Value(static_cast<unsigned>(*keep_warm_temperature)), allocator);
+            }
+
+            if (keep_warm_limit)
+            {
+                keep_warm.AddMember("limit", rjs::Value(*keep_warm_limit / 2.0), allocator);
+            }
+
+            result.AddMember("keep_warm", keep_warm, allocator);
+        }
+
+        if (turn_off_after_boil)
+        {
+            result.AddMember("turn_off_after_boil", rjs::Value(*turn_off_after_boil), allocator);
+        }
+
+        return result;
     }
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include "utils/json.hpp"
 #include "utils/const_map.hpp"
+#include "ble/advertisement.hpp"
 
 #include <cstdint>
 #include <memory>
@@ -13,6 +14,10 @@
 // DEVICE INCLUDES
 #include "device_base.hpp"
 #include "xiaomi-mikettle.hpp"
+#include "passive.hpp"
+#include "xiaomi-mibeacon.hpp"
+#include "bthome.hpp"
+#include "atc-mithermometer.hpp"
 
 namespace hub::device::mappers
 {
@@ -50,6 +55,49 @@ namespace hub::device::mappers
     {
         return get_device_factory(device_name)();
     }
+
+    template<typename DecoderT>
+    inline constexpr auto map_decoder() noexcept
+    {
+        return std::make_pair(DecoderT::DECODER_KEY, &DecoderT::decode);
+    }
+
+    // Passive (advertisement only) decoders are mapped here
+    inline constexpr auto g_decoder_mapper = utils::make_const_map<passive::decoder_key, passive::decoder_function_type>(
+        map_decoder<xiaomi::mibeacon>(),
+        map_decoder<bthome>(),
+        map_decoder<atc::mithermometer>()
+    );
+
+    /**
+     * @brief Decode sensor readings broadcast in the service or manufacturer data of the advertisement.
+     * 
+     * @return true At least one measurement was decoded.
+     */
+    inline bool decode_advertisement(const ble::advertisement& adv, passive::reading& result) noexcept
+    {
+        const uint8_t initial_count = result.count;
+
+        for (uint8_t i = 0; i < adv.service_data_count; i++)
+        {
+            const auto& service_data = adv.service_data[i];
+
+            if (auto it = g_decoder_mapper.find({ passive::data_source::service_data, service_data.uuid }); it != g_decoder_mapper.cend())
+            {
+                it->second(adv.begin(service_data.value), service_data.value.length, result);
+            }
+        }
+
+        if (adv.has(ble::advertisement::HAS_MANUFACTURER_DATA))
+        {
+            if (auto it = g_decoder_mapper.find({ passive::data_source::manufacturer_data, adv.company_id }); it != g_decoder_mapper.cend())
+            {
+                it->second(adv.begin(adv.manufacturer_data), adv.manufacturer_data.length, result);
+            }
+        }
+
+        return result.count != initial_count;
+    }
 }
 
 #endif
\ No newline at end of file
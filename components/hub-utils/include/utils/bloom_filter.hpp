@@ -0,0 +1,95 @@
+#ifndef HUB_UTILS_BLOOM_FILTER_HPP
+#define HUB_UTILS_BLOOM_FILTER_HPP
+
+#include <array>
+#include <cstdint>
+
+namespace hub::utils
+{
+    /**
+     * @brief Fixed-size bloom filter over 64-bit keys. Membership test may return false positives, never false negatives.
+     * 
+     * Not thread-safe, the filter must not be modified while other tasks query it.
+     *
+     * @tparam Bits Number of bits, must be a power of two.
+     * @tparam HashCount Number of bits set per key.
+     */
+    template<std::size_t Bits, std::size_t HashCount = 3>
+    class bloom_filter
+    {
+    public:
+
+        static_assert(Bits >= 64 && (Bits & (Bits - 1)) == 0, "Bits must be a power of two, at least 64.");
+        static_assert(HashCount != 0, "At least one hash is required.");
+
+        constexpr bloom_filter() noexcept :
+            m_words{  }
+        {
+
+        }
+
+        constexpr void add(uint64_t key) noexcept
+        {
+            const uint64_t hash = mix(key);
+
+            for (std::size_t i = 0; i < HashCount; i++)
+            {
+                const std::size_t bit = index(hash, i);
+                m_words[bit / 64] |= (1ull << (bit % 64));
+            }
+        }
+
+        [[nodiscard]] constexpr bool might_contain(uint64_t key) const noexcept
+        {
+            const uint64_t hash = mix(key);
+
+            for (std::size_t i = 0; i < HashCount; i++)
+            {
+                const std::size_t bit = index(hash, i);
+
+                if (!(m_words[bit / 64] & (1ull << (bit % 64))))
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        constexpr void clear() noexcept
+        {
+            for (auto& word : m_words)
+            {
+                word = 0;
+            }
+        }
+
+    private:
+
+        static constexpr std::size_t MASK{ Bits - 1 };
+
+        /**
+         * @brief splitmix64 finalizer, spreads adjacent keys (e.g. MACs from one vendor) over the whole filter.
+         */
+        static constexpr uint64_t mix(uint64_t key) noexcept
+        {
+            key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ull;
+            key = (key ^ (key >> 27)) * 0x94d049bb133111ebull;
+            return key ^ (key >> 31);
+        }
+
+        /**
+         * @brief Double hashing, bit i = h1 + i * h2. The odd h2 visits distinct bits for up to Bits hashes.
+         */
+        static constexpr std::size_t index(uint64_t hash, std::size_t i) noexcept
+        {
+            const uint32_t h1 = static_cast<uint32_t>(hash);
+            const uint32_t h2 = static_cast<uint32_t>(hash >> 32) | 1u;
+            return (h1 + i * h2) & MASK;
+        }
+
+        std::array<uint64_t, Bits / 64> m_words;
+    };
+}
+
+#endif
\ No newline at end of file
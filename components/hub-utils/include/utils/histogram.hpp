@@ -0,0 +1,153 @@
+#ifndef HUB_UTILS_HISTOGRAM_HPP
+#define HUB_UTILS_HISTOGRAM_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+namespace hub::utils
+{
+    /**
+     * @brief Fixed-bucket histogram of unsigned samples (e.g. durations in microseconds) with power of two bucket bounds.
+     * Bucket 0 holds zero, bucket i holds [2^(i-1), 2^i), the last bucket also holds everything above.
+     *
+     * Recording is lock-free and allocation-free, so it can be done from any task including the Bluedroid callbacks.
+     *
+     * @tparam BucketCount Number of buckets.
+     */
+    template<std::size_t BucketCount>
+    class histogram
+    {
+    public:
+
+        static_assert(BucketCount >= 2 && BucketCount <= 64, "BucketCount must be between 2 and 64.");
+
+        /**
+         * @brief Consistent copy of the histogram, used for reporting.
+         */
+        struct snapshot_type
+        {
+            std::array<uint32_t, BucketCount>   buckets;
+            uint32_t                            count;
+            uint64_t                            sum;
+            uint32_t                            max;
+
+            uint32_t mean() const noexcept
+            {
+                return count ? static_cast<uint32_t>(sum / count) : 0;
+            }
+
+            /**
+             * @brief Upper bound of the bucket holding the given percentile of samples.
+             *
+             * @param percent Percentile, 0 - 100.
+             */
+            uint64_t percentile(uint32_t percent) const noexcept
+            {
+                const uint64_t rank = (static_cast<uint64_t>(count) * percent + 99) / 100;
+                uint64_t accumulated = 0;
+
+                for (std::size_t i = 0; i < BucketCount; i++)
+                {
+                    accumulated += buckets[i];
+
+                    if (accumulated >= rank && accumulated != 0)
+                    {
+                        return (i == BucketCount - 1) ? max : upper_bound(i);
+                    }
+                }
+
+                return 0;
+            }
+        };
+
+        histogram() noexcept :
+            m_buckets{  },
+            m_count{ 0 },
+            m_sum{ 0 },
+            m_max{ 0 }
+        {
+
+        }
+
+        histogram(const histogram&)             = delete;
+
+        histogram& operator=(const histogram&)  = delete;
+
+        ~histogram()                            = default;
+
+        void record(uint32_t value) noexcept
+        {
+            m_buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+            m_count.fetch_add(1, std::memory_order_relaxed);
+            m_sum.fetch_add(value, std::memory_order_relaxed);
+
+            uint32_t max = m_max.load(std::memory_order_relaxed);
+
+            while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+            {
+
+            }
+        }
+
+        /**
+         * @brief Copy of the current state. Samples recorded concurrently may be partially included.
+         */
+        snapshot_type snapshot() const noexcept
+        {
+            snapshot_type result{  };
+
+            for (std::size_t i = 0; i < BucketCount; i++)
+            {
+                result.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+            }
+
+            result.count    = m_count.load(std::memory_order_relaxed);
+            result.sum      = m_sum.load(std::memory_order_relaxed);
+            result.max      = m_max.load(std::memory_order_relaxed);
+            return result;
+        }
+
+        void reset() noexcept
+        {
+            for (auto& bucket : m_buckets)
+            {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+
+            m_count.store(0, std::memory_order_relaxed);
+            m_sum.store(0, std::memory_order_relaxed);
+            m_max.store(0, std::memory_order_relaxed);
+        }
+
+        static constexpr std::size_t bucket_index(uint32_t value) noexcept
+        {
+            if (value == 0)
+            {
+                return 0;
+            }
+
+            // Bit length of the value.
+            const std::size_t index = 32 - static_cast<std::size_t>(__builtin_clz(value));
+            return (index < BucketCount - 1) ? index : BucketCount - 1;
+        }
+
+        /**
+         * @brief Exclusive upper bound of the bucket.
+         */
+        static constexpr uint64_t upper_bound(std::size_t index) noexcept
+        {
+            return (index == BucketCount - 1) ? std::numeric_limits<uint64_t>::max() : (1ull << index);
+        }
+
+    private:
+
+        std::array<std::atomic<uint32_t>, BucketCount>  m_buckets;
+        std::atomic<uint32_t>                           m_count;
+        std::atomic<uint64_t>                           m_sum;
+        std::atomic<uint32_t>                           m_max;
+    };
+}
+
+#endif
\ No newline at end of file
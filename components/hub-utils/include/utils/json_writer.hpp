@@ -0,0 +1,285 @@
+#ifndef HUB_UTILS_JSON_WRITER_HPP
+#define HUB_UTILS_JSON_WRITER_HPP
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace hub::utils::json
+{
+    /**
+     * @brief JSON writer emitting straight into an inline buffer, for messages of a known shape published at a high rate.
+     * Never allocates, writing past the capacity only marks the writer as overflowed.
+     *
+     * Commas are inserted by the writer, every key has to be followed by exactly one value or container.
+     *
+     * @tparam Capacity Buffer size in bytes.
+     */
+    template<std::size_t Capacity>
+    class fixed_writer
+    {
+    public:
+
+        static constexpr std::size_t MAX_DEPTH{ 32 };  // Nesting tracked in a 32 bit mask.
+
+        fixed_writer() noexcept :
+            m_size{ 0 },
+            m_depth{ 0 },
+            m_has_members{ 0 },
+            m_after_key{ false },
+            m_overflow{ false }
+        {
+
+        }
+
+        void start_object() noexcept
+        {
+            open('{');
+        }
+
+        void end_object() noexcept
+        {
+            close('}');
+        }
+
+        void start_array() noexcept
+        {
+            open('[');
+        }
+
+        void end_array() noexcept
+        {
+            close(']');
+        }
+
+        void key(std::string_view name) noexcept
+        {
+            put_string(separate(), name, ":");
+            m_after_key = true;
+        }
+
+        void string(std::string_view value) noexcept
+        {
+            put_string(separate(), value, "");
+        }
+
+        void number(uint32_t value) noexcept
+        {
+            put_number(separate(), value);
+        }
+
+        void number(int32_t value) noexcept
+        {
+            put_number(separate(), value);
+        }
+
+        void boolean(bool value) noexcept
+        {
+            put_raw(separate(), value ? std::string_view("true") : std::string_view("false"));
+        }
+
+        void null() noexcept
+        {
+            put_raw(separate(), "null");
+        }
+
+        /**
+         * @brief Check that the document fit into the buffer and every container was closed.
+         */
+        bool is_valid() const noexcept
+        {
+            return !m_overflow && m_depth == 0;
+        }
+
+        /**
+         * @brief Document written so far, not null-terminated.
+         */
+        std::string_view view() const noexcept
+        {
+            return std::string_view(m_buffer.data(), m_size);
+        }
+
+        void clear() noexcept
+        {
+            m_size          = 0;
+            m_depth         = 0;
+            m_has_members   = 0;
+            m_after_key     = false;
+            m_overflow      = false;
+        }
+
+    private:
+
+        /**
+         * @brief Track the members of the open container.
+         *
+         * @return true A comma has to precede the value, it is not the first in its container and does not follow a key.
+         */
+        bool separate() noexcept
+        {
+            if (m_after_key)
+            {
+                m_after_key = false;
+                return false;
+            }
+
+            if (m_depth == 0)
+            {
+                return false;
+            }
+
+            const uint32_t bit = 1u << (m_depth - 1);
+            const bool comma = m_has_members & bit;
+
+            m_has_members |= bit;
+            return comma;
+        }
+
+        void open(char bracket) noexcept
+        {
+            const char text[]{ ',', bracket };
+            const bool comma = separate();
+
+            put_raw(false, std::string_view(text + !comma, 1 + comma));
+
+            if (m_depth == MAX_DEPTH)
+            {
+                m_overflow = true;
+                return;
+            }
+
+            m_depth++;
+            m_has_members &= ~(1u << (m_depth - 1));
+        }
+
+        void close(char bracket) noexcept
+        {
+            if (m_depth != 0)
+            {
+                m_depth--;
+            }
+
+            put_raw(false, std::string_view(&bracket, 1));
+        }
+
+        /**
+         * @brief Claim length bytes of the buffer. Every value is written through a local cursor and the size
+         * stored once, byte stores would otherwise force the size to be reloaded after each of them.
+         *
+         * @return char* Start of the claimed bytes, nullptr if they do not fit.
+         */
+        char* reserve(std::size_t length) noexcept
+        {
+            if (length > Capacity - m_size)
+            {
+                m_overflow = true;
+                return nullptr;
+            }
+
+            char* out = m_buffer.data() + m_size;
+            m_size += length;
+            return out;
+        }
+
+        void put_raw(bool comma, std::string_view text) noexcept
+        {
+            if (char* out = reserve(comma + text.size()); out)
+            {
+                // Nothing may be stored for an empty write, out is one past the buffer if it is full.
+                if (comma)
+                {
+                    *out = ',';
+                }
+
+                std::char_traits<char>::copy(out + comma, text.data(), text.size());
+            }
+        }
+
+        template<typename T>
+        void put_number(bool comma, T value) noexcept
+        {
+            char digits[12];
+            auto [end, error] = std::to_chars(digits, digits + sizeof(digits), value);
+
+            put_raw(comma, std::string_view(digits, static_cast<std::size_t>(end - digits)));
+        }
+
+        /**
+         * @brief Write a quoted string followed by the suffix. Keys and most values need no escaping, they are copied
+         * and checked in a single pass and only rewritten if an escape turns up.
+         */
+        void put_string(bool comma, std::string_view text, std::string_view suffix) noexcept
+        {
+            const std::size_t start = m_size;
+            char* out = reserve(comma + text.size() + 2 + suffix.size());
+
+            if (!out)
+            {
+                return;
+            }
+
+            *out = ',';
+            out += comma;
+            *out++ = '"';
+
+            bool escape = false;
+
+            for (char c : text)
+            {
+                escape |= (c == '"') | (c == '\\') | (static_cast<unsigned char>(c) < 0x20);
+                *out++ = c;
+            }
+
+            if (escape)
+            {
+                m_size = start;
+                put_escaped(comma, text, suffix);
+                return;
+            }
+
+            *out++ = '"';
+            std::char_traits<char>::copy(out, suffix.data(), suffix.size());
+        }
+
+        void put_escaped(bool comma, std::string_view text, std::string_view suffix) noexcept
+        {
+            static constexpr char HEX[]{ "0123456789abcdef" };
+
+            put_raw(comma, "\"");
+
+            for (char c : text)
+            {
+                const auto code = static_cast<unsigned char>(c);
+
+                if (c == '"' || c == '\\')
+                {
+                    const char escaped[]{ '\\', c };
+                    put_raw(false, std::string_view(escaped, sizeof(escaped)));
+                }
+                else if (code < 0x20)
+                {
+                    const char escaped[]{ '\\', 'u', '0', '0', HEX[code >> 4], HEX[code & 0x0f] };
+                    put_raw(false, std::string_view(escaped, sizeof(escaped)));
+                }
+                else
+                {
+                    put_raw(false, std::string_view(&c, 1));
+                }
+            }
+
+            put_raw(false, "\"");
+            put_raw(false, suffix);
+        }
+
+        std::array<char, Capacity>  m_buffer;
+        std::size_t                 m_size;
+        uint8_t                     m_depth;
+        uint32_t                    m_has_members;  // Bit per open container, set once it has a member.
+        bool                        m_after_key;
+        bool                        m_overflow;
+    };
+}
+
+#endif
\ No newline at end of file
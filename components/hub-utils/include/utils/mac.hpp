@@ -62,6 +62,16 @@ namespace hub::utils
 
         explicit operator const uint8_t*() const noexcept;
 
+        bool operator==(const mac& other) const noexcept
+        {
+            return m_address == other.m_address;
+        }
+
+        bool operator!=(const mac& other) const noexcept
+        {
+            return !(*this == other);
+        }
+
     private:
 
         std::array<uint8_t, MAC_SIZE> m_address;
@@ -0,0 +1,113 @@
+#ifndef HUB_UTILS_SPSC_RING_HPP
+#define HUB_UTILS_SPSC_RING_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+namespace hub::utils
+{
+    /**
+     * @brief Lock-free, fixed capacity ring buffer for exactly one producer and one consumer task.
+     * Storage is preallocated, push and pop never block and never allocate.
+     *
+     * @tparam T Element type, must be trivially copyable.
+     * @tparam Capacity Number of slots, must be a power of two.
+     */
+    template<typename T, std::size_t Capacity>
+    class spsc_ring
+    {
+    public:
+
+        static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two.");
+        static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable.");
+
+        using value_type = T;
+        using size_type  = std::size_t;
+
+        spsc_ring() noexcept :
+            m_head{ 0 },
+            m_tail{ 0 },
+            m_buffer{  }
+        {
+
+        }
+
+        spsc_ring(const spsc_ring&)             = delete;
+
+        spsc_ring& operator=(const spsc_ring&)  = delete;
+
+        ~spsc_ring()                            = default;
+
+        /**
+         * @brief Copy item into the ring. Producer side only.
+         *
+         * @return true Item was queued.
+         * @return false Ring is full, item was not queued.
+         */
+        bool try_push(const value_type& item) noexcept
+        {
+            const size_type tail = m_tail.load(std::memory_order_relaxed);
+
+            if (tail - m_head.load(std::memory_order_acquire) == Capacity)
+            {
+                return false;
+            }
+
+            m_buffer[tail & MASK] = item;
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Move the oldest item out of the ring. Consumer side only.
+         *
+         * @return true Item was written to out.
+         * @return false Ring is empty.
+         */
+        bool try_pop(value_type& out) noexcept
+        {
+            const size_type head = m_head.load(std::memory_order_relaxed);
+
+            if (head == m_tail.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+
+            out = m_buffer[head & MASK];
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Number of queued items. Exact only when called from the producer or consumer while the other side is idle.
+         */
+        [[nodiscard]] size_type size() const noexcept
+        {
+            return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+        }
+
+        [[nodiscard]] bool empty() const noexcept
+        {
+            return size() == 0;
+        }
+
+        [[nodiscard]] static constexpr size_type capacity() noexcept
+        {
+            return Capacity;
+        }
+
+    private:
+
+        static constexpr size_type MASK{ Capacity - 1 };
+        static constexpr size_type CACHE_LINE_SIZE{ 64 };
+
+        // Head and tail on separate cache lines, so producer and consumer do not invalidate each other.
+        alignas(CACHE_LINE_SIZE) std::atomic<size_type>     m_head;
+        alignas(CACHE_LINE_SIZE) std::atomic<size_type>     m_tail;
+        alignas(CACHE_LINE_SIZE) std::array<T, Capacity>    m_buffer;
+    };
+}
+
+#endif
\ No newline at end of file
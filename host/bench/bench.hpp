@@ -0,0 +1,55 @@
+#ifndef HUB_HOST_BENCH_HPP
+#define HUB_HOST_BENCH_HPP
+
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <string_view>
+
+namespace bench
+{
+    /**
+     * @brief Prevent the compiler from optimizing away a computed value.
+     */
+    template<typename T>
+    inline void do_not_optimize(T&& value) noexcept
+    {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+    /**
+     * @brief Print the mean time per iteration of iterations started at start and timed by the caller, e.g. run by an executor.
+     * 
+     * @return double Mean nanoseconds per iteration.
+     */
+    inline double report(std::string_view name, std::size_t iterations, std::chrono::steady_clock::time_point start)
+    {
+        auto elapsed    = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        auto per_op     = elapsed / static_cast<double>(iterations);
+
+        std::printf("%-40.*s %12zu iterations %12.1f ns/op %14.0f op/s\n",
+            static_cast<int>(name.size()), name.data(), iterations, per_op, 1e9 / per_op);
+
+        return per_op;
+    }
+
+    /**
+     * @brief Run fun(i) for i in [0, iterations) and print the mean time per iteration.
+     * 
+     * @return double Mean nanoseconds per iteration.
+     */
+    template<typename FunT>
+    inline double run(std::string_view name, std::size_t iterations, FunT fun)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        for (std::size_t i = 0; i < iterations; i++)
+        {
+            fun(i);
+        }
+
+        return report(name, iterations, start);
+    }
+}
+
+#endif
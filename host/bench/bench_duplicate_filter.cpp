@@ -0,0 +1,63 @@
+#include "bench.hpp"
+
+#include <vector>
+
+#include "ble/advertisement.hpp"
+#include "ble/duplicate_filter.hpp"
+
+namespace
+{
+    constexpr std::size_t ITERATIONS = 1000000;
+
+    std::vector<hub::ble::advertisement> make_advertisements(std::size_t devices)
+    {
+        std::vector<hub::ble::advertisement> result(devices);
+
+        for (std::size_t i = 0; i < devices; i++)
+        {
+            const uint8_t payload[] = {
+                0x02, ESP_BLE_AD_TYPE_FLAG, 0x06,
+                0x06, ESP_BLE_AD_TYPE_SERVICE_DATA, 0x95, 0xfe, 0x50, 0x20, static_cast<uint8_t>(i)
+            };
+
+            result[i].address       = { 0xa4, 0xc1, 0x38, 0x00, static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i) };
+            result[i].event_type    = ESP_BLE_EVT_NON_CONN_ADV;
+            hub::ble::parse_advertisement(payload, sizeof(payload), result[i]);
+        }
+
+        return result;
+    }
+
+    template<std::size_t Capacity>
+    void run(std::size_t devices)
+    {
+        auto advertisements = make_advertisements(devices);
+        hub::ble::duplicate_filter<Capacity> filter(1000);
+        std::size_t suppressed = 0;
+
+        char name[64];
+        std::snprintf(name, sizeof(name), "duplicate_filter<%zu>: %zu devices", Capacity, devices);
+
+        bench::run(name, ITERATIONS, [&](std::size_t i) {
+            // Every 16th advertisement of a device carries a new payload.
+            auto& adv = advertisements[i % devices];
+
+            if ((i / devices) % 16 == 0)
+            {
+                adv.data[adv.data_length - 1]++;
+            }
+
+            suppressed += filter.is_duplicate(adv, static_cast<TickType_t>(i / 1000)) ? 1 : 0;
+        });
+
+        std::printf("  suppressed %.1f%%\n", 100.0 * static_cast<double>(suppressed) / ITERATIONS);
+    }
+}
+
+int main()
+{
+    run<128>(64);
+    run<128>(512);
+    run<1024>(512);
+    return 0;
+}
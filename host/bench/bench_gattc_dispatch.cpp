@@ -0,0 +1,147 @@
+#include "bench.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "esp_log.h"
+
+#include "ble/client.hpp"
+#include "ble/service.hpp"
+#include "ble/characteristic.hpp"
+#include "shim/bluedroid.hpp"
+
+namespace
+{
+    constexpr std::size_t ITERATIONS = 2000000;
+
+    // Largest CONFIG_BTDM_CTRL_BLE_MAX_CONN supported by the ESP32 controller.
+    constexpr std::size_t MAX_CONNECTIONS = 9;
+
+    struct registered
+    {
+        esp_gatt_if_t interface;
+    };
+
+    /**
+     * @brief Client lookup as done before the dispatch table: every slot is locked and compared.
+     */
+    void run_weak_ptr_scan()
+    {
+        std::array<std::weak_ptr<registered>, MAX_CONNECTIONS> refs;
+        std::vector<std::shared_ptr<registered>> owners;
+
+        for (std::size_t i = 0; i < MAX_CONNECTIONS; i++)
+        {
+            owners.push_back(std::make_shared<registered>(registered{ static_cast<esp_gatt_if_t>(3 + i) }));
+            refs[i] = owners.back();
+        }
+
+        bench::run("lookup: weak_ptr scan, 9 slots", ITERATIONS, [&](std::size_t i) {
+            const auto gattc_if = static_cast<esp_gatt_if_t>(3 + i % MAX_CONNECTIONS);
+
+            auto iter = std::find_if(refs.cbegin(), refs.cend(), [gattc_if](auto ref) {
+                return !ref.expired() && ref.lock()->interface == gattc_if;
+            });
+
+            auto found = (iter != refs.cend()) ? iter->lock() : std::shared_ptr<registered>();
+            bench::do_not_optimize(found);
+        });
+    }
+
+    void run_dispatch_table()
+    {
+        std::array<std::atomic<registered*>, ESP_GATT_IF_NONE> table{  };
+        std::vector<std::unique_ptr<registered>> owners;
+
+        for (std::size_t i = 0; i < MAX_CONNECTIONS; i++)
+        {
+            owners.push_back(std::make_unique<registered>(registered{ static_cast<esp_gatt_if_t>(3 + i) }));
+            table[owners.back()->interface].store(owners.back().get());
+        }
+
+        bench::run("lookup: dispatch table, 9 slots", ITERATIONS, [&](std::size_t i) {
+            auto* found = table[3 + i % MAX_CONNECTIONS].load();
+            bench::do_not_optimize(found);
+        });
+    }
+
+    /**
+     * @brief Notifications delivered through the client GATTC callback to a subscribed characteristic.
+     */
+    void run_notifications()
+    {
+        esp_bt_uuid_t service_uuid{ ESP_UUID_LEN_16, { 0x181a } };
+        esp_bt_uuid_t characteristic_uuid{ ESP_UUID_LEN_16, { 0x2a6e } };
+
+        auto device = std::make_shared<shim::bluedroid::peripheral>();
+        device->add_service(service_uuid);
+        device->add_characteristic(characteristic_uuid, ESP_GATT_CHAR_PROP_BIT_NOTIFY, { 0, 0 });
+
+        const uint8_t address[] = { 0xa4, 0xc1, 0x38, 0x00, 0x00, 0x01 };
+        shim::bluedroid::add_peripheral(address, device);
+
+        auto client = std::make_shared<hub::ble::client>();
+
+        if (!client->connect(hub::utils::mac(address, address + sizeof(address))))
+        {
+            std::printf("connect failed\n");
+            return;
+        }
+
+        auto characteristic = client->get_service_by_uuid(&service_uuid)
+            .value()
+            .get_characteristic_by_uuid(&characteristic_uuid)
+            .value();
+
+        std::size_t received = 0;
+        std::size_t copied = 0;
+        characteristic.subscribe([&received](hub::ble::value_view value) { received += value.size(); });
+
+        uint8_t value[] = { 0x12, 0x34 };
+
+        esp_ble_gattc_cb_param_t param{  };
+        param.notify.handle     = characteristic.get_handle();
+        param.notify.value      = value;
+        param.notify.value_len  = sizeof(value);
+        param.notify.is_notify  = true;
+        std::copy(address, address + sizeof(address), param.notify.remote_bda);
+
+        const esp_gatt_if_t gattc_if = shim::bluedroid::gattc::get_interface(0);
+
+        bench::run("gattc: notify to subscribed client", ITERATIONS, [&](std::size_t) {
+            shim::bluedroid::gattc::dispatch(ESP_GATTC_NOTIFY_EVT, gattc_if, &param);
+        });
+
+        std::printf("  delivered %zu bytes\n", received);
+
+        // Handlers handing the value to another task keep an owned copy from the notification pool.
+        characteristic.subscribe([&copied](hub::ble::value_view value) {
+            if (auto owned = value.copy(); owned)
+            {
+                copied += owned->size();
+            }
+        });
+
+        bench::run("gattc: notify with pooled copy", ITERATIONS, [&](std::size_t) {
+            shim::bluedroid::gattc::dispatch(ESP_GATTC_NOTIFY_EVT, gattc_if, &param);
+        });
+
+        std::printf("  copied %zu bytes\n", copied);
+
+        client->disconnect();
+    }
+}
+
+int main()
+{
+    esp_log_level_set("*", ESP_LOG_WARN);
+
+    run_weak_ptr_scan();
+    run_dispatch_table();
+    run_notifications();
+
+    return 0;
+}
\ No newline at end of file
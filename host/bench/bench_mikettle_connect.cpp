@@ -0,0 +1,320 @@
+#include "bench.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "esp_log.h"
+
+#include "rc4.hpp"
+#include "shim/bluedroid.hpp"
+#include "ble/coroutine.hpp"
+#include "utils/mac.hpp"
+#include "xiaomi-mikettle.hpp"
+
+namespace
+{
+    constexpr std::size_t ITERATIONS = 20;
+
+    // Round trip of a request at a 7.5 ms connection interval.
+    constexpr std::chrono::microseconds LINK_LATENCY{ 7500 };
+
+    constexpr uint16_t PRODUCT_ID{ 275 };
+
+    constexpr std::array<uint8_t, 4>  KEY1{ 0x90, 0xCA, 0x85, 0xDE };
+    constexpr std::array<uint8_t, 4>  KEY2{ 0x92, 0xAB, 0x54, 0xFA };
+    constexpr std::array<uint8_t, 12> TOKEN{ 0x91, 0xf5, 0x80, 0x93, 0x24, 0x49, 0xb4, 0x0d, 0x6b, 0x06, 0xd2, 0x8a };
+
+    constexpr esp_bt_uuid_t uuid16(uint16_t uuid) noexcept
+    {
+        return esp_bt_uuid_t{ ESP_UUID_LEN_16, { uuid } };
+    }
+
+    /**
+     * @brief Kettle following the authentication of the real one. The request has to be encrypted with the key derived
+     * from its address, the response is notified two link round trips later and the confirmation completes the handshake.
+     * Requests out of order fail it, a confirmation arriving before the reply went out included.
+     *
+     * @param auth_init_properties Properties of the auth init characteristic, whether it takes write commands.
+     */
+    class simulated_kettle : public shim::bluedroid::peripheral
+    {
+    public:
+
+        simulated_kettle(const uint8_t* address, esp_gatt_char_prop_t auth_init_properties)
+        {
+            std::array<uint8_t, 6> reversed;
+            std::reverse_copy(address, address + reversed.size(), reversed.begin());
+
+            const std::array<uint8_t, 8> mix_a{
+                reversed[0], reversed[2], reversed[5], PRODUCT_ID & 0xff, PRODUCT_ID & 0xff, reversed[4], reversed[5], reversed[1] };
+            const std::array<uint8_t, 8> mix_b{
+                reversed[0], reversed[2], reversed[5], (PRODUCT_ID >> 8) & 0xff, reversed[4], reversed[0], reversed[5], PRODUCT_ID & 0xff };
+
+            m_request       = hub::device::rc4::stream::encrypt(hub::device::rc4::stream(mix_a), TOKEN);
+            m_response      = hub::device::rc4::stream::encrypt(hub::device::rc4::stream(mix_b), m_request);
+            m_confirmation  = hub::device::rc4::stream::encrypt(hub::device::rc4::stream(TOKEN), KEY2);
+
+            add_service(uuid16(0xfe95));
+            m_auth_init_handle  = add_characteristic(uuid16(0x0010), auth_init_properties);
+            m_auth_handle       = add_characteristic(uuid16(0x0001), ESP_GATT_CHAR_PROP_BIT_WRITE | ESP_GATT_CHAR_PROP_BIT_NOTIFY);
+            add_descriptor(uuid16(0x2902), { 0x00, 0x00 });
+            add_characteristic(uuid16(0x0004), ESP_GATT_CHAR_PROP_BIT_READ, { '1', '.', '0', '.', '7' });
+
+            add_service(esp_bt_uuid_t{
+                ESP_UUID_LEN_128,
+                { .uuid128 = { 0x56, 0x61, 0x23, 0x37, 0x28, 0x26, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0x36, 0x47, 0x34, 0x01 } } });
+            add_characteristic(uuid16(0xaa01), ESP_GATT_CHAR_PROP_BIT_WRITE, { 0x01, 0x5a });
+            add_characteristic(uuid16(0xaa02), ESP_GATT_CHAR_PROP_BIT_NOTIFY);
+            add_descriptor(uuid16(0x2902), { 0x00, 0x00 });
+            add_characteristic(uuid16(0xaa04), ESP_GATT_CHAR_PROP_BIT_WRITE, { 0x18 });
+            add_characteristic(uuid16(0xaa05), ESP_GATT_CHAR_PROP_BIT_WRITE, { 0x00 });
+        }
+
+        ~simulated_kettle() override
+        {
+            if (m_responder.joinable())
+            {
+                m_responder.join();
+            }
+        }
+
+        esp_gatt_status_t on_write(uint16_t handle, const std::vector<uint8_t>& value) override
+        {
+            std::lock_guard lock{ m_mutex };
+
+            if (handle == m_auth_init_handle)
+            {
+                m_stage = std::equal(value.begin(), value.end(), KEY1.begin(), KEY1.end()) ? stage::initialized : stage::failed;
+                return ESP_GATT_OK;
+            }
+
+            if (handle != m_auth_handle)
+            {
+                return peripheral::on_write(handle, value);
+            }
+
+            if (m_stage == stage::initialized && std::equal(value.begin(), value.end(), m_request.begin(), m_request.end()))
+            {
+                m_stage = stage::requested;
+
+                // Notifications are not held back by the requests that follow.
+                if (m_responder.joinable())
+                {
+                    m_responder.join();
+                }
+
+                m_responder = std::thread([this]() {
+                    std::this_thread::sleep_for(2 * get_latency());
+
+                    {
+                        std::lock_guard lock{ m_mutex };
+
+                        if (m_stage != stage::requested)
+                        {
+                            return;
+                        }
+
+                        m_stage = stage::replied;
+                    }
+
+                    notify(m_auth_handle, { m_response.begin(), m_response.end() });
+                });
+            }
+            else if (m_stage == stage::replied && std::equal(value.begin(), value.end(), m_confirmation.begin(), m_confirmation.end()))
+            {
+                m_stage = stage::authenticated;
+                m_authentications++;
+            }
+            else
+            {
+                m_early_confirmations += (m_stage == stage::requested);
+                m_stage = stage::failed;
+            }
+
+            return ESP_GATT_OK;
+        }
+
+        std::size_t get_authentications() const noexcept
+        {
+            std::lock_guard lock{ m_mutex };
+            return m_authentications;
+        }
+
+        std::size_t get_early_confirmations() const noexcept
+        {
+            std::lock_guard lock{ m_mutex };
+            return m_early_confirmations;
+        }
+
+    private:
+
+        enum class stage
+        {
+            idle,
+            initialized,
+            requested,
+            replied,
+            authenticated,
+            failed
+        };
+
+        mutable std::mutex          m_mutex;
+        std::thread                 m_responder;
+        stage                       m_stage{ stage::idle };
+        std::size_t                 m_authentications{ 0 };
+        std::size_t                 m_early_confirmations{ 0 };
+        uint16_t                    m_auth_init_handle{ 0 };
+        uint16_t                    m_auth_handle{ 0 };
+        std::array<uint8_t, 12>     m_request{  };
+        std::array<uint8_t, 12>     m_response{  };
+        std::array<uint8_t, 4>      m_confirmation{  };
+    };
+
+    /**
+     * @brief Connect, authenticate and subscribe to the status, then disconnect.
+     *
+     * @param fresh Use a new driver for every connection, so nothing is known about the kettle.
+     */
+    void run_connect(std::string_view name, const hub::utils::mac& address, const simulated_kettle& kettle, bool fresh)
+    {
+        auto device = std::make_shared<hub::device::xiaomi::mikettle>();
+        device->set_message_handler([](std::string_view) {  });
+
+        // Warm up, the attribute table is discovered once and the auth request derived once per driver.
+        device->connect(address, BLE_ADDR_TYPE_PUBLIC);
+        device->disconnect();
+
+        const std::size_t authentications   = kettle.get_authentications();
+        const std::size_t early             = kettle.get_early_confirmations();
+        const std::size_t requests          = shim::bluedroid::gattc::get_request_count();
+
+        bench::run(name, ITERATIONS, [&](std::size_t) {
+            if (fresh)
+            {
+                device = std::make_shared<hub::device::xiaomi::mikettle>();
+                device->set_message_handler([](std::string_view) {  });
+            }
+
+            device->connect(address, BLE_ADDR_TYPE_PUBLIC);
+            device->disconnect();
+        });
+
+        std::printf("  %zu of %zu authenticated, %zu early confirmations, %.1f requests/connection\n",
+            kettle.get_authentications() - authentications,
+            ITERATIONS,
+            kettle.get_early_confirmations() - early,
+            static_cast<double>(shim::bluedroid::gattc::get_request_count() - requests) / ITERATIONS);
+    }
+
+#if defined(HUB_BLE_COROUTINES)
+    /**
+     * @brief Connect, authenticate and subscribe to the status, then disconnect, count times in a row.
+     */
+    hub::ble::coro::task<void> connect_session(hub::device::xiaomi::mikettle& device, hub::utils::mac address, std::size_t count, bool& done)
+    {
+        try
+        {
+            for (std::size_t i = 0; i < count; i++)
+            {
+                co_await device.connect_async(address, BLE_ADDR_TYPE_PUBLIC);
+                device.disconnect();
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::printf("  connection failed: %s\n", e.what());
+        }
+
+        done = true;
+    }
+
+    /**
+     * @brief Other work of the task, resumed every tick until the connections are done.
+     */
+    hub::ble::coro::task<void> tick_session(const bool& done, std::size_t& ticks)
+    {
+        while (!done)
+        {
+            co_await hub::ble::coro::sleep_for(hub::timing::miliseconds(portTICK_PERIOD_MS));
+            ticks++;
+        }
+    }
+
+    /**
+     * @brief As run_connect reconnecting, with the driver connecting in a session of an executor. A second session
+     * shares the task, the ticks it ran show the task is not blocked while the handshakes are in flight.
+     */
+    void run_connect_coroutine(std::string_view name, const hub::utils::mac& address, const simulated_kettle& kettle)
+    {
+        auto device = std::make_shared<hub::device::xiaomi::mikettle>();
+        device->set_message_handler([](std::string_view) {  });
+
+        device->connect(address, BLE_ADDR_TYPE_PUBLIC);
+        device->disconnect();
+
+        const std::size_t authentications   = kettle.get_authentications();
+        const std::size_t early             = kettle.get_early_confirmations();
+        const std::size_t requests          = shim::bluedroid::gattc::get_request_count();
+
+        hub::ble::coro::executor executor;
+        std::size_t ticks   = 0;
+        bool done           = false;
+
+        // The blocking disconnect is part of the session, the ticker only waits for the last tick once.
+        const auto start = std::chrono::steady_clock::now();
+
+        executor.spawn(connect_session(*device, address, ITERATIONS, done));
+        executor.spawn(tick_session(done, ticks));
+        executor.run();
+
+        bench::report(name, ITERATIONS, start);
+
+        std::printf("  %zu of %zu authenticated, %zu early confirmations, %.1f requests/connection, %.1f ticks/connection\n",
+            kettle.get_authentications() - authentications,
+            ITERATIONS,
+            kettle.get_early_confirmations() - early,
+            static_cast<double>(shim::bluedroid::gattc::get_request_count() - requests) / ITERATIONS,
+            static_cast<double>(ticks) / ITERATIONS);
+    }
+#endif
+}
+
+int main()
+{
+    esp_log_level_set("*", ESP_LOG_WARN);
+
+    const uint8_t address[] = { 0xa4, 0xc1, 0x38, 0x00, 0x00, 0x02 };
+    const hub::utils::mac kettle_address(address, address + sizeof(address));
+
+    // Whether real kettles take write commands on the auth init characteristic is not known, both are measured.
+    const uint8_t command_address[] = { 0xa4, 0xc1, 0x38, 0x00, 0x00, 0x03 };
+    const hub::utils::mac command_kettle_address(command_address, command_address + sizeof(command_address));
+
+    auto kettle = std::make_shared<simulated_kettle>(address, ESP_GATT_CHAR_PROP_BIT_WRITE);
+    kettle->set_latency(LINK_LATENCY);
+    shim::bluedroid::add_peripheral(address, kettle);
+
+    auto command_kettle = std::make_shared<simulated_kettle>(command_address, ESP_GATT_CHAR_PROP_BIT_WRITE | ESP_GATT_CHAR_PROP_BIT_WRITE_NR);
+    command_kettle->set_latency(LINK_LATENCY);
+    shim::bluedroid::add_peripheral(command_address, command_kettle);
+
+    run_connect("mikettle: connect, new driver", kettle_address, *kettle, true);
+    run_connect("mikettle: reconnect", kettle_address, *kettle, false);
+    run_connect("mikettle: reconnect, init write command", command_kettle_address, *command_kettle, false);
+
+#if defined(HUB_BLE_COROUTINES)
+    // The host allows a single connection like the firmware, so sessions of several kettles cannot overlap here.
+    run_connect_coroutine("mikettle: reconnect, coroutine", kettle_address, *kettle);
+    run_connect_coroutine("mikettle: coroutine, init write command", command_kettle_address, *command_kettle);
+#endif
+
+    shim::bluedroid::reset();
+
+    return 0;
+}
\ No newline at end of file
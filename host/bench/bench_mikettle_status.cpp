@@ -0,0 +1,134 @@
+#include "bench.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "rapidjson/document.h"
+#include "rapidjson/writer.h"
+#include "rapidjson/stringbuffer.h"
+
+#include "utils/mac.hpp"
+#include "utils/json_writer.hpp"
+#include "xiaomi-mikettle.hpp"
+
+namespace
+{
+    constexpr std::size_t ITERATIONS = 1000000;
+
+    std::atomic<std::size_t> g_allocations{ 0 };
+
+    using status = hub::device::xiaomi::mikettle::status;
+
+    // Boiling, target 90 °C, at 63 °C, keep warm for 12 hours.
+    constexpr std::array<uint8_t, 12> PAYLOAD{ 0x01, 0x00, 0x00, 0x00, 0x5a, 0x3f, 0x01, 0x02, 0xd0, 0x00, 0x00, 0x00 };
+
+    /**
+     * @brief Status message as built before: a document per notification, serialized into a string.
+     */
+    std::string write_document(const uint8_t* data, std::string_view address)
+    {
+        rapidjson::Document result;
+
+        result.SetObject();
+        result.AddMember("action",  rapidjson::Value(data[0]), result.GetAllocator());
+        result.AddMember("mode",    rapidjson::Value(data[1]), result.GetAllocator());
+
+        {
+            auto temperature = rapidjson::Value(rapidjson::kObjectType);
+
+            temperature.AddMember("set",        rapidjson::Value(data[4]), result.GetAllocator());
+            temperature.AddMember("current",    rapidjson::Value(data[5]), result.GetAllocator());
+
+            result.AddMember("temperature", temperature, result.GetAllocator());
+        }
+
+        {
+            auto keep_warm = rapidjson::Value(rapidjson::kObjectType);
+
+            keep_warm.AddMember("type", rapidjson::Value(data[6]),                  result.GetAllocator());
+            keep_warm.AddMember("time", rapidjson::Value((data[7] << 8) | data[8]), result.GetAllocator());
+
+            result.AddMember("keep_warm", keep_warm, result.GetAllocator());
+        }
+
+        const std::string address_str(address);
+        result.AddMember("address", rapidjson::Value(address_str.c_str(), static_cast<rapidjson::SizeType>(address_str.length()), result.GetAllocator()), result.GetAllocator());
+
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        result.Accept(writer);
+
+        return std::string(buffer.GetString(), buffer.GetSize());
+    }
+
+    template<typename FunT>
+    void run_counted(std::string_view name, FunT fun)
+    {
+        const std::size_t before = g_allocations.load();
+        bench::run(name, ITERATIONS, fun);
+        std::printf("  %.2f allocations/op\n", static_cast<double>(g_allocations.load() - before) / ITERATIONS);
+    }
+}
+
+void* operator new(std::size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (void* memory = std::malloc(size ? size : 1); memory)
+    {
+        return memory;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+int main()
+{
+    const uint8_t mac[] = { 0xa4, 0xc1, 0x38, 0x00, 0x00, 0x01 };
+
+    std::array<char, hub::utils::mac::MAC_STR_SIZE> address_buffer;
+    hub::utils::mac(mac, mac + sizeof(mac)).to_charbuff(address_buffer.begin());
+    const std::string_view address(address_buffer.data(), address_buffer.size());
+
+    {
+        hub::utils::json::fixed_writer<status::MESSAGE_SIZE> writer;
+        status::decode(PAYLOAD.data(), PAYLOAD.size())->write(writer, address);
+        std::printf("%.*s\n", static_cast<int>(writer.view().size()), writer.view().data());
+    }
+
+    run_counted("mikettle: document and string", [&](std::size_t) {
+        auto payload = write_document(PAYLOAD.data(), address);
+        bench::do_not_optimize(payload);
+    });
+
+    run_counted("mikettle: decode only", [&](std::size_t) {
+        auto decoded = status::decode(PAYLOAD.data(), PAYLOAD.size());
+        bench::do_not_optimize(decoded);
+    });
+
+    run_counted("mikettle: decode and fixed writer", [&](std::size_t) {
+        hub::utils::json::fixed_writer<status::MESSAGE_SIZE> writer;
+
+        if (auto decoded = status::decode(PAYLOAD.data(), PAYLOAD.size()); decoded)
+        {
+            decoded->write(writer, address);
+        }
+
+        bench::do_not_optimize(writer);
+    });
+
+    return 0;
+}
\ No newline at end of file
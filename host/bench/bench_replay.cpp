@@ -0,0 +1,155 @@
+#include "bench.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include "shim/bluedroid.hpp"
+#include "ble/scanner.hpp"
+#include "ble/recording.hpp"
+
+namespace
+{
+    constexpr std::size_t RECORDS               = 100000;
+    constexpr std::size_t DEVICES               = 300;
+    constexpr uint32_t    MEAN_INTERVAL_US      = 500;
+
+    /**
+     * @brief Busy room: a few hundred devices advertising every 100 ms - 1 s, some sensors changing their payload.
+     */
+    std::vector<uint8_t> make_log()
+    {
+        using namespace hub::ble;
+
+        std::vector<uint8_t> log(recording::HEADER_SIZE);
+        recording::encode_header(log.data());
+
+        std::mt19937 generator{ 42 };
+        std::exponential_distribution<double> interval{ 1.0 / MEAN_INTERVAL_US };
+        std::uniform_int_distribution<std::size_t> device{ 0, DEVICES - 1 };
+        std::uniform_int_distribution<int> rssi{ -95, -40 };
+
+        recording::scan_result_type scan_result{  };
+        std::array<uint8_t, recording::MAX_RECORD_SIZE> record;
+
+        for (std::size_t i = 0; i < RECORDS; i++)
+        {
+            const std::size_t id = device(generator);
+            const uint8_t payload[] = {
+                0x02, ESP_BLE_AD_TYPE_FLAG, 0x06,
+                0x08, ESP_BLE_AD_TYPE_NAME_CMPL, 'S', 'e', 'n', 's', 'o', 'r', static_cast<uint8_t>('0' + id % 10),
+                0x07, ESP_BLE_AD_TYPE_SERVICE_DATA, 0xd2, 0xfc, 0x40, 0x02, static_cast<uint8_t>(id), static_cast<uint8_t>((id % 4 == 0) ? i : 0)
+            };
+
+            scan_result.search_evt      = ESP_GAP_SEARCH_INQ_RES_EVT;
+            scan_result.ble_addr_type   = BLE_ADDR_TYPE_PUBLIC;
+            scan_result.ble_evt_type    = (id % 3 == 0) ? ESP_BLE_EVT_NON_CONN_ADV : ESP_BLE_EVT_CONN_ADV;
+            scan_result.rssi            = rssi(generator);
+            scan_result.adv_data_len    = sizeof(payload);
+            scan_result.scan_rsp_len    = 0;
+
+            const uint8_t address[] = { 0xa4, 0xc1, 0x38, 0x00, static_cast<uint8_t>(id >> 8), static_cast<uint8_t>(id) };
+            std::copy(std::begin(address), std::end(address), scan_result.bda);
+            std::copy(std::begin(payload), std::end(payload), scan_result.ble_adv);
+
+            const auto length = recording::encode(scan_result, static_cast<uint32_t>(interval(generator)), record.data());
+            log.insert(log.end(), record.begin(), record.begin() + length);
+        }
+
+        return log;
+    }
+
+    std::vector<uint8_t> read_log(const char* path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+}
+
+/**
+ * @brief Replay a scan log through the whole scanner pipeline: GAP callback, filters, queue and subscriber.
+ * 
+ * Usage: bench_replay [log file | -] [speed]
+ * Without a log file (or with "-") a synthetic busy environment is generated. Speed 0 (default) replays as fast as possible.
+ */
+int main(int argc, char** argv)
+{
+    using namespace hub;
+
+    esp_log_level_set("*", ESP_LOG_WARN);
+
+    const auto log      = (argc > 1 && std::string_view(argv[1]) != "-") ? read_log(argv[1]) : make_log();
+    const double speed  = (argc > 2) ? std::atof(argv[2]) : 0.0;
+
+    auto factory = ble::scanner::get_observable_factory(ble::scanner::config_t{ timing::seconds(1) });
+    std::atomic<std::size_t> received{ 0 };
+    std::promise<void> completed;
+
+    auto subscription = factory(0).subscribe(
+        [&received](ble::scanner::message_type message) {
+            bench::do_not_optimize(message);
+            received++;
+        },
+        [&completed]() {
+            completed.set_value();
+        });
+
+    shim::bluedroid::flush();
+
+    // Record the replayed stream as well, which measures the recording overhead and checks the round trip.
+    std::vector<uint8_t> rerecorded;
+    std::mutex rerecorded_mutex;
+    auto recorder = std::make_unique<ble::recording::recorder>([&rerecorded, &rerecorded_mutex](const uint8_t* data, std::size_t length) {
+        std::lock_guard lock{ rerecorded_mutex };
+        rerecorded.insert(rerecorded.end(), data, data + length);
+    });
+
+    ble::scanner::set_recorder(recorder.get());
+
+    const auto start = std::chrono::steady_clock::now();
+
+    auto replayed = ble::recording::replay(log.data(), log.size(), speed, [](esp_ble_gap_cb_param_t& param) {
+        shim::bluedroid::gap::dispatch(ESP_GAP_BLE_SCAN_RESULT_EVT, &param);
+    });
+
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    shim::bluedroid::gap::complete_scan();
+    completed.get_future().wait();
+    subscription.unsubscribe();
+
+    ble::scanner::set_recorder(nullptr);
+    const uint32_t recorder_dropped = recorder->get_dropped_count();
+    recorder.reset();
+
+    if (!replayed)
+    {
+        std::printf("invalid log\n");
+        return 1;
+    }
+
+    std::size_t rerecorded_count = 0;
+    auto counted = ble::recording::replay(rerecorded.data(), rerecorded.size(), 0, [&rerecorded_count](esp_ble_gap_cb_param_t&) {
+        rerecorded_count++;
+    });
+
+    const auto statistics = ble::scanner::get_statistics();
+
+    std::printf("replayed %zu records in %.3f s, %.0f records/s\n", *replayed, elapsed, *replayed / elapsed);
+    std::printf("forwarded %u, suppressed %u, dropped %u, delivered %zu\n",
+        statistics.forwarded, statistics.suppressed, statistics.dropped, received.load());
+    std::printf("callback duration: mean %u us, p50 < %llu us, p99 < %llu us, max %u us\n",
+        statistics.callback_duration.mean(),
+        static_cast<unsigned long long>(statistics.callback_duration.percentile(50)),
+        static_cast<unsigned long long>(statistics.callback_duration.percentile(99)),
+        statistics.callback_duration.max);
+    std::printf("re-recorded %zu records, %u dropped by the recorder\n", rerecorded_count, recorder_dropped);
+
+    return (counted && rerecorded_count + recorder_dropped == *replayed) ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+#include "bench.hpp"
+
+#include <array>
+#include <atomic>
+#include <future>
+#include <vector>
+
+#include "shim/bluedroid.hpp"
+#include "ble/scanner.hpp"
+
+namespace
+{
+    constexpr std::size_t ITERATIONS    = 200000;
+    constexpr std::size_t DEVICES       = 64;
+
+    struct advertisement
+    {
+        std::array<uint8_t, ESP_BD_ADDR_LEN>    address;
+        std::vector<uint8_t>                    data;
+    };
+
+    std::vector<advertisement> make_advertisements()
+    {
+        std::vector<advertisement> result;
+
+        for (std::size_t i = 0; i < DEVICES; i++)
+        {
+            advertisement adv{ { 0xa4, 0xc1, 0x38, 0x00, static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i) }, {} };
+
+            // Flags, complete local name, service data.
+            adv.data = { 0x02, ESP_BLE_AD_TYPE_FLAG, 0x06 };
+            adv.data.insert(adv.data.end(), { 0x0a, ESP_BLE_AD_TYPE_NAME_CMPL, 'M', 'i', 'K', 'e', 't', 't', 'l', 'e', static_cast<uint8_t>('0' + i % 10) });
+            adv.data.insert(adv.data.end(), { 0x06, ESP_BLE_AD_TYPE_SERVICE_DATA, 0x95, 0xfe, 0x50, 0x20, static_cast<uint8_t>(i) });
+
+            result.push_back(std::move(adv));
+        }
+
+        return result;
+    }
+}
+
+int main()
+{
+    using namespace hub;
+
+    esp_log_level_set("*", ESP_LOG_WARN);
+
+    const auto advertisements   = make_advertisements();
+    auto factory                = ble::scanner::get_observable_factory(ble::scanner::config_t{ timing::miliseconds(0) });
+    std::atomic<std::size_t> received{ 0 };
+    std::promise<void> completed;
+
+    auto subscription = factory(0).subscribe(
+        [&received](ble::scanner::message_type message) {
+            bench::do_not_optimize(message);
+            received++;
+        },
+        [&completed]() {
+            completed.set_value();
+        });
+
+    shim::bluedroid::flush();
+
+    bench::run("scanner: GAP callback (producer side)", ITERATIONS, [&advertisements](std::size_t i) {
+        const auto& adv = advertisements[i % DEVICES];
+        shim::bluedroid::gap::scan_result(adv.address.data(), BLE_ADDR_TYPE_PUBLIC, -60, adv.data.data(), static_cast<uint8_t>(adv.data.size()));
+    });
+
+    shim::bluedroid::gap::complete_scan();
+    completed.get_future().wait();
+    subscription.unsubscribe();
+
+    const std::size_t dropped = ble::scanner::get_dropped_count();
+
+    std::printf("delivered %zu, dropped %zu of %zu scan results\n", received.load(), dropped, ITERATIONS);
+    return (received + dropped == ITERATIONS) ? 0 : 1;
+}
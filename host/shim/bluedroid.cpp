@@ -0,0 +1,1447 @@
+#include "shim/bluedroid.hpp"
+
+#include "esp_bt.h"
+#include "esp_bt_main.h"
+#include "esp_gatt_common_api.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <set>
+#include <thread>
+
+#include "worker.hpp"
+
+namespace shim::bluedroid
+{
+    namespace
+    {
+        struct prepared_write
+        {
+            uint16_t                handle;
+            uint16_t                offset;
+            std::vector<uint8_t>    value;
+        };
+
+        struct connection
+        {
+            uint16_t                    conn_id;
+            esp_gatt_if_t               gattc_if;
+            address_type                address;
+            std::shared_ptr<peripheral> device;
+            std::set<uint16_t>          notify_handles;
+            std::vector<prepared_write> prepared_writes;
+            bool                        discovered;
+        };
+
+        struct state
+        {
+            std::mutex                                      mutex;
+            esp_gap_ble_cb_t                                gap_callback{ nullptr };
+            esp_gattc_cb_t                                  gattc_callback{ nullptr };
+            std::map<address_type, std::shared_ptr<peripheral>> peripherals;
+            std::map<uint16_t, connection>                  connections;
+            std::map<esp_gatt_if_t, uint16_t>               apps;
+            esp_gatt_if_t                                   next_gattc_if{ 3 };
+            uint16_t                                        next_conn_id{ 0 };
+            uint16_t                                        local_mtu{ ESP_GATT_DEF_BLE_MTU_SIZE };
+            bool                                            scanning{ false };
+            uint32_t                                        scan_duration{ 0 };
+            esp_ble_scan_params_t                           scan_params{  };
+            std::set<std::pair<address_type, esp_ble_wl_addr_type_t>> whitelist;
+            std::atomic<std::size_t>                        request_count{ 0 };
+        };
+
+        state& get_state()
+        {
+            static state s_state;
+            return s_state;
+        }
+
+        worker& get_btc_task()
+        {
+            static worker s_worker;
+            return s_worker;
+        }
+
+        // Serializes callback invocations between the BTC worker and synchronous dispatch from drivers.
+        std::mutex& get_dispatch_mutex()
+        {
+            static std::mutex s_mutex;
+            return s_mutex;
+        }
+
+        address_type to_address(const uint8_t* address) noexcept
+        {
+            address_type result;
+            std::copy(address, address + ESP_BD_ADDR_LEN, result.begin());
+            return result;
+        }
+
+        bool uuid_equal(const esp_bt_uuid_t& left, const esp_bt_uuid_t& right) noexcept
+        {
+            if (left.len != right.len)
+            {
+                return false;
+            }
+
+            switch (left.len)
+            {
+            case ESP_UUID_LEN_16:
+                return left.uuid.uuid16 == right.uuid.uuid16;
+            case ESP_UUID_LEN_32:
+                return left.uuid.uuid32 == right.uuid.uuid32;
+            case ESP_UUID_LEN_128:
+                return std::memcmp(left.uuid.uuid128, right.uuid.uuid128, ESP_UUID_LEN_128) == 0;
+            default:
+                return false;
+            }
+        }
+
+        void invoke_gap(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param)
+        {
+            esp_gap_ble_cb_t callback;
+
+            {
+                std::lock_guard lock{ get_state().mutex };
+                callback = get_state().gap_callback;
+            }
+
+            if (callback)
+            {
+                std::lock_guard lock{ get_dispatch_mutex() };
+                callback(event, param);
+            }
+        }
+
+        void invoke_gattc(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t* param)
+        {
+            esp_gattc_cb_t callback;
+
+            {
+                std::lock_guard lock{ get_state().mutex };
+                callback = get_state().gattc_callback;
+            }
+
+            if (callback)
+            {
+                std::lock_guard lock{ get_dispatch_mutex() };
+                callback(event, gattc_if, param);
+            }
+        }
+
+        /**
+         * @brief Deliver a connection event to every registered interface, as Bluedroid reports connections
+         * and disconnections to all applications, not only to the one that opened the link.
+         */
+        void broadcast_gattc(esp_gattc_cb_event_t event, const esp_ble_gattc_cb_param_t& param)
+        {
+            std::vector<esp_gatt_if_t> interfaces;
+
+            {
+                std::lock_guard lock{ get_state().mutex };
+
+                for (const auto& [gattc_if, app_id] : get_state().apps)
+                {
+                    interfaces.push_back(gattc_if);
+                }
+            }
+
+            for (esp_gatt_if_t gattc_if : interfaces)
+            {
+                esp_ble_gattc_cb_param_t copy = param;
+                invoke_gattc(event, gattc_if, &copy);
+            }
+        }
+
+        void post_gap(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t param)
+        {
+            get_btc_task().post([event, param]() mutable {
+                invoke_gap(event, &param);
+            });
+        }
+
+        void post_gattc(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t param)
+        {
+            get_btc_task().post([event, gattc_if, param]() mutable {
+                invoke_gattc(event, gattc_if, &param);
+            });
+        }
+
+        /**
+         * @brief Run a request against the connected peripheral on the BTC worker after the simulated link latency.
+         * The handler returns the event parameters to deliver, or false to deliver nothing.
+         *
+         * @param round_trip False for writes without response, they go out with the next request instead of waiting for one.
+         */
+        template<typename HandlerT>
+        esp_err_t post_request(esp_gatt_if_t gattc_if, uint16_t conn_id, HandlerT handler, bool round_trip = true)
+        {
+            get_state().request_count++;
+
+            get_btc_task().post([gattc_if, conn_id, handler{ std::move(handler) }, round_trip]() mutable {
+                std::shared_ptr<peripheral> device;
+
+                {
+                    std::lock_guard lock{ get_state().mutex };
+
+                    if (auto iter = get_state().connections.find(conn_id);
+                        iter != get_state().connections.end() && iter->second.gattc_if == gattc_if)
+                    {
+                        device = iter->second.device;
+                    }
+                }
+
+                if (device && round_trip && device->get_latency().count() > 0)
+                {
+                    std::this_thread::sleep_for(device->get_latency());
+                }
+
+                handler(device);
+            });
+
+            return ESP_OK;
+        }
+
+        template<typename FunT>
+        void for_each_characteristic(const peripheral& device, uint16_t start_handle, uint16_t end_handle, FunT fun)
+        {
+            for (const auto& service : device.get_services())
+            {
+                for (const auto& characteristic : service.characteristics)
+                {
+                    if (characteristic.handle >= start_handle && characteristic.handle <= end_handle)
+                    {
+                        fun(characteristic);
+                    }
+                }
+            }
+        }
+
+        const peripheral::characteristic_def* find_characteristic_def(const peripheral& device, uint16_t handle) noexcept
+        {
+            for (const auto& service : device.get_services())
+            {
+                for (const auto& characteristic : service.characteristics)
+                {
+                    if (characteristic.handle == handle)
+                    {
+                        return &characteristic;
+                    }
+                }
+            }
+
+            return nullptr;
+        }
+
+        std::shared_ptr<peripheral> get_discovered_device(esp_gatt_if_t gattc_if, uint16_t conn_id)
+        {
+            std::lock_guard lock{ get_state().mutex };
+
+            if (auto iter = get_state().connections.find(conn_id);
+                iter != get_state().connections.end() && iter->second.gattc_if == gattc_if && iter->second.discovered)
+            {
+                return iter->second.device;
+            }
+
+            return nullptr;
+        }
+    }
+
+    uint16_t peripheral::add_service(esp_bt_uuid_t uuid, bool is_primary)
+    {
+        uint16_t handle = m_next_handle++;
+        m_services.push_back(service_def{ handle, handle, uuid, is_primary, {} });
+        return handle;
+    }
+
+    uint16_t peripheral::add_characteristic(esp_bt_uuid_t uuid, esp_gatt_char_prop_t properties, std::vector<uint8_t> value)
+    {
+        // Characteristic declaration and value occupy two handles, the value handle is reported.
+        m_next_handle++;
+        uint16_t handle = m_next_handle++;
+        m_services.back().characteristics.push_back(characteristic_def{ handle, uuid, properties, std::move(value), {} });
+        m_services.back().end_handle = handle;
+        return handle;
+    }
+
+    uint16_t peripheral::add_descriptor(esp_bt_uuid_t uuid, std::vector<uint8_t> value)
+    {
+        uint16_t handle = m_next_handle++;
+        m_services.back().characteristics.back().descriptors.push_back(descriptor_def{ handle, uuid, std::move(value) });
+        m_services.back().end_handle = handle;
+        return handle;
+    }
+
+    uint16_t peripheral::find_characteristic(esp_bt_uuid_t uuid) const noexcept
+    {
+        for (const auto& service : m_services)
+        {
+            for (const auto& characteristic : service.characteristics)
+            {
+                if (uuid_equal(characteristic.uuid, uuid))
+                {
+                    return characteristic.handle;
+                }
+            }
+        }
+
+        return ESP_GATT_ILLEGAL_HANDLE;
+    }
+
+    void peripheral::notify(uint16_t handle, std::vector<uint8_t> value)
+    {
+        std::vector<std::pair<esp_gatt_if_t, esp_ble_gattc_cb_param_t>> targets;
+
+        {
+            std::lock_guard lock{ get_state().mutex };
+
+            for (const auto& [conn_id, conn] : get_state().connections)
+            {
+                if (conn.device.get() != this || conn.notify_handles.count(handle) == 0)
+                {
+                    continue;
+                }
+
+                esp_ble_gattc_cb_param_t param{  };
+                param.notify.conn_id    = conn_id;
+                param.notify.handle     = handle;
+                param.notify.value_len  = static_cast<uint16_t>(value.size());
+                param.notify.is_notify  = true;
+                std::copy(conn.address.begin(), conn.address.end(), param.notify.remote_bda);
+
+                targets.emplace_back(conn.gattc_if, param);
+            }
+        }
+
+        for (auto& [gattc_if, param] : targets)
+        {
+            get_btc_task().post([gattc_if{ gattc_if }, param{ param }, value]() mutable {
+                param.notify.value = value.data();
+                invoke_gattc(ESP_GATTC_NOTIFY_EVT, gattc_if, &param);
+            });
+        }
+    }
+
+    std::vector<uint8_t>* peripheral::find_value(uint16_t handle) noexcept
+    {
+        for (auto& service : m_services)
+        {
+            for (auto& characteristic : service.characteristics)
+            {
+                if (characteristic.handle == handle)
+                {
+                    return &characteristic.value;
+                }
+
+                for (auto& descriptor : characteristic.descriptors)
+                {
+                    if (descriptor.handle == handle)
+                    {
+                        return &descriptor.value;
+                    }
+                }
+            }
+        }
+
+        return nullptr;
+    }
+
+    esp_gatt_status_t peripheral::on_read(uint16_t handle, std::vector<uint8_t>& value)
+    {
+        if (auto stored = find_value(handle); stored)
+        {
+            value = *stored;
+            return ESP_GATT_OK;
+        }
+
+        return ESP_GATT_INVALID_HANDLE;
+    }
+
+    esp_gatt_status_t peripheral::on_write(uint16_t handle, const std::vector<uint8_t>& value)
+    {
+        if (auto stored = find_value(handle); stored)
+        {
+            *stored = value;
+            return ESP_GATT_OK;
+        }
+
+        return ESP_GATT_INVALID_HANDLE;
+    }
+
+    void add_peripheral(const uint8_t* address, std::shared_ptr<peripheral> device)
+    {
+        device->m_address = to_address(address);
+
+        std::lock_guard lock{ get_state().mutex };
+        get_state().peripherals[to_address(address)] = std::move(device);
+    }
+
+    void remove_peripheral(const uint8_t* address)
+    {
+        std::lock_guard lock{ get_state().mutex };
+        get_state().peripherals.erase(to_address(address));
+    }
+
+    void drop_connection(const uint8_t* address, esp_gatt_conn_reason_t reason)
+    {
+        const auto remote = to_address(address);
+
+        get_btc_task().post([remote, reason]() {
+            std::vector<connection> dropped;
+
+            {
+                std::lock_guard lock{ get_state().mutex };
+                auto& connections = get_state().connections;
+
+                for (auto iter = connections.begin(); iter != connections.end();)
+                {
+                    if (iter->second.address == remote)
+                    {
+                        dropped.push_back(std::move(iter->second));
+                        iter = connections.erase(iter);
+                    }
+                    else
+                    {
+                        ++iter;
+                    }
+                }
+            }
+
+            for (const auto& conn : dropped)
+            {
+                esp_ble_gattc_cb_param_t param{  };
+                param.disconnect.reason     = reason;
+                param.disconnect.conn_id    = conn.conn_id;
+                std::copy(remote.begin(), remote.end(), param.disconnect.remote_bda);
+                broadcast_gattc(ESP_GATTC_DISCONNECT_EVT, param);
+
+                param = esp_ble_gattc_cb_param_t{  };
+                param.close.status  = ESP_GATT_OK;
+                param.close.conn_id = conn.conn_id;
+                param.close.reason  = reason;
+                std::copy(remote.begin(), remote.end(), param.close.remote_bda);
+                invoke_gattc(ESP_GATTC_CLOSE_EVT, conn.gattc_if, &param);
+            }
+        });
+    }
+
+    void flush()
+    {
+        get_btc_task().flush();
+    }
+
+    void reset()
+    {
+        flush();
+
+        std::lock_guard lock{ get_state().mutex };
+        auto& state = get_state();
+
+        state.gap_callback      = nullptr;
+        state.gattc_callback    = nullptr;
+        state.peripherals.clear();
+        state.connections.clear();
+        state.apps.clear();
+        state.next_gattc_if     = 3;
+        state.next_conn_id      = 0;
+        state.local_mtu         = ESP_GATT_DEF_BLE_MTU_SIZE;
+        state.scanning          = false;
+        state.scan_duration     = 0;
+        state.scan_params       = esp_ble_scan_params_t{  };
+        state.whitelist.clear();
+        state.request_count     = 0;
+    }
+
+    namespace gap
+    {
+        void scan_result(
+            const uint8_t*      address,
+            esp_ble_addr_type_t addr_type,
+            int                 rssi,
+            const uint8_t*      adv,
+            uint8_t             adv_data_len,
+            uint8_t             scan_rsp_len)
+        {
+            {
+                std::lock_guard lock{ get_state().mutex };
+                const auto& state = get_state();
+
+                if (state.scan_params.scan_filter_policy == BLE_SCAN_FILTER_ALLOW_ONLY_WLST &&
+                    !state.whitelist.count({ to_address(address), (addr_type == BLE_ADDR_TYPE_PUBLIC) ? BLE_WL_ADDR_TYPE_PUBLIC : BLE_WL_ADDR_TYPE_RANDOM }))
+                {
+                    return;
+                }
+            }
+
+            esp_ble_gap_cb_param_t param;
+
+            param.scan_rst.search_evt       = ESP_GAP_SEARCH_INQ_RES_EVT;
+            param.scan_rst.dev_type         = ESP_BT_DEVICE_TYPE_BLE;
+            param.scan_rst.ble_addr_type    = addr_type;
+            param.scan_rst.ble_evt_type     = ESP_BLE_EVT_CONN_ADV;
+            param.scan_rst.rssi             = rssi;
+            param.scan_rst.flag             = 0;
+            param.scan_rst.num_resps        = 1;
+            param.scan_rst.adv_data_len     = adv_data_len;
+            param.scan_rst.scan_rsp_len     = scan_rsp_len;
+            param.scan_rst.num_dis          = 0;
+
+            std::copy(address, address + ESP_BD_ADDR_LEN, param.scan_rst.bda);
+            std::fill(std::begin(param.scan_rst.ble_adv), std::end(param.scan_rst.ble_adv), 0);
+            std::copy(
+                adv,
+                adv + std::min<std::size_t>(adv_data_len + scan_rsp_len, sizeof(param.scan_rst.ble_adv)),
+                param.scan_rst.ble_adv);
+
+            invoke_gap(ESP_GAP_BLE_SCAN_RESULT_EVT, &param);
+        }
+
+        void complete_scan()
+        {
+            {
+                std::lock_guard lock{ get_state().mutex };
+                get_state().scanning = false;
+            }
+
+            esp_ble_gap_cb_param_t param{  };
+            param.scan_rst.search_evt = ESP_GAP_SEARCH_INQ_CMPL_EVT;
+
+            invoke_gap(ESP_GAP_BLE_SCAN_RESULT_EVT, &param);
+        }
+
+        void dispatch(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param)
+        {
+            invoke_gap(event, param);
+        }
+
+        bool is_scanning() noexcept
+        {
+            std::lock_guard lock{ get_state().mutex };
+            return get_state().scanning;
+        }
+
+        uint32_t get_scan_duration() noexcept
+        {
+            std::lock_guard lock{ get_state().mutex };
+            return get_state().scan_duration;
+        }
+
+        std::size_t get_whitelist_count() noexcept
+        {
+            std::lock_guard lock{ get_state().mutex };
+            return get_state().whitelist.size();
+        }
+
+        esp_ble_scan_params_t get_scan_params() noexcept
+        {
+            std::lock_guard lock{ get_state().mutex };
+            return get_state().scan_params;
+        }
+    }
+
+    namespace gattc
+    {
+        void dispatch(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t* param)
+        {
+            invoke_gattc(event, gattc_if, param);
+        }
+
+        std::size_t get_request_count() noexcept
+        {
+            return get_state().request_count;
+        }
+
+        esp_gatt_if_t get_interface(uint16_t app_id) noexcept
+        {
+            std::lock_guard lock{ get_state().mutex };
+
+            for (const auto& [gattc_if, registered_app_id] : get_state().apps)
+            {
+                if (registered_app_id == app_id)
+                {
+                    return gattc_if;
+                }
+            }
+
+            return ESP_GATT_IF_NONE;
+        }
+    }
+}
+
+using namespace shim::bluedroid;
+
+extern "C"
+{
+    esp_err_t esp_bt_controller_init(esp_bt_controller_config_t* cfg)
+    {
+        return cfg ? ESP_OK : ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t esp_bt_controller_deinit(void)
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t esp_bt_controller_enable(esp_bt_mode_t mode)
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t esp_bt_controller_disable(void)
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t esp_bluedroid_init(void)
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t esp_bluedroid_deinit(void)
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t esp_bluedroid_enable(void)
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t esp_bluedroid_disable(void)
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t esp_ble_gatt_set_local_mtu(uint16_t mtu)
+    {
+        if (mtu < ESP_GATT_DEF_BLE_MTU_SIZE || mtu > ESP_GATT_MAX_MTU_SIZE)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        std::lock_guard lock{ get_state().mutex };
+        get_state().local_mtu = mtu;
+        return ESP_OK;
+    }
+
+    esp_err_t esp_ble_gap_register_callback(esp_gap_ble_cb_t callback)
+    {
+        std::lock_guard lock{ get_state().mutex };
+        get_state().gap_callback = callback;
+        return ESP_OK;
+    }
+
+    esp_err_t esp_ble_gap_set_scan_params(esp_ble_scan_params_t* scan_params)
+    {
+        if (!scan_params || scan_params->scan_window > scan_params->scan_interval)
+        {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        {
+            std::lock_guard lock{ get_state().mutex };
+            get_state().scan_params = *scan_params;
+        }
+
+        esp_ble_gap_cb_param_t param{  };
+        param.scan_param_cmpl.status = ESP_BT_STATUS_SUCCESS;
+        post_gap(ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT, param);
+
+        return ESP_OK;
+    }
+
+    esp_err_t esp_ble_gap_start_scanning(uint32_t duration)
+    {
+        {
+            std::lock_guard lock{ get_state().mutex };
+            get_state().scanning        = true;
+            get_state().scan_duration   = duration;
+        }
+
+        esp_ble_gap_cb_param_t param{  };
+        param.scan_start_cmpl.status = ESP_BT_STATUS_SUCCESS;
+        post_gap(ESP_GAP_BLE_SCAN_START_COMPLETE_EVT, param);
+
+        return ESP_OK;
+    }
+
+    esp_err_t esp_ble_gap_stop_scanning(void)
+    {
+        {
+            std::lock_guard lock{ get_state().mutex };
+            get_state().scanning = false;
+        }
+
+        esp_ble_gap_cb_param_t param{  };
+        param.scan_stop_cmpl.status = ESP_BT_STATUS_SUCCESS;
+        post_gap(ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT, param);
+
+        return ESP_OK;
+    }
+
+    esp_err_t esp_ble_gap_update_conn_params(esp_ble_conn_update_params_t* params)
+    {
+        if (!params || params->min_int > params->max_int)
+        {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        esp_ble_gap_cb_param_t param{  };
+        param.update_conn_params.status = ESP_BT_STATUS_FAIL;
+        std::copy(std::begin(params->bda), std::end(params->bda), param.update_conn_params.bda);
+
+        {
+            std::lock_guard lock{ get_state().mutex };
+
+            const auto address = to_address(params->bda);
+
+            // Peripherals accept the request and settle on the longest interval allowed.
+            if (std::any_of(get_state().connections.cbegin(), get_state().connections.cend(), [&address](const auto& conn) {
+                    return conn.second.address == address;
+                }))
+            {
+                param.update_conn_params.status     = ESP_BT_STATUS_SUCCESS;
+                param.update_conn_params.min_int    = params->min_int;
+                param.update_conn_params.max_int    = params->max_int;
+                param.update_conn_params.latency    = params->latency;
+                param.update_conn_params.conn_int   = params->max_int;
+                param.update_conn_params.timeout    = params->timeout;
+            }
+        }
+
+        post_gap(ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT, param);
+        return ESP_OK;
+    }
+
+    esp_err_t esp_ble_gap_read_rssi(esp_bd_addr_t remote_addr)
+    {
+        if (!remote_addr)
+        {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        esp_ble_gap_cb_param_t param{  };
+        param.read_rssi_cmpl.status = ESP_BT_STATUS_FAIL;
+        std::copy(remote_addr, remote_addr + ESP_BD_ADDR_LEN, param.read_rssi_cmpl.remote_addr);
+
+        {
+            std::lock_guard lock{ get_state().mutex };
+
+            const auto address = to_address(remote_addr);
+
+            for (const auto& conn : get_state().connections)
+            {
+                if (conn.second.address == address)
+                {
+                    param.read_rssi_cmpl.status = ESP_BT_STATUS_SUCCESS;
+                    param.read_rssi_cmpl.rssi   = conn.second.device->get_rssi();
+                    break;
+                }
+            }
+        }
+
+        post_gap(ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT, param);
+        return ESP_OK;
+    }
+
+    esp_err_t esp_ble_gap_update_whitelist(bool add_remove, esp_bd_addr_t remote_bda, esp_ble_wl_addr_type_t wl_addr_type)
+    {
+        if (!remote_bda)
+        {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        esp_ble_gap_cb_param_t param{  };
+        param.update_whitelist_cmpl.status      = ESP_BT_STATUS_SUCCESS;
+        param.update_whitelist_cmpl.wl_opration = add_remove ? ESP_BLE_WHITELIST_ADD : ESP_BLE_WHITELIST_REMOVE;
+
+        {
+            std::lock_guard lock{ get_state().mutex };
+            auto& state = get_state();
+            const auto entry = std::make_pair(to_address(remote_bda), wl_addr_type);
+
+            // The controller rejects changes while the list is in use and additions beyond its capacity.
+            if ((state.scanning && state.scan_params.scan_filter_policy == BLE_SCAN_FILTER_ALLOW_ONLY_WLST) ||
+                (add_remove && !state.whitelist.count(entry) && state.whitelist.size() == shim::bluedroid::gap::WHITELIST_SIZE))
+            {
+                param.update_whitelist_cmpl.status = ESP_BT_STATUS_FAIL;
+            }
+            else if (add_remove)
+            {
+                state.whitelist.insert(entry);
+            }
+            else
+            {
+                state.whitelist.erase(entry);
+            }
+        }
+
+        post_gap(ESP_GAP_BLE_UPDATE_WHITELIST_COMPLETE_EVT, param);
+        return ESP_OK;
+    }
+
+    esp_err_t esp_ble_gap_clear_whitelist(void)
+    {
+        esp_ble_gap_cb_param_t param{  };
+        param.update_whitelist_cmpl.status      = ESP_BT_STATUS_SUCCESS;
+        param.update_whitelist_cmpl.wl_opration = ESP_BLE_WHITELIST_CLEAR;
+
+        {
+            std::lock_guard lock{ get_state().mutex };
+            auto& state = get_state();
+
+            if (state.scanning && state.scan_params.scan_filter_policy == BLE_SCAN_FILTER_ALLOW_ONLY_WLST)
+            {
+                param.update_whitelist_cmpl.status = ESP_BT_STATUS_FAIL;
+            }
+            else
+            {
+                state.whitelist.clear();
+            }
+        }
+
+        post_gap(ESP_GAP_BLE_UPDATE_WHITELIST_COMPLETE_EVT, param);
+        return ESP_OK;
+    }
+
+    esp_err_t esp_ble_gap_get_whitelist_size(uint16_t* length)
+    {
+        if (!length)
+        {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        *length = shim::bluedroid::gap::WHITELIST_SIZE;
+        return ESP_OK;
+    }
+
+    uint8_t* esp_ble_resolve_adv_data(uint8_t* adv_data, uint8_t type, uint8_t* length)
+    {
+        constexpr uint8_t max_length = ESP_BLE_ADV_DATA_LEN_MAX + ESP_BLE_SCAN_RSP_DATA_LEN_MAX;
+
+        if (!adv_data || !length)
+        {
+            return nullptr;
+        }
+
+        uint8_t offset = 0;
+
+        while (offset < max_length)
+        {
+            uint8_t field_length = adv_data[offset];
+
+            if (field_length == 0 || offset + 1 + field_length > max_length)
+            {
+                break;
+            }
+
+            if (adv_data[offset + 1] == type)
+            {
+                *length = field_length - 1;
+                return adv_data + offset + 2;
+            }
+
+            offset += field_length + 1;
+        }
+
+        *length = 0;
+        return nullptr;
+    }
+
+    esp_err_t esp_ble_gattc_register_callback(esp_gattc_cb_t callback)
+    {
+        std::lock_guard lock{ get_state().mutex };
+        get_state().gattc_callback = callback;
+        return ESP_OK;
+    }
+
+    esp_err_t esp_ble_gattc_app_register(uint16_t app_id)
+    {
+        esp_gatt_if_t gattc_if;
+
+        {
+            std::lock_guard lock{ get_state().mutex };
+            gattc_if = get_state().next_gattc_if++;
+            get_state().apps[gattc_if] = app_id;
+        }
+
+        esp_ble_gattc_cb_param_t param{  };
+        param.reg.status = ESP_GATT_OK;
+        param.reg.app_id = app_id;
+        post_gattc(ESP_GATTC_REG_EVT, gattc_if, param);
+
+        // On the target the BTC task runs at a higher priority than the caller and
+        // delivers REG_EVT before this call returns.
+        get_btc_task().flush();
+
+        return ESP_OK;
+    }
+
+    esp_err_t esp_ble_gattc_app_unregister(esp_gatt_if_t gattc_if)
+    {
+        {
+            std::lock_guard lock{ get_state().mutex };
+
+            if (get_state().apps.erase(gattc_if) == 0)
+            {
+                return ESP_FAIL;
+            }
+        }
+
+        esp_ble_gattc_cb_param_t param{  };
+        post_gattc(ESP_GATTC_UNREG_EVT, gattc_if, param);
+
+        return ESP_OK;
+    }
+
+    esp_err_t esp_ble_gattc_open(esp_gatt_if_t gattc_if, esp_bd_addr_t remote_bda, esp_ble_addr_type_t remote_addr_type, bool is_direct)
+    {
+        auto address = to_address(remote_bda);
+
+        get_state().request_count++;
+
+        get_btc_task().post([gattc_if, address, remote_addr_type]() {
+            std::shared_ptr<peripheral> device;
+            uint16_t conn_id = 0;
+
+            {
+                std::lock_guard lock{ get_state().mutex };
+                auto& state = get_state();
+
+                if (auto iter = state.peripherals.find(address);
+                    iter != state.peripherals.end() && iter->second->get_address_type() == remote_addr_type && state.apps.count(gattc_if) != 0)
+                {
+                    device  = iter->second;
+                    conn_id = state.next_conn_id++;
+                    state.connections[conn_id] = connection{ conn_id, gattc_if, address, device, {}, {}, false };
+                }
+            }
+
+            esp_ble_gattc_cb_param_t param{  };
+
+            if (!device)
+            {
+                param.open.status = ESP_GATT_ERROR;
+                std::copy(address.begin(), address.end(), param.open.remote_bda);
+                invoke_gattc(ESP_GATTC_OPEN_EVT, gattc_if, &param);
+                return;
+            }
+
+            if (device->get_latency().count() > 0)
+            {
+                std::this_thread::sleep_for(device->get_latency());
+            }
+
+            param.connect.conn_id       = conn_id;
+            param.connect.link_role     = 0;
+            param.connect.conn_params   = { 0x28, 0, 0x1f4 };
+            std::copy(address.begin(), address.end(), param.connect.remote_bda);
+            broadcast_gattc(ESP_GATTC_CONNECT_EVT, param);
+
+            param = esp_ble_gattc_cb_param_t{  };
+            param.open.status   = ESP_GATT_OK;
+            param.open.conn_id  = conn_id;
+            param.open.mtu      = ESP_GATT_DEF_BLE_MTU_SIZE;
+            std::copy(address.begin(), address.end(), param.open.remote_bda);
+            invoke_gattc(ESP_GATTC_OPEN_EVT, gattc_if, &param);
+        });
+
+        return ESP_OK;
+    }
+
+    esp_err_t esp_ble_gattc_close(esp_gatt_if_t gattc_if, uint16_t conn_id)
+    {
+        get_state().request_count++;
+
+        get_btc_task().post([gattc_if, conn_id]() {
+            address_type address;
+
+            {
+                std::lock_guard lock{ get_state().mutex };
+                auto iter = get_state().connections.find(conn_id);
+
+                if (iter == get_state().connections.end() || iter->second.gattc_if != gattc_if)
+                {
+                    return;
+                }
+
+                address = iter->second.address;
+                get_state().connections.erase(iter);
+            }
+
+            esp_ble_gattc_cb_param_t param{  };
+            param.disconnect.reason     = ESP_GATT_CONN_TERMINATE_LOCAL_HOST;
+            param.disconnect.conn_id    = conn_id;
+            std::copy(address.begin(), address.end(), param.disconnect.remote_bda);
+            broadcast_gattc(ESP_GATTC_DISCONNECT_EVT, param);
+
+            param = esp_ble_gattc_cb_param_t{  };
+            param.close.status  = ESP_GATT_OK;
+            param.close.conn_id = conn_id;
+            param.close.reason  = ESP_GATT_CONN_TERMINATE_LOCAL_HOST;
+            std::copy(address.begin(), address.end(), param.close.remote_bda);
+            invoke_gattc(ESP_GATTC_CLOSE_EVT, gattc_if, &param);
+        });
+
+        return ESP_OK;
+    }
+
+    esp_err_t esp_ble_gattc_send_mtu_req(esp_gatt_if_t gattc_if, uint16_t conn_id)
+    {
+        return post_request(gattc_if, conn_id, [gattc_if, conn_id](std::shared_ptr<peripheral> device) {
+            esp_ble_gattc_cb_param_t param{  };
+            param.cfg_mtu.conn_id = conn_id;
+
+            if (device)
+            {
+                std::lock_guard lock{ get_state().mutex };
+                param.cfg_mtu.status    = ESP_GATT_OK;
+                param.cfg_mtu.mtu       = std::min(get_state().local_mtu, device->get_mtu());
+            }
+            else
+            {
+                param.cfg_mtu.status    = ESP_GATT_ERROR;
+                param.cfg_mtu.mtu       = ESP_GATT_DEF_BLE_MTU_SIZE;
+            }
+
+            invoke_gattc(ESP_GATTC_CFG_MTU_EVT, gattc_if, &param);
+        });
+    }
+
+    esp_err_t esp_ble_gattc_search_service(esp_gatt_if_t gattc_if, uint16_t conn_id, esp_bt_uuid_t* filter_uuid)
+    {
+        std::optional<esp_bt_uuid_t> filter;
+
+        if (filter_uuid)
+        {
+            filter = *filter_uuid;
+        }
+
+        return post_request(gattc_if, conn_id, [gattc_if, conn_id, filter](std::shared_ptr<peripheral> device) {
+            esp_ble_gattc_cb_param_t param{  };
+
+            if (device)
+            {
+                for (const auto& service : device->get_services())
+                {
+                    if (filter && !uuid_equal(*filter, service.uuid))
+                    {
+                        continue;
+                    }
+
+                    param = esp_ble_gattc_cb_param_t{  };
+                    param.search_res.conn_id        = conn_id;
+                    param.search_res.start_handle   = service.start_handle;
+                    param.search_res.end_handle     = service.end_handle;
+                    param.search_res.srvc_id.uuid   = service.uuid;
+                    param.search_res.srvc_id.inst_id = 0;
+                    param.search_res.is_primary     = service.is_primary;
+                    invoke_gattc(ESP_GATTC_SEARCH_RES_EVT, gattc_if, &param);
+                }
+
+                std::lock_guard lock{ get_state().mutex };
+
+                if (auto iter = get_state().connections.find(conn_id); iter != get_state().connections.end())
+                {
+                    iter->second.discovered = true;
+                }
+            }
+
+            param = esp_ble_gattc_cb_param_t{  };
+            param.search_cmpl.status                    = device ? ESP_GATT_OK : ESP_GATT_ERROR;
+            param.search_cmpl.conn_id                   = conn_id;
+            param.search_cmpl.searched_service_source   = ESP_GATT_SERVICE_FROM_REMOTE_DEVICE;
+            invoke_gattc(ESP_GATTC_SEARCH_CMPL_EVT, gattc_if, &param);
+        });
+    }
+
+    esp_gatt_status_t esp_ble_gattc_get_attr_count(
+        esp_gatt_if_t           gattc_if,
+        uint16_t                conn_id,
+        esp_gatt_db_attr_type_t type,
+        uint16_t                start_handle,
+        uint16_t                end_handle,
+        uint16_t                char_handle,
+        uint16_t*               count)
+    {
+        auto device = get_discovered_device(gattc_if, conn_id);
+
+        if (!device || !count)
+        {
+            return ESP_GATT_INVALID_HANDLE;
+        }
+
+        *count = 0;
+
+        switch (type)
+        {
+        case ESP_GATT_DB_PRIMARY_SERVICE:
+        case ESP_GATT_DB_SECONDARY_SERVICE:
+            for (const auto& service : device->get_services())
+            {
+                if (service.start_handle >= start_handle && service.end_handle <= end_handle &&
+                    service.is_primary == (type == ESP_GATT_DB_PRIMARY_SERVICE))
+                {
+                    ++(*count);
+                }
+            }
+            break;
+        case ESP_GATT_DB_CHARACTERISTIC:
+            for_each_characteristic(*device, start_handle, end_handle, [count](const auto&) { ++(*count); });
+            break;
+        case ESP_GATT_DB_DESCRIPTOR:
+            if (auto characteristic = find_characteristic_def(*device, char_handle); characteristic)
+            {
+                *count = static_cast<uint16_t>(characteristic->descriptors.size());
+            }
+            break;
+        default:
+            for_each_characteristic(*device, start_handle, end_handle, [count](const auto& characteristic) {
+                *count += static_cast<uint16_t>(1 + characteristic.descriptors.size());
+            });
+            break;
+        }
+
+        return ESP_GATT_OK;
+    }
+
+    esp_gatt_status_t esp_ble_gattc_get_all_char(
+        esp_gatt_if_t           gattc_if,
+        uint16_t                conn_id,
+        uint16_t                start_handle,
+        uint16_t                end_handle,
+        esp_gattc_char_elem_t*  result,
+        uint16_t*               count,
+        uint16_t                offset)
+    {
+        auto device = get_discovered_device(gattc_if, conn_id);
+
+        if (!device || !result || !count)
+        {
+            return ESP_GATT_INVALID_HANDLE;
+        }
+
+        uint16_t capacity   = *count;
+        uint16_t index      = 0;
+        *count = 0;
+
+        for_each_characteristic(*device, start_handle, end_handle, [&](const auto& characteristic) {
+            if (index++ >= offset && *count < capacity)
+            {
+                result[(*count)++] = esp_gattc_char_elem_t{ characteristic.handle, characteristic.properties, characteristic.uuid };
+            }
+        });
+
+        return (*count != 0) ? ESP_GATT_OK : ESP_GATT_NOT_FOUND;
+    }
+
+    esp_gatt_status_t esp_ble_gattc_get_all_descr(
+        esp_gatt_if_t           gattc_if,
+        uint16_t                conn_id,
+        uint16_t                char_handle,
+        esp_gattc_descr_elem_t* result,
+        uint16_t*               count,
+        uint16_t                offset)
+    {
+        auto device = get_discovered_device(gattc_if, conn_id);
+
+        if (!device || !result || !count)
+        {
+            return ESP_GATT_INVALID_HANDLE;
+        }
+
+        uint16_t capacity = *count;
+        *count = 0;
+
+        if (auto characteristic = find_characteristic_def(*device, char_handle); characteristic)
+        {
+            for (std::size_t i = offset; i < characteristic->descriptors.size() && *count < capacity; i++)
+            {
+                result[(*count)++] = esp_gattc_descr_elem_t{ characteristic->descriptors[i].handle, characteristic->descriptors[i].uuid };
+            }
+        }
+
+        return (*count != 0) ? ESP_GATT_OK : ESP_GATT_NOT_FOUND;
+    }
+
+    esp_gatt_status_t esp_ble_gattc_get_char_by_uuid(
+        esp_gatt_if_t           gattc_if,
+        uint16_t                conn_id,
+        uint16_t                start_handle,
+        uint16_t                end_handle,
+        esp_bt_uuid_t           char_uuid,
+        esp_gattc_char_elem_t*  result,
+        uint16_t*               count)
+    {
+        auto device = get_discovered_device(gattc_if, conn_id);
+
+        if (!device || !result || !count)
+        {
+            return ESP_GATT_INVALID_HANDLE;
+        }
+
+        uint16_t capacity = *count;
+        *count = 0;
+
+        for_each_characteristic(*device, start_handle, end_handle, [&](const auto& characteristic) {
+            if (uuid_equal(characteristic.uuid, char_uuid) && *count < capacity)
+            {
+                result[(*count)++] = esp_gattc_char_elem_t{ characteristic.handle, characteristic.properties, characteristic.uuid };
+            }
+        });
+
+        return (*count != 0) ? ESP_GATT_OK : ESP_GATT_NOT_FOUND;
+    }
+
+    esp_gatt_status_t esp_ble_gattc_get_descr_by_uuid(
+        esp_gatt_if_t           gattc_if,
+        uint16_t                conn_id,
+        uint16_t                start_handle,
+        uint16_t                end_handle,
+        esp_bt_uuid_t           char_uuid,
+        esp_bt_uuid_t           descr_uuid,
+        esp_gattc_descr_elem_t* result,
+        uint16_t*               count)
+    {
+        auto device = get_discovered_device(gattc_if, conn_id);
+
+        if (!device || !result || !count)
+        {
+            return ESP_GATT_INVALID_HANDLE;
+        }
+
+        uint16_t capacity = *count;
+        *count = 0;
+
+        for_each_characteristic(*device, start_handle, end_handle, [&](const auto& characteristic) {
+            if (!uuid_equal(characteristic.uuid, char_uuid))
+            {
+                return;
+            }
+
+            for (const auto& descriptor : characteristic.descriptors)
+            {
+                if (uuid_equal(descriptor.uuid, descr_uuid) && *count < capacity)
+                {
+                    result[(*count)++] = esp_gattc_descr_elem_t{ descriptor.handle, descriptor.uuid };
+                }
+            }
+        });
+
+        return (*count != 0) ? ESP_GATT_OK : ESP_GATT_NOT_FOUND;
+    }
+
+    esp_err_t esp_ble_gattc_read_char(esp_gatt_if_t gattc_if, uint16_t conn_id, uint16_t handle, esp_gatt_auth_req_t auth_req)
+    {
+        return post_request(gattc_if, conn_id, [gattc_if, conn_id, handle](std::shared_ptr<peripheral> device) {
+            std::vector<uint8_t> value;
+            esp_ble_gattc_cb_param_t param{  };
+
+            param.read.status       = device ? device->on_read(handle, value) : ESP_GATT_ERROR;
+            param.read.conn_id      = conn_id;
+            param.read.handle       = handle;
+            param.read.value        = value.data();
+            param.read.value_len    = static_cast<uint16_t>(value.size());
+            invoke_gattc(ESP_GATTC_READ_CHAR_EVT, gattc_if, &param);
+        });
+    }
+
+    esp_err_t esp_ble_gattc_read_char_descr(esp_gatt_if_t gattc_if, uint16_t conn_id, uint16_t handle, esp_gatt_auth_req_t auth_req)
+    {
+        return post_request(gattc_if, conn_id, [gattc_if, conn_id, handle](std::shared_ptr<peripheral> device) {
+            std::vector<uint8_t> value;
+            esp_ble_gattc_cb_param_t param{  };
+
+            param.read.status       = device ? device->on_read(handle, value) : ESP_GATT_ERROR;
+            param.read.conn_id      = conn_id;
+            param.read.handle       = handle;
+            param.read.value        = value.data();
+            param.read.value_len    = static_cast<uint16_t>(value.size());
+            invoke_gattc(ESP_GATTC_READ_DESCR_EVT, gattc_if, &param);
+        });
+    }
+
+    esp_err_t esp_ble_gattc_write_char(
+        esp_gatt_if_t           gattc_if,
+        uint16_t                conn_id,
+        uint16_t                handle,
+        uint16_t                value_len,
+        uint8_t*                value,
+        esp_gatt_write_type_t   write_type,
+        esp_gatt_auth_req_t     auth_req)
+    {
+        std::vector<uint8_t> data(value, value + value_len);
+
+        return post_request(gattc_if, conn_id, [gattc_if, conn_id, handle, data{ std::move(data) }](std::shared_ptr<peripheral> device) {
+            esp_ble_gattc_cb_param_t param{  };
+
+            param.write.status  = device ? device->on_write(handle, data) : ESP_GATT_ERROR;
+            param.write.conn_id = conn_id;
+            param.write.handle  = handle;
+            param.write.offset  = 0;
+            invoke_gattc(ESP_GATTC_WRITE_CHAR_EVT, gattc_if, &param);
+        }, write_type != ESP_GATT_WRITE_TYPE_NO_RSP);
+    }
+
+    esp_err_t esp_ble_gattc_write_char_descr(
+        esp_gatt_if_t           gattc_if,
+        uint16_t                conn_id,
+        uint16_t                handle,
+        uint16_t                value_len,
+        uint8_t*                value,
+        esp_gatt_write_type_t   write_type,
+        esp_gatt_auth_req_t     auth_req)
+    {
+        std::vector<uint8_t> data(value, value + value_len);
+
+        return post_request(gattc_if, conn_id, [gattc_if, conn_id, handle, data{ std::move(data) }](std::shared_ptr<peripheral> device) {
+            esp_ble_gattc_cb_param_t param{  };
+
+            param.write.status  = device ? device->on_write(handle, data) : ESP_GATT_ERROR;
+            param.write.conn_id = conn_id;
+            param.write.handle  = handle;
+            param.write.offset  = 0;
+            invoke_gattc(ESP_GATTC_WRITE_DESCR_EVT, gattc_if, &param);
+        });
+    }
+
+    esp_err_t esp_ble_gattc_prepare_write(
+        esp_gatt_if_t           gattc_if,
+        uint16_t                conn_id,
+        uint16_t                handle,
+        uint16_t                offset,
+        uint16_t                value_len,
+        uint8_t*                value,
+        esp_gatt_auth_req_t     auth_req)
+    {
+        std::vector<uint8_t> data(value, value + value_len);
+
+        return post_request(gattc_if, conn_id, [gattc_if, conn_id, handle, offset, data{ std::move(data) }](std::shared_ptr<peripheral> device) {
+            esp_ble_gattc_cb_param_t param{  };
+            param.write.status = ESP_GATT_ERROR;
+
+            if (device)
+            {
+                std::lock_guard lock{ get_state().mutex };
+
+                if (auto iter = get_state().connections.find(conn_id); iter != get_state().connections.end())
+                {
+                    iter->second.prepared_writes.push_back(prepared_write{ handle, offset, data });
+                    param.write.status = ESP_GATT_OK;
+                }
+            }
+
+            param.write.conn_id = conn_id;
+            param.write.handle  = handle;
+            param.write.offset  = offset;
+            invoke_gattc(ESP_GATTC_PREP_WRITE_EVT, gattc_if, &param);
+        });
+    }
+
+    esp_err_t esp_ble_gattc_execute_write(esp_gatt_if_t gattc_if, uint16_t conn_id, bool is_execute)
+    {
+        return post_request(gattc_if, conn_id, [gattc_if, conn_id, is_execute](std::shared_ptr<peripheral> device) {
+            std::vector<prepared_write> prepared_writes;
+            esp_ble_gattc_cb_param_t param{  };
+
+            {
+                std::lock_guard lock{ get_state().mutex };
+
+                if (auto iter = get_state().connections.find(conn_id); iter != get_state().connections.end())
+                {
+                    prepared_writes.swap(iter->second.prepared_writes);
+                }
+            }
+
+            param.exec_cmpl.status  = device ? ESP_GATT_OK : ESP_GATT_ERROR;
+            param.exec_cmpl.conn_id = conn_id;
+
+            if (device && is_execute)
+            {
+                std::map<uint16_t, std::vector<uint8_t>> values;
+
+                for (const auto& prepared : prepared_writes)
+                {
+                    auto& value = values[prepared.handle];
+
+                    if (prepared.offset != value.size())
+                    {
+                        param.exec_cmpl.status = ESP_GATT_INVALID_OFFSET;
+                        break;
+                    }
+
+                    value.insert(value.end(), prepared.value.begin(), prepared.value.end());
+                }
+
+                for (auto iter = values.begin(); iter != values.end() && param.exec_cmpl.status == ESP_GATT_OK; ++iter)
+                {
+                    param.exec_cmpl.status = device->on_write(iter->first, iter->second);
+                }
+            }
+
+            invoke_gattc(ESP_GATTC_EXEC_EVT, gattc_if, &param);
+        });
+    }
+
+    esp_err_t esp_ble_gattc_register_for_notify(esp_gatt_if_t gattc_if, esp_bd_addr_t server_bda, uint16_t handle)
+    {
+        auto address = to_address(server_bda);
+
+        get_state().request_count++;
+
+        get_btc_task().post([gattc_if, address, handle]() {
+            esp_ble_gattc_cb_param_t param{  };
+            param.reg_for_notify.status = ESP_GATT_ERROR;
+            param.reg_for_notify.handle = handle;
+
+            {
+                std::lock_guard lock{ get_state().mutex };
+
+                for (auto& [conn_id, conn] : get_state().connections)
+                {
+                    if (conn.gattc_if == gattc_if && conn.address == address)
+                    {
+                        conn.notify_handles.insert(handle);
+                        param.reg_for_notify.status = ESP_GATT_OK;
+                    }
+                }
+            }
+
+            invoke_gattc(ESP_GATTC_REG_FOR_NOTIFY_EVT, gattc_if, &param);
+        });
+
+        return ESP_OK;
+    }
+
+    esp_err_t esp_ble_gattc_unregister_for_notify(esp_gatt_if_t gattc_if, esp_bd_addr_t server_bda, uint16_t handle)
+    {
+        auto address = to_address(server_bda);
+
+        get_state().request_count++;
+
+        get_btc_task().post([gattc_if, address, handle]() {
+            esp_ble_gattc_cb_param_t param{  };
+            param.unreg_for_notify.status = ESP_GATT_ERROR;
+            param.unreg_for_notify.handle = handle;
+
+            {
+                std::lock_guard lock{ get_state().mutex };
+
+                for (auto& [conn_id, conn] : get_state().connections)
+                {
+                    if (conn.gattc_if == gattc_if && conn.address == address && conn.notify_handles.erase(handle) != 0)
+                    {
+                        param.unreg_for_notify.status = ESP_GATT_OK;
+                    }
+                }
+            }
+
+            invoke_gattc(ESP_GATTC_UNREG_FOR_NOTIFY_EVT, gattc_if, &param);
+        });
+
+        return ESP_OK;
+    }
+}
@@ -0,0 +1,184 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <pthread.h>
+
+struct tskTaskControlBlock
+{
+    TaskFunction_t  task_code;
+    void*           parameters;
+};
+
+namespace
+{
+    struct event_group
+    {
+        std::mutex              mutex;
+        std::condition_variable changed;
+        EventBits_t             bits{ 0 };
+    };
+
+    const auto g_start_time = std::chrono::steady_clock::now();
+
+    thread_local TaskHandle_t g_current_task{ nullptr };
+
+    std::chrono::milliseconds to_duration(TickType_t ticks) noexcept
+    {
+        return std::chrono::milliseconds(static_cast<uint64_t>(ticks) * portTICK_PERIOD_MS);
+    }
+
+    bool bits_satisfied(EventBits_t bits, EventBits_t bits_to_wait_for, BaseType_t wait_for_all_bits) noexcept
+    {
+        return wait_for_all_bits ? 
+            ((bits & bits_to_wait_for) == bits_to_wait_for) : 
+            ((bits & bits_to_wait_for) != 0);
+    }
+}
+
+extern "C"
+{
+    EventGroupHandle_t xEventGroupCreate(void)
+    {
+        return new (std::nothrow) event_group();
+    }
+
+    void vEventGroupDelete(EventGroupHandle_t event_group)
+    {
+        delete static_cast<::event_group*>(event_group);
+    }
+
+    EventBits_t xEventGroupSetBits(EventGroupHandle_t event_group, const EventBits_t bits_to_set)
+    {
+        auto group = static_cast<::event_group*>(event_group);
+        EventBits_t result;
+
+        {
+            std::lock_guard lock{ group->mutex };
+            group->bits |= bits_to_set;
+            result = group->bits;
+        }
+
+        group->changed.notify_all();
+        return result;
+    }
+
+    EventBits_t xEventGroupClearBits(EventGroupHandle_t event_group, const EventBits_t bits_to_clear)
+    {
+        auto group = static_cast<::event_group*>(event_group);
+        std::lock_guard lock{ group->mutex };
+        EventBits_t result = group->bits;
+        group->bits &= ~bits_to_clear;
+        return result;
+    }
+
+    EventBits_t xEventGroupGetBits(EventGroupHandle_t event_group)
+    {
+        auto group = static_cast<::event_group*>(event_group);
+        std::lock_guard lock{ group->mutex };
+        return group->bits;
+    }
+
+    EventBits_t xEventGroupWaitBits(
+        EventGroupHandle_t  event_group,
+        const EventBits_t   bits_to_wait_for,
+        const BaseType_t    clear_on_exit,
+        const BaseType_t    wait_for_all_bits,
+        TickType_t          ticks_to_wait)
+    {
+        auto group = static_cast<::event_group*>(event_group);
+        std::unique_lock lock{ group->mutex };
+
+        auto predicate = [&]() { return bits_satisfied(group->bits, bits_to_wait_for, wait_for_all_bits); };
+
+        bool satisfied = (ticks_to_wait == portMAX_DELAY) ?
+            (group->changed.wait(lock, predicate), true) :
+            group->changed.wait_for(lock, to_duration(ticks_to_wait), predicate);
+
+        EventBits_t result = group->bits;
+
+        if (satisfied && clear_on_exit)
+        {
+            group->bits &= ~bits_to_wait_for;
+        }
+
+        return result;
+    }
+
+    BaseType_t xTaskCreate(
+        TaskFunction_t  task_code,
+        const char*     name,
+        uint32_t        stack_depth,
+        void*           parameters,
+        UBaseType_t     priority,
+        TaskHandle_t*   created_task)
+    {
+        auto task = new (std::nothrow) tskTaskControlBlock{ task_code, parameters };
+
+        if (!task)
+        {
+            return pdFAIL;
+        }
+
+        if (created_task)
+        {
+            *created_task = task;
+        }
+
+        std::thread([task]() {
+            g_current_task = task;
+            task->task_code(task->parameters);
+        }).detach();
+
+        return pdPASS;
+    }
+
+    BaseType_t xTaskCreatePinnedToCore(
+        TaskFunction_t  task_code,
+        const char*     name,
+        uint32_t        stack_depth,
+        void*           parameters,
+        UBaseType_t     priority,
+        TaskHandle_t*   created_task,
+        BaseType_t      core_id)
+    {
+        return xTaskCreate(task_code, name, stack_depth, parameters, priority, created_task);
+    }
+
+    void vTaskDelete(TaskHandle_t task)
+    {
+        if (task != nullptr && task != g_current_task)
+        {
+            // Deleting other tasks is not supported on the host.
+            return;
+        }
+
+        delete g_current_task;
+        g_current_task = nullptr;
+        pthread_exit(nullptr);
+    }
+
+    void vTaskDelay(TickType_t ticks)
+    {
+        std::this_thread::sleep_for(to_duration(ticks));
+    }
+
+    TickType_t xTaskGetTickCount(void)
+    {
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - g_start_time);
+        return static_cast<TickType_t>(elapsed.count() / portTICK_PERIOD_MS);
+    }
+
+    TaskHandle_t xTaskGetCurrentTaskHandle(void)
+    {
+        // Threads not started by xTaskCreate, e.g. main and the shim workers, get distinct handles as tasks do on the target.
+        thread_local tskTaskControlBlock native_task{ nullptr, nullptr };
+
+        return g_current_task ? g_current_task : &native_task;
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef HUB_HOST_ESP_BT_MAIN_H
+#define HUB_HOST_ESP_BT_MAIN_H
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t esp_bluedroid_init(void);
+
+esp_err_t esp_bluedroid_deinit(void);
+
+esp_err_t esp_bluedroid_enable(void);
+
+esp_err_t esp_bluedroid_disable(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
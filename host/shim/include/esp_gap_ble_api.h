@@ -0,0 +1,224 @@
+#ifndef HUB_HOST_ESP_GAP_BLE_API_H
+#define HUB_HOST_ESP_GAP_BLE_API_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "esp_bt_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_BLE_ADV_DATA_LEN_MAX        31
+#define ESP_BLE_SCAN_RSP_DATA_LEN_MAX   31
+
+typedef enum {
+    ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT       = 0,
+    ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT,
+    ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT,
+    ESP_GAP_BLE_SCAN_RESULT_EVT,
+    ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT,
+    ESP_GAP_BLE_SCAN_RSP_DATA_RAW_SET_COMPLETE_EVT,
+    ESP_GAP_BLE_ADV_START_COMPLETE_EVT,
+    ESP_GAP_BLE_SCAN_START_COMPLETE_EVT,
+    ESP_GAP_BLE_AUTH_CMPL_EVT                   = 8,
+    ESP_GAP_BLE_KEY_EVT,
+    ESP_GAP_BLE_SEC_REQ_EVT,
+    ESP_GAP_BLE_PASSKEY_NOTIF_EVT,
+    ESP_GAP_BLE_PASSKEY_REQ_EVT,
+    ESP_GAP_BLE_OOB_REQ_EVT,
+    ESP_GAP_BLE_LOCAL_IR_EVT,
+    ESP_GAP_BLE_LOCAL_ER_EVT,
+    ESP_GAP_BLE_NC_REQ_EVT,
+    ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT,
+    ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT,
+    ESP_GAP_BLE_SET_STATIC_RAND_ADDR_EVT        = 19,
+    ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT,
+    ESP_GAP_BLE_SET_PKT_LENGTH_COMPLETE_EVT,
+    ESP_GAP_BLE_SET_LOCAL_PRIVACY_COMPLETE_EVT,
+    ESP_GAP_BLE_REMOVE_BOND_DEV_COMPLETE_EVT,
+    ESP_GAP_BLE_CLEAR_BOND_DEV_COMPLETE_EVT,
+    ESP_GAP_BLE_GET_BOND_DEV_COMPLETE_EVT,
+    ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT,
+    ESP_GAP_BLE_UPDATE_WHITELIST_COMPLETE_EVT,
+    ESP_GAP_BLE_EVT_MAX,
+} esp_gap_ble_cb_event_t;
+
+typedef enum {
+    ESP_BLE_AD_TYPE_FLAG                    = 0x01,
+    ESP_BLE_AD_TYPE_16SRV_PART              = 0x02,
+    ESP_BLE_AD_TYPE_16SRV_CMPL              = 0x03,
+    ESP_BLE_AD_TYPE_32SRV_PART              = 0x04,
+    ESP_BLE_AD_TYPE_32SRV_CMPL              = 0x05,
+    ESP_BLE_AD_TYPE_128SRV_PART             = 0x06,
+    ESP_BLE_AD_TYPE_128SRV_CMPL             = 0x07,
+    ESP_BLE_AD_TYPE_NAME_SHORT              = 0x08,
+    ESP_BLE_AD_TYPE_NAME_CMPL               = 0x09,
+    ESP_BLE_AD_TYPE_TX_PWR                  = 0x0A,
+    ESP_BLE_AD_TYPE_DEV_CLASS               = 0x0D,
+    ESP_BLE_AD_TYPE_SM_TK                   = 0x10,
+    ESP_BLE_AD_TYPE_SM_OOB_FLAG             = 0x11,
+    ESP_BLE_AD_TYPE_INT_RANGE               = 0x12,
+    ESP_BLE_AD_TYPE_SOL_SRV_UUID            = 0x14,
+    ESP_BLE_AD_TYPE_128SOL_SRV_UUID         = 0x15,
+    ESP_BLE_AD_TYPE_SERVICE_DATA            = 0x16,
+    ESP_BLE_AD_TYPE_PUBLIC_TARGET           = 0x17,
+    ESP_BLE_AD_TYPE_RANDOM_TARGET           = 0x18,
+    ESP_BLE_AD_TYPE_APPEARANCE              = 0x19,
+    ESP_BLE_AD_TYPE_ADV_INT                 = 0x1A,
+    ESP_BLE_AD_TYPE_LE_DEV_ADDR             = 0x1b,
+    ESP_BLE_AD_TYPE_LE_ROLE                 = 0x1c,
+    ESP_BLE_AD_TYPE_SPAIR_C256              = 0x1d,
+    ESP_BLE_AD_TYPE_SPAIR_R256              = 0x1e,
+    ESP_BLE_AD_TYPE_32SOL_SRV_UUID          = 0x1f,
+    ESP_BLE_AD_TYPE_32SERVICE_DATA          = 0x20,
+    ESP_BLE_AD_TYPE_128SERVICE_DATA         = 0x21,
+    ESP_BLE_AD_TYPE_LE_SECURE_CONFIRM       = 0x22,
+    ESP_BLE_AD_TYPE_LE_SECURE_RANDOM        = 0x23,
+    ESP_BLE_AD_TYPE_URI                     = 0x24,
+    ESP_BLE_AD_TYPE_INDOOR_POSITION         = 0x25,
+    ESP_BLE_AD_TYPE_TRANS_DISC_DATA         = 0x26,
+    ESP_BLE_AD_TYPE_LE_SUPPORT_FEATURE      = 0x27,
+    ESP_BLE_AD_TYPE_CHAN_MAP_UPDATE         = 0x28,
+    ESP_BLE_AD_MANUFACTURER_SPECIFIC_TYPE   = 0xFF,
+} esp_ble_adv_data_type;
+
+typedef enum {
+    BLE_SCAN_TYPE_PASSIVE   = 0x0,
+    BLE_SCAN_TYPE_ACTIVE    = 0x1,
+} esp_ble_scan_type_t;
+
+typedef enum {
+    BLE_SCAN_FILTER_ALLOW_ALL           = 0x0,
+    BLE_SCAN_FILTER_ALLOW_ONLY_WLST     = 0x1,
+    BLE_SCAN_FILTER_ALLOW_UND_RPA_DIR   = 0x2,
+    BLE_SCAN_FILTER_ALLOW_WLIST_RPA_DIR = 0x3,
+} esp_ble_scan_filter_t;
+
+typedef enum {
+    BLE_SCAN_DUPLICATE_DISABLE  = 0x0,
+    BLE_SCAN_DUPLICATE_ENABLE   = 0x1,
+    BLE_SCAN_DUPLICATE_MAX      = 0x2,
+} esp_ble_scan_duplicate_t;
+
+typedef struct {
+    esp_ble_scan_type_t         scan_type;
+    esp_ble_addr_type_t         own_addr_type;
+    esp_ble_scan_filter_t       scan_filter_policy;
+    uint16_t                    scan_interval;
+    uint16_t                    scan_window;
+    esp_ble_scan_duplicate_t    scan_duplicate;
+} esp_ble_scan_params_t;
+
+typedef struct {
+    esp_bd_addr_t   bda;
+    uint16_t        min_int;
+    uint16_t        max_int;
+    uint16_t        latency;
+    uint16_t        timeout;
+} esp_ble_conn_update_params_t;
+
+typedef enum {
+    ESP_BLE_WHITELIST_REMOVE    = 0x00,
+    ESP_BLE_WHITELIST_ADD       = 0x01,
+    ESP_BLE_WHITELIST_CLEAR     = 0x02,
+} esp_ble_wl_opration_t;
+
+typedef enum {
+    ESP_GAP_SEARCH_INQ_RES_EVT              = 0,
+    ESP_GAP_SEARCH_INQ_CMPL_EVT             = 1,
+    ESP_GAP_SEARCH_DISC_RES_EVT             = 2,
+    ESP_GAP_SEARCH_DISC_BLE_RES_EVT         = 3,
+    ESP_GAP_SEARCH_DISC_CMPL_EVT            = 4,
+    ESP_GAP_SEARCH_DI_DISC_CMPL_EVT         = 5,
+    ESP_GAP_SEARCH_SEARCH_CANCEL_CMPL_EVT   = 6,
+    ESP_GAP_SEARCH_INQ_DISCARD_NUM_EVT      = 7,
+} esp_gap_search_evt_t;
+
+typedef enum {
+    ESP_BLE_EVT_CONN_ADV        = 0x00,
+    ESP_BLE_EVT_CONN_DIR_ADV    = 0x01,
+    ESP_BLE_EVT_DISC_ADV        = 0x02,
+    ESP_BLE_EVT_NON_CONN_ADV    = 0x03,
+    ESP_BLE_EVT_SCAN_RSP        = 0x04,
+} esp_ble_evt_type_t;
+
+typedef union {
+    struct ble_scan_param_cmpl_evt_param {
+        esp_bt_status_t status;
+    } scan_param_cmpl;
+
+    struct ble_scan_result_evt_param {
+        esp_gap_search_evt_t    search_evt;
+        esp_bd_addr_t           bda;
+        esp_bt_dev_type_t       dev_type;
+        esp_ble_addr_type_t     ble_addr_type;
+        esp_ble_evt_type_t      ble_evt_type;
+        int                     rssi;
+        uint8_t                 ble_adv[ESP_BLE_ADV_DATA_LEN_MAX + ESP_BLE_SCAN_RSP_DATA_LEN_MAX];
+        int                     flag;
+        int                     num_resps;
+        uint8_t                 adv_data_len;
+        uint8_t                 scan_rsp_len;
+        uint32_t                num_dis;
+    } scan_rst;
+
+    struct ble_scan_start_cmpl_evt_param {
+        esp_bt_status_t status;
+    } scan_start_cmpl;
+
+    struct ble_scan_stop_cmpl_evt_param {
+        esp_bt_status_t status;
+    } scan_stop_cmpl;
+
+    struct ble_update_conn_params_evt_param {
+        esp_bt_status_t status;
+        esp_bd_addr_t   bda;
+        uint16_t        min_int;
+        uint16_t        max_int;
+        uint16_t        latency;
+        uint16_t        conn_int;
+        uint16_t        timeout;
+    } update_conn_params;
+
+    struct ble_read_rssi_cmpl_evt_param {
+        esp_bt_status_t status;
+        int8_t          rssi;
+        esp_bd_addr_t   remote_addr;
+    } read_rssi_cmpl;
+
+    struct ble_update_whitelist_cmpl_evt_param {
+        esp_bt_status_t         status;
+        esp_ble_wl_opration_t   wl_opration;
+    } update_whitelist_cmpl;
+} esp_ble_gap_cb_param_t;
+
+typedef void (*esp_gap_ble_cb_t)(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param);
+
+esp_err_t esp_ble_gap_register_callback(esp_gap_ble_cb_t callback);
+
+esp_err_t esp_ble_gap_set_scan_params(esp_ble_scan_params_t* scan_params);
+
+esp_err_t esp_ble_gap_start_scanning(uint32_t duration);
+
+esp_err_t esp_ble_gap_stop_scanning(void);
+
+esp_err_t esp_ble_gap_update_conn_params(esp_ble_conn_update_params_t* params);
+
+esp_err_t esp_ble_gap_read_rssi(esp_bd_addr_t remote_addr);
+
+esp_err_t esp_ble_gap_update_whitelist(bool add_remove, esp_bd_addr_t remote_bda, esp_ble_wl_addr_type_t wl_addr_type);
+
+esp_err_t esp_ble_gap_clear_whitelist(void);
+
+esp_err_t esp_ble_gap_get_whitelist_size(uint16_t* length);
+
+uint8_t* esp_ble_resolve_adv_data(uint8_t* adv_data, uint8_t type, uint8_t* length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
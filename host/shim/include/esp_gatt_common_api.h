@@ -0,0 +1,19 @@
+#ifndef HUB_HOST_ESP_GATT_COMMON_API_H
+#define HUB_HOST_ESP_GATT_COMMON_API_H
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_gatt_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t esp_ble_gatt_set_local_mtu(uint16_t mtu);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
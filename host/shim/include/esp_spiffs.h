@@ -0,0 +1,31 @@
+#ifndef HUB_HOST_ESP_SPIFFS_H
+#define HUB_HOST_ESP_SPIFFS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    const char* base_path;
+    const char* partition_label;
+    size_t      max_files;
+    bool        format_if_mount_failed;
+} esp_vfs_spiffs_conf_t;
+
+/**
+ * @brief On the host, the partition is not mounted; files are accessed through the host filesystem.
+ */
+esp_err_t esp_vfs_spiffs_register(const esp_vfs_spiffs_conf_t* conf);
+
+esp_err_t esp_vfs_spiffs_unregister(const char* partition_label);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef HUB_HOST_ESP_SYSTEM_H
+#define HUB_HOST_ESP_SYSTEM_H
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t esp_random(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
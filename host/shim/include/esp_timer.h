@@ -0,0 +1,21 @@
+#ifndef HUB_HOST_ESP_TIMER_H
+#define HUB_HOST_ESP_TIMER_H
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Microseconds elapsed since the shim was loaded (monotonic clock).
+ */
+int64_t esp_timer_get_time(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef HUB_HOST_FREERTOS_EVENT_GROUPS_H
+#define HUB_HOST_FREERTOS_EVENT_GROUPS_H
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef TickType_t  EventBits_t;
+typedef void*       EventGroupHandle_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+
+void vEventGroupDelete(EventGroupHandle_t event_group);
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t event_group, const EventBits_t bits_to_set);
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t event_group, const EventBits_t bits_to_clear);
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t event_group);
+
+EventBits_t xEventGroupWaitBits(
+    EventGroupHandle_t  event_group,
+    const EventBits_t   bits_to_wait_for,
+    const BaseType_t    clear_on_exit,
+    const BaseType_t    wait_for_all_bits,
+    TickType_t          ticks_to_wait);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef HUB_HOST_FREERTOS_TASK_H
+#define HUB_HOST_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*TaskFunction_t)(void*);
+
+struct tskTaskControlBlock;
+typedef struct tskTaskControlBlock* TaskHandle_t;
+
+/**
+ * @brief Tasks are backed by detached pthreads. Priority and stack depth are accepted and ignored.
+ */
+BaseType_t xTaskCreate(
+    TaskFunction_t  task_code,
+    const char*     name,
+    uint32_t        stack_depth,
+    void*           parameters,
+    UBaseType_t     priority,
+    TaskHandle_t*   created_task);
+
+BaseType_t xTaskCreatePinnedToCore(
+    TaskFunction_t  task_code,
+    const char*     name,
+    uint32_t        stack_depth,
+    void*           parameters,
+    UBaseType_t     priority,
+    TaskHandle_t*   created_task,
+    BaseType_t      core_id);
+
+/**
+ * @brief Only self-deletion (task == NULL or the calling task) is supported on the host.
+ */
+void vTaskDelete(TaskHandle_t task);
+
+void vTaskDelay(TickType_t ticks);
+
+TickType_t xTaskGetTickCount(void);
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
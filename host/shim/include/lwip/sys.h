@@ -0,0 +1,4 @@
+#ifndef HUB_HOST_LWIP_SYS_H
+#define HUB_HOST_LWIP_SYS_H
+
+#endif
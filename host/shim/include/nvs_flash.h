@@ -0,0 +1,18 @@
+#ifndef HUB_HOST_NVS_FLASH_H
+#define HUB_HOST_NVS_FLASH_H
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t nvs_flash_init(void);
+
+esp_err_t nvs_flash_deinit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,20 @@
+/*
+ * Host mirror of the subset of sdkconfig used by the hub components.
+ * Keep in sync with the project sdkconfig.
+ */
+#ifndef HUB_HOST_SDKCONFIG_H
+#define HUB_HOST_SDKCONFIG_H
+
+#define CONFIG_IDF_TARGET                   "linux"
+#define CONFIG_FREERTOS_HZ                  100
+#define CONFIG_BT_ENABLED                   1
+#define CONFIG_BT_BLUEDROID_ENABLED         1
+#define CONFIG_BT_GATTC_ENABLE              1
+// Tests of several connection slots build their own copy of hub-ble with more.
+#ifndef CONFIG_BTDM_CTRL_BLE_MAX_CONN
+#define CONFIG_BTDM_CTRL_BLE_MAX_CONN       1
+#define CONFIG_BTDM_CTRL_BLE_MAX_CONN_EFF   1
+#endif
+#define CONFIG_LOG_DEFAULT_LEVEL            3
+
+#endif
@@ -0,0 +1,257 @@
+#ifndef HUB_HOST_SHIM_BLUEDROID_HPP
+#define HUB_HOST_SHIM_BLUEDROID_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "esp_bt_defs.h"
+#include "esp_gap_ble_api.h"
+#include "esp_gattc_api.h"
+
+/**
+ * @brief Host-side control of the Bluedroid shim.
+ * 
+ * GAP and GATTC API calls made by the components are answered on a single "BTC" worker thread,
+ * as on the target. Test drivers and benchmarks use the functions below either to dispatch events
+ * synchronously into the registered callbacks or to attach simulated peripherals.
+ */
+namespace shim::bluedroid
+{
+    using address_type = std::array<uint8_t, ESP_BD_ADDR_LEN>;
+
+    /**
+     * @brief Simulated GATT server. Attribute database is built with add_service, add_characteristic
+     * and add_descriptor; handles are assigned sequentially. Default read/write behaviour stores values
+     * in the database, derived classes override on_read/on_write to model a device.
+     */
+    class peripheral
+    {
+    public:
+
+        struct descriptor_def
+        {
+            uint16_t                handle;
+            esp_bt_uuid_t           uuid;
+            std::vector<uint8_t>    value;
+        };
+
+        struct characteristic_def
+        {
+            uint16_t                    handle;
+            esp_bt_uuid_t               uuid;
+            esp_gatt_char_prop_t        properties;
+            std::vector<uint8_t>        value;
+            std::vector<descriptor_def> descriptors;
+        };
+
+        struct service_def
+        {
+            uint16_t                        start_handle;
+            uint16_t                        end_handle;
+            esp_bt_uuid_t                   uuid;
+            bool                            is_primary;
+            std::vector<characteristic_def> characteristics;
+        };
+
+        peripheral()                                = default;
+
+        peripheral(const peripheral&)               = delete;
+
+        peripheral& operator=(const peripheral&)    = delete;
+
+        virtual ~peripheral()                       = default;
+
+        uint16_t add_service(esp_bt_uuid_t uuid, bool is_primary = true);
+
+        uint16_t add_characteristic(esp_bt_uuid_t uuid, esp_gatt_char_prop_t properties, std::vector<uint8_t> value = {});
+
+        uint16_t add_descriptor(esp_bt_uuid_t uuid, std::vector<uint8_t> value = {});
+
+        const std::vector<service_def>& get_services() const noexcept
+        {
+            return m_services;
+        }
+
+        /**
+         * @brief Handle of the first characteristic with the given uuid, ESP_GATT_ILLEGAL_HANDLE if not found.
+         */
+        uint16_t find_characteristic(esp_bt_uuid_t uuid) const noexcept;
+
+        /**
+         * @brief Send notification to every GATTC interface registered for notifications on the handle.
+         */
+        void notify(uint16_t handle, std::vector<uint8_t> value);
+
+        /**
+         * @brief Delay applied before every response, simulating the link round trip.
+         */
+        void set_latency(std::chrono::microseconds latency) noexcept
+        {
+            m_latency = latency;
+        }
+
+        std::chrono::microseconds get_latency() const noexcept
+        {
+            return m_latency;
+        }
+
+        /**
+         * @brief Signal strength reported by ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT while connected.
+         */
+        void set_rssi(int8_t rssi) noexcept
+        {
+            m_rssi = rssi;
+        }
+
+        int8_t get_rssi() const noexcept
+        {
+            return m_rssi;
+        }
+
+        /**
+         * @brief Address type the peripheral advertises with, connections opened with another type fail.
+         */
+        void set_address_type(esp_ble_addr_type_t type) noexcept
+        {
+            m_address_type = type;
+        }
+
+        esp_ble_addr_type_t get_address_type() const noexcept
+        {
+            return m_address_type;
+        }
+
+        void set_mtu(uint16_t mtu) noexcept
+        {
+            m_mtu = mtu;
+        }
+
+        uint16_t get_mtu() const noexcept
+        {
+            return m_mtu;
+        }
+
+        virtual esp_gatt_status_t on_read(uint16_t handle, std::vector<uint8_t>& value);
+
+        virtual esp_gatt_status_t on_write(uint16_t handle, const std::vector<uint8_t>& value);
+
+        const address_type& get_address() const noexcept
+        {
+            return m_address;
+        }
+
+    protected:
+
+        std::vector<uint8_t>* find_value(uint16_t handle) noexcept;
+
+    private:
+
+        friend void add_peripheral(const uint8_t* address, std::shared_ptr<peripheral> device);
+
+        std::vector<service_def>    m_services;
+        uint16_t                    m_next_handle{ 1 };
+        uint16_t                    m_mtu{ ESP_GATT_MAX_MTU_SIZE };
+        std::chrono::microseconds   m_latency{ 0 };
+        int8_t                      m_rssi{ -60 };
+        esp_ble_addr_type_t         m_address_type{ BLE_ADDR_TYPE_PUBLIC };
+        address_type                m_address{  };
+    };
+
+    /**
+     * @brief Make the peripheral connectable under the given address.
+     */
+    void add_peripheral(const uint8_t* address, std::shared_ptr<peripheral> device);
+
+    void remove_peripheral(const uint8_t* address);
+
+    /**
+     * @brief Simulate the loss of every connection to the peripheral, posting ESP_GATTC_DISCONNECT_EVT and
+     * ESP_GATTC_CLOSE_EVT with the given reason as the controller does on a supervision timeout.
+     */
+    void drop_connection(const uint8_t* address, esp_gatt_conn_reason_t reason = ESP_GATT_CONN_TIMEOUT);
+
+    /**
+     * @brief Block until every event posted to the BTC worker has been delivered.
+     */
+    void flush();
+
+    /**
+     * @brief Drop all registered callbacks, connections and peripherals.
+     */
+    void reset();
+
+    namespace gap
+    {
+        /**
+         * @brief Size of the simulated controller filter accept list, as on the ESP32 controller.
+         */
+        inline constexpr uint16_t WHITELIST_SIZE{ 12 };
+
+        /**
+         * @brief Dispatch ESP_GAP_BLE_SCAN_RESULT_EVT/ESP_GAP_SEARCH_INQ_RES_EVT synchronously on the calling thread.
+         * Results from devices outside the accept list are dropped, as by the controller, when the scan filter policy requires it.
+         * 
+         * @param address Advertiser address.
+         * @param addr_type Advertiser address type.
+         * @param rssi Received signal strength.
+         * @param adv Advertising data followed by scan response data.
+         * @param adv_data_len Length of the advertising data part.
+         * @param scan_rsp_len Length of the scan response part.
+         */
+        void scan_result(
+            const uint8_t*      address,
+            esp_ble_addr_type_t addr_type,
+            int                 rssi,
+            const uint8_t*      adv,
+            uint8_t             adv_data_len,
+            uint8_t             scan_rsp_len = 0);
+
+        /**
+         * @brief Dispatch ESP_GAP_SEARCH_INQ_CMPL_EVT synchronously and stop the simulated scan.
+         */
+        void complete_scan();
+
+        /**
+         * @brief Dispatch an arbitrary GAP event synchronously on the calling thread.
+         */
+        void dispatch(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param);
+
+        bool is_scanning() noexcept;
+
+        /**
+         * @brief Duration passed to the last esp_ble_gap_start_scanning call.
+         */
+        uint32_t get_scan_duration() noexcept;
+
+        esp_ble_scan_params_t get_scan_params() noexcept;
+
+        /**
+         * @brief Number of entries in the simulated controller filter accept list.
+         */
+        std::size_t get_whitelist_count() noexcept;
+    }
+
+    namespace gattc
+    {
+        /**
+         * @brief Dispatch a GATTC event synchronously on the calling thread, bypassing the BTC worker.
+         */
+        void dispatch(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t* param);
+
+        /**
+         * @brief Number of requests (read, write, search, ...) issued by the components since the last reset.
+         */
+        std::size_t get_request_count() noexcept;
+
+        /**
+         * @brief Interface assigned to the registered application, ESP_GATT_IF_NONE if it is not registered.
+         */
+        esp_gatt_if_t get_interface(uint16_t app_id) noexcept;
+    }
+}
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef HUB_HOST_SHIM_MQTT_HPP
+#define HUB_HOST_SHIM_MQTT_HPP
+
+#include <cstddef>
+#include <functional>
+#include <string_view>
+
+/**
+ * @brief Host-side control of the esp-mqtt shim. There is no broker: publishes are handed to the
+ * publish hook and counted, incoming messages are injected with deliver.
+ */
+namespace shim::mqtt
+{
+    using publish_hook_type = std::function<void(std::string_view topic, std::string_view data, int qos, int retain)>;
+
+    /**
+     * @brief Called on the publishing thread for every esp_mqtt_client_publish.
+     */
+    void set_publish_hook(publish_hook_type hook);
+
+    /**
+     * @brief Dispatch MQTT_EVENT_DATA synchronously to every started client subscribed to a matching topic filter.
+     * 
+     * @return std::size_t Number of clients the message was delivered to.
+     */
+    std::size_t deliver(std::string_view topic, std::string_view data);
+
+    std::size_t get_publish_count() noexcept;
+
+    std::size_t get_published_bytes() noexcept;
+
+    void reset();
+}
+
+#endif
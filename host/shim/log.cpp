@@ -0,0 +1,113 @@
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace
+{
+    const auto g_start_time = std::chrono::steady_clock::now();
+
+    std::atomic<esp_log_level_t>            g_default_level{ static_cast<esp_log_level_t>(CONFIG_LOG_DEFAULT_LEVEL) };
+    std::atomic<bool>                       g_has_tag_levels{ false };
+    std::mutex                              g_tag_levels_mutex;
+    std::map<std::string, esp_log_level_t>  g_tag_levels;
+
+    constexpr char level_letter(esp_log_level_t level) noexcept
+    {
+        switch (level)
+        {
+        case ESP_LOG_ERROR:     return 'E';
+        case ESP_LOG_WARN:      return 'W';
+        case ESP_LOG_INFO:      return 'I';
+        case ESP_LOG_DEBUG:     return 'D';
+        case ESP_LOG_VERBOSE:   return 'V';
+        default:                return ' ';
+        }
+    }
+}
+
+extern "C"
+{
+    void esp_log_level_set(const char* tag, esp_log_level_t level)
+    {
+        if (std::strcmp(tag, "*") == 0)
+        {
+            std::lock_guard lock{ g_tag_levels_mutex };
+            g_tag_levels.clear();
+            g_has_tag_levels = false;
+            g_default_level = level;
+            return;
+        }
+
+        std::lock_guard lock{ g_tag_levels_mutex };
+        g_tag_levels[tag] = level;
+        g_has_tag_levels = true;
+    }
+
+    esp_log_level_t esp_log_level_get(const char* tag)
+    {
+        if (!g_has_tag_levels)
+        {
+            return g_default_level;
+        }
+
+        std::lock_guard lock{ g_tag_levels_mutex };
+
+        if (auto iter = g_tag_levels.find(tag); iter != g_tag_levels.end())
+        {
+            return iter->second;
+        }
+
+        return g_default_level;
+    }
+
+    uint32_t esp_log_timestamp(void)
+    {
+        return static_cast<uint32_t>(esp_timer_get_time() / 1000);
+    }
+
+    void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...)
+    {
+        va_list args;
+        va_start(args, format);
+
+        std::fprintf(stderr, "%c (%u) %s: ", level_letter(level), esp_log_timestamp(), tag);
+        std::vfprintf(stderr, format, args);
+        std::fputc('\n', stderr);
+
+        va_end(args);
+    }
+
+    int64_t esp_timer_get_time(void)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_start_time).count();
+    }
+
+    const char* esp_err_to_name(esp_err_t code)
+    {
+        switch (code)
+        {
+        case ESP_OK:                    return "ESP_OK";
+        case ESP_FAIL:                  return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:            return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:       return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:     return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:      return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:         return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED:     return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:           return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_RESPONSE:  return "ESP_ERR_INVALID_RESPONSE";
+        case ESP_ERR_INVALID_CRC:       return "ESP_ERR_INVALID_CRC";
+        case ESP_ERR_INVALID_VERSION:   return "ESP_ERR_INVALID_VERSION";
+        case ESP_ERR_INVALID_MAC:       return "ESP_ERR_INVALID_MAC";
+        default:                        return "UNKNOWN ERROR";
+        }
+    }
+}
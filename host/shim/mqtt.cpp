@@ -0,0 +1,340 @@
+#include "shim/mqtt.hpp"
+
+#include "mqtt_client.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "worker.hpp"
+
+struct esp_mqtt_client
+{
+    struct handler
+    {
+        esp_mqtt_event_id_t event;
+        esp_event_handler_t callback;
+        void*               arg;
+    };
+
+    std::string             uri;
+    void*                   user_context;
+    std::vector<handler>    handlers;
+    std::set<std::string>   subscriptions;
+    bool                    started;
+    int                     next_msg_id;
+};
+
+namespace shim::mqtt
+{
+    namespace
+    {
+        struct state
+        {
+            std::mutex                      mutex;
+            std::set<esp_mqtt_client*>      clients;
+            publish_hook_type               publish_hook;
+            std::atomic<std::size_t>        publish_count{ 0 };
+            std::atomic<std::size_t>        published_bytes{ 0 };
+        };
+
+        state& get_state()
+        {
+            static state s_state;
+            return s_state;
+        }
+
+        worker& get_mqtt_task()
+        {
+            static worker s_worker;
+            return s_worker;
+        }
+
+        /**
+         * @brief MQTT topic filter matching with '+' and '#' wildcards.
+         */
+        bool topic_matches(std::string_view filter, std::string_view topic) noexcept
+        {
+            while (!filter.empty())
+            {
+                auto filter_level   = filter.substr(0, filter.find('/'));
+                auto topic_level    = topic.substr(0, topic.find('/'));
+
+                if (filter_level == "#")
+                {
+                    return true;
+                }
+
+                if (filter_level != "+" && filter_level != topic_level)
+                {
+                    return false;
+                }
+
+                bool filter_last    = (filter_level.size() == filter.size());
+                bool topic_last     = (topic_level.size() == topic.size());
+
+                if (filter_last || topic_last)
+                {
+                    return filter_last && topic_last;
+                }
+
+                filter.remove_prefix(filter_level.size() + 1);
+                topic.remove_prefix(topic_level.size() + 1);
+            }
+
+            return topic.empty();
+        }
+
+        void dispatch(esp_mqtt_client* client, esp_mqtt_event_t& event)
+        {
+            std::vector<esp_mqtt_client::handler> handlers;
+
+            {
+                std::lock_guard lock{ get_state().mutex };
+
+                if (get_state().clients.count(client) == 0)
+                {
+                    return;
+                }
+
+                handlers = client->handlers;
+            }
+
+            for (const auto& handler : handlers)
+            {
+                if (handler.event == MQTT_EVENT_ANY || handler.event == event.event_id)
+                {
+                    handler.callback(handler.arg, "MQTT_EVENTS", event.event_id, &event);
+                }
+            }
+        }
+
+        void post(esp_mqtt_client* client, esp_mqtt_event_id_t event_id)
+        {
+            get_mqtt_task().post([client, event_id]() {
+                esp_mqtt_event_t event{  };
+                event.event_id  = event_id;
+                event.client    = client;
+                dispatch(client, event);
+            });
+        }
+    }
+
+    void set_publish_hook(publish_hook_type hook)
+    {
+        std::lock_guard lock{ get_state().mutex };
+        get_state().publish_hook = std::move(hook);
+    }
+
+    std::size_t deliver(std::string_view topic, std::string_view data)
+    {
+        std::vector<esp_mqtt_client*> targets;
+
+        {
+            std::lock_guard lock{ get_state().mutex };
+
+            for (auto client : get_state().clients)
+            {
+                if (client->started && std::any_of(
+                    client->subscriptions.begin(),
+                    client->subscriptions.end(),
+                    [topic](const std::string& filter) { return topic_matches(filter, topic); }))
+                {
+                    targets.push_back(client);
+                }
+            }
+        }
+
+        std::string topic_buffer(topic);
+        std::string data_buffer(data);
+
+        for (auto client : targets)
+        {
+            esp_mqtt_event_t event{  };
+            event.event_id          = MQTT_EVENT_DATA;
+            event.client            = client;
+            event.user_context      = client->user_context;
+            event.topic             = topic_buffer.data();
+            event.topic_len         = static_cast<int>(topic_buffer.size());
+            event.data              = data_buffer.data();
+            event.data_len          = static_cast<int>(data_buffer.size());
+            event.total_data_len    = event.data_len;
+
+            dispatch(client, event);
+        }
+
+        return targets.size();
+    }
+
+    std::size_t get_publish_count() noexcept
+    {
+        return get_state().publish_count;
+    }
+
+    std::size_t get_published_bytes() noexcept
+    {
+        return get_state().published_bytes;
+    }
+
+    void reset()
+    {
+        get_mqtt_task().flush();
+
+        std::lock_guard lock{ get_state().mutex };
+        get_state().publish_hook    = nullptr;
+        get_state().publish_count   = 0;
+        get_state().published_bytes = 0;
+    }
+}
+
+using namespace shim::mqtt;
+
+extern "C"
+{
+    esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t* config)
+    {
+        if (!config)
+        {
+            return nullptr;
+        }
+
+        auto client = new esp_mqtt_client{ config->uri ? config->uri : "", config->user_context, {}, {}, false, 1 };
+
+        std::lock_guard lock{ get_state().mutex };
+        get_state().clients.insert(client);
+        return client;
+    }
+
+    esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event, esp_event_handler_t event_handler, void* event_handler_arg)
+    {
+        if (!client || !event_handler)
+        {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        std::lock_guard lock{ get_state().mutex };
+        client->handlers.push_back(esp_mqtt_client::handler{ event, event_handler, event_handler_arg });
+        return ESP_OK;
+    }
+
+    esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+    {
+        if (!client)
+        {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        {
+            std::lock_guard lock{ get_state().mutex };
+
+            if (client->started)
+            {
+                return ESP_FAIL;
+            }
+
+            client->started = true;
+        }
+
+        post(client, MQTT_EVENT_BEFORE_CONNECT);
+        post(client, MQTT_EVENT_CONNECTED);
+        return ESP_OK;
+    }
+
+    esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client)
+    {
+        if (!client)
+        {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        {
+            std::lock_guard lock{ get_state().mutex };
+
+            if (!client->started)
+            {
+                return ESP_FAIL;
+            }
+
+            client->started = false;
+        }
+
+        post(client, MQTT_EVENT_DISCONNECTED);
+        get_mqtt_task().flush();
+        return ESP_OK;
+    }
+
+    esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client)
+    {
+        if (!client)
+        {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        get_mqtt_task().flush();
+
+        {
+            std::lock_guard lock{ get_state().mutex };
+            get_state().clients.erase(client);
+        }
+
+        delete client;
+        return ESP_OK;
+    }
+
+    int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char* topic, int qos)
+    {
+        if (!client || !topic)
+        {
+            return -1;
+        }
+
+        std::lock_guard lock{ get_state().mutex };
+        client->subscriptions.insert(topic);
+        return client->next_msg_id++;
+    }
+
+    int esp_mqtt_client_unsubscribe(esp_mqtt_client_handle_t client, const char* topic)
+    {
+        if (!client || !topic)
+        {
+            return -1;
+        }
+
+        std::lock_guard lock{ get_state().mutex };
+        client->subscriptions.erase(topic);
+        return client->next_msg_id++;
+    }
+
+    int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char* topic, const char* data, int len, int qos, int retain)
+    {
+        if (!client || !topic)
+        {
+            return -1;
+        }
+
+        std::string_view payload = data ? std::string_view(data, (len == 0) ? std::strlen(data) : static_cast<std::size_t>(len)) : std::string_view();
+        publish_hook_type hook;
+        int msg_id;
+
+        {
+            std::lock_guard lock{ get_state().mutex };
+            hook    = get_state().publish_hook;
+            msg_id  = (qos == 0) ? 0 : client->next_msg_id++;
+        }
+
+        get_state().publish_count++;
+        get_state().published_bytes += payload.size();
+
+        if (hook)
+        {
+            hook(topic, payload, qos, retain);
+        }
+
+        return msg_id;
+    }
+}
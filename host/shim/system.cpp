@@ -0,0 +1,370 @@
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_spiffs.h"
+#include "esp_system.h"
+#include "esp_wifi.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "worker.hpp"
+
+ESP_EVENT_DEFINE_BASE(WIFI_EVENT);
+ESP_EVENT_DEFINE_BASE(IP_EVENT);
+
+namespace
+{
+    struct handler
+    {
+        esp_event_base_t    base;
+        int32_t             id;
+        esp_event_handler_t callback;
+        void*               arg;
+    };
+
+    struct state
+    {
+        std::mutex                          mutex;
+        std::unique_ptr<shim::worker>       loop;
+        std::vector<handler>                handlers;
+    };
+
+    state& get_state()
+    {
+        static state s_state;
+        return s_state;
+    }
+
+    // Blobs are kept in memory for the lifetime of the process, keyed by "<namespace>/<key>".
+    struct nvs_state
+    {
+        std::mutex                                          mutex;
+        std::map<std::string, std::vector<uint8_t>>         blobs;
+        std::map<nvs_handle_t, std::pair<std::string, nvs_open_mode_t>> handles;
+        nvs_handle_t                                        next_handle{ 1 };
+    };
+
+    nvs_state& get_nvs_state()
+    {
+        static nvs_state s_nvs_state;
+        return s_nvs_state;
+    }
+
+    /**
+     * @brief Blob name of the key in the namespace the handle was opened with, empty for an unknown handle.
+     */
+    std::string get_blob_name(nvs_handle_t handle, const char* key, bool write)
+    {
+        auto& nvs = get_nvs_state();
+
+        if (auto iter = nvs.handles.find(handle); iter != nvs.handles.end() && (!write || iter->second.second == NVS_READWRITE))
+        {
+            return iter->second.first + "/" + key;
+        }
+
+        return std::string();
+    }
+
+    bool base_matches(esp_event_base_t left, esp_event_base_t right) noexcept
+    {
+        return left == ESP_EVENT_ANY_BASE || left == right || (left && right && std::strcmp(left, right) == 0);
+    }
+}
+
+extern "C"
+{
+    esp_err_t esp_event_loop_create_default(void)
+    {
+        std::lock_guard lock{ get_state().mutex };
+
+        if (get_state().loop)
+        {
+            return ESP_ERR_INVALID_STATE;
+        }
+
+        get_state().loop = std::make_unique<shim::worker>();
+        return ESP_OK;
+    }
+
+    esp_err_t esp_event_loop_delete_default(void)
+    {
+        std::unique_ptr<shim::worker> loop;
+
+        {
+            std::lock_guard lock{ get_state().mutex };
+
+            if (!get_state().loop)
+            {
+                return ESP_ERR_INVALID_STATE;
+            }
+
+            loop = std::move(get_state().loop);
+            get_state().handlers.clear();
+        }
+
+        loop.reset();
+        return ESP_OK;
+    }
+
+    esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler, void* event_handler_arg)
+    {
+        std::lock_guard lock{ get_state().mutex };
+
+        if (!get_state().loop)
+        {
+            return ESP_ERR_INVALID_STATE;
+        }
+
+        get_state().handlers.push_back(handler{ event_base, event_id, event_handler, event_handler_arg });
+        return ESP_OK;
+    }
+
+    esp_err_t esp_event_handler_unregister(esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler)
+    {
+        std::lock_guard lock{ get_state().mutex };
+        auto& handlers = get_state().handlers;
+
+        handlers.erase(
+            std::remove_if(handlers.begin(), handlers.end(), [=](const handler& item) {
+                return item.base == event_base && item.id == event_id && item.callback == event_handler;
+            }),
+            handlers.end());
+
+        return ESP_OK;
+    }
+
+    esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id, const void* event_data, size_t event_data_size, uint32_t ticks_to_wait)
+    {
+        std::lock_guard lock{ get_state().mutex };
+
+        if (!get_state().loop)
+        {
+            return ESP_ERR_INVALID_STATE;
+        }
+
+        auto data = event_data
+            ? std::vector<uint8_t>(static_cast<const uint8_t*>(event_data), static_cast<const uint8_t*>(event_data) + event_data_size)
+            : std::vector<uint8_t>();
+
+        get_state().loop->post([event_base, event_id, data{ std::move(data) }]() mutable {
+            std::vector<handler> handlers;
+
+            {
+                std::lock_guard lock{ get_state().mutex };
+                handlers = get_state().handlers;
+            }
+
+            for (const auto& item : handlers)
+            {
+                if (base_matches(item.base, event_base) && (item.id == ESP_EVENT_ANY_ID || item.id == event_id))
+                {
+                    item.callback(item.arg, event_base, event_id, data.empty() ? nullptr : data.data());
+                }
+            }
+        });
+
+        return ESP_OK;
+    }
+
+    esp_err_t esp_netif_init(void)
+    {
+        return ESP_OK;
+    }
+
+    esp_netif_t* esp_netif_create_default_wifi_sta(void)
+    {
+        return nullptr;
+    }
+
+    esp_err_t nvs_flash_init(void)
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t nvs_flash_deinit(void)
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle)
+    {
+        if (!name || !out_handle)
+        {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        auto& nvs = get_nvs_state();
+        std::lock_guard lock{ nvs.mutex };
+
+        const std::string prefix = std::string(name) + "/";
+
+        // Like on the target, a namespace can only be opened read-only once something was written to it.
+        if (open_mode == NVS_READONLY && 
+            std::none_of(nvs.blobs.cbegin(), nvs.blobs.cend(), [&prefix](const auto& blob) { return blob.first.compare(0, prefix.size(), prefix) == 0; }))
+        {
+            return ESP_ERR_NVS_NOT_FOUND;
+        }
+
+        *out_handle = nvs.next_handle++;
+        nvs.handles.emplace(*out_handle, std::make_pair(std::string(name), open_mode));
+        return ESP_OK;
+    }
+
+    void nvs_close(nvs_handle_t handle)
+    {
+        auto& nvs = get_nvs_state();
+        std::lock_guard lock{ nvs.mutex };
+        nvs.handles.erase(handle);
+    }
+
+    esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length)
+    {
+        auto& nvs = get_nvs_state();
+        std::lock_guard lock{ nvs.mutex };
+
+        const auto name = get_blob_name(handle, key, false);
+
+        if (name.empty() || !length)
+        {
+            return name.empty() ? ESP_ERR_NVS_INVALID_HANDLE : ESP_ERR_INVALID_ARG;
+        }
+
+        auto iter = nvs.blobs.find(name);
+
+        if (iter == nvs.blobs.end())
+        {
+            return ESP_ERR_NVS_NOT_FOUND;
+        }
+
+        if (out_value)
+        {
+            if (*length < iter->second.size())
+            {
+                return ESP_ERR_NVS_INVALID_LENGTH;
+            }
+
+            std::memcpy(out_value, iter->second.data(), iter->second.size());
+        }
+
+        *length = iter->second.size();
+        return ESP_OK;
+    }
+
+    esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length)
+    {
+        auto& nvs = get_nvs_state();
+        std::lock_guard lock{ nvs.mutex };
+
+        const auto name = get_blob_name(handle, key, true);
+
+        if (name.empty())
+        {
+            return ESP_ERR_NVS_INVALID_HANDLE;
+        }
+
+        const auto* bytes = static_cast<const uint8_t*>(value);
+        nvs.blobs[name].assign(bytes, bytes + length);
+        return ESP_OK;
+    }
+
+    esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key)
+    {
+        auto& nvs = get_nvs_state();
+        std::lock_guard lock{ nvs.mutex };
+
+        const auto name = get_blob_name(handle, key, true);
+
+        if (name.empty())
+        {
+            return ESP_ERR_NVS_INVALID_HANDLE;
+        }
+
+        return nvs.blobs.erase(name) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    esp_err_t nvs_commit(nvs_handle_t handle)
+    {
+        auto& nvs = get_nvs_state();
+        std::lock_guard lock{ nvs.mutex };
+        return nvs.handles.count(handle) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+    }
+
+    esp_err_t esp_vfs_spiffs_register(const esp_vfs_spiffs_conf_t* conf)
+    {
+        return conf ? ESP_OK : ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t esp_vfs_spiffs_unregister(const char* partition_label)
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t esp_wifi_init(const wifi_init_config_t* config)
+    {
+        return config ? ESP_OK : ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t esp_wifi_deinit(void)
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+    {
+        return (mode < WIFI_MODE_MAX) ? ESP_OK : ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t* conf)
+    {
+        return conf ? ESP_OK : ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t esp_wifi_start(void)
+    {
+        return esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_START, nullptr, 0, 0);
+    }
+
+    esp_err_t esp_wifi_stop(void)
+    {
+        return ESP_OK;
+    }
+
+    /**
+     * @brief The host is always connected: report the loopback address.
+     */
+    esp_err_t esp_wifi_connect(void)
+    {
+        ip_event_got_ip_t event{  };
+        event.ip_info.ip.addr   = 0x0100007f;
+        event.ip_changed        = true;
+
+        if (esp_err_t result = esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, nullptr, 0, 0); result != ESP_OK)
+        {
+            return result;
+        }
+
+        return esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, &event, sizeof(event), 0);
+    }
+
+    esp_err_t esp_wifi_disconnect(void)
+    {
+        return ESP_OK;
+    }
+
+    uint32_t esp_random(void)
+    {
+        static std::mutex s_mutex;
+        static std::mt19937 s_engine{ std::random_device{  }() };
+
+        std::lock_guard lock{ s_mutex };
+        return static_cast<uint32_t>(s_engine());
+    }
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include "worker.hpp"
+
+namespace shim
+{
+    worker::worker() :
+        m_mutex         {  },
+        m_job_available {  },
+        m_idle          {  },
+        m_jobs          {  },
+        m_busy          { false },
+        m_stop          { false },
+        m_thread        { &worker::run, this }
+    {
+
+    }
+
+    worker::~worker()
+    {
+        {
+            std::lock_guard lock{ m_mutex };
+            m_stop = true;
+        }
+
+        m_job_available.notify_one();
+        m_thread.join();
+    }
+
+    void worker::post(std::function<void()> job)
+    {
+        {
+            std::lock_guard lock{ m_mutex };
+            m_jobs.push_back(std::move(job));
+        }
+
+        m_job_available.notify_one();
+    }
+
+    void worker::flush()
+    {
+        if (std::this_thread::get_id() == m_thread.get_id())
+        {
+            return;
+        }
+
+        std::unique_lock lock{ m_mutex };
+        m_idle.wait(lock, [this]() { return m_jobs.empty() && !m_busy; });
+    }
+
+    void worker::run()
+    {
+        std::unique_lock lock{ m_mutex };
+
+        while (true)
+        {
+            m_job_available.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+
+            if (m_jobs.empty())
+            {
+                return;
+            }
+
+            auto job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+            m_busy = true;
+
+            lock.unlock();
+            job();
+            lock.lock();
+
+            m_busy = false;
+
+            if (m_jobs.empty())
+            {
+                m_idle.notify_all();
+            }
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef HUB_HOST_SHIM_WORKER_HPP
+#define HUB_HOST_SHIM_WORKER_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace shim
+{
+    /**
+     * @brief Single thread executing posted jobs in FIFO order. Stands in for the Bluedroid BTC task,
+     * the default event loop and the MQTT task.
+     */
+    class worker
+    {
+    public:
+
+        worker();
+
+        worker(const worker&)               = delete;
+
+        worker& operator=(const worker&)    = delete;
+
+        ~worker();
+
+        void post(std::function<void()> job);
+
+        /**
+         * @brief Block until the queue is empty and no job is running. No-op when called from the worker itself.
+         */
+        void flush();
+
+    private:
+
+        void run();
+
+        std::mutex                          m_mutex;
+        std::condition_variable             m_job_available;
+        std::condition_variable             m_idle;
+        std::deque<std::function<void()>>   m_jobs;
+        bool                                m_busy;
+        bool                                m_stop;
+        std::thread                         m_thread;
+    };
+}
+
+#endif
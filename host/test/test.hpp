@@ -0,0 +1,32 @@
+#ifndef HUB_HOST_TEST_HPP
+#define HUB_HOST_TEST_HPP
+
+#include <cstdio>
+#include <string_view>
+
+namespace test
+{
+    inline int g_failures{ 0 };
+
+    /**
+     * @brief Report a failed check without stopping the test, main returns failed() as the exit code.
+     */
+    inline void check(bool condition, std::string_view what, const char* file, int line) noexcept
+    {
+        if (!condition)
+        {
+            std::printf("%s:%i: check failed: %.*s\n", file, line, static_cast<int>(what.size()), what.data());
+            g_failures++;
+        }
+    }
+
+    inline int failed() noexcept
+    {
+        std::printf("%i checks failed\n", g_failures);
+        return g_failures == 0 ? 0 : 1;
+    }
+}
+
+#define CHECK(condition) test::check((condition), #condition, __FILE__, __LINE__)
+
+#endif
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "test.hpp"
+
+#include <atomic>
+#include <memory>
+
+#include "esp_log.h"
+
+#include "ble/client.hpp"
+#include "ble/service.hpp"
+#include "shim/bluedroid.hpp"
+#include "utils/mac.hpp"
+
+namespace
+{
+    constexpr uint8_t ADDRESS_A[] = { 0xa4, 0xc1, 0x38, 0x00, 0x00, 0x0a };
+    constexpr uint8_t ADDRESS_B[] = { 0xa4, 0xc1, 0x38, 0x00, 0x00, 0x0b };
+
+    constexpr esp_bt_uuid_t SERVICE_A{ ESP_UUID_LEN_16, { 0x180a } };
+    constexpr esp_bt_uuid_t SERVICE_B{ ESP_UUID_LEN_16, { 0x180f } };
+
+    struct slot
+    {
+        std::shared_ptr<hub::ble::client>   client{ std::make_shared<hub::ble::client>() };
+        std::atomic<int>                    lost{ 0 };
+
+        slot()
+        {
+            client->set_disconnect_handler([this](esp_gatt_conn_reason_t) { lost++; });
+        }
+    };
+
+    std::shared_ptr<shim::bluedroid::peripheral> make_peripheral(esp_bt_uuid_t service)
+    {
+        auto device = std::make_shared<shim::bluedroid::peripheral>();
+        device->add_service(service);
+        device->add_characteristic(esp_bt_uuid_t{ ESP_UUID_LEN_16, { 0x2a24 } }, ESP_GATT_CHAR_PROP_BIT_READ, { 'x' });
+        return device;
+    }
+
+    /**
+     * @brief Connection events are reported to every registered application, each client only takes its own.
+     */
+    void test_connection_events()
+    {
+        const hub::utils::mac address_a(ADDRESS_A, ADDRESS_A + sizeof(ADDRESS_A));
+        const hub::utils::mac address_b(ADDRESS_B, ADDRESS_B + sizeof(ADDRESS_B));
+
+        shim::bluedroid::add_peripheral(ADDRESS_A, make_peripheral(SERVICE_A));
+        shim::bluedroid::add_peripheral(ADDRESS_B, make_peripheral(SERVICE_B));
+
+        slot a;
+        slot b;
+
+        CHECK(a.client->connect(address_a).has_value());
+        CHECK(b.client->connect(address_b).has_value());
+
+        CHECK(a.client->get_address() == address_a);
+        CHECK(b.client->get_address() == address_b);
+
+        // Requests go out on the connection of the client.
+        CHECK(a.client->get_service_by_uuid(&SERVICE_A).has_value());
+        CHECK(b.client->get_service_by_uuid(&SERVICE_B).has_value());
+
+        // Closing one link leaves the other connected.
+        CHECK(a.client->disconnect().has_value());
+        shim::bluedroid::flush();
+
+        CHECK(!a.client->is_connected());
+        CHECK(b.client->is_connected());
+        CHECK(a.lost == 0);
+        CHECK(b.lost == 0);
+
+        CHECK(a.client->connect(address_a).has_value());
+
+        // Losing one link is reported to its client only.
+        shim::bluedroid::drop_connection(ADDRESS_B);
+        shim::bluedroid::flush();
+
+        CHECK(a.client->is_connected());
+        CHECK(!b.client->is_connected());
+        CHECK(a.lost == 0);
+        CHECK(b.lost == 1);
+
+        CHECK(a.client->get_service_by_uuid(&SERVICE_A).has_value());
+
+        a.client->disconnect();
+        b.client->disconnect();
+        shim::bluedroid::flush();
+    }
+}
+
+int main()
+{
+    esp_log_level_set("*", ESP_LOG_WARN);
+
+    test_connection_events();
+
+    shim::bluedroid::reset();
+
+    return test::failed();
+}
@@ -0,0 +1,176 @@
+#include "test.hpp"
+
+#include <string_view>
+
+#include "utils/json_writer.hpp"
+
+namespace
+{
+    using namespace std::literals;
+
+    using hub::utils::json::fixed_writer;
+
+    /**
+     * @brief Writer followed by a guard, writes past the buffer land in the writer state or the guard.
+     */
+    template<std::size_t Capacity>
+    struct guarded_writer
+    {
+        fixed_writer<Capacity>  writer;
+        char                    guard[8]{ 'g', 'g', 'g', 'g', 'g', 'g', 'g', 'g' };
+
+        bool is_intact() const noexcept
+        {
+            return writer.view().size() <= Capacity && std::string_view(guard, sizeof(guard)) == "gggggggg"sv;
+        }
+    };
+
+    void test_document()
+    {
+        fixed_writer<64> writer;
+
+        writer.start_object();
+        writer.key("a");
+        writer.number(uint32_t{ 1 });
+        writer.key("b");
+        writer.number(int32_t{ -2 });
+        writer.key("c");
+        writer.start_array();
+        writer.boolean(true);
+        writer.null();
+        writer.string("x");
+        writer.start_object();
+        writer.end_object();
+        writer.end_array();
+        writer.end_object();
+
+        CHECK(writer.is_valid());
+        CHECK(writer.view() == R"({"a":1,"b":-2,"c":[true,null,"x",{}]})"sv);
+
+        writer.clear();
+        writer.start_array();
+        writer.end_array();
+
+        CHECK(writer.is_valid());
+        CHECK(writer.view() == "[]"sv);
+    }
+
+    void test_escape()
+    {
+        fixed_writer<64> writer;
+
+        writer.start_object();
+        writer.key("k\"");
+        writer.string("a\\b\n\x1f");
+        writer.key("plain");
+        writer.string("");
+        writer.end_object();
+
+        CHECK(writer.is_valid());
+        CHECK(writer.view() == R"({"k\"":"a\\b\u000a\u001f","plain":""})"sv);
+    }
+
+    void test_exact_capacity()
+    {
+        // "ab\\cd" takes exactly 8 bytes once escaped.
+        {
+            guarded_writer<8> out;
+            out.writer.string("ab\\cd");
+
+            CHECK(out.is_intact());
+            CHECK(out.writer.is_valid());
+            CHECK(out.writer.view() == R"("ab\\cd")"sv);
+        }
+
+        {
+            guarded_writer<7> out;
+            out.writer.string("ab\\cd");
+
+            CHECK(out.is_intact());
+            CHECK(!out.writer.is_valid());
+        }
+
+        {
+            guarded_writer<4> out;
+            out.writer.string("ab");
+
+            CHECK(out.is_intact());
+            CHECK(out.writer.is_valid());
+            CHECK(out.writer.view() == R"("ab")"sv);
+        }
+
+        {
+            guarded_writer<3> out;
+            out.writer.string("ab");
+
+            CHECK(out.is_intact());
+            CHECK(!out.writer.is_valid());
+        }
+
+        // The last value fills the buffer exactly, the closing bracket does not fit.
+        {
+            guarded_writer<15> out;
+            out.writer.start_object();
+            out.writer.key("a");
+            out.writer.number(uint32_t{ 1 });
+            out.writer.key("b");
+            out.writer.null();
+
+            CHECK(out.is_intact());
+            CHECK(out.writer.view() == R"({"a":1,"b":null)"sv);
+
+            out.writer.end_object();
+
+            CHECK(out.is_intact());
+            CHECK(!out.writer.is_valid());
+        }
+
+        {
+            guarded_writer<16> out;
+            out.writer.start_object();
+            out.writer.key("a");
+            out.writer.string("\"");
+            out.writer.key("b");
+            out.writer.boolean(false);
+            out.writer.end_object();
+
+            CHECK(out.is_intact());
+            CHECK(!out.writer.is_valid());
+        }
+
+        {
+            guarded_writer<20> out;
+            out.writer.start_object();
+            out.writer.key("a");
+            out.writer.string("\"");
+            out.writer.key("b");
+            out.writer.boolean(false);
+            out.writer.end_object();
+
+            CHECK(out.is_intact());
+            CHECK(out.writer.is_valid());
+            CHECK(out.writer.view() == R"({"a":"\"","b":false})"sv);
+        }
+    }
+
+    void test_unbalanced()
+    {
+        fixed_writer<16> writer;
+
+        writer.start_object();
+        CHECK(!writer.is_valid());
+
+        writer.end_object();
+        CHECK(writer.is_valid());
+    }
+}
+
+int main()
+{
+    test_document();
+    test_escape();
+    test_exact_capacity();
+    test_unbalanced();
+
+    return test::failed();
+}